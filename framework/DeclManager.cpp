@@ -18,6 +18,7 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 #include "LoadStack.h"
 
 #include "DeclSubtitles.h"
+#include "containers/ProducerConsumerQueue.h"
 
 
 /*
@@ -74,6 +75,7 @@ class idDeclFile;
 class idDeclLocal : public idDeclBase {
 	friend class idDeclFile;
 	friend class idDeclManagerLocal;
+	friend class idDeclScanTest;
 
 public:
 								idDeclLocal();
@@ -144,6 +146,37 @@ private:
 	idDeclLocal *				nextInFile;				// next decl in the decl file
 };
 
+// location of one decl in decl file, as found by scanning
+typedef struct {
+	declType_t					type;
+	idStr						name;
+	int							offset;
+	int							length;
+	int							line;
+} declFileEntry_t;
+
+// result of tokenizing decl file for decl boundaries
+// it does not depend on decl manager state, so many files can be scanned in parallel
+class idDeclFileScan {
+public:
+								idDeclFileScan() : buffer( NULL ), length( -1 ), timestamp( 0 ), checksum( 0 ), numLines( 0 ), numWarnings( 0 ), fromCache( false ) {}
+								~idDeclFileScan() { Clear(); }
+
+	void						Clear();
+	void						FreeBuffer();
+
+	char *						buffer;
+	int							length;
+	ID_TIME_T					timestamp;
+	int							checksum;
+	int							numLines;
+	int							numWarnings;			// such scans are not put into index cache
+	bool						fromCache;				// entries were taken from index cache, tokenizing skipped
+	idList<declFileEntry_t>		entries;
+};
+
+class idDeclIndexCache;
+
 class idDeclFile {
 public:
 								idDeclFile();
@@ -152,6 +185,12 @@ public:
 	void						Reload( bool force );
 	int							LoadAndParse();
 
+								// reads file and finds decls in it
+								// thread-safe as long as decl types are not registered concurrently
+	bool						Scan( idDeclFileScan &scan, const idDeclIndexCache *cache = NULL ) const;
+								// creates / updates decls from scanned file
+	int							ApplyScan( idDeclFileScan &scan );
+
 public:
 	idStr						fileName;
 	declType_t					defaultType;
@@ -166,8 +205,52 @@ public:
 	idDeclLocal *				decls;
 };
 
+/*
+Decl index cache: remembers decl boundaries found in every scanned decl file.
+Stored in fscache/ under fs_savepath, and allows to skip tokenizing of unchanged files on startup.
+A record is valid only if file checksum and size match, and the set of registered decl types is the same.
+*/
+typedef struct {
+	idStr						fileName;
+	declType_t					defaultType;
+	int							typesSignature;			// see idDeclManagerLocal::GetDeclTypesSignature
+	int							checksum;
+	int							length;
+	int							numLines;
+	idList<declFileEntry_t>		entries;
+} declIndexRecord_t;
+
+class idDeclIndexCache {
+public:
+								idDeclIndexCache() : typesSignature( 0 ), dirty( false ) {}
+								~idDeclIndexCache() { Clear(); }
+
+	void						Clear();
+	bool						Load( const char *OSPath );
+	bool						Save( const char *OSPath );
+
+	void						SetTypesSignature( int signature ) { typesSignature = signature; }
+	bool						IsDirty() const { return dirty; }
+	int							Num() const { return records.Num(); }
+
+								// returns record matching file contents, or NULL if file must be tokenized
+								// thread-safe if cache is not modified concurrently
+	const declIndexRecord_t *	Find( const idDeclFile &file, int checksum, int length ) const;
+								// remembers decls of freshly scanned file
+	void						Store( const idDeclFile &file, const idDeclFileScan &scan );
+
+private:
+	idList<declIndexRecord_t *>	records;
+	idHashIndex					hash;
+	int							typesSignature;
+	bool						dirty;
+
+	int							FindIndex( const char *fileName ) const;
+};
+
 class idDeclManagerLocal : public idDeclManager {
 	friend class idDeclLocal;
+	friend class idDeclScanTest;
 
 public:
 	virtual void				Init( void ) override;
@@ -221,6 +304,7 @@ public:
 	idDeclType *				GetDeclType( int type ) const { return declTypes[type]; }
 	const idDeclFile *			GetImplicitDeclFile( void ) const { return &implicitDecls; }
 	idList<idDeclFile*> &		GetLoadedFiles() { return loadedFiles; }
+	int							GetDeclTypesSignature( void ) const;
 
 private:
 	idList<idDeclType *>		declTypes;
@@ -237,15 +321,25 @@ private:
 	bool						insideLevelLoad;
 	LoadStack					loadStack;
 
+	idDeclIndexCache			indexCache;
+	bool						indexCacheLoaded;
+
 	static idCVar				decl_show;
+	static idCVar				decl_indexCache;
+	static idCVar				decl_loadParallel;
 
 private:
+	idStr						GetIndexCachePath( void ) const;
+	void						LoadAndParseFiles( int first, int last );
+
 	static void					ListDecls_f( const idCmdArgs &args );
 	static void					ReloadDecls_f( const idCmdArgs &args );
 	static void					TouchDecl_f( const idCmdArgs &args );
 };
 
 idCVar idDeclManagerLocal::decl_show( "decl_show", "0", CVAR_SYSTEM, "set to 1 to print parses, 2 to also print references", 0, 2, idCmdSystem::ArgCompletion_Integer<0,2> );
+idCVar idDeclManagerLocal::decl_indexCache( "decl_indexCache", "1", CVAR_SYSTEM | CVAR_BOOL, "cache decl boundaries of every decl file in fscache/ under fs_savepath to avoid tokenizing unchanged decl files on startup" );
+idCVar idDeclManagerLocal::decl_loadParallel( "decl_loadParallel", "1", CVAR_SYSTEM | CVAR_BOOL, "scan decl files for decl boundaries in parallel jobs" );
 idCVar decl_skip_redefine_warning(
 	"decl_skip_redefine_warning", "cf;", CVAR_SYSTEM,
 	"Conditionally suppress 'decl X previously defined at Y' warnings.\n"
@@ -616,50 +710,71 @@ void idDeclFile::Reload( bool force ) {
 
 /*
 ================
-idDeclFile::LoadAndParse
+idDeclFileScan::Clear
+================
+*/
+void idDeclFileScan::Clear() {
+	FreeBuffer();
+	length = -1;
+	entries.Clear();
+	fromCache = false;
+	numWarnings = 0;
+}
 
-This is used during both the initial load, and any reloads
+/*
+================
+idDeclFileScan::FreeBuffer
 ================
 */
-int c_savedMemory = 0;
+void idDeclFileScan::FreeBuffer() {
+	if ( buffer ) {
+		Mem_Free( buffer );
+		buffer = NULL;
+	}
+}
 
-int idDeclFile::LoadAndParse() {
+/*
+================
+idDeclFile::Scan
+
+Loads the text and identifies each individual declaration in it.
+Does not touch decls or decl manager state, so it can be called from parallel jobs.
+================
+*/
+bool idDeclFile::Scan( idDeclFileScan &scan, const idDeclIndexCache *cache ) const {
 	int			i, numTypes;
 	idLexer		src;
 	idToken		token;
 	int			startMarker;
-	char *		buffer;
-	int			length, size;
 	int			sourceLine;
-	idStr		name;
-	idDeclLocal *newDecl;
-	bool		reparse;
+	declFileEntry_t entry;
+
+	scan.Clear();
 
 	// load the text
 	common->DPrintf( "...loading '%s'\n", fileName.c_str() );
-	length = fileSystem->ReadFile( fileName, (void **)&buffer, &timestamp );
-	if ( length == -1 ) {
-		common->FatalError( "couldn't load %s", fileName.c_str() );
-		return 0;
+	scan.length = fileSystem->ReadFile( fileName, (void **)&scan.buffer, &scan.timestamp );
+	if ( scan.length == -1 ) {
+		return false;
 	}
 
-	if ( !src.LoadMemory( buffer, length, fileName ) ) {
-		common->Error( "Couldn't parse %s", fileName.c_str() );
-		Mem_Free( buffer );
-		return 0;
+	scan.checksum = MD5_BlockChecksum( scan.buffer, scan.length );
+
+	if ( cache ) {
+		if ( const declIndexRecord_t *record = cache->Find( *this, scan.checksum, scan.length ) ) {
+			scan.entries = record->entries;
+			scan.numLines = record->numLines;
+			scan.fromCache = true;
+			return true;
+		}
 	}
 
-	// mark all the defs that were from the last reload of this file
-	for ( idDeclLocal *decl = decls; decl; decl = decl->nextInFile ) {
-		decl->redefinedInReload = false;
+	if ( !src.LoadMemory( scan.buffer, scan.length, fileName ) ) {
+		return false;
 	}
 
 	src.SetFlags( DECL_LEXER_FLAGS );
 
-	checksum = MD5_BlockChecksum( buffer, length );
-
-	fileSize = length;
-
 	// scan through, identifying each individual declaration
 	while( 1 ) {
 
@@ -689,6 +804,7 @@ int idDeclFile::LoadAndParse() {
 
 				// if we ever see an open brace, we somehow missed the [type] <name> prefix
 				src.Warning( "Missing decl name" );
+				scan.numWarnings++;
 				src.SkipBracedSection( false );
 				continue;
 
@@ -696,6 +812,7 @@ int idDeclFile::LoadAndParse() {
 
 				if ( defaultType == DECL_MAX_TYPES ) {
 					src.Warning( "No type" );
+					scan.numWarnings++;
 					continue;
 				}
 				src.UnreadToken( &token );
@@ -715,12 +832,14 @@ int idDeclFile::LoadAndParse() {
 		// now parse the name
 		if ( !src.ReadToken( &token ) ) {
 			src.Warning( "Type without definition at end of file" );
+			scan.numWarnings++;
 			break;
 		}
 
 		if ( !token.Icmp( "{" ) ) {
 			// if we ever see an open brace, we somehow missed the [type] <name> prefix
 			src.Warning( "Missing decl name" );
+			scan.numWarnings++;
 			src.SkipBracedSection( false );
 			continue;
 		}
@@ -731,26 +850,66 @@ int idDeclFile::LoadAndParse() {
 			continue;
 		}
 
-		name = token;
+		entry.type = identifiedType;
+		entry.name = token;
 
 		// make sure there's a '{'
 		if ( !src.ReadToken( &token ) ) {
 			src.Warning( "Type without definition at end of file" );
+			scan.numWarnings++;
 			break;
 		}
 		if ( token != "{" ) {
 			src.Warning( "Expecting '{' but found '%s'", token.c_str() );
+			scan.numWarnings++;
 			continue;
 		}
 		src.UnreadToken( &token );
 
 		// now take everything until a matched closing brace
 		src.SkipBracedSection();
-		size = src.GetFileOffset() - startMarker;
+
+		entry.offset = startMarker;
+		entry.length = src.GetFileOffset() - startMarker;
+		entry.line = sourceLine;
+		scan.entries.Append( entry );
+	}
+
+	if ( src.HadError() ) {
+		scan.numWarnings++;
+	}
+	scan.numLines = src.GetLineNum();
+
+	return true;
+}
+
+/*
+================
+idDeclFile::ApplyScan
+
+Creates new decls and updates existing ones from the scanned file.
+Must be called from main thread, in the order in which files should override each other.
+================
+*/
+int idDeclFile::ApplyScan( idDeclFileScan &scan ) {
+	idDeclLocal *newDecl;
+	bool		reparse;
+
+	timestamp = scan.timestamp;
+	checksum = scan.checksum;
+	fileSize = scan.length;
+
+	// mark all the defs that were from the last reload of this file
+	for ( idDeclLocal *decl = decls; decl; decl = decl->nextInFile ) {
+		decl->redefinedInReload = false;
+	}
+
+	for ( int i = 0; i < scan.entries.Num(); i++ ) {
+		const declFileEntry_t &entry = scan.entries[i];
 
 		// look it up, possibly getting a newly created default decl
 		reparse = false;
-		newDecl = declManagerLocal.FindTypeWithoutParsing( identifiedType, name, false );
+		newDecl = declManagerLocal.FindTypeWithoutParsing( entry.type, entry.name, false );
 		if ( newDecl ) {
 			// update the existing copy
 			if ( newDecl->sourceFile != this || newDecl->redefinedInReload ) {
@@ -764,11 +923,12 @@ int idDeclFile::LoadAndParse() {
 				assert( !internalError );	// should never happen
 
 				if ( !suppress ) {
-					src.Warning(
-						"%s%s '%s' previously defined at %s:%i",
+					common->Warning(
+						"file %s, line %d: %s%s '%s' previously defined at %s:%i",
+						fileName.c_str(), entry.line,
 						(internalError ? "INTERNAL ERROR! " : ""),
-						declManagerLocal.GetDeclNameFromType( identifiedType ),
-						name.c_str(), newDecl->sourceFile->fileName.c_str(), newDecl->sourceLine
+						declManagerLocal.GetDeclNameFromType( entry.type ),
+						entry.name.c_str(), newDecl->sourceFile->fileName.c_str(), newDecl->sourceLine
 					);
 				}
 
@@ -780,7 +940,7 @@ int idDeclFile::LoadAndParse() {
 			}
 		} else {
 			// allow it to be created as a default, then add it to the per-file list
-			newDecl = declManagerLocal.FindTypeWithoutParsing( identifiedType, name, true );
+			newDecl = declManagerLocal.FindTypeWithoutParsing( entry.type, entry.name, true );
 			newDecl->nextInFile = this->decls;
 			this->decls = newDecl;
 		}
@@ -792,11 +952,11 @@ int idDeclFile::LoadAndParse() {
 			newDecl->textSource = NULL;
 		}
 
-		newDecl->SetTextLocal( buffer + startMarker, size );
+		newDecl->SetTextLocal( scan.buffer + entry.offset, entry.length );
 		newDecl->sourceFile = this;
-		newDecl->sourceTextOffset = startMarker;
-		newDecl->sourceTextLength = size;
-		newDecl->sourceLine = sourceLine;
+		newDecl->sourceTextOffset = entry.offset;
+		newDecl->sourceTextLength = entry.length;
+		newDecl->sourceLine = entry.line;
 		newDecl->declState = DS_UNPARSED;
 
 		// if it is currently in use, reparse it immedaitely
@@ -805,9 +965,7 @@ int idDeclFile::LoadAndParse() {
 		}
 	}
 
-	numLines = src.GetLineNum();
-
-	Mem_Free( buffer );
+	numLines = scan.numLines;
 
 	// any defs that weren't redefinedInReload should now be defaulted
 	for ( idDeclLocal *decl = decls ; decl ; decl = decl->nextInFile ) {
@@ -824,6 +982,224 @@ int idDeclFile::LoadAndParse() {
 	return checksum;
 }
 
+/*
+================
+idDeclFile::LoadAndParse
+
+This is used during both the initial load, and any reloads
+================
+*/
+int c_savedMemory = 0;
+
+int idDeclFile::LoadAndParse() {
+	idDeclFileScan scan;
+
+	if ( !Scan( scan ) ) {
+		if ( scan.length == -1 ) {
+			common->FatalError( "couldn't load %s", fileName.c_str() );
+		} else {
+			common->Error( "Couldn't parse %s", fileName.c_str() );
+		}
+		return 0;
+	}
+
+	return ApplyScan( scan );
+}
+
+/*
+====================================================================================
+
+ idDeclIndexCache
+
+====================================================================================
+*/
+
+#define DECL_INDEX_MAGIC	"TDMDECLIX"
+#define DECL_INDEX_VERSION	1
+
+/*
+================
+idDeclIndexCache::Clear
+================
+*/
+void idDeclIndexCache::Clear() {
+	records.DeleteContents( true );
+	hash.ClearFree();
+	dirty = false;
+}
+
+/*
+================
+idDeclIndexCache::FindIndex
+================
+*/
+int idDeclIndexCache::FindIndex( const char *fileName ) const {
+	int key = hash.GenerateKey( fileName, false );
+	for ( int i = hash.First( key ); i != -1; i = hash.Next( i ) ) {
+		if ( records[i]->fileName.Icmp( fileName ) == 0 ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+================
+idDeclIndexCache::Find
+================
+*/
+const declIndexRecord_t *idDeclIndexCache::Find( const idDeclFile &file, int checksum, int length ) const {
+	int idx = FindIndex( file.fileName );
+	if ( idx < 0 ) {
+		return NULL;
+	}
+	const declIndexRecord_t *record = records[idx];
+	if ( record->checksum != checksum || record->length != length || record->defaultType != file.defaultType || record->typesSignature != typesSignature ) {
+		return NULL;
+	}
+	return record;
+}
+
+/*
+================
+idDeclIndexCache::Store
+================
+*/
+void idDeclIndexCache::Store( const idDeclFile &file, const idDeclFileScan &scan ) {
+	int idx = FindIndex( file.fileName );
+	declIndexRecord_t *record;
+	if ( idx >= 0 ) {
+		record = records[idx];
+	} else {
+		record = new declIndexRecord_t;
+		record->fileName = file.fileName;
+		hash.Add( hash.GenerateKey( file.fileName, false ), records.Append( record ) );
+	}
+	record->defaultType = file.defaultType;
+	record->typesSignature = typesSignature;
+	record->checksum = scan.checksum;
+	record->length = scan.length;
+	record->numLines = scan.numLines;
+	record->entries = scan.entries;
+	dirty = true;
+}
+
+/*
+================
+idDeclIndexCache::Load
+
+Whole contents is protected by checksum, so truncated or damaged file is rejected.
+================
+*/
+bool idDeclIndexCache::Load( const char *OSPath ) {
+	Clear();
+
+	idFile *f = fileSystem->OpenExplicitFileRead( OSPath );
+	if ( !f ) {
+		return false;
+	}
+
+	idStr magic;
+	int version = -1, size = -1, dataChecksum = 0;
+	f->ReadString( magic );
+	f->ReadInt( version );
+	f->ReadInt( size );
+	f->ReadInt( dataChecksum );
+	bool ok = ( magic == DECL_INDEX_MAGIC && version == DECL_INDEX_VERSION && size >= 0 && size == f->Length() - f->Tell() );
+	idList<char> data;
+	if ( ok ) {
+		data.SetNum( size );
+		ok = ( f->Read( data.Ptr(), size ) == size && MD5_BlockChecksum( data.Ptr(), size ) == dataChecksum );
+	}
+	fileSystem->CloseFile( f );
+	if ( !ok ) {
+		return false;
+	}
+
+	idFile_Memory mem( "declindex", data.Ptr(), data.Num() );
+	int numRecords = 0;
+	mem.ReadInt( numRecords );
+	for ( int i = 0; ok && i < numRecords; i++ ) {
+		declIndexRecord_t *record = new declIndexRecord_t;
+		int defaultType = 0, numEntries = 0;
+		mem.ReadString( record->fileName );
+		mem.ReadInt( defaultType );
+		mem.ReadInt( record->typesSignature );
+		mem.ReadInt( record->checksum );
+		mem.ReadInt( record->length );
+		mem.ReadInt( record->numLines );
+		mem.ReadInt( numEntries );
+		record->defaultType = (declType_t)defaultType;
+
+		record->entries.SetNum( numEntries );
+		for ( int j = 0; j < numEntries; j++ ) {
+			declFileEntry_t &entry = record->entries[j];
+			int type = 0;
+			mem.ReadInt( type );
+			mem.ReadString( entry.name );
+			mem.ReadInt( entry.offset );
+			mem.ReadInt( entry.length );
+			mem.ReadInt( entry.line );
+			entry.type = (declType_t)type;
+			// decl text must be within file, or we would read out of buffer
+			ok = ok && entry.offset >= 0 && entry.length >= 0 && entry.offset + entry.length <= record->length;
+			ok = ok && type >= 0 && type < DECL_MAX_TYPES;
+		}
+
+		hash.Add( hash.GenerateKey( record->fileName, false ), records.Append( record ) );
+	}
+
+	if ( !ok ) {
+		Clear();
+		return false;
+	}
+	dirty = false;
+	return true;
+}
+
+/*
+================
+idDeclIndexCache::Save
+================
+*/
+bool idDeclIndexCache::Save( const char *OSPath ) {
+	idFile_Memory mem( "declindex" );
+	mem.WriteInt( records.Num() );
+	for ( int i = 0; i < records.Num(); i++ ) {
+		const declIndexRecord_t *record = records[i];
+		mem.WriteString( record->fileName );
+		mem.WriteInt( record->defaultType );
+		mem.WriteInt( record->typesSignature );
+		mem.WriteInt( record->checksum );
+		mem.WriteInt( record->length );
+		mem.WriteInt( record->numLines );
+		mem.WriteInt( record->entries.Num() );
+		for ( int j = 0; j < record->entries.Num(); j++ ) {
+			const declFileEntry_t &entry = record->entries[j];
+			mem.WriteInt( entry.type );
+			mem.WriteString( entry.name );
+			mem.WriteInt( entry.offset );
+			mem.WriteInt( entry.length );
+			mem.WriteInt( entry.line );
+		}
+	}
+
+	fileSystem->CreateOSPath( OSPath );
+	idFile *f = fileSystem->OpenExplicitFileWrite( OSPath );
+	if ( !f ) {
+		return false;
+	}
+	f->WriteString( DECL_INDEX_MAGIC );
+	f->WriteInt( DECL_INDEX_VERSION );
+	f->WriteInt( mem.Length() );
+	f->WriteInt( MD5_BlockChecksum( mem.GetDataPtr(), mem.Length() ) );
+	bool ok = ( f->Write( mem.GetDataPtr(), mem.Length() ) == mem.Length() );
+	fileSystem->CloseFile( f );
+
+	dirty = false;
+	return ok;
+}
+
 /*
 ====================================================================================
 
@@ -844,6 +1220,7 @@ void idDeclManagerLocal::Init( void ) {
 	common->Printf( "----- Initializing Decls -----\n" );
 
 	checksum = 0;
+	indexCacheLoaded = false;
 
 #ifdef USE_COMPRESSED_DECLS
 	SetupHuffman();
@@ -933,6 +1310,8 @@ void idDeclManagerLocal::Shutdown( void ) {
 
 	// free decl files
 	loadedFiles.DeleteContents( true );
+	indexCache.Clear();
+	indexCacheLoaded = false;
 
 	// free the decl types and folders
 	declTypes.DeleteContents( true );
@@ -1125,8 +1504,166 @@ void idDeclManagerLocal::RegisterDeclFolder( const char *folder, const char *ext
 	}
 
 	// load and parse added decl files
-	for ( i = previouslyLoadedNum; i < loadedFiles.Num(); i++ ) {
-		loadedFiles[i]->LoadAndParse();
+	LoadAndParseFiles( previouslyLoadedNum, loadedFiles.Num() );
+}
+
+/*
+===================
+idDeclManagerLocal::GetDeclTypesSignature
+
+Scanning result depends on which decl types are registered.
+===================
+*/
+int idDeclManagerLocal::GetDeclTypesSignature( void ) const {
+	idStr text;
+	for ( int i = 0; i < declTypes.Num(); i++ ) {
+		if ( declTypes[i] ) {
+			text += va( "%s=%d;", declTypes[i]->typeName.c_str(), (int)declTypes[i]->type );
+		}
+	}
+	return MD5_BlockChecksum( text.c_str(), text.Length() );
+}
+
+/*
+===================
+idDeclManagerLocal::GetIndexCachePath
+===================
+*/
+idStr idDeclManagerLocal::GetIndexCachePath( void ) const {
+	const char *savePath = cvarSystem->GetCVarString( "fs_savepath" );
+	if ( !savePath[0] ) {
+		return "";
+	}
+	return fileSystem->BuildOSPath( savePath, "fscache", "declindex.dat" );
+}
+
+/*
+===================
+idDeclManagerLocal::LoadAndParseFiles
+
+Loads and parses loadedFiles[first..last).
+Files are scanned in parallel jobs, but decls are created strictly in file order,
+so the result is exactly the same as if files were processed one by one.
+===================
+*/
+void idDeclManagerLocal::LoadAndParseFiles( int first, int last ) {
+	int n = last - first;
+	if ( n <= 0 ) {
+		return;
+	}
+
+	idStr cachePath;
+	if ( decl_indexCache.GetBool() ) {
+		cachePath = GetIndexCachePath();
+	}
+	const idDeclIndexCache *cache = NULL;
+	if ( cachePath.Length() ) {
+		if ( !indexCacheLoaded ) {
+			indexCache.Load( cachePath );
+			indexCacheLoaded = true;
+		}
+		indexCache.SetTypesSignature( GetDeclTypesSignature() );
+		cache = &indexCache;
+	}
+
+	struct ScanJob {
+		idDeclFile *file;
+		const idDeclIndexCache *cache;
+		idDeclFileScan scan;
+		bool ok;
+		idStrList warnings;		// scan warnings from job thread, printed when merged
+	};
+	idList<ScanJob> jobs;
+	jobs.SetNum( n );
+	for ( int i = 0; i < n; i++ ) {
+		jobs[i].file = loadedFiles[first + i];
+		jobs[i].cache = cache;
+		jobs[i].ok = false;
+	}
+
+	// returns false if the file failed to load, then ScanFailed must be called
+	auto MergeJob = []( ScanJob &job ) -> bool {
+		idLexerMessages::Print( job.warnings );
+		if ( !job.ok ) {
+			return false;
+		}
+		job.file->ApplyScan( job.scan );
+		return true;
+	};
+	auto ScanFailed = []( const ScanJob &job ) {
+		if ( job.scan.length == -1 ) {
+			common->FatalError( "couldn't load %s", job.file->fileName.c_str() );
+		} else {
+			common->Error( "Couldn't parse %s", job.file->fileName.c_str() );
+		}
+	};
+
+	// note: job manager is not initialized yet when core decl folders are registered
+	if ( decl_loadParallel.GetBool() && n > 1 && parallelJobManager->GetNumProcessingUnits() > 1 ) {
+		static idProducerConsumerQueue<ScanJob*> queue;
+		queue.ClearFree();
+
+		auto ScanJobFunc = []( void *param ) {
+			ScanJob *job = (ScanJob *)param;
+			{
+				idLexerMessages messages;
+				job->ok = job->file->Scan( job->scan, job->cache );
+				job->warnings = messages.GetMessages();
+			}
+			queue.Append( job );
+		};
+		RegisterJob( ScanJobFunc, "scanDeclFile" );
+
+		idParallelJobList *joblist = parallelJobManager->AllocJobList( JOBLIST_UTILITY, JOBLIST_PRIORITY_MEDIUM, n, 0, nullptr );
+		for ( int i = 0; i < n; i++ ) {
+			joblist->AddJob( ScanJobFunc, &jobs[i] );
+		}
+		joblist->Submit( nullptr, JOBLIST_PARALLELISM_NONINTERACTIVE | JOBLIST_PARALLELISM_FLAG_DISK );
+
+		// merge files in order, as soon as all preceding files are scanned
+		idList<bool> finished;
+		finished.SetNum( n );
+		memset( finished.Ptr(), 0, n * sizeof( bool ) );
+		// after a failure nothing more is merged, but all jobs must finish before the error is raised
+		int finishedCount = 0, merged = 0, failed = -1;
+		while ( finishedCount < n ) {
+			ScanJob *job = queue.Pop();
+			finished[job - jobs.Ptr()] = true;
+			finishedCount++;
+			for ( ; failed == -1 && merged < n && finished[merged]; merged++ ) {
+				if ( !MergeJob( jobs[merged] ) ) {
+					failed = merged;
+				}
+				jobs[merged].scan.FreeBuffer();
+			}
+		}
+
+		parallelJobManager->FreeJobList( joblist );
+		queue.ClearFree();
+
+		if ( failed != -1 ) {
+			ScanFailed( jobs[failed] );
+		}
+	} else {
+		for ( int i = 0; i < n; i++ ) {
+			jobs[i].ok = jobs[i].file->Scan( jobs[i].scan, cache );
+			if ( !MergeJob( jobs[i] ) ) {
+				ScanFailed( jobs[i] );
+			}
+			jobs[i].scan.FreeBuffer();
+		}
+	}
+
+	if ( cache ) {
+		// cache is read by scanning jobs, so it is updated only after all of them have finished
+		for ( int i = 0; i < n; i++ ) {
+			if ( jobs[i].ok && !jobs[i].scan.fromCache && jobs[i].scan.numWarnings == 0 ) {
+				indexCache.Store( *jobs[i].file, jobs[i].scan );
+			}
+		}
+		if ( indexCache.IsDirty() && !indexCache.Save( cachePath ) ) {
+			common->Warning( "Failed to save decl index cache to %s", cachePath.c_str() );
+		}
 	}
 }
 
@@ -2355,3 +2892,167 @@ idDeclLocal::EverReferenced
 bool idDeclLocal::EverReferenced( void ) const {
 	return everReferenced;
 }
+
+
+#include "../tests/testing.h"
+
+// wraps the private parts of the decl manager used by the tests
+class idDeclScanTest {
+public:
+	static idList<idDeclFile *> &Files() {
+		return declManagerLocal.loadedFiles;
+	}
+	static int TypesSignature() {
+		return declManagerLocal.GetDeclTypesSignature();
+	}
+
+	// every decl found by scan must be the one registered in decl manager (unless overridden by another file)
+	static void CheckMatchesDecls( const idDeclFile *file, const idDeclFileScan &scan ) {
+		for ( int i = 0; i < scan.entries.Num(); i++ ) {
+			const declFileEntry_t &entry = scan.entries[i];
+			idDeclLocal *decl = declManagerLocal.FindTypeWithoutParsing( entry.type, entry.name, false );
+			REQUIRE( decl );
+			if ( decl->sourceFile == file ) {
+				CHECK( decl->sourceTextOffset == entry.offset );
+				CHECK( decl->sourceTextLength == entry.length );
+				CHECK( decl->sourceLine == entry.line );
+			}
+		}
+	}
+};
+
+static void DeclScanTest_CheckSameEntries( const idDeclFileScan &a, const idDeclFileScan &b ) {
+	CHECK( a.checksum == b.checksum );
+	CHECK( a.length == b.length );
+	CHECK( a.numLines == b.numLines );
+	REQUIRE( a.entries.Num() == b.entries.Num() );
+	for ( int i = 0; i < a.entries.Num(); i++ ) {
+		const declFileEntry_t &x = a.entries[i];
+		const declFileEntry_t &y = b.entries[i];
+		CHECK( x.type == y.type );
+		CHECK( x.name == y.name );
+		CHECK( x.offset == y.offset );
+		CHECK( x.length == y.length );
+		CHECK( x.line == y.line );
+	}
+}
+
+static void DeclScanTest_ScanParallel( idList<idDeclFileScan> &scans, const idDeclIndexCache *cache ) {
+	struct Job {
+		idDeclFile *file;
+		idDeclFileScan *scan;
+		const idDeclIndexCache *cache;
+	};
+	idList<idDeclFile *> &files = idDeclScanTest::Files();
+	idList<Job> jobs;
+	jobs.SetNum( files.Num() );
+	for ( int i = 0; i < files.Num(); i++ ) {
+		jobs[i] = { files[i], &scans[i], cache };
+	}
+	auto ScanJobFunc = []( void *param ) {
+		Job *job = (Job *)param;
+		job->file->Scan( *job->scan, job->cache );
+		job->scan->FreeBuffer();
+	};
+	RegisterJob( ScanJobFunc, "scanDeclFileTest" );
+	idParallelJobList *joblist = parallelJobManager->AllocJobList( JOBLIST_UTILITY, JOBLIST_PRIORITY_MEDIUM, jobs.Num(), 0, nullptr );
+	for ( int i = 0; i < jobs.Num(); i++ ) {
+		joblist->AddJob( ScanJobFunc, &jobs[i] );
+	}
+	joblist->Submit( nullptr, JOBLIST_PARALLELISM_NONINTERACTIVE | JOBLIST_PARALLELISM_FLAG_DISK );
+	joblist->Wait();
+	parallelJobManager->FreeJobList( joblist );
+}
+
+TEST_CASE("DeclManager:ParallelScan") {
+	idList<idDeclFile *> &files = idDeclScanTest::Files();
+	REQUIRE( files.Num() > 0 );
+
+	idList<idDeclFileScan> serial, parallel;
+	serial.SetNum( files.Num() );
+	parallel.SetNum( files.Num() );
+	for ( int i = 0; i < files.Num(); i++ ) {
+		REQUIRE( files[i]->Scan( serial[i] ) );
+		serial[i].FreeBuffer();
+		// loaded decls must be exactly what scan finds now
+		CHECK( serial[i].checksum == files[i]->checksum );
+		idDeclScanTest::CheckMatchesDecls( files[i], serial[i] );
+	}
+
+	DeclScanTest_ScanParallel( parallel, NULL );
+	for ( int i = 0; i < files.Num(); i++ ) {
+		DeclScanTest_CheckSameEntries( serial[i], parallel[i] );
+	}
+}
+
+TEST_CASE("DeclManager:IndexCache") {
+	idList<idDeclFile *> &files = idDeclScanTest::Files();
+	REQUIRE( files.Num() > 0 );
+	idStr cachePath = fileSystem->BuildOSPath( cvarSystem->GetCVarString( "fs_savepath" ), "tests", "declindex_test.dat" );
+
+	idDeclIndexCache cache;
+	cache.SetTypesSignature( idDeclScanTest::TypesSignature() );
+
+	idList<idDeclFileScan> uncached;
+	uncached.SetNum( files.Num() );
+	int numStored = 0;
+	for ( int i = 0; i < files.Num(); i++ ) {
+		REQUIRE( files[i]->Scan( uncached[i], &cache ) );
+		uncached[i].FreeBuffer();
+		CHECK( !uncached[i].fromCache );
+		if ( uncached[i].numWarnings == 0 ) {
+			cache.Store( *files[i], uncached[i] );
+			numStored++;
+		}
+	}
+	CHECK( cache.IsDirty() );
+	REQUIRE( cache.Save( cachePath ) );
+	CHECK( !cache.IsDirty() );
+
+	// decl lists must be same when loaded from cache
+	idDeclIndexCache loaded;
+	REQUIRE( loaded.Load( cachePath ) );
+	CHECK( loaded.Num() == numStored );
+	loaded.SetTypesSignature( idDeclScanTest::TypesSignature() );
+
+	idList<idDeclFileScan> cached;
+	cached.SetNum( files.Num() );
+	DeclScanTest_ScanParallel( cached, &loaded );
+	for ( int i = 0; i < files.Num(); i++ ) {
+		CHECK( cached[i].fromCache == ( uncached[i].numWarnings == 0 ) );
+		DeclScanTest_CheckSameEntries( uncached[i], cached[i] );
+		idDeclScanTest::CheckMatchesDecls( files[i], cached[i] );
+	}
+
+	SUBCASE( "Changed file is not taken from cache" ) {
+		const idDeclFileScan &scan = uncached[0];
+		CHECK( loaded.Find( *files[0], scan.checksum, scan.length ) != NULL );
+		CHECK( loaded.Find( *files[0], scan.checksum + 1, scan.length ) == NULL );
+		CHECK( loaded.Find( *files[0], scan.checksum, scan.length + 1 ) == NULL );
+	}
+
+	SUBCASE( "Registered decl types change invalidates cache" ) {
+		loaded.SetTypesSignature( idDeclScanTest::TypesSignature() + 1 );
+		const idDeclFileScan &scan = uncached[0];
+		CHECK( loaded.Find( *files[0], scan.checksum, scan.length ) == NULL );
+	}
+
+	SUBCASE( "Corrupted cache is rejected" ) {
+		idFile *f = fileSystem->OpenExplicitFileRead( cachePath );
+		REQUIRE( f );
+		idList<byte> data;
+		data.SetNum( f->Length() );
+		f->Read( data.Ptr(), data.Num() );
+		fileSystem->CloseFile( f );
+		f = fileSystem->OpenExplicitFileWrite( cachePath );
+		REQUIRE( f );
+		f->Write( data.Ptr(), data.Num() / 2 );
+		fileSystem->CloseFile( f );
+
+		idDeclIndexCache truncated;
+		CHECK( !truncated.Load( cachePath ) );
+		CHECK( truncated.Num() == 0 );
+	}
+
+	remove( cachePath );
+}
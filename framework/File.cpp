@@ -1221,6 +1221,8 @@ idFile_InZip::idFile_InZip( void ) {
 	fileSize = 0;
 	memset( &z, 0, sizeof( z ) );
 	domain = FDOM_UNKNOWN;
+	seekIndex = NULL;
+	handlePool = NULL;
 }
 
 /*
@@ -1229,8 +1231,16 @@ idFile_InZip::~idFile_InZip
 =================
 */
 idFile_InZip::~idFile_InZip( void ) {
-	unzCloseCurrentFile( z );
-	unzClose( z );
+	if ( handlePool ) {
+		handlePool->Return( z );
+		handlePool->Release();
+	} else {
+		unzCloseCurrentFile( z );
+		unzClose( z );
+	}
+	if ( seekIndex ) {
+		seekIndex->Release();
+	}
 }
 
 /*
@@ -1343,48 +1353,614 @@ int idFile_InZip::Seek( long offset, fsOrigin_t origin ) {
 	if (stdioOrigin == SEEK_CUR && offset == 0)
 		return 0; //noop
 
-	if (stdioOrigin == SEEK_END) {
-		//Note: meaning of offset is non-standard here!
-		offset = -offset;
-	}
+	//Note: meaning of offset is non-standard for FS_SEEK_END!
+	long stdioOffset = (stdioOrigin == SEEK_END ? -offset : offset);
 	//try to seek quickly in uncompressed zip:
-	int simpleSeekOk = unzseek64(z, offset, stdioOrigin);
+	int simpleSeekOk = unzseek64(z, stdioOffset, stdioOrigin);
 	if (simpleSeekOk == UNZ_OK)
 		return 0;
 
 	//zip is likely to be compressed, seek slowly then
 	//note that we have to read and decompress all intermediate data
 
-	int res, i;
-	char *buf;
-
+	int current = unztell( z );
+	int target;
 	switch( origin ) {
+		case FS_SEEK_SET: {
+			target = offset;
+			break;
+		}
+		case FS_SEEK_CUR: {
+			target = current + offset;
+			break;
+		}
 		case FS_SEEK_END: {
-			offset = fileSize - offset;
+			target = fileSize - offset;
+			break;
 		}
-		case FS_SEEK_SET: {
-			// set the file position in the zip file (also sets the current file info)
-			unzSetOffset64(z, zipFilePos);
-			unzOpenCurrentFile( z );
-			if ( offset <= 0 ) {
-				return 0;
+		default: {
+			common->FatalError( "idFile_InZip::Seek: bad origin for %s\n", name.c_str() );
+			return -1;
+		}
+	}
+	if ( target < 0 || target > fileSize ) {
+		return -1;
+	}
+
+	if ( seekIndex && ( target < current || target - current > seekIndex->GetSpan() ) ) {
+		// restart inflation from the closest seek point before target
+		const idZipSeekIndex::seekPoint_t *point = PrepareSeekPoint( target );
+		current = unztell( z );		// building index reopens the file
+		if ( point && ( target < current || (int)point->uncompressedPos > current ) ) {
+			int res = unzSeekToDeflatePoint(
+				z, point->compressedPos, point->bits, point->prevByte, point->uncompressedPos,
+				seekIndex->GetWindow( *point ), idZipSeekIndex::WINDOW_SIZE
+			);
+			if ( res == UNZ_OK ) {
+				current = (int)point->uncompressedPos;
 			}
 		}
-		case FS_SEEK_CUR: {
-			buf = (char *) _alloca16( ZIP_SEEK_BUF_SIZE );
-			for ( i = 0; i < ( offset - ZIP_SEEK_BUF_SIZE ); i += ZIP_SEEK_BUF_SIZE ) {
-				res = unzReadCurrentFile( z, buf, ZIP_SEEK_BUF_SIZE );
-				if ( res < ZIP_SEEK_BUF_SIZE ) {
-					return -1;
+	}
+
+	if ( target < current ) {
+		// set the file position in the zip file (also sets the current file info)
+		unzSetOffset64( z, zipFilePos );
+		unzOpenCurrentFile( z );
+		current = 0;
+	}
+	return SkipForward( target - current );
+}
+
+/*
+=================
+idFile_InZip::SkipForward
+
+  decompresses and drops given number of bytes
+=================
+*/
+int idFile_InZip::SkipForward( int count ) {
+	char *buf = (char *) _alloca16( ZIP_SEEK_BUF_SIZE );
+	while ( count > 0 ) {
+		int len = idMath::Imin( count, ZIP_SEEK_BUF_SIZE );
+		int res = unzReadCurrentFile( z, buf, len );
+		if ( res != len ) {
+			return -1;
+		}
+		count -= len;
+	}
+	return 0;
+}
+
+/*
+=================
+idFile_InZip::PrepareSeekPoint
+
+  builds seek index if it is not built yet
+  returns NULL if index cannot be used
+=================
+*/
+const idZipSeekIndex::seekPoint_t *idFile_InZip::PrepareSeekPoint( int pos ) {
+	idScopedCriticalSection lock( seekIndex->mutex );
+	if ( seekIndex->state == idZipSeekIndex::STATE_EMPTY ) {
+		if ( BuildSeekIndex() ) {
+			seekIndex->state = idZipSeekIndex::STATE_BUILT;
+		} else {
+			common->Warning( "idFile_InZip: failed to build seek index for %s", fullPath.c_str() );
+			seekIndex->state = idZipSeekIndex::STATE_FAILED;
+		}
+	}
+	if ( seekIndex->state != idZipSeekIndex::STATE_BUILT ) {
+		return NULL;
+	}
+	return &seekIndex->FindPoint( pos );
+}
+
+/*
+=================
+idFile_InZip::BuildSeekIndex
+
+  Inflates the whole file once, remembering a seek point at deflate block
+  boundary every span bytes (see zran.c in zlib examples).
+  Reopens the file, so that it is positioned at the beginning afterwards.
+=================
+*/
+bool idFile_InZip::BuildSeekIndex( void ) {
+	static const int WINDOW_SIZE = idZipSeekIndex::WINDOW_SIZE;
+	idZipSeekIndex &index = *seekIndex;
+
+	// read raw deflate stream of the file
+	int method = 0, level = 0;
+	unzSetOffset64( z, zipFilePos );
+	if ( unzOpenCurrentFile2( z, &method, &level, 1 ) != UNZ_OK || method != Z_DEFLATED ) {
+		unzSetOffset64( z, zipFilePos );
+		unzOpenCurrentFile( z );
+		return false;
+	}
+
+	z_stream strm;
+	memset( &strm, 0, sizeof( strm ) );
+	if ( inflateInit2( &strm, -MAX_WBITS ) != Z_OK ) {
+		unzSetOffset64( z, zipFilePos );
+		unzOpenCurrentFile( z );
+		return false;
+	}
+
+	// distance between points is at least span, so their number is bounded
+	int maxPoints = fileSize / index.span + 2;
+	index.points.Resize( maxPoints );
+	index.windows.Resize( maxPoints * WINDOW_SIZE );
+
+	// beginning of file: no dictionary needed
+	idZipSeekIndex::seekPoint_t &start = index.points.Alloc();
+	memset( &start, 0, sizeof( start ) );
+	index.windows.SetNum( WINDOW_SIZE, false );
+	memset( index.windows.Ptr(), 0, WINDOW_SIZE );
+
+	byte *input = (byte *)Mem_Alloc( ZIP_SEEK_BUF_SIZE );
+	byte *window = (byte *)Mem_Alloc( WINDOW_SIZE );
+	uint64_t totalIn = 0, totalOut = 0, lastOut = 0;
+	byte lastInputByte = 0;
+	bool ok = true, eof = false;
+	int ret = Z_OK;
+	do {
+		if ( strm.avail_in == 0 && !eof ) {
+			if ( strm.next_in ) {
+				lastInputByte = strm.next_in[-1];
+			}
+			int len = unzReadCurrentFile( z, input, ZIP_SEEK_BUF_SIZE );
+			if ( len < 0 ) {
+				ok = false;
+				break;
+			}
+			// note: inflate may need one more call after all input is consumed
+			eof = ( len == 0 );
+			strm.avail_in = len;
+			strm.next_in = ( len ? input : strm.next_in );
+		}
+		do {
+			// uncompressed data goes into circular window
+			if ( strm.avail_out == 0 ) {
+				strm.avail_out = WINDOW_SIZE;
+				strm.next_out = window;
+			}
+			totalIn += strm.avail_in;
+			totalOut += strm.avail_out;
+			ret = inflate( &strm, Z_BLOCK );
+			totalIn -= strm.avail_in;
+			totalOut -= strm.avail_out;
+			if ( ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR || ret == Z_BUF_ERROR ) {
+				ok = false;
+				break;
+			}
+			if ( ret == Z_STREAM_END ) {
+				break;
+			}
+			// at the end of a block (but not the last one), add point if it is far enough
+			bool blockEnd = ( strm.data_type & 128 ) && !( strm.data_type & 64 );
+			if ( blockEnd && totalOut - lastOut > (uint64_t)index.span && index.points.Num() < maxPoints ) {
+				idZipSeekIndex::seekPoint_t &point = index.points.Alloc();
+				point.compressedPos = totalIn;
+				point.uncompressedPos = totalOut;
+				point.bits = strm.data_type & 7;
+				point.prevByte = ( strm.next_in > input ? strm.next_in[-1] : lastInputByte );
+				// copy last WINDOW_SIZE bytes of output in order
+				int n = index.windows.Num();
+				index.windows.SetNum( n + WINDOW_SIZE, false );
+				byte *dst = index.windows.Ptr() + n;
+				int left = strm.avail_out;
+				if ( left ) {
+					memcpy( dst, window + WINDOW_SIZE - left, left );
 				}
+				if ( left < WINDOW_SIZE ) {
+					memcpy( dst + left, window, WINDOW_SIZE - left );
+				}
+				lastOut = totalOut;
 			}
-			res = i + unzReadCurrentFile( z, buf, offset - i );
-			return ( res == offset ) ? 0 : -1;
+		} while ( strm.avail_in != 0 );
+	} while ( ok && ret != Z_STREAM_END );
+
+	inflateEnd( &strm );
+	Mem_Free( window );
+	Mem_Free( input );
+
+	if ( totalOut != (uint64_t)fileSize ) {
+		ok = false;
+	}
+	if ( !ok ) {
+		index.points.Clear();
+		index.windows.Clear();
+	}
+
+	// reopen normally
+	unzSetOffset64( z, zipFilePos );
+	unzOpenCurrentFile( z );
+	return ok;
+}
+
+
+/*
+=================================================================================
+
+idZipSeekIndex
+
+=================================================================================
+*/
+
+/*
+=================
+idZipSeekIndex::idZipSeekIndex
+=================
+*/
+idZipSeekIndex::idZipSeekIndex( int span ) {
+	refCount.SetValue( 1 );
+	state = STATE_EMPTY;
+	this->span = idMath::Imax( span, WINDOW_SIZE );
+}
+
+/*
+=================
+idZipSeekIndex::~idZipSeekIndex
+=================
+*/
+idZipSeekIndex::~idZipSeekIndex( void ) {
+}
+
+/*
+=================
+idZipSeekIndex::Release
+=================
+*/
+void idZipSeekIndex::Release( void ) {
+	if ( refCount.Decrement() == 0 ) {
+		delete this;
+	}
+}
+
+/*
+=================
+idZipSeekIndex::FindPoint
+=================
+*/
+const idZipSeekIndex::seekPoint_t &idZipSeekIndex::FindPoint( uint64_t pos ) const {
+	assert( points.Num() > 0 && points[0].uncompressedPos == 0 );
+	int lo = 0, hi = points.Num();
+	while ( hi - lo > 1 ) {
+		int mid = ( lo + hi ) >> 1;
+		if ( points[mid].uncompressedPos <= pos ) {
+			lo = mid;
+		} else {
+			hi = mid;
 		}
-		default: {
-			common->FatalError( "idFile_InZip::Seek: bad origin for %s\n", name.c_str() );
+	}
+	return points[lo];
+}
+
+/*
+=================
+idZipSeekIndex::GetWindow
+=================
+*/
+const byte *idZipSeekIndex::GetWindow( const seekPoint_t &point ) const {
+	int idx = &point - points.Ptr();
+	assert( idx >= 0 && idx < points.Num() );
+	return windows.Ptr() + idx * WINDOW_SIZE;
+}
+
+
+/*
+=================================================================================
+
+idZipHandlePool
+
+=================================================================================
+*/
+
+/*
+=================
+idZipHandlePool::idZipHandlePool
+=================
+*/
+idZipHandlePool::idZipHandlePool( const char *OSPath, void *templateHandle ) {
+	refCount.SetValue( 1 );
+	osPath = OSPath;
+	this->templateHandle = templateHandle;
+}
+
+/*
+=================
+idZipHandlePool::~idZipHandlePool
+=================
+*/
+idZipHandlePool::~idZipHandlePool( void ) {
+	for ( int i = 0; i < freeHandles.Num(); i++ ) {
+		unzClose( freeHandles[i] );
+	}
+	unzClose( templateHandle );
+}
+
+/*
+=================
+idZipHandlePool::Release
+=================
+*/
+void idZipHandlePool::Release( void ) {
+	if ( refCount.Decrement() == 0 ) {
+		delete this;
+	}
+}
+
+/*
+=================
+idZipHandlePool::LockCounted
+=================
+*/
+void idZipHandlePool::LockCounted( void ) {
+	if ( !mutex.Lock( false ) ) {
+		numContended.Increment();
+		mutex.Lock();
+	}
+}
+
+/*
+=================
+idZipHandlePool::Acquire
+=================
+*/
+void *idZipHandlePool::Acquire( uint64_t zipFilePos ) {
+	numAcquires.Increment();
+
+	unzFile uf = NULL;
+	LockCounted();
+	if ( freeHandles.Num() > 0 ) {
+		uf = freeHandles[freeHandles.Num() - 1];
+		freeHandles.RemoveIndex( freeHandles.Num() - 1 );
+	}
+	mutex.Unlock();
+
+	if ( !uf ) {
+		// clone template handle: it is not modified after pk4 is loaded, so no lock is needed
+		uf = unzReOpen( osPath, templateHandle );
+		if ( !uf ) {
+			return NULL;
+		}
+		numReopens.Increment();
+	}
+
+	if ( unzSetOffset64( uf, zipFilePos ) != UNZ_OK || unzOpenCurrentFile( uf ) != UNZ_OK ) {
+		unzClose( uf );
+		return NULL;
+	}
+	return uf;
+}
+
+/*
+=================
+idZipHandlePool::Return
+=================
+*/
+void idZipHandlePool::Return( void *handle ) {
+	unzCloseCurrentFile( handle );
+
+	LockCounted();
+	bool keep = ( freeHandles.Num() < MAX_FREE_HANDLES );
+	if ( keep ) {
+		freeHandles.Append( handle );
+	}
+	mutex.Unlock();
+
+	if ( !keep ) {
+		unzClose( handle );
+	}
+}
+
+
+/*
+=================================================================================
+
+idFileMapping
+
+=================================================================================
+*/
+
+/*
+=================
+idFileMapping::idFileMapping
+=================
+*/
+idFileMapping::idFileMapping( void ) {
+	data = NULL;
+	length = 0;
+}
+
+/*
+=================
+idFileMapping::~idFileMapping
+=================
+*/
+idFileMapping::~idFileMapping( void ) {
+	Sys_UnmapFile( data, length );
+}
+
+/*
+=================
+idFileMapping::Open
+=================
+*/
+idFileMapping *idFileMapping::Open( const char *OSPath ) {
+	size_t length = 0;
+	const void *data = Sys_MapFileRead( OSPath, length );
+	if ( !data ) {
+		return NULL;
+	}
+	idFileMapping *mapping = new idFileMapping();
+	mapping->data = (const byte *)data;
+	mapping->length = length;
+	mapping->refCount.SetValue( 1 );
+	return mapping;
+}
+
+/*
+=================
+idFileMapping::Release
+=================
+*/
+void idFileMapping::Release( void ) {
+	if ( refCount.Decrement() == 0 ) {
+		delete this;
+	}
+}
+
+
+/*
+=================================================================================
+
+idFile_InZipMapped
+
+=================================================================================
+*/
+
+/*
+=================
+idFile_InZipMapped::idFile_InZipMapped
+=================
+*/
+idFile_InZipMapped::idFile_InZipMapped( idFileMapping *mapping, const byte *data, int length ) {
+	name = "invalid";
+	this->mapping = mapping;
+	mapping->AddRef();
+	filePtr = data;
+	fileSize = length;
+	curPos = 0;
+	domain = FDOM_UNKNOWN;
+}
+
+/*
+=================
+idFile_InZipMapped::~idFile_InZipMapped
+=================
+*/
+idFile_InZipMapped::~idFile_InZipMapped( void ) {
+	mapping->Release();
+}
+
+/*
+=================
+idFile_InZipMapped::Read
+=================
+*/
+int idFile_InZipMapped::Read( void *buffer, int len ) {
+	if ( len > fileSize - curPos ) {
+		len = fileSize - curPos;
+	}
+	if ( len <= 0 ) {
+		return 0;
+	}
+	memcpy( buffer, filePtr + curPos, len );
+	curPos += len;
+	fileSystem->AddToReadCount( len );
+	return len;
+}
+
+/*
+=================
+idFile_InZipMapped::Write
+=================
+*/
+int idFile_InZipMapped::Write( const void *buffer, int len ) {
+	common->FatalError( "idFile_InZipMapped::Write: cannot write to the zipped file %s", name.c_str() );
+	return 0;
+}
+
+/*
+=================
+idFile_InZipMapped::ForceFlush
+=================
+*/
+void idFile_InZipMapped::ForceFlush( void ) {
+	common->FatalError( "idFile_InZipMapped::ForceFlush: cannot flush the zipped file %s", name.c_str() );
+}
+
+/*
+=================
+idFile_InZipMapped::Flush
+=================
+*/
+void idFile_InZipMapped::Flush( void ) {
+	common->FatalError( "idFile_InZipMapped::Flush: cannot flush the zipped file %s", name.c_str() );
+}
+
+/*
+=================
+idFile_InZipMapped::Tell
+=================
+*/
+int idFile_InZipMapped::Tell( void ) {
+	return curPos;
+}
+
+/*
+================
+idFile_InZipMapped::Length
+================
+*/
+int idFile_InZipMapped::Length( void ) {
+	return fileSize;
+}
+
+/*
+================
+idFile_InZipMapped::Timestamp
+================
+*/
+ID_TIME_T idFile_InZipMapped::Timestamp( void ) {
+	return 0;
+}
+
+/*
+================
+idFile_InZipMapped::GetDomain
+================
+*/
+domainStatus_t idFile_InZipMapped::GetDomain() const {
+	return domain;
+}
+
+/*
+=================
+idFile_InZipMapped::Seek
+
+  returns zero on success and -1 on failure
+=================
+*/
+int idFile_InZipMapped::Seek( long offset, fsOrigin_t origin ) {
+	long long pos;
+	switch( origin ) {
+		case FS_SEEK_CUR: {
+			pos = (long long)curPos + offset;
+			break;
+		}
+		case FS_SEEK_END: {
+			// same as in idFile_InZip: offset is measured back from the end
+			pos = (long long)fileSize - offset;
+			break;
+		}
+		case FS_SEEK_SET: {
+			pos = offset;
 			break;
 		}
+		default: {
+			common->FatalError( "idFile_InZipMapped::Seek: bad origin for %s\n", name.c_str() );
+			return -1;
+		}
 	}
-	return -1;
+	if ( pos < 0 ) {
+		curPos = 0;
+		return -1;
+	}
+	if ( pos > fileSize ) {
+		curPos = fileSize;
+		return -1;
+	}
+	curPos = (int)pos;
+	return 0;
 }
@@ -214,6 +214,97 @@ private:
 };
 
 
+/*
+ * Seek points for random access into deflated file in pk4 (see zran.c in zlib examples).
+ * Every point remembers positions in compressed and uncompressed data and the last 32 KB
+ * of uncompressed data before it, so inflation can be restarted from the point.
+ * Shared by all opened instances of the same pk4 entry, built on the first long seek.
+ */
+class idZipSeekIndex {
+public:
+	static const int		WINDOW_SIZE = 32768;
+
+	typedef struct {
+		uint64_t			compressedPos;	// first byte of compressed data after the point
+		uint64_t			uncompressedPos;
+		int					bits;			// number of unused bits in the byte before compressedPos
+		byte				prevByte;		// byte before compressedPos (if bits != 0)
+	} seekPoint_t;
+
+							idZipSeekIndex( int span );
+
+	void					AddRef( void ) { refCount.Increment(); }
+	void					Release( void );
+
+	int						GetSpan( void ) const { return span; }
+	bool					IsBuilt( void ) const { return state == STATE_BUILT; }
+	int						NumPoints( void ) const { return points.Num(); }
+
+							// returns the last point not after the given uncompressed position
+	const seekPoint_t &		FindPoint( uint64_t pos ) const;
+	const byte *			GetWindow( const seekPoint_t &point ) const;
+
+private:
+	friend class			idFile_InZip;
+
+	enum {
+		STATE_EMPTY,
+		STATE_BUILT,
+		STATE_FAILED
+	};
+
+							~idZipSeekIndex( void );
+
+	idSysInterlockedInteger	refCount;
+	idSysMutex				mutex;			// locked while the index is being built
+	int						state;
+	int						span;			// minimal distance between points in uncompressed data
+	idList<seekPoint_t>		points;
+	idList<byte>			windows;		// WINDOW_SIZE bytes for every point
+};
+
+
+/*
+ * Pool of minizip handles opened on the same pk4.
+ * Every opened file in pk4 needs its own handle: they are taken from the pool
+ * and returned back on close instead of reopening the pk4 for every file.
+ * Thread-safe. Reference counted: opened files keep the pool alive.
+ */
+class idZipHandlePool {
+public:
+	static const int		MAX_FREE_HANDLES = 16;
+
+							// takes ownership of the handle which was used to load pk4 index
+							idZipHandlePool( const char *OSPath, void *templateHandle );
+
+	void					AddRef( void ) { refCount.Increment(); }
+	void					Release( void );
+
+							// returns handle with current file opened at given position, NULL on failure
+	void *					Acquire( uint64_t zipFilePos );
+	void					Return( void *handle );
+
+	// statistics
+	int						NumAcquires( void ) const { return numAcquires.GetValue(); }
+	int						NumReopens( void ) const { return numReopens.GetValue(); }
+	int						NumContended( void ) const { return numContended.GetValue(); }
+
+private:
+							~idZipHandlePool( void );
+	void					LockCounted( void );
+
+	idSysInterlockedInteger	refCount;
+	idSysMutex				mutex;			// protects freeHandles
+	idStr					osPath;
+	void *					templateHandle;	// never read from, only cloned
+	idList<void *>			freeHandles;
+
+	idSysInterlockedInteger	numAcquires;
+	idSysInterlockedInteger	numReopens;		// new handles opened
+	idSysInterlockedInteger	numContended;	// times a thread had to wait for mutex
+};
+
+
 class idFile_InZip : public idFile {
 	friend class			idFileSystemLocal;
 
@@ -242,6 +333,70 @@ private:
 	int						fileSize;		// size of the file
 	void *					z;				// unzip info
 	domainStatus_t			domain;			// stgatilov #5766
+	idZipSeekIndex *		seekIndex;		// seek points of the pak entry (NULL if not used)
+	idZipHandlePool *		handlePool;		// z is returned there on close (NULL if z is owned)
+
+	const idZipSeekIndex::seekPoint_t *PrepareSeekPoint( int pos );
+	bool					BuildSeekIndex( void );
+	int						SkipForward( int count );
+};
+
+
+/*
+ * Read-only memory mapping of a whole file (pk4), shared by all files opened from it.
+ * Reference counted: it is unmapped when the last reference is released.
+ */
+class idFileMapping {
+public:
+	static idFileMapping *	Open( const char *OSPath );	// returns NULL if file cannot be mapped
+
+	void					AddRef( void ) { refCount.Increment(); }
+	void					Release( void );
+
+	const byte *			GetData( void ) const { return data; }
+	size_t					GetLength( void ) const { return length; }
+
+private:
+							idFileMapping( void );
+							~idFileMapping( void );
+
+	idSysInterlockedInteger	refCount;
+	const byte *			data;
+	size_t					length;
+};
+
+
+// stored (uncompressed) file in pk4, read directly from memory-mapped pk4
+class idFile_InZipMapped : public idFile {
+	friend class			idFileSystemLocal;
+
+public:
+							idFile_InZipMapped( idFileMapping *mapping, const byte *data, int length );
+	virtual					~idFile_InZipMapped( void ) override;
+
+	virtual const char *	GetName( void ) override { return name.c_str(); }
+	virtual const char *	GetFullPath( void ) override { return fullPath.c_str(); }
+	virtual int				Read( void *buffer, int len ) override;
+	virtual int				Write( const void *buffer, int len ) override;
+	virtual int				Length( void ) override;
+	virtual ID_TIME_T		Timestamp( void ) override;
+	virtual domainStatus_t	GetDomain() const override;
+	virtual int				Tell( void ) override;
+	virtual void			ForceFlush( void ) override;
+	virtual void			Flush( void ) override;
+	virtual int				Seek( long offset, fsOrigin_t origin ) override;
+
+							// returns const pointer to the file data (valid until file is closed)
+	const byte *			GetDataPtr( void ) const { return filePtr; }
+
+private:
+	idStr					name;			// name of the file in the pak
+	idStr					fullPath;		// full file path including pak file name
+	idFileMapping *			mapping;		// mapping of the whole pak (referenced while file is open)
+	const byte *			filePtr;		// file data inside the mapping
+	int						fileSize;		// size of the file
+	int						curPos;			// current read position
+	domainStatus_t			domain;			// stgatilov #5766
 };
 
 #endif /* !__FILE_H__ */
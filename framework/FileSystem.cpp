@@ -128,6 +128,10 @@ in search order, fs_mod > BASE_TDM
 typedef struct fileInPack_s {
 	idStr				name;						// name of the file
 	ZPOS64_T			pos;						// file info position in zip
+	ZPOS64_T			compressedSize;
+	ZPOS64_T			uncompressedSize;
+	int					compressionMethod;			// 0 = stored
+	idZipSeekIndex *	seekIndex;					// seek points for deflated file (created on demand)
 	struct fileInPack_s * next;						// next file in the hash
 } fileInPack_t;
 
@@ -144,16 +148,20 @@ typedef struct {
 
 typedef struct {
 	idStr				pakFilename;				// c:\doom\base\pak0.pk4
-	unzFile				handle;
+	idZipHandlePool		*handlePool;				// handles for reading files from this pk4
 	int					checksum;
 	int					numfiles;
 	int					length;
-	bool				referenced;
+	std::atomic<bool>	referenced;				// set by lock-free readers in OpenFileRead
 	binaryStatus_t		binary;
 	bool				addon;						// this is an addon pack - addon_search tells if it's 'active'
 	bool				addon_search;				// is in the search list
 	addonInfo_t			*addon_info;
 	bool				isNew;						// for downloaded paks
+	bool				indexCached;				// entries were loaded from index cache instead of central directory
+	idFileMapping		*mapping;					// whole pk4 mapped into memory (created on demand)
+	bool				mappingFailed;
+	idSysMutex			lazyMutex;					// protects stuff created on demand: mapping, seek indexes
 	fileInPack_t		*hashTable[FILE_HASH_SIZE];
 	fileInPack_t		*buildBuffer;
 } pack_t;
@@ -167,7 +175,7 @@ typedef struct searchpath_s {
 	pack_t *			pack;						// only one of pack / dir will be non NULL
 	directory_t *		dir;
 	domainStatus_t		domain;						// stgatilov #5766: TDM core / FM
-	struct searchpath_s *next;
+	std::atomic<struct searchpath_s *> next;	// nodes are published with release stores, see OpenFileRead
 } searchpath_t;
 
 // search flags when opening a file
@@ -257,19 +265,22 @@ public:
 	static void				TouchFile_f( const idCmdArgs &args );
 	static void				TouchFileList_f( const idCmdArgs &args );
 	static void				TestThreads_f( const idCmdArgs &args );
+	void					GetZipHandleStats( int &acquires, int &reopens, int &contended ) const;
 
 private:
     friend void				BackgroundDownloadThread(void *parms);
+	friend class			idFileSystemTest;
 
 	mutable idSysMutex		globalMutex;		// locked on most filesystem operations
+	std::atomic<int>		lockFreeReaders;	// threads walking search paths without globalMutex (see OpenFileRead)
 
-	searchpath_t *			searchPaths;
+	std::atomic<searchpath_t *>	searchPaths;
 	idSysInterlockedInteger	readCount;			// total bytes read
 	idSysInterlockedInteger	loadCount;			// total files read
 	idSysInterlockedInteger	loadStack;			// total files in memory
 	idStr					gameFolder;			// this will be a single name without separators
 
-	searchpath_t			*addonPaks;			// not loaded up, but we saw them
+	std::atomic<searchpath_t *>	addonPaks;		// not loaded up, but we saw them
 
 	idDict					mapDict;			// for GetMapDecl
 
@@ -279,6 +290,9 @@ private:
 	static idCVar			fs_devpath;
 	static idCVar			fs_caseSensitiveOS;
 	static idCVar			fs_searchAddons;
+	static idCVar			fs_pakIndexCache;
+	static idCVar			fs_mapPaks;
+	static idCVar			fs_zipSeekSpan;
 
     // taaaki: fs_game and fs_game_base have been removed as TDM is no longer a mod and these fs cvars were causing
     // confusion due to inconsistent usage. fs_mod has been added to allow for mods of TDM.
@@ -323,16 +337,20 @@ private:
 
 	int						GetFileListTree( const char *relativePath, const idStrList &extensions, idStrList &list, idHashIndex &hashIndex, const char* gamedir = NULL ) const; //note: thread-unsafe!
 	pack_t *				LoadZipFile( const char *zipfile ); //note: thread-unsafe!
+	idStr					GetPakIndexCachePath( const char *zipfile ) const;
+	static void				FreeZipFile( pack_t *pack );
 	void					AddGameDirectory( const char *path, const char *dir, domainStatus_t domain ); //note: thread-unsafe!
 	void					SetupGameDirectories( const char *gameName ); //note: thread-unsafe!
 	void					Startup( void ); //note: thread-unsafe!
 
 	static bool				FileAllowedFromDir( const char *path );
+	void					WaitForLockFreeReaders( void );
 							// searches all the paks
 	pack_t *				GetPackForChecksum( int checksum, bool searchAddons = false ); //note: thread-unsafe!
 							// searches all the paks
 	pack_t *				FindPakForFileChecksum( const char *relativePath, int fileChecksum, bool bReference ); //note: thread-unsafe!
-	idFile_InZip *			ReadFileFromZip( pack_t *pak, fileInPack_t *pakFile, const char *relativePath ); //note: thread-unsafe!
+	idFile *				ReadFileFromZip( pack_t *pak, fileInPack_t *pakFile, const char *relativePath, domainStatus_t domain = FDOM_UNKNOWN );
+	idFile_InZipMapped *	ReadFileFromMappedZip( pack_t *pak, fileInPack_t *pakFile, const char *relativePath );
 	static int				GetFileChecksum( idFile *file );
 	static addonInfo_t *	ParseAddonDef( const char *buf, const int len );
 	void					FollowAddonDependencies( pack_t *pak );
@@ -356,6 +374,9 @@ idCVar	idFileSystemLocal::fs_caseSensitiveOS( "fs_caseSensitiveOS", "0", CVAR_SY
 idCVar	idFileSystemLocal::fs_caseSensitiveOS( "fs_caseSensitiveOS", "1", CVAR_SYSTEM | CVAR_BOOL, "" );
 #endif
 idCVar	idFileSystemLocal::fs_searchAddons( "fs_searchAddons", "0", CVAR_SYSTEM | CVAR_BOOL, "search all addon pk4s ( disables addon functionality )" );
+idCVar	idFileSystemLocal::fs_mapPaks( "fs_mapPaks", "1", CVAR_SYSTEM | CVAR_BOOL, "map pk4 files into memory and read stored (uncompressed) files directly from memory (64-bit only)" );
+idCVar	idFileSystemLocal::fs_zipSeekSpan( "fs_zipSeekSpan", "512", CVAR_SYSTEM | CVAR_INTEGER, "distance in KB between seek points in deflated pk4 files: any seek decompresses at most that much data (0 = disable seek points)", 0, 65536 );
+idCVar	idFileSystemLocal::fs_pakIndexCache( "fs_pakIndexCache", "1", CVAR_SYSTEM | CVAR_BOOL, "cache index of every pk4 in fscache/ under fs_savepath to avoid walking zip directories on startup" );
 
 // greebo: Custom savepath in darkmod/fms/
 idCVar	idFileSystemLocal::fs_modSavePath( "fs_modSavePath", "", CVAR_SYSTEM | CVAR_INIT, "This is where all screenshots and savegames will be written to." );
@@ -379,6 +400,7 @@ idFileSystemLocal::idFileSystemLocal( void ) {
 	restartGamePakChecksum = 0;
 	memset( &backgroundThread, 0, sizeof( backgroundThread ) );
 	addonPaks = NULL;
+	lockFreeReaders = 0;
 }
 
 /*
@@ -1234,6 +1256,241 @@ bool RepackPK4(unzFile uf, const char *srcZipfile) {
 }
 
 
+/*
+=================
+Pak index cache
+
+Walking the central directory of every pk4 with minizip takes a noticeable part of startup.
+After a pk4 is walked, its entries are saved into a compact binary file (fscache/ in fs_savepath),
+which is later loaded with one read instead of walking the zip again.
+The cache is valid only if pk4 size, timestamp and CRC32 of its central directory did not change.
+=================
+*/
+#define PAK_INDEX_MAGIC		"TDMPKIX"
+#define PAK_INDEX_VERSION	1
+
+typedef struct {
+	char				magic[8];
+	int					version;
+	int					numEntries;
+	int					namesSize;					// total size of all names (each is null-terminated)
+	int					checksum;					// pack_t::checksum
+	long long			fileLength;					// pk4 file size
+	long long			timestamp;					// pk4 modification time
+	unsigned int		centralDirCrc;				// CRC32 of pk4 central directory
+	int					padding;
+} pakIndexHeader_t;
+
+typedef struct {
+	ZPOS64_T			pos;
+	ZPOS64_T			compressedSize;
+	ZPOS64_T			uncompressedSize;
+	int					nameOffset;
+	int					nameLength;
+	short				compressionMethod;
+	short				hash;
+} pakIndexEntry_t;
+
+static bool GetZipCentralDirectoryCrc( FILE *f, int fileLength, unsigned int &crc ) {
+	// find "end of central directory" record: it is at the end of zip, but may be followed by comment
+	static const int EOCD_SIZE = 22;
+	if ( fileLength < EOCD_SIZE ) {
+		return false;
+	}
+	int tailSize = idMath::Imin( fileLength, 0xFFFF + EOCD_SIZE );
+	idList<byte> tail;
+	tail.SetNum( tailSize );
+	if ( fseek( f, fileLength - tailSize, SEEK_SET ) != 0 || (int)fread( tail.Ptr(), 1, tailSize, f ) != tailSize ) {
+		return false;
+	}
+	const byte *eocd = NULL;
+	for ( int i = tailSize - EOCD_SIZE; i >= 0; i-- ) {
+		if ( tail[i] == 'P' && tail[i + 1] == 'K' && tail[i + 2] == 5 && tail[i + 3] == 6 ) {
+			eocd = &tail[i];
+			break;
+		}
+	}
+	if ( !eocd ) {
+		return false;
+	}
+	unsigned int cdSize = eocd[12] | ( eocd[13] << 8 ) | ( eocd[14] << 16 ) | ( (unsigned int)eocd[15] << 24 );
+	unsigned int cdOffset = eocd[16] | ( eocd[17] << 8 ) | ( eocd[18] << 16 ) | ( (unsigned int)eocd[19] << 24 );
+	if ( (long long)cdOffset + cdSize > fileLength ) {
+		return false;	// zip64 or broken zip
+	}
+
+	idList<byte> centralDir;
+	centralDir.SetNum( cdSize );
+	if ( fseek( f, cdOffset, SEEK_SET ) != 0 || fread( centralDir.Ptr(), 1, cdSize, f ) != cdSize ) {
+		return false;
+	}
+	crc = crc32( 0L, centralDir.Ptr(), cdSize );
+	return true;
+}
+
+static bool MakePakIndexStamp( FILE *f, int fileLength, pakIndexHeader_t &stamp ) {
+	memset( &stamp, 0, sizeof( stamp ) );
+	strcpy( stamp.magic, PAK_INDEX_MAGIC );
+	stamp.version = PAK_INDEX_VERSION;
+	stamp.fileLength = fileLength;
+	stamp.timestamp = Sys_FileTimeStamp( f );
+	return GetZipCentralDirectoryCrc( f, fileLength, stamp.centralDirCrc );
+}
+
+static bool LoadPakIndexCache( const char *cachePath, const pakIndexHeader_t &stamp, pack_t *pack ) {
+	FILE *f = fopen( cachePath, "rb" );
+	if ( !f ) {
+		return false;
+	}
+	fseek( f, 0, SEEK_END );
+	int size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	idList<byte> data;
+	bool ok = ( size >= (int)sizeof( pakIndexHeader_t ) );
+	if ( ok ) {
+		data.SetNum( size );
+		ok = ( (int)fread( data.Ptr(), 1, size, f ) == size );
+	}
+	fclose( f );
+	if ( !ok ) {
+		return false;
+	}
+
+	const pakIndexHeader_t *header = (const pakIndexHeader_t *)data.Ptr();
+	if ( memcmp( header->magic, stamp.magic, sizeof( stamp.magic ) ) != 0 || header->version != stamp.version ) {
+		return false;
+	}
+	if ( header->fileLength != stamp.fileLength || header->timestamp != stamp.timestamp || header->centralDirCrc != stamp.centralDirCrc ) {
+		return false;	// pk4 has changed
+	}
+	if ( header->numEntries != pack->numfiles || header->namesSize < 0 ) {
+		return false;
+	}
+	if ( size != (int)sizeof( pakIndexHeader_t ) + header->numEntries * (int)sizeof( pakIndexEntry_t ) + header->namesSize ) {
+		return false;
+	}
+	const pakIndexEntry_t *entries = (const pakIndexEntry_t *)( header + 1 );
+	const char *names = (const char *)( entries + header->numEntries );
+	for ( int i = 0; i < header->numEntries; i++ ) {
+		const pakIndexEntry_t &e = entries[i];
+		if ( e.nameOffset < 0 || e.nameLength < 0 || e.nameOffset + e.nameLength >= header->namesSize || names[e.nameOffset + e.nameLength] != '\0' ) {
+			return false;
+		}
+		if ( e.hash < 0 || e.hash >= FILE_HASH_SIZE ) {
+			return false;
+		}
+	}
+
+	// note: files are added to hash chains in same order as when walking central directory
+	fileInPack_t *buildBuffer = new fileInPack_t[header->numEntries];
+	for ( int i = 0; i < header->numEntries; i++ ) {
+		const pakIndexEntry_t &e = entries[i];
+		buildBuffer[i].name = names + e.nameOffset;
+		buildBuffer[i].pos = e.pos;
+		buildBuffer[i].compressedSize = e.compressedSize;
+		buildBuffer[i].uncompressedSize = e.uncompressedSize;
+		buildBuffer[i].compressionMethod = e.compressionMethod;
+		buildBuffer[i].seekIndex = NULL;
+		buildBuffer[i].next = pack->hashTable[e.hash];
+		pack->hashTable[e.hash] = &buildBuffer[i];
+	}
+	pack->buildBuffer = buildBuffer;
+	pack->checksum = header->checksum;
+	pack->indexCached = true;
+	return true;
+}
+
+static bool SavePakIndexCache( const char *cachePath, const pakIndexHeader_t &stamp, const pack_t *pack ) {
+	idList<pakIndexEntry_t> entries;
+	entries.SetNum( pack->numfiles );
+	memset( entries.Ptr(), 0, entries.MemoryUsed() );
+	for ( int h = 0; h < FILE_HASH_SIZE; h++ ) {
+		for ( const fileInPack_t *pakFile = pack->hashTable[h]; pakFile; pakFile = pakFile->next ) {
+			entries[pakFile - pack->buildBuffer].hash = h;
+		}
+	}
+	idList<char> names;
+	for ( int i = 0; i < pack->numfiles; i++ ) {
+		const fileInPack_t &pakFile = pack->buildBuffer[i];
+		pakIndexEntry_t &e = entries[i];
+		e.pos = pakFile.pos;
+		e.compressedSize = pakFile.compressedSize;
+		e.uncompressedSize = pakFile.uncompressedSize;
+		e.compressionMethod = pakFile.compressionMethod;
+		e.nameOffset = names.Num();
+		e.nameLength = pakFile.name.Length();
+		for ( int j = 0; j <= e.nameLength; j++ ) {
+			names.Append( pakFile.name.c_str()[j] );
+		}
+	}
+
+	pakIndexHeader_t header = stamp;
+	header.numEntries = pack->numfiles;
+	header.namesSize = names.Num();
+	header.checksum = pack->checksum;
+
+	FILE *f = fopen( cachePath, "wb" );
+	if ( !f ) {
+		return false;
+	}
+	bool ok = true;
+	ok = ok && fwrite( &header, sizeof( header ), 1, f ) == 1;
+	ok = ok && (int)fwrite( entries.Ptr(), sizeof( pakIndexEntry_t ), entries.Num(), f ) == entries.Num();
+	ok = ok && (int)fwrite( names.Ptr(), 1, names.Num(), f ) == names.Num();
+	ok = ( fclose( f ) == 0 ) && ok;
+	if ( !ok ) {
+		// truncated file would be rejected anyway, but don't leave garbage around
+		remove( cachePath );
+	}
+	return ok;
+}
+
+/*
+=================
+idFileSystemLocal::GetPakIndexCachePath
+=================
+*/
+idStr idFileSystemLocal::GetPakIndexCachePath( const char *zipfile ) const {
+	if ( !fs_savepath.GetString()[0] ) {
+		return "";
+	}
+	// same pk4 name is common among FMs, so add hash of full path
+	idStr fullPath = zipfile;
+	fullPath.BackSlashesToSlashes();
+	fullPath.ToLower();
+	idStr name = zipfile;
+	name.StripPath();
+	name.StripFileExtension();
+	name += va( "_%08x.idx", MD4_BlockChecksum( fullPath.c_str(), fullPath.Length() ) );
+	return BuildOSPath( fs_savepath.GetString(), "fscache", name );
+}
+
+/*
+=================
+idFileSystemLocal::FreeZipFile
+=================
+*/
+void idFileSystemLocal::FreeZipFile( pack_t *pack ) {
+	// note: files opened from this pack hold their own references
+	if ( pack->handlePool ) {
+		pack->handlePool->Release();
+	}
+	if ( pack->mapping ) {
+		pack->mapping->Release();
+	}
+	for ( int i = 0; pack->buildBuffer && i < pack->numfiles; i++ ) {
+		if ( pack->buildBuffer[i].seekIndex ) {
+			pack->buildBuffer[i].seekIndex->Release();
+		}
+	}
+	delete [] pack->buildBuffer;
+	if ( pack->addon_info ) {
+		pack->addon_info->mapDecls.DeleteContents( true );
+		delete pack->addon_info;
+	}
+	delete pack;
+}
+
 /*
 =================
 idFileSystemLocal::LoadZipFile
@@ -1254,6 +1511,8 @@ pack_t *idFileSystemLocal::LoadZipFile( const char *zipfile ) {
 	int				len;
 	int				confHash;
 	fileInPack_t	*pakFile;
+	idStr			cachePath;
+	pakIndexHeader_t cacheStamp;
 
 	f = OpenOSFile( zipfile, "rb" );
 	if ( !f ) {
@@ -1261,10 +1520,14 @@ pack_t *idFileSystemLocal::LoadZipFile( const char *zipfile ) {
 	}
 	fseek( f, 0, SEEK_END );
 	len = ftell( f );
+	if ( fs_pakIndexCache.GetBool() ) {
+		cachePath = GetPakIndexCachePath( zipfile );
+		if ( cachePath.Length() && !MakePakIndexStamp( f, len, cacheStamp ) ) {
+			cachePath.Clear();	// can't validate cache for this zip
+		}
+	}
 	fclose( f );
 
-	fs_numHeaderLongs = 0;
-
 	uf = unzOpen( zipfile );
 	err = unzGetGlobalInfo64( uf, &gi );
 
@@ -1272,70 +1535,101 @@ pack_t *idFileSystemLocal::LoadZipFile( const char *zipfile ) {
 		return NULL;
 	}
 
-	buildBuffer = new fileInPack_t[gi.number_entry];
 	pack = new pack_t;
 	for( int i = 0; i < FILE_HASH_SIZE; i++ ) {
 		pack->hashTable[i] = NULL;
 	}
 
 	pack->pakFilename = zipfile;
-	pack->handle = uf;
+	pack->handlePool = NULL;
 	pack->numfiles = gi.number_entry;
-	pack->buildBuffer = buildBuffer;
+	pack->buildBuffer = NULL;
 	pack->referenced = false;
 	pack->binary = BINARY_UNKNOWN;
 	pack->addon = false;
 	pack->addon_search = false;
 	pack->addon_info = NULL;
 	pack->isNew = false;
+	pack->indexCached = false;
+	pack->mapping = NULL;
+	pack->mappingFailed = false;
 
 	pack->length = len;
 
-	bool needsRepacking = false;
-	unzGoToFirstFile(uf);
-	fs_headerLongs = (int *)Mem_ClearedAlloc( gi.number_entry * sizeof(int) );
-	for ( int i = 0; i < (int)gi.number_entry; i++ ) {
-		err = unzGetCurrentFileInfo64( uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0 );
-		if ( err != UNZ_OK ) {
-			break;
+	if ( cachePath.Length() && LoadPakIndexCache( cachePath, cacheStamp, pack ) ) {
+		if ( fs_debug.GetInteger() ) {
+			common->Printf( "Loaded index of %s from %s\n", zipfile, cachePath.c_str() );
+		}
+	} else {
+		buildBuffer = new fileInPack_t[gi.number_entry];
+		pack->buildBuffer = buildBuffer;
+
+		fs_numHeaderLongs = 0;
+		bool needsRepacking = false;
+		unzGoToFirstFile(uf);
+		fs_headerLongs = (int *)Mem_ClearedAlloc( gi.number_entry * sizeof(int) );
+		for ( int i = 0; i < (int)gi.number_entry; i++ ) {
+			err = unzGetCurrentFileInfo64( uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0 );
+			if ( err != UNZ_OK ) {
+				break;
+			}
+			if ( file_info.uncompressed_size > 0 ) {
+				fs_headerLongs[fs_numHeaderLongs++] = LittleInt( file_info.crc );
+			}
+			hash = HashFileName( filename_inzip );
+			buildBuffer[i].name = filename_inzip;
+			buildBuffer[i].name.ToLower();
+			buildBuffer[i].name.BackSlashesToSlashes();
+			// store the file position in the zip
+			buildBuffer[i].pos = unzGetOffset64( uf );
+			buildBuffer[i].compressedSize = file_info.compressed_size;
+			buildBuffer[i].uncompressedSize = file_info.uncompressed_size;
+			buildBuffer[i].compressionMethod = file_info.compression_method;
+			buildBuffer[i].seekIndex = NULL;
+			// add the file to the hash
+			buildBuffer[i].next = pack->hashTable[hash];
+			pack->hashTable[hash] = &buildBuffer[i];
+			//stgatilov: check if file is compressed but should be uncompressed
+			if (DoNotCompressFile(filename_inzip) && file_info.compression_method != 0)
+				needsRepacking = true;
+			// go to the next file in the zip
+			unzGoToNextFile(uf);
+		}
+
+		//stgatilov: repack the whole pk4 if required
+		if (needsRepacking) {
+			Mem_Free(fs_headerLongs);
+			delete pack;
+			delete[] buildBuffer;
+			if (RepackPK4(uf, zipfile))
+				return LoadZipFile(zipfile);
+			else
+				return NULL;	//repacking error
+		}
+
+		pack->checksum = MD4_BlockChecksum( fs_headerLongs, 4 * fs_numHeaderLongs );
+		pack->checksum = LittleInt( pack->checksum );
+
+		Mem_Free( fs_headerLongs );
+
+		if ( cachePath.Length() ) {
+			CreateOSPath( cachePath );
+			if ( !SavePakIndexCache( cachePath, cacheStamp, pack ) ) {
+				common->Warning( "Failed to write pk4 index cache %s", cachePath.c_str() );
+			}
 		}
-		if ( file_info.uncompressed_size > 0 ) {
-			fs_headerLongs[fs_numHeaderLongs++] = LittleInt( file_info.crc );
-		}
-		hash = HashFileName( filename_inzip );
-		buildBuffer[i].name = filename_inzip;
-		buildBuffer[i].name.ToLower();
-		buildBuffer[i].name.BackSlashesToSlashes();
-		// store the file position in the zip
-		buildBuffer[i].pos = unzGetOffset64( uf );
-		// add the file to the hash
-		buildBuffer[i].next = pack->hashTable[hash];
-		pack->hashTable[hash] = &buildBuffer[i];
-		//stgatilov: check if file is compressed but should be uncompressed
-		if (DoNotCompressFile(filename_inzip) && file_info.compression_method != 0)
-			needsRepacking = true;
-		// go to the next file in the zip
-		unzGoToNextFile(uf);
-	}
-
-	//stgatilov: repack the whole pk4 if required
-	if (needsRepacking) {
-		Mem_Free(fs_headerLongs);
-		delete pack;
-		delete[] buildBuffer;
-		if (RepackPK4(uf, zipfile))
-			return LoadZipFile(zipfile);
-		else
-			return NULL;	//repacking error
 	}
 
+	// index is loaded, now uf is only cloned to read files
+	pack->handlePool = new idZipHandlePool( zipfile, uf );
+
 	// check if this is an addon pak
 	pack->addon = false;
 	confHash = HashFileName( ADDON_CONFIG );
 	for ( pakFile = pack->hashTable[confHash]; pakFile; pakFile = pakFile->next ) {
 		if ( !FilenameCompare( pakFile->name, ADDON_CONFIG ) ) {			
 			pack->addon = true;			
-			idFile_InZip *file = ReadFileFromZip( pack, pakFile, ADDON_CONFIG );
+			idFile *file = ReadFileFromZip( pack, pakFile, ADDON_CONFIG );
 			// may be just an empty file if you don't bother about the mapDef
 			if ( file && file->Length() ) {
 				char *buf = new char[ file->Length() + 1 ];
@@ -1351,11 +1645,6 @@ pack_t *idFileSystemLocal::LoadZipFile( const char *zipfile ) {
 		}
 	}
 
-	pack->checksum = MD4_BlockChecksum( fs_headerLongs, 4 * fs_numHeaderLongs );
-	pack->checksum = LittleInt( pack->checksum );
-
-	Mem_Free( fs_headerLongs );
-
 	return pack;
 }
 
@@ -1393,7 +1682,8 @@ int idFileSystemLocal::AddZipFile( const char *path ) {
 		last = last->next;
 	}
 
-	last->next = search;
+	// publish fully constructed node: OpenFileRead can walk the list concurrently
+	last->next.store( search, std::memory_order_release );
 	common->Printf( "Appended %s (checksum 0x%x)\n", pak->pakFilename.c_str(), pak->checksum );
 	return pak->checksum;
 }
@@ -1842,6 +2132,25 @@ int	idFileSystemLocal::ListOSFiles( const char *directory, const char *extension
 	return ret;
 }
 
+/*
+================
+idFileSystemLocal::GetZipHandleStats
+
+sums statistics of pk4 handle pools
+================
+*/
+void idFileSystemLocal::GetZipHandleStats( int &acquires, int &reopens, int &contended ) const {
+	idScopedCriticalSection lock(globalMutex);
+	acquires = reopens = contended = 0;
+	for ( searchpath_t *search = searchPaths; search; search = search->next ) {
+		if ( search->pack && search->pack->handlePool ) {
+			acquires += search->pack->handlePool->NumAcquires();
+			reopens += search->pack->handlePool->NumReopens();
+			contended += search->pack->handlePool->NumContended();
+		}
+	}
+}
+
 #include <thread>
 void idFileSystemLocal::TestThreads_f( const idCmdArgs& args ) {
 	static constexpr int B = 555;
@@ -1895,6 +2204,9 @@ void idFileSystemLocal::TestThreads_f( const idCmdArgs& args ) {
 		}
 	};
 
+	int acquires[2], reopens[2], contended[2];
+	fileSystemLocal.GetZipHandleStats( acquires[0], reopens[0], contended[0] );
+
 	tManyThreads.Start();
 	const int N = 1<<4;
 	std::thread threads[N];
@@ -1912,6 +2224,10 @@ void idFileSystemLocal::TestThreads_f( const idCmdArgs& args ) {
 		tOneThread.Milliseconds(), tManyThreads.Milliseconds(), 
 		tOneThread.Milliseconds() / tManyThreads.Milliseconds()
 	);
+	fileSystemLocal.GetZipHandleStats( acquires[1], reopens[1], contended[1] );
+	common->Printf( "Pk4 handles: %d acquired, %d opened, %d waits for pool lock\n",
+		acquires[1] - acquires[0], reopens[1] - reopens[0], contended[1] - contended[0]
+	);
 }
 
 /*
@@ -2190,8 +2506,8 @@ void idFileSystemLocal::AddGameDirectory( const char *path, const char *dir, dom
 
 	search->dir->path = path;
 	search->dir->gamedir = dir;
-	search->next = searchPaths;
-	searchPaths = search;
+	search->next = searchPaths.load();
+	searchPaths.store( search, std::memory_order_release );
 
 	// find all pak files in this directory
 	pakfile = BuildOSPath( path, dir, "" );
@@ -2215,8 +2531,8 @@ void idFileSystemLocal::AddGameDirectory( const char *path, const char *dir, dom
 		search->dir = NULL;
 		search->pack = pak;
 		search->domain = domain;
-		search->next = searchPaths->next;
-		searchPaths->next = search;
+		search->next = searchPaths.load()->next.load();
+		searchPaths.load()->next.store( search, std::memory_order_release );
 
 		// This same info is printed in the next list, if you want checksums use fs_debug.
 		//common->Printf( "  Loaded %s (checksum 0x%x)\n", pakfile.c_str(), pak->checksum );
@@ -2280,7 +2596,8 @@ idFileSystemLocal::Startup
 ================
 */
 void idFileSystemLocal::Startup( void ) {
-	searchpath_t	**search;
+	std::atomic<searchpath_t *> *search;
+	searchpath_t	*sp;
 	pack_t			*pak;
 	int				addon_index;
     bool            addFsModSave = false;
@@ -2367,17 +2684,17 @@ void idFileSystemLocal::Startup( void ) {
     // currently all addons are in the search list - deal with filtering out and dependencies now
 	// scan through and deal with dependencies
 	search = &searchPaths;
-	while ( *search ) {
-		if ( !( *search )->pack || !( *search )->pack->addon ) {
-			search = &( ( *search )->next );
+	while ( ( sp = search->load() ) != NULL ) {
+		if ( !sp->pack || !sp->pack->addon ) {
+			search = &sp->next;
 			continue;
 		}
-		pak = ( *search )->pack;
+		pak = sp->pack;
 		if ( fs_searchAddons.GetBool() ) {
 			// when we have fs_searchAddons on we should never have addonChecksums
 			assert( !addonChecksums.Num() );
 			pak->addon_search = true;
-			search = &( ( *search )->next );
+			search = &sp->next;
 			continue;
 		}
 		addon_index = addonChecksums.FindIndex( pak->checksum );
@@ -2387,30 +2704,40 @@ void idFileSystemLocal::Startup( void ) {
 			addonChecksums.RemoveIndex( addon_index );
 			FollowAddonDependencies( pak );
 		}
-		search = &( ( *search )->next );
+		search = &sp->next;
 	}
 
 	// now scan to filter out addons not marked addon_search
+	idList<searchpath_t *> unlinked;
 	search = &searchPaths;
-	while ( *search ) {
-		if ( !( *search )->pack || !( *search )->pack->addon ) {
-			search = &( ( *search )->next );
+	while ( ( sp = search->load() ) != NULL ) {
+		if ( !sp->pack || !sp->pack->addon ) {
+			search = &sp->next;
 			continue;
 		}
-		assert( !( *search )->dir );
-		pak = ( *search )->pack;
+		assert( !sp->dir );
+		pak = sp->pack;
 		if ( pak->addon_search ) {
 			common->Printf( "Addon pk4 %s with checksum 0x%x is on the search list\n", pak->pakFilename.c_str(), pak->checksum );
-			search = &( ( *search )->next );
+			search = &sp->next;
 		} else {
-			// remove from search list, put in addons list
-			searchpath_t *paksearch = *search;
-			*search = ( *search )->next;
-			paksearch->next = addonPaks;
-			addonPaks = paksearch;
+			// remove from search list, put a copy in addons list:
+			// a reader standing on the unlinked node must still reach the rest of the search list
+			searchpath_t *paksearch = new searchpath_t;
+			paksearch->dir = NULL;
+			paksearch->pack = pak;
+			paksearch->domain = sp->domain;
+			paksearch->next = addonPaks.load();
+			addonPaks.store( paksearch, std::memory_order_release );
+			search->store( sp->next.load(), std::memory_order_release );
+			unlinked.Append( sp );
 			common->Printf( "Addon pk4 %s with checksum 0x%x is on addon list\n", pak->pakFilename.c_str(), pak->checksum );				
 		}
 	}
+	if ( unlinked.Num() ) {
+		WaitForLockFreeReaders();
+		unlinked.DeleteContents( true );
+	}
 
 	// add our commands
 	cmdSystem->AddCommand( "dir", Dir_f, CMD_FL_SYSTEM, "lists a folder", idCmdSystem::ArgCompletion_FileName );
@@ -2677,6 +3004,11 @@ void idFileSystemLocal::Shutdown( bool reloading ) {
 
 	searchpath_t *sp, *next, *loop;
 
+	// any FS_ calls will now be an error until reinitialized
+	searchpath_t *oldSearchPaths = searchPaths.exchange( NULL );
+	searchpath_t *oldAddonPaks = addonPaks.exchange( NULL );
+	WaitForLockFreeReaders();
+
 	gameFolder.ClearFree();
 	serverPaks.ClearFree();
 
@@ -2692,18 +3024,12 @@ void idFileSystemLocal::Shutdown( bool reloading ) {
 	ClearDirCache();
 
 	// free everything - loop through searchPaths and addonPaks
-	for ( loop = searchPaths; loop; loop == searchPaths ? loop = addonPaks : loop = NULL ) {
+	for ( loop = oldSearchPaths; loop; loop == oldSearchPaths ? loop = oldAddonPaks : loop = NULL ) {
 		for ( sp = loop; sp; sp = next ) {
 			next = sp->next;
 
 			if ( sp->pack ) {
-				unzClose( sp->pack->handle );
-				delete [] sp->pack->buildBuffer;
-				if ( sp->pack->addon_info ) {
-					sp->pack->addon_info->mapDecls.DeleteContents( true );
-					delete sp->pack->addon_info;
-				}
-				delete sp->pack;
+				FreeZipFile( sp->pack );
 			}
 			if ( sp->dir ) {
 				delete sp->dir;
@@ -2712,10 +3038,6 @@ void idFileSystemLocal::Shutdown( bool reloading ) {
 		}
 	}
 
-	// any FS_ calls will now be an error until reinitialized
-	searchPaths = NULL;
-	addonPaks = NULL;
-
 	cmdSystem->RemoveCommand( "path" );
 	cmdSystem->RemoveCommand( "dir" );
 	cmdSystem->RemoveCommand( "dirtree" );
@@ -2789,40 +3111,125 @@ bool idFileSystemLocal::FileAllowedFromDir( const char *path ) {
 	return false;
 }
 
+static ID_INLINE unsigned int ReadZipUint16( const byte *ptr ) {
+	return ptr[0] | ( ptr[1] << 8 );
+}
+static ID_INLINE unsigned int ReadZipUint32( const byte *ptr ) {
+	return ptr[0] | ( ptr[1] << 8 ) | ( ptr[2] << 16 ) | ( (unsigned int)ptr[3] << 24 );
+}
+
+/*
+===========
+idFileSystemLocal::ReadFileFromMappedZip
+
+Stored (uncompressed) file is read directly from memory-mapped pk4 without minizip:
+reads and seeks don't need any copying/reopening then.
+Returns NULL if it is not possible, then the file must be read via minizip.
+===========
+*/
+idFile_InZipMapped *idFileSystemLocal::ReadFileFromMappedZip( pack_t *pak, fileInPack_t *pakFile, const char *relativePath ) {
+	if ( pakFile->compressionMethod != 0 || !fs_mapPaks.GetBool() ) {
+		return NULL;
+	}
+	if ( sizeof( void * ) < 8 ) {
+		return NULL;	// 32-bit address space is not enough to map all the pk4 files
+	}
+	{
+		idScopedCriticalSection lock( pak->lazyMutex );
+		if ( !pak->mapping ) {
+			if ( pak->mappingFailed ) {
+				return NULL;
+			}
+			pak->mapping = idFileMapping::Open( pak->pakFilename );
+			if ( !pak->mapping ) {
+				common->Warning( "ReadFileFromMappedZip: Couldn't map %s into memory", pak->pakFilename.c_str() );
+				pak->mappingFailed = true;
+				return NULL;
+			}
+		}
+	}
+	const byte *zipData = pak->mapping->GetData();
+	size_t zipLength = pak->mapping->GetLength();
+
+	// central directory header of the file
+	static const int CENTRAL_HEADER_SIZE = 46;
+	static const int LOCAL_HEADER_SIZE = 30;
+	if ( pakFile->pos + CENTRAL_HEADER_SIZE > zipLength ) {
+		return NULL;
+	}
+	const byte *central = zipData + pakFile->pos;
+	if ( ReadZipUint32( central ) != 0x02014b50 ) {
+		return NULL;
+	}
+	unsigned int compressedSize = ReadZipUint32( central + 20 );
+	unsigned int uncompressedSize = ReadZipUint32( central + 24 );
+	unsigned int localOffset = ReadZipUint32( central + 42 );
+	if ( compressedSize != uncompressedSize || uncompressedSize != pakFile->uncompressedSize || uncompressedSize > INT_MAX ) {
+		return NULL;	// zip64 or something strange
+	}
+
+	// local header: it has its own lengths of name and extra field
+	if ( (size_t)localOffset + LOCAL_HEADER_SIZE > zipLength ) {
+		return NULL;
+	}
+	const byte *local = zipData + localOffset;
+	if ( ReadZipUint32( local ) != 0x04034b50 ) {
+		return NULL;
+	}
+	size_t dataOffset = (size_t)localOffset + LOCAL_HEADER_SIZE + ReadZipUint16( local + 26 ) + ReadZipUint16( local + 28 );
+	if ( dataOffset + compressedSize > zipLength ) {
+		return NULL;
+	}
+
+	idFile_InZipMapped *file = new idFile_InZipMapped( pak->mapping, zipData + dataOffset, (int)compressedSize );
+	file->name = relativePath;
+	file->fullPath = pak->pakFilename + "/" + relativePath;
+	return file;
+}
+
 /*
 ===========
 idFileSystemLocal::ReadFileFromZip
 ===========
 */
-idFile_InZip * idFileSystemLocal::ReadFileFromZip( pack_t *pak, fileInPack_t *pakFile, const char *relativePath ) {
+idFile * idFileSystemLocal::ReadFileFromZip( pack_t *pak, fileInPack_t *pakFile, const char *relativePath, domainStatus_t domain ) {
 	// relativePath == pakFile->name according to FilenameCompare()
 	// pakFile->Pos is position of that file within the zip
 
-	// set position in pk4 file to the file (in the zip/pk4) we want a handle on
-	unzSetOffset64( pak->handle, pakFile->pos );
+	if ( idFile_InZipMapped *mappedFile = ReadFileFromMappedZip( pak, pakFile, relativePath ) ) {
+		mappedFile->domain = domain;
+		return mappedFile;
+	}
 
-	// clone handle and assign a new internal filestream to zip file to it
-	unzFile uf = unzReOpen( pak->pakFilename, pak->handle );
+	// take handle with its own filestream, already positioned at the file (in the zip/pk4)
+	// note: it comes from per-pk4 pool, so pk4 is not reopened for every file
+	unzFile uf = pak->handlePool->Acquire( pakFile->pos );
 	if ( uf == NULL ) {
 		common->FatalError( "ReadFileFromZip: Couldn't reopen %s", pak->pakFilename.c_str() );
 	}
 
-	// the following stuff is needed to get the uncompress filesize (for file->fileSize)
-	char	filename_inzip[MAX_ZIPPED_FILE_NAME];
-	unz_file_info64	file_info;
-	int err = unzGetCurrentFileInfo64( uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0 );
-	if ( err != UNZ_OK ) {
-		common->FatalError( "Couldn't get file info for %s in %s, pos %llu", relativePath, pak->pakFilename.c_str(), pakFile->pos );
-	}
-
 	// create idFile_InZip and set fields accordingly
 	idFile_InZip *file = new idFile_InZip();
 	file->z = uf;
+	file->handlePool = pak->handlePool;
+	file->handlePool->AddRef();
 	file->name = relativePath;
-	file->compressed = (file_info.compression_method != 0);
+	file->compressed = (pakFile->compressionMethod != 0);
 	file->fullPath = pak->pakFilename + "/" + relativePath;
 	file->zipFilePos = pakFile->pos;
-	file->fileSize = file_info.uncompressed_size;
+	file->fileSize = pakFile->uncompressedSize;
+	file->domain = domain;
+
+	// large deflated files get seek points, shared by all opened instances
+	int seekSpan = fs_zipSeekSpan.GetInteger() * 1024;
+	if ( file->compressed && seekSpan > 0 && pakFile->uncompressedSize > 2 * (ZPOS64_T)seekSpan ) {
+		idScopedCriticalSection lock( pak->lazyMutex );
+		if ( !pakFile->seekIndex ) {
+			pakFile->seekIndex = new idZipSeekIndex( seekSpan );
+		}
+		pakFile->seekIndex->AddRef();
+		file->seekIndex = pakFile->seekIndex;
+	}
 
 	return file;
 }
@@ -2872,13 +3279,16 @@ idFile *idFileSystemLocal::OpenFileReadFlags( const char *relativePath, int sear
 	// search through the path, one element at a time
 	hash = HashFileName( relativePath );
 
-	for ( search = searchPaths; search; search = search->next ) {
+	// serverPaks only changes in Shutdown, after search paths are detached and lock-free readers are gone
+	const bool restricted = serverPaks.Num() > 0;
+
+	for ( search = searchPaths; search; search = search->next.load( std::memory_order_acquire ) ) {
 		if ( search->dir && ( searchFlags & FSFLAG_SEARCH_DIRS ) ) {
 			// check a file in the directory tree
 
 			// if we are running restricted, the only files we
 			// will allow to come from the directory are .cfg files
-			if ( serverPaks.Num() ) {
+			if ( restricted ) {
 				if ( !FileAllowedFromDir( relativePath ) ) {
 					continue;
 				}
@@ -2939,19 +3349,17 @@ idFile *idFileSystemLocal::OpenFileReadFlags( const char *relativePath, int sear
 			for ( pakFile = pak->hashTable[hash]; pakFile; pakFile = pakFile->next ) {
 				// case and separator insensitive comparisons
 				if ( !FilenameCompare( pakFile->name, relativePath ) ) {
-					idFile_InZip *file = ReadFileFromZip( pak, pakFile, relativePath );
-					file->domain = search->domain;
+					idFile *file = ReadFileFromZip( pak, pakFile, relativePath, search->domain );
 
 					if ( foundInPak ) {
 						*foundInPak = pak;
 					}
 
-					if ( !pak->referenced ) {
-						// mark this pak referenced
+					// mark this pak referenced
+					if ( !pak->referenced.exchange( true ) ) {
 						if ( fs_debug.GetInteger( ) ) {
 							common->Printf( "idFileSystem::OpenFileRead: %s -> adding %s to referenced paks\n", relativePath, pak->pakFilename.c_str() );
 						}
-						pak->referenced = true;
 					}
 
 					if ( fs_debug.GetInteger( ) ) {
@@ -2969,7 +3377,7 @@ idFile *idFileSystemLocal::OpenFileReadFlags( const char *relativePath, int sear
 			pak = search->pack;
 			for ( pakFile = pak->hashTable[hash]; pakFile; pakFile = pakFile->next ) {
 				if ( !FilenameCompare( pakFile->name, relativePath ) ) {
-					idFile_InZip *file = ReadFileFromZip( pak, pakFile, relativePath );
+					idFile *file = ReadFileFromZip( pak, pakFile, relativePath );
 					if ( foundInPak ) {
 						*foundInPak = pak;
 					}
@@ -2981,7 +3389,7 @@ idFile *idFileSystemLocal::OpenFileReadFlags( const char *relativePath, int sear
 					return file;
 				}
 			}
-			search = search->next;
+			search = search->next.load( std::memory_order_acquire );
 		}
 	}
 	
@@ -2998,8 +3406,28 @@ idFileSystemLocal::OpenFileRead
 ===========
 */
 idFile *idFileSystemLocal::OpenFileRead( const char *relativePath, const char* gamedir ) {
-	idScopedCriticalSection lock(globalMutex);
-    return OpenFileReadFlags( relativePath, FSFLAG_SEARCH_DIRS | FSFLAG_SEARCH_PAKS, NULL, gamedir );
+	// No globalMutex here, since workers open lots of files in parallel.
+	// Search path nodes are published with release stores,
+	// unlinked nodes are freed only after WaitForLockFreeReaders.
+	// Reading from pk4 is thread-safe: handles are pooled per pk4, lazy stuff has pack's own lock.
+	lockFreeReaders++;
+	idFile *file = OpenFileReadFlags( relativePath, FSFLAG_SEARCH_DIRS | FSFLAG_SEARCH_PAKS, NULL, gamedir );
+	lockFreeReaders--;
+	return file;
+}
+
+/*
+===========
+idFileSystemLocal::WaitForLockFreeReaders
+
+Must be called with globalMutex locked after search paths are detached, before freeing them.
+===========
+*/
+void idFileSystemLocal::WaitForLockFreeReaders( void ) {
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	while ( lockFreeReaders.load() > 0 ) {
+		Sys_Sleep( 1 );
+	}
 }
 
 idFile * idFileSystemLocal::OpenFileReadPrefetch( const char *relativePath, const char *gamedir ) {
@@ -3432,7 +3860,7 @@ pack_t *idFileSystemLocal::FindPakForFileChecksum( const char *relativePath, int
 			pak = search->pack;
 			for ( pakFile = pak->hashTable[ hash ]; pakFile; pakFile = pakFile->next ) {
 				if ( !FilenameCompare( pakFile->name, relativePath ) ) {
-					idFile_InZip *file = ReadFileFromZip( pak, pakFile, relativePath );
+					idFile *file = ReadFileFromZip( pak, pakFile, relativePath );
 					if ( findChecksum == GetFileChecksum( file ) ) {
 						if ( fs_debug.GetBool() ) {
 							common->Printf( "found '%s' with checksum 0x%x in pak '%s'\n", relativePath, findChecksum, pak->pakFilename.c_str() );
@@ -3821,3 +4249,574 @@ const char* idFileSystemLocal::ModPath() const {
 
 	return path;
 }
+
+
+#include "../tests/testing.h"
+
+typedef std::vector<std::pair<std::string, std::string>> pakTestFiles_t;
+
+// wraps the private parts of the file system used by the tests
+class idFileSystemTest {
+public:
+	static pack_t *Load( const char *zipPath, bool useCache ) {
+		idTestCVar cache( idFileSystemLocal::fs_pakIndexCache, useCache );
+		return fileSystemLocal.LoadZipFile( zipPath );
+	}
+	static void Free( pack_t *pack ) {
+		idFileSystemLocal::FreeZipFile( pack );
+	}
+	static idStr CachePath( const char *zipPath ) {
+		return fileSystemLocal.GetPakIndexCachePath( zipPath );
+	}
+
+	static fileInPack_t *Find( pack_t *pack, const char *relativePath ) {
+		int hash = idFileSystemLocal::HashFileName( relativePath );
+		for ( fileInPack_t *pakFile = pack->hashTable[hash]; pakFile; pakFile = pakFile->next ) {
+			if ( !fileSystemLocal.FilenameCompare( pakFile->name, relativePath ) ) {
+				return pakFile;
+			}
+		}
+		return NULL;
+	}
+
+	static std::string ReadContents( pack_t *pack, fileInPack_t *pakFile ) {
+		idFile *file = fileSystemLocal.ReadFileFromZip( pack, pakFile, pakFile->name );
+		std::string contents( file->Length(), '\0' );
+		if ( file->Length() ) {
+			file->Read( &contents[0], file->Length() );
+		}
+		fileSystemLocal.CloseFile( file );
+		return contents;
+	}
+
+	static idFile *Open( pack_t *pack, const char *relativePath, bool mapped ) {
+		idTestCVar mapPaks( idFileSystemLocal::fs_mapPaks, mapped );
+		fileInPack_t *pakFile = Find( pack, relativePath );
+		REQUIRE( pakFile );
+		return fileSystemLocal.ReadFileFromZip( pack, pakFile, pakFile->name );
+	}
+
+	// pack is shared between threads: lazy mapping must be done under lock, as in OpenFileReadFlags
+	static idFile *OpenLocked( pack_t *pack, const char *relativePath ) {
+		idScopedCriticalSection lock( fileSystemLocal.globalMutex );
+		fileInPack_t *pakFile = Find( pack, relativePath );
+		return fileSystemLocal.ReadFileFromZip( pack, pakFile, pakFile->name );
+	}
+
+	static idFile *OpenWithSeekSpan( pack_t *pack, const char *relativePath, int spanKB ) {
+		idTestCVar seekSpan( idFileSystemLocal::fs_zipSeekSpan, spanKB );
+		fileInPack_t *pakFile = Find( pack, relativePath );
+		REQUIRE( pakFile );
+		return fileSystemLocal.ReadFileFromZip( pack, pakFile, pakFile->name );
+	}
+
+	// temporarily puts pack in front of all search paths
+	static searchpath_t *PushPack( pack_t *pack ) {
+		idScopedCriticalSection lock( fileSystemLocal.globalMutex );
+		searchpath_t *search = new searchpath_t;
+		search->dir = NULL;
+		search->pack = pack;
+		search->domain = FDOM_UNKNOWN;
+		search->next = fileSystemLocal.searchPaths.load();
+		fileSystemLocal.searchPaths.store( search, std::memory_order_release );
+		return search;
+	}
+	static void PopPack( searchpath_t *search ) {
+		idScopedCriticalSection lock( fileSystemLocal.globalMutex );
+		REQUIRE( fileSystemLocal.searchPaths == search );
+		fileSystemLocal.searchPaths.store( search->next.load(), std::memory_order_release );
+		fileSystemLocal.WaitForLockFreeReaders();
+		delete search;
+	}
+};
+
+static void FileSystemTest_WritePk4( const char *zipPath, const pakTestFiles_t &files ) {
+	zipFile zf = zipOpen( zipPath, APPEND_STATUS_CREATE );
+	REQUIRE( zf );
+	for ( const auto &file : files ) {
+		zip_fileinfo info;
+		memset( &info, 0, sizeof( info ) );
+		// sounds must be stored, otherwise LoadZipFile repacks the pk4
+		bool store = idStr::CheckExtension( file.first.c_str(), ".ogg" );
+		REQUIRE( zipOpenNewFileInZip( zf, file.first.c_str(), &info, NULL, 0, NULL, 0, NULL, store ? 0 : Z_DEFLATED, store ? 0 : Z_DEFAULT_COMPRESSION ) == ZIP_OK );
+		REQUIRE( zipWriteInFileInZip( zf, file.second.data(), (unsigned)file.second.size() ) == ZIP_OK );
+		REQUIRE( zipCloseFileInZip( zf ) == ZIP_OK );
+	}
+	REQUIRE( zipClose( zf, NULL ) == ZIP_OK );
+}
+
+static pakTestFiles_t FileSystemTest_GenerateFiles( int count, int seed ) {
+	static const char *EXTENSIONS[] = { ".tga", ".mtr", ".ogg", ".def" };
+	idRandom rnd( seed );
+	pakTestFiles_t files;
+	for ( int i = 0; i < count; i++ ) {
+		// mixed case and backslashes are normalized by LoadZipFile
+		idStr name = va( "%s%s%d/File_%d%s", ( i % 7 == 0 ? "Textures\\" : "textures/" ), ( i % 2 ? "dir" : "DIR" ), i % 13, i, EXTENSIONS[i % 4] );
+		std::string contents;
+		int len = rnd.RandomInt( 3000 );
+		for ( int j = 0; j < len; j++ ) {
+			contents += (char)( 'a' + rnd.RandomInt( j % 5 == 0 ? 26 : 3 ) );
+		}
+		files.emplace_back( name.c_str(), contents );
+	}
+	return files;
+}
+
+static std::string FileSystemTest_GenerateContents( int size, int seed ) {
+	// text-like data, so that deflate produces many blocks
+	idRandom rnd( seed );
+	std::string contents( size, '\0' );
+	for ( int i = 0; i < size; i++ ) {
+		contents[i] = (char)( i % 11 == 0 ? rnd.RandomInt( 256 ) : 'a' + rnd.RandomInt( 4 ) );
+	}
+	return contents;
+}
+
+static idStr FileSystemTest_NormalizedName( const std::string &name ) {
+	idStr res = name.c_str();
+	res.BackSlashesToSlashes();
+	res.ToLower();
+	return res;
+}
+
+static void FileSystemTest_CheckSameEntries( const fileInPack_t *a, const fileInPack_t *b ) {
+	CHECK( a->name == b->name );
+	CHECK( a->pos == b->pos );
+	CHECK( a->compressedSize == b->compressedSize );
+	CHECK( a->uncompressedSize == b->uncompressedSize );
+	CHECK( a->compressionMethod == b->compressionMethod );
+}
+
+static void FileSystemTest_CheckSamePacks( pack_t *uncached, pack_t *cached, const pakTestFiles_t &files ) {
+	REQUIRE( uncached->numfiles == cached->numfiles );
+	CHECK( uncached->checksum == cached->checksum );
+	CHECK( uncached->addon == cached->addon );
+	// hash chains must be identical, so that lookup order is not affected by cache
+	for ( int h = 0; h < FILE_HASH_SIZE; h++ ) {
+		const fileInPack_t *a = uncached->hashTable[h];
+		const fileInPack_t *b = cached->hashTable[h];
+		for ( ; a && b; a = a->next, b = b->next ) {
+			FileSystemTest_CheckSameEntries( a, b );
+		}
+		CHECK( ( a == NULL && b == NULL ) );
+	}
+	for ( const auto &file : files ) {
+		idStr name = FileSystemTest_NormalizedName( file.first );
+		fileInPack_t *a = idFileSystemTest::Find( uncached, name );
+		fileInPack_t *b = idFileSystemTest::Find( cached, name );
+		REQUIRE( a );
+		REQUIRE( b );
+		FileSystemTest_CheckSameEntries( a, b );
+		CHECK( idFileSystemTest::ReadContents( cached, b ) == file.second );
+	}
+	CHECK( idFileSystemTest::Find( cached, "textures/missing.tga" ) == NULL );
+}
+
+// performs same random seeks and reads on file, compares with expected contents
+static void FileSystemTest_CheckRandomAccess( idFile *file, const std::string &expected, int seed ) {
+	idRandom rnd( seed );
+	int len = (int)expected.size();
+	REQUIRE( file->Length() == len );
+	int pos = 0;
+	std::string buffer;
+	for ( int iter = 0; iter < 100; iter++ ) {
+		int mode = rnd.RandomInt( 3 );
+		int target = rnd.RandomInt( len + 1 );
+		if ( mode == 0 ) {
+			CHECK( file->Seek( target, FS_SEEK_SET ) == 0 );
+		} else if ( mode == 1 ) {
+			CHECK( file->Seek( target - pos, FS_SEEK_CUR ) == 0 );
+		} else {
+			CHECK( file->Seek( len - target, FS_SEEK_END ) == 0 );
+		}
+		pos = target;
+		CHECK( file->Tell() == pos );
+		int size = rnd.RandomInt( 500 );
+		buffer.assign( size, '\0' );
+		int readBytes = file->Read( &buffer[0], size );
+		int expectedBytes = idMath::Imin( size, len - pos );
+		REQUIRE( readBytes == expectedBytes );
+		CHECK( buffer.compare( 0, readBytes, expected, pos, readBytes ) == 0 );
+		pos += readBytes;
+		CHECK( file->Tell() == pos );
+	}
+}
+
+TEST_CASE("FileSystem:PakIndexCache") {
+	idStr zipPath = fileSystem->BuildOSPath( cvarSystem->GetCVarString( "fs_savepath" ), "tests", "pakindex_test.pk4" );
+	fileSystem->CreateOSPath( zipPath );
+	idStr cachePath = idFileSystemTest::CachePath( zipPath );
+	REQUIRE( cachePath.Length() > 0 );
+	remove( cachePath );
+
+	pakTestFiles_t files = FileSystemTest_GenerateFiles( 2000, 0 );
+	FileSystemTest_WritePk4( zipPath, files );
+
+	pack_t *uncached = idFileSystemTest::Load( zipPath, false );
+	REQUIRE( uncached );
+	CHECK( !uncached->indexCached );
+
+	// first load walks the zip and saves cache
+	pack_t *first = idFileSystemTest::Load( zipPath, true );
+	REQUIRE( first );
+	CHECK( !first->indexCached );
+	FileSystemTest_CheckSamePacks( uncached, first, files );
+	idFileSystemTest::Free( first );
+
+	// second load uses cache
+	pack_t *cached = idFileSystemTest::Load( zipPath, true );
+	REQUIRE( cached );
+	CHECK( cached->indexCached );
+	FileSystemTest_CheckSamePacks( uncached, cached, files );
+	idFileSystemTest::Free( cached );
+	idFileSystemTest::Free( uncached );
+
+	SUBCASE( "Modified pk4 invalidates cache" ) {
+		// same names and sizes: only CRC of central directory changes
+		pakTestFiles_t modified = files;
+		for ( auto &file : modified ) {
+			for ( char &ch : file.second ) {
+				ch = ( ch == 'a' ? 'b' : ch );
+			}
+		}
+		FileSystemTest_WritePk4( zipPath, modified );
+
+		pack_t *reloaded = idFileSystemTest::Load( zipPath, true );
+		REQUIRE( reloaded );
+		CHECK( !reloaded->indexCached );
+		pack_t *expected = idFileSystemTest::Load( zipPath, false );
+		REQUIRE( expected );
+		FileSystemTest_CheckSamePacks( expected, reloaded, modified );
+		idFileSystemTest::Free( reloaded );
+		idFileSystemTest::Free( expected );
+	}
+
+	SUBCASE( "Corrupted cache is rejected" ) {
+		// truncate file: size check must catch it
+		FILE *f = fopen( cachePath, "rb" );
+		REQUIRE( f );
+		fseek( f, 0, SEEK_END );
+		int size = ftell( f );
+		fseek( f, 0, SEEK_SET );
+		idList<byte> data;
+		data.SetNum( size );
+		REQUIRE( (int)fread( data.Ptr(), 1, size, f ) == size );
+		fclose( f );
+		f = fopen( cachePath, "wb" );
+		fwrite( data.Ptr(), 1, size - 5, f );
+		fclose( f );
+
+		pack_t *reloaded = idFileSystemTest::Load( zipPath, true );
+		REQUIRE( reloaded );
+		CHECK( !reloaded->indexCached );
+		pack_t *expected = idFileSystemTest::Load( zipPath, false );
+		FileSystemTest_CheckSamePacks( expected, reloaded, files );
+		idFileSystemTest::Free( reloaded );
+		idFileSystemTest::Free( expected );
+	}
+
+	remove( cachePath );
+	remove( zipPath );
+}
+
+TEST_CASE("FileSystem:MappedPakFiles") {
+	idStr zipPath = fileSystem->BuildOSPath( cvarSystem->GetCVarString( "fs_savepath" ), "tests", "pakmapping_test.pk4" );
+	fileSystem->CreateOSPath( zipPath );
+	pakTestFiles_t files = FileSystemTest_GenerateFiles( 200, 1 );
+	FileSystemTest_WritePk4( zipPath, files );
+
+	pack_t *pack = idFileSystemTest::Load( zipPath, false );
+	REQUIRE( pack );
+
+	SUBCASE( "Only stored files are mapped" ) {
+		for ( const auto &file : files ) {
+			idStr name = FileSystemTest_NormalizedName( file.first );
+			bool stored = idStr::CheckExtension( name, ".ogg" );
+			idFile *f = idFileSystemTest::Open( pack, name, true );
+			CHECK( ( dynamic_cast<idFile_InZipMapped *>( f ) != NULL ) == ( stored && sizeof( void * ) >= 8 ) );
+			CHECK( idStr::Cmp( f->GetName(), name ) == 0 );
+			CHECK( idStr::Cmp( f->GetFullPath(), pack->pakFilename + "/" + name ) == 0 );
+			fileSystemLocal.CloseFile( f );
+			// whole file must be the same
+			CHECK( idFileSystemTest::ReadContents( pack, idFileSystemTest::Find( pack, name ) ) == file.second );
+		}
+	}
+
+	SUBCASE( "Seeks and reads match minizip" ) {
+		int seed = 0;
+		for ( const auto &file : files ) {
+			idStr name = FileSystemTest_NormalizedName( file.first );
+			if ( !idStr::CheckExtension( name, ".ogg" ) ) {
+				continue;
+			}
+			for ( int mapped = 0; mapped < 2; mapped++ ) {
+				idFile *f = idFileSystemTest::Open( pack, name, mapped != 0 );
+				FileSystemTest_CheckRandomAccess( f, file.second, seed );
+				// seeking outside file fails
+				CHECK( f->Seek( f->Length() + 1, FS_SEEK_SET ) == -1 );
+				fileSystemLocal.CloseFile( f );
+			}
+			seed++;
+		}
+	}
+
+	SUBCASE( "Concurrent reads from many threads" ) {
+		static const int THREADS = 8;
+		std::atomic<int> mismatches( 0 );
+		std::thread threads[THREADS];
+		for ( int t = 0; t < THREADS; t++ ) {
+			threads[t] = std::thread( [&, t]() {
+				for ( int i = t; i < (int)files.size(); i += 3 ) {
+					idStr name = FileSystemTest_NormalizedName( files[i].first );
+					idFile *f = idFileSystemTest::OpenLocked( pack, name );
+					std::string contents( f->Length(), '\0' );
+					if ( f->Length() ) {
+						f->Read( &contents[0], f->Length() );
+					}
+					if ( contents != files[i].second ) {
+						mismatches++;
+					}
+					delete f;
+				}
+			} );
+		}
+		for ( int t = 0; t < THREADS; t++ ) {
+			threads[t].join();
+		}
+		CHECK( mismatches.load() == 0 );
+	}
+
+	SUBCASE( "File outlives its pack" ) {
+		int idx = -1;
+		for ( int i = 0; i < (int)files.size() && idx < 0; i++ ) {
+			if ( idStr::CheckExtension( files[i].first.c_str(), ".ogg" ) && files[i].second.size() > 0 ) {
+				idx = i;
+			}
+		}
+		REQUIRE( idx >= 0 );
+		idFile *f = idFileSystemTest::Open( pack, FileSystemTest_NormalizedName( files[idx].first ), true );
+		idFileSystemTest::Free( pack );
+		pack = NULL;
+		// mapping is reference-counted by opened files
+		FileSystemTest_CheckRandomAccess( f, files[idx].second, 13 );
+		fileSystemLocal.CloseFile( f );
+	}
+
+	if ( pack ) {
+		idFileSystemTest::Free( pack );
+	}
+	remove( zipPath );
+}
+
+TEST_CASE("FileSystem:MappedPakFilesPerformance"
+	* doctest::skip()
+) {
+	idStr zipPath = fileSystem->BuildOSPath( cvarSystem->GetCVarString( "fs_savepath" ), "tests", "pakmapping_perf.pk4" );
+	fileSystem->CreateOSPath( zipPath );
+	pakTestFiles_t files;
+	idRandom rnd( 0 );
+	for ( int i = 0; i < 16; i++ ) {
+		std::string contents( 4 << 20, '\0' );
+		for ( char &ch : contents ) {
+			ch = (char)rnd.RandomInt( 256 );
+		}
+		files.emplace_back( va( "sound/perf_%d.ogg", i ), contents );
+	}
+	FileSystemTest_WritePk4( zipPath, files );
+	pack_t *pack = idFileSystemTest::Load( zipPath, false );
+	REQUIRE( pack );
+
+	// read every file in small chunks with occasional backward seeks, like sound streaming does
+	idList<byte> buffer;
+	buffer.SetNum( 16 << 10 );
+	for ( int mapped = 0; mapped < 2; mapped++ ) {
+		double startClock = Sys_GetClockTicks();
+		long long totalBytes = 0;
+		for ( const auto &file : files ) {
+			idFile *f = idFileSystemTest::Open( pack, file.first.c_str(), mapped != 0 );
+			for ( int pos = 0; pos < f->Length(); ) {
+				if ( pos > 0 && ( pos / buffer.Num() ) % 16 == 0 ) {
+					f->Seek( pos - buffer.Num() / 2, FS_SEEK_SET );
+				}
+				totalBytes += f->Read( buffer.Ptr(), buffer.Num() );
+				pos = f->Tell();
+			}
+			fileSystemLocal.CloseFile( f );
+		}
+		double sec = ( Sys_GetClockTicks() - startClock ) / Sys_ClockTicksPerSecond();
+		MESSAGE( va( "%s: %0.1lf MB in %0.3lf sec (%0.1lf MB/s)",
+			mapped ? "Mapped" : "Minizip", totalBytes / 1048576.0, sec, totalBytes / 1048576.0 / sec
+		) );
+	}
+
+	idFileSystemTest::Free( pack );
+	remove( zipPath );
+}
+
+TEST_CASE("FileSystem:ZipSeekPoints") {
+	idStr zipPath = fileSystem->BuildOSPath( cvarSystem->GetCVarString( "fs_savepath" ), "tests", "zipseek_test.pk4" );
+	fileSystem->CreateOSPath( zipPath );
+	pakTestFiles_t files;
+	files.emplace_back( "textures/large.tga", FileSystemTest_GenerateContents( 3 << 20, 1 ) );
+	files.emplace_back( "textures/small.tga", FileSystemTest_GenerateContents( 100 << 10, 2 ) );
+	files.emplace_back( "textures/empty.tga", "" );
+	FileSystemTest_WritePk4( zipPath, files );
+
+	pack_t *pack = idFileSystemTest::Load( zipPath, false );
+	REQUIRE( pack );
+	fileInPack_t *large = idFileSystemTest::Find( pack, "textures/large.tga" );
+	fileInPack_t *small = idFileSystemTest::Find( pack, "textures/small.tga" );
+	REQUIRE( ( large && small ) );
+	REQUIRE( large->compressionMethod != 0 );
+
+	SUBCASE( "Random seeks match full decompression" ) {
+		for ( int span : { 0, 64, 256 } ) {
+			for ( const auto &file : files ) {
+				idFile *f = idFileSystemTest::OpenWithSeekSpan( pack, file.first.c_str(), span );
+				CHECK( f->IsCompressed() );
+				FileSystemTest_CheckRandomAccess( f, file.second, span + (int)file.second.size() );
+				CHECK( f->Seek( f->Length() + 1, FS_SEEK_SET ) == -1 );
+				CHECK( f->Seek( -1, FS_SEEK_SET ) == -1 );
+				fileSystemLocal.CloseFile( f );
+			}
+		}
+		// index is built only for large file and lives in pak entry
+		REQUIRE( large->seekIndex );
+		CHECK( large->seekIndex->IsBuilt() );
+		CHECK( large->seekIndex->NumPoints() > 3 );
+		CHECK( small->seekIndex == NULL );
+	}
+
+	SUBCASE( "Index is shared between opened files" ) {
+		idFile *f1 = idFileSystemTest::OpenWithSeekSpan( pack, "textures/large.tga", 64 );
+		idFile *f2 = idFileSystemTest::OpenWithSeekSpan( pack, "textures/large.tga", 64 );
+		REQUIRE( large->seekIndex );
+		CHECK( !large->seekIndex->IsBuilt() );
+		FileSystemTest_CheckRandomAccess( f1, files[0].second, 1 );
+		CHECK( large->seekIndex->IsBuilt() );
+		int numPoints = large->seekIndex->NumPoints();
+		FileSystemTest_CheckRandomAccess( f2, files[0].second, 2 );
+		CHECK( large->seekIndex->NumPoints() == numPoints );
+		// seek points are spread evenly: every position has a point not far before it
+		for ( int pos = 0; pos < (int)files[0].second.size(); pos += 10000 ) {
+			const idZipSeekIndex::seekPoint_t &point = large->seekIndex->FindPoint( pos );
+			CHECK( point.uncompressedPos <= (uint64_t)pos );
+			CHECK( pos - point.uncompressedPos <= 3 * ( 64 << 10 ) );
+		}
+		fileSystemLocal.CloseFile( f1 );
+		// file keeps index alive after pack is freed
+		idFileSystemTest::Free( pack );
+		pack = NULL;
+		FileSystemTest_CheckRandomAccess( f2, files[0].second, 3 );
+		fileSystemLocal.CloseFile( f2 );
+	}
+
+	if ( pack ) {
+		idFileSystemTest::Free( pack );
+	}
+	remove( zipPath );
+}
+
+TEST_CASE("FileSystem:ZipSeekPointsPerformance"
+	* doctest::skip()
+) {
+	idStr zipPath = fileSystem->BuildOSPath( cvarSystem->GetCVarString( "fs_savepath" ), "tests", "zipseek_perf.pk4" );
+	fileSystem->CreateOSPath( zipPath );
+	pakTestFiles_t files;
+	files.emplace_back( "video/perf.roq", FileSystemTest_GenerateContents( 32 << 20, 0 ) );
+	FileSystemTest_WritePk4( zipPath, files );
+	pack_t *pack = idFileSystemTest::Load( zipPath, false );
+	REQUIRE( pack );
+
+	// random small reads all over the file
+	idList<byte> buffer;
+	buffer.SetNum( 4 << 10 );
+	for ( int span : { 0, 1024, 256, 64 } ) {
+		idRandom rnd( 0 );
+		double startClock = Sys_GetClockTicks();
+		idFile *f = idFileSystemTest::OpenWithSeekSpan( pack, files[0].first.c_str(), span );
+		for ( int i = 0; i < 200; i++ ) {
+			f->Seek( rnd.RandomInt( f->Length() - buffer.Num() ), FS_SEEK_SET );
+			f->Read( buffer.Ptr(), buffer.Num() );
+		}
+		fileSystemLocal.CloseFile( f );
+		double sec = ( Sys_GetClockTicks() - startClock ) / Sys_ClockTicksPerSecond();
+		MESSAGE( va( "span %d KB: %0.3lf sec for 200 random reads", span, sec ) );
+		idFileSystemTest::Free( pack );
+		pack = idFileSystemTest::Load( zipPath, false );
+	}
+
+	idFileSystemTest::Free( pack );
+	remove( zipPath );
+}
+
+TEST_CASE("FileSystem:ConcurrentOpenStress") {
+	idStr zipPath = fileSystem->BuildOSPath( cvarSystem->GetCVarString( "fs_savepath" ), "tests", "fsstress_test.pk4" );
+	fileSystem->CreateOSPath( zipPath );
+	pakTestFiles_t files = FileSystemTest_GenerateFiles( 3000, 5 );
+	for ( auto &file : files ) {
+		// make sure real game files are not hit
+		file.first = "fsstress_test/" + file.first;
+	}
+	FileSystemTest_WritePk4( zipPath, files );
+	pack_t *pack = idFileSystemTest::Load( zipPath, false );
+	REQUIRE( pack );
+	searchpath_t *search = idFileSystemTest::PushPack( pack );
+
+	static const int THREADS = 8;
+	static const int OPENS_PER_THREAD = 3000;
+	std::atomic<int> notFound( 0 ), mismatches( 0 );
+	auto worker = [&]( int seed ) {
+		idRandom rnd( seed );
+		idList<char> buffer;
+		for ( int i = 0; i < OPENS_PER_THREAD; i++ ) {
+			const auto &file = files[rnd.RandomInt( files.size() )];
+			idStr name = file.first.c_str();
+			name.BackSlashesToSlashes();
+			idFile *f = fileSystem->OpenFileRead( name );
+			if ( !f ) {
+				notFound++;
+				continue;
+			}
+			int len = f->Length();
+			buffer.SetNum( len + 1 );
+			// sometimes read the tail first, then go back
+			int split = ( i % 4 == 0 ? rnd.RandomInt( len + 1 ) : 0 );
+			bool ok = ( len == (int)file.second.size() );
+			if ( ok && split > 0 ) {
+				ok = f->Seek( split, FS_SEEK_SET ) == 0 && f->Read( buffer.Ptr() + split, len - split ) == len - split;
+				ok = ok && f->Seek( 0, FS_SEEK_SET ) == 0 && f->Read( buffer.Ptr(), split ) == split;
+			} else if ( ok ) {
+				ok = f->Read( buffer.Ptr(), len ) == len;
+			}
+			if ( !ok || memcmp( buffer.Ptr(), file.second.data(), len ) != 0 ) {
+				mismatches++;
+			}
+			fileSystem->CloseFile( f );
+		}
+	};
+
+	int reopensBefore = pack->handlePool->NumReopens();
+	double startClock = Sys_GetClockTicks();
+	std::thread threads[THREADS];
+	for ( int t = 0; t < THREADS; t++ ) {
+		threads[t] = std::thread( worker, t );
+	}
+	for ( int t = 0; t < THREADS; t++ ) {
+		threads[t].join();
+	}
+	double sec = ( Sys_GetClockTicks() - startClock ) / Sys_ClockTicksPerSecond();
+
+	CHECK( notFound.load() == 0 );
+	CHECK( mismatches.load() == 0 );
+	// every thread holds at most one handle at a time, the rest are reused
+	CHECK( pack->handlePool->NumReopens() - reopensBefore <= THREADS );
+	MESSAGE( va( "%d opens in %d threads: %0.3lf sec, %d handles acquired, %d opened, %d waits for pool lock",
+		THREADS * OPENS_PER_THREAD, THREADS, sec,
+		pack->handlePool->NumAcquires(), pack->handlePool->NumReopens(), pack->handlePool->NumContended()
+	) );
+
+	idFileSystemTest::PopPack( search );
+	idFileSystemTest::Free( pack );
+	remove( zipPath );
+}
@@ -118,3 +118,51 @@ extern int ZEXPORT unzseek64(unzFile file, ZPOS64_T offset, int origin)
 
 	return UNZ_OK;
 }
+
+extern int ZEXPORT unzSeekToDeflatePoint(unzFile file, ZPOS64_T compressedPos, int bits, int prevByte,
+                                         ZPOS64_T uncompressedPos, const Bytef *window, uInt windowSize)
+{
+	unz64_s* s;
+	file_in_zip64_read_info_s* pfile_in_zip_read_info;
+	ZPOS64_T data_begin;
+
+	if (file == NULL)
+		return UNZ_PARAMERROR;
+
+	s = (unz64_s*)file;
+	pfile_in_zip_read_info = s->pfile_in_zip_read;
+
+	if (pfile_in_zip_read_info == NULL)
+		return UNZ_ERRNO;
+
+	if (pfile_in_zip_read_info->compression_method != Z_DEFLATED || pfile_in_zip_read_info->raw ||
+		!pfile_in_zip_read_info->stream_initialised)
+		return UNZ_ERRNO;
+
+	if (compressedPos > s->cur_file_info.compressed_size || uncompressedPos > s->cur_file_info.uncompressed_size ||
+		bits < 0 || bits > 7)
+		return UNZ_PARAMERROR;
+
+	/* pos_in_zipfile moves forward exactly as rest_read_compressed decreases */
+	data_begin = pfile_in_zip_read_info->pos_in_zipfile -
+		(s->cur_file_info.compressed_size - pfile_in_zip_read_info->rest_read_compressed);
+
+	if (inflateReset(&pfile_in_zip_read_info->stream) != Z_OK)
+		return UNZ_INTERNALERROR;
+	if (bits && inflatePrime(&pfile_in_zip_read_info->stream, bits, prevByte >> (8 - bits)) != Z_OK)
+		return UNZ_INTERNALERROR;
+	if (inflateSetDictionary(&pfile_in_zip_read_info->stream, window, windowSize) != Z_OK)
+		return UNZ_INTERNALERROR;
+
+	pfile_in_zip_read_info->stream.avail_in = 0;
+	pfile_in_zip_read_info->stream.next_in = 0;
+	pfile_in_zip_read_info->pos_in_zipfile = data_begin + compressedPos;
+	pfile_in_zip_read_info->rest_read_compressed = s->cur_file_info.compressed_size - compressedPos;
+
+	/* note: crc32 cannot be checked after that */
+	pfile_in_zip_read_info->rest_read_uncompressed = s->cur_file_info.uncompressed_size - uncompressedPos;
+	pfile_in_zip_read_info->stream.total_out = (uLong)uncompressedPos;
+	pfile_in_zip_read_info->total_out_64 = uncompressedPos;
+
+	return UNZ_OK;
+}
@@ -27,6 +27,13 @@ extern int ZEXPORT unzseek OF((unzFile file, z_off_t offset, int origin));
 extern int ZEXPORT unzseek64 OF((unzFile file, ZPOS64_T offset, int origin));
 /* Seek within the uncompressed data if compression method is storage. */
 
+extern int ZEXPORT unzSeekToDeflatePoint OF((unzFile file, ZPOS64_T compressedPos, int bits, int prevByte,
+                                             ZPOS64_T uncompressedPos, const Bytef *window, uInt windowSize));
+/* Restart inflation of the current deflated file from a point remembered earlier (see zran.c in zlib examples):
+   compressedPos is offset of the first byte after the point in compressed data,
+   bits is number of unused bits in the previous byte prevByte,
+   window is the uncompressed data before the point, used as dictionary. */
+
 #ifdef __cplusplus
 }
 #endif
@@ -281,6 +281,7 @@ void idGameLocal::Clear( void )
 	m_guiError.Clear();
 
 	m_AreaManager.Clear();
+	m_PerceptionScheduler.Clear();
 	m_ConversationSystem.reset();
 
 	if (m_ModelGenerator)
@@ -2537,6 +2538,7 @@ void idGameLocal::MapShutdown( void ) {
 
 	clip.Shutdown();
 	idClipModel::ClearTraceModelCache();
+	idAnimator::ClearPoseCache();
 
 	mapFileName.Clear();
 
@@ -3366,6 +3368,30 @@ gameReturn_t idGameLocal::RunFrame( const usercmd_t *clientCmds, int timestepMs,
 			timer_think.Clear();
 			timer_think.Start();
 
+			if ( rb_islands.GetInteger() > 0 || af_islands.GetInteger() > 0 ) { // step free moveables and ragdolls before they think
+				TRACE_CPU_SCOPE( "PhysicsIslands" )
+				idList<idEntity *> physicsEntities;
+				for ( auto iter = activeEntities.Begin(); iter; activeEntities.Next(iter) ) {
+					ent = iter.entity;
+					if ( ( ent->thinkFlags & TH_PHYSICS ) && !( inCinematic && g_cinematic.GetBool() && !ent->cinematic ) ) {
+						physicsEntities.Append( ent );
+					}
+				}
+				if ( rb_islands.GetInteger() > 0 ) {
+					idPhysics_RigidBody::EvaluateIslands( physicsEntities, time - previousTime, time, rb_islands.GetInteger() > 1 );
+				}
+				if ( af_islands.GetInteger() > 0 ) {
+					idPhysics_AF::EvaluateIslands( physicsEntities, time - previousTime, time, af_islands.GetInteger() > 1 );
+				}
+			}
+
+			m_PerceptionScheduler.BeginFrame( cv_ai_opt_perception_budget.GetInteger() );
+
+			// solve the route requests queued by the AI last frame
+			for ( int aasNum = 0; aasNum < aasList.Num(); aasNum++ ) {
+				aasList[ aasNum ]->RunRouteRequests();
+			}
+
 			{ // let entities think
 				TRACE_CPU_SCOPE( "ThinkAllEntities" )
 				num = 0;
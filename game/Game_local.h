@@ -107,6 +107,7 @@ void gameError( const char *fmt, ... );
 #include "DifficultyManager.h"
 
 #include "ai/AreaManager.h"
+#include "ai/PerceptionScheduler.h"
 #include "GamePlayTimer.h"
 #include "ModelGenerator.h"
 #include "LightController.h"
@@ -520,6 +521,9 @@ public:
 	// The manager for handling AI => Area mappings (needed for AI to remember locked doors, for instance)
 	ai::AreaManager			m_AreaManager;
 
+	// Spreads AI visual scans across frames under a per-frame budget
+	ai::PerceptionScheduler	m_PerceptionScheduler;
+
 	// The manager class for all map conversations
 	ai::ConversationSystemPtr	m_ConversationSystem;
 
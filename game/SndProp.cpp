@@ -83,6 +83,19 @@ const int s_MAX_FLOODNODES = 200;
 **/
 const float s_MAX_DETAILNODES = 6; // grayman #3660 - was 3, so double it
 
+/**
+* Max number of portal events in a cached wavefront expansion from one portal
+*
+* When the expansion goes above this number, it is terminated
+**/
+const int s_MAX_WAVETREE_LABELS = 4096;
+
+/**
+* Cached wavefront expansions go this much [dB] beyond the loss needed by the
+* sound which caused them, so that slightly louder sounds can reuse them.
+**/
+const float s_WAVETREE_LOSS_MARGIN = 10.0f;
+
 /**
 * 1/log(10), useful for change of base between log and log10
 **/
@@ -107,6 +120,8 @@ CsndProp::CsndProp ( void )
 
 	m_TimeStampProp = 0;
 	m_TimeStampPortLoss = 0;
+	m_PortLossEpoch = 0;
+	m_NumExpansions = 0;
 }
 
 void CsndProp::Clear( void )
@@ -117,6 +132,10 @@ void CsndProp::Clear( void )
 
 	m_AreaPropsG.Clear();
 
+	// cached expansions point into m_EventAreas, which is deleted below
+	ClearWaveCache();
+	m_VisitedAreasInd.Clear();
+
 	m_bLoadSuccess = false;
 	m_bDefaultSpherical = false;
 
@@ -215,6 +234,9 @@ void CsndProp::Restore(idRestoreGame *savefile)
 	savefile->ReadInt(m_TimeStampProp);
 	savefile->ReadInt(m_TimeStampPortLoss);
 
+	ClearWaveCache();
+	m_VisitedAreasInd.Clear();
+
 	m_PopAreasInd.Clear();
 	savefile->ReadInt(num);
 	m_PopAreasInd.SetNum(num);
@@ -739,7 +761,10 @@ void CsndProp::Propagate
 		timer_Prop.Start();
 	}
 
-	bExpandFinished = ExpandWave( vol0, origin, minAudThresh ); // grayman #3660
+	bExpandFinished = ExpandWaveCached( vol0, origin, minAudThresh ); // grayman #3660
+
+	// mark populated areas reached by the wave
+	UpdatePopulated();
 
 	if ( cv_spr_debug.GetBool() ) // grayman - only time things if the debug cvar is set
 	{
@@ -844,6 +869,43 @@ Quit:
 	return returnval;
 }
 
+float CsndProp::InitialPortalDist( const idVec3 &origin, SsndArea *pSndArea, int port )
+{
+	// grayman #3660 - using the portal center can throw the loss
+	// results way off when a mission uses large portals. Instead of
+	// using the center, use an orthogonal projection of the origin onto the plane
+	// of the portal, then pull the projection onto the portal if it's not already there.
+	const idWinding *wind = pSndArea->portals[port].winding;
+	idPlane WPlane;
+	wind->GetPlane(WPlane);
+	float scale;
+	WPlane.RayIntersection( origin, WPlane.Normal(), scale );
+	idVec3 portalCoord = origin + scale*WPlane.Normal();
+	if ( !wind->PointInside( WPlane.Normal(), portalCoord, 0.1f ))
+	{
+		// Not inside winding, so pull the point to the portal.
+		if (scale < 0.0f)
+		{
+			portalCoord -= 0.1f*WPlane.Normal();
+		}
+		else
+		{
+			portalCoord += 0.1f*WPlane.Normal();
+		}
+		portalCoord = SurfPoint( origin, portalCoord, &(pSndArea->portals[port]));
+	}
+
+	// old way
+	//idVec3 portalCoord = pSndArea->portals[port].center;
+
+	return (origin - portalCoord).LengthFast() * s_DOOM_TO_METERS;
+}
+
+float CsndProp::PathLoss( float dist, float att ) const
+{
+	return m_SndGlobals.Falloff_Ind * s_invLog10*idMath::Log16(dist) + att + 8;
+}
+
 bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // grayman #3660
 {
 	bool				returnval;
@@ -854,7 +916,6 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 	idList<SExpQue>		AddedAreas; // temp storage for next expansion queue
 	SExpQue				tempQEntry;
 	SPortEvent			*pPortEv; // pointer to portal event data
-	SPopArea			*pPopArea; // pointer to populated area data
 
 	DM_LOG(LC_SOUND, LT_DEBUG)LOGSTRING("Starting wavefront expansion\r" );
 
@@ -863,6 +924,7 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 	{
 		m_EventAreas[i].bVisited = false;
 	}
+	m_VisitedAreasInd.Clear();
 
 	NextAreas.Clear();
 	AddedAreas.Clear();
@@ -880,9 +942,8 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 	}
 
 	m_EventAreas[ initArea ].bVisited = true;
-
-	// Update m_PopAreas to show that the area has been visited
-	m_PopAreas[ initArea ].bVisited = true;
+	m_EventAreas[ initArea ].EntryPorts.Clear();
+	m_VisitedAreasInd.Append( initArea );
 	DM_LOG(LC_SOUND, LT_DEBUG)LOGSTRING("Processing initial area, area %d is marked 'visited'\r",initArea);
 
 	// array index pointers to save on calculation
@@ -892,34 +953,7 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 	// calculate initial portal losses from the sound origin point
 	for ( int i2 = 0 ; i2 < pSndAreas->numPortals ; i2++ )
 	{
-		// grayman #3660 - using the portal center can throw the loss
-		// results way off when a mission uses large portals. Instead of
-		// using the center, use an orthogonal projection of the origin onto the plane
-		// of the portal, then pull the projection onto the portal if it's not already there.
-		const idWinding *wind = pSndAreas->portals[i2].winding;
-		idPlane WPlane;
-		wind->GetPlane(WPlane);
-		float scale;
-		WPlane.RayIntersection( origin, WPlane.Normal(), scale );
-		idVec3 portalCoord = origin + scale*WPlane.Normal();
-		if ( !wind->PointInside( WPlane.Normal(), portalCoord, 0.1f ))
-		{
-			// Not inside winding, so pull the point to the portal.
-			if (scale < 0.0f)
-			{
-				portalCoord -= 0.1f*WPlane.Normal();
-			}
-			else
-			{
-				portalCoord += 0.1f*WPlane.Normal();
-			}
-			portalCoord = SurfPoint( origin, portalCoord, &(pSndAreas->portals[i2]));
-		}
-
-		// old way
-		//idVec3 portalCoord = pSndAreas->portals[i2].center;
-
-		tempDist = (origin - portalCoord).LengthFast() * s_DOOM_TO_METERS;
+		tempDist = InitialPortalDist( origin, pSndAreas, i2 );
 
 		// calculate and set initial portal losses
 		tempAtt = m_AreaPropsG[ initArea ].LossMult * tempDist;
@@ -985,7 +1019,6 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 			// array index pointers to save on calculation
 			pSndAreas = &m_sndAreas[ area ];
 			pEventAreas = &m_EventAreas[ area ];
-			pPopArea = &m_PopAreas[area];
 
 			// find the local portal number in area for the portal handle
 			int portHandle = NextAreas[j].portalH;
@@ -1002,6 +1035,18 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 			
 			DM_LOG(LC_SOUND, LT_DEBUG)LOGSTRING("Identified local portal index %d\r", LocalPort );
 
+			if ( !pEventAreas->bVisited )
+			{
+				// first visit in this expansion: forget losses left over from
+				// previous propagations, so the result only depends on this one
+				for ( int i = 0 ; i < pSndAreas->numPortals ; i++ )
+				{
+					pEventAreas->PortalDat[i].Loss = idMath::INFINITY;
+				}
+				pEventAreas->EntryPorts.Clear();
+				m_VisitedAreasInd.Append( area );
+			}
+
 			pPortEv = &pEventAreas->PortalDat[ LocalPort ];
 
 			// copy information from the portal's other side
@@ -1011,16 +1056,8 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 			pPortEv->Floods = floods - 1;
 			pPortEv->PrevPort = NextAreas[j].PrevPort;
 
-			// Updated the Populated Areas to show that it's been visited
-			// Only do this for populated areas that matter (ie, they've been updated
-			// on this propagation)
-			
-			if ( pPopArea->addedTime == m_TimeStampProp )
-			{
-				pPopArea->bVisited = true;
-				// note the portal flooded in on for later processing
-				pPopArea->VisitedPorts.AddUnique( LocalPort );
-			}
+			// note the portal flooded in on for later processing (see UpdatePopulated)
+			pEventAreas->EntryPorts.AddUnique( LocalPort );
 
 			// Flood to portals in this area
 			for ( int i = 0 ; i < pSndAreas->numPortals ; i++ )
@@ -1105,6 +1142,342 @@ bool CsndProp::ExpandWave(float volInit, idVec3 origin, float minAudThresh) // g
 	return returnval;
 } // end function
 
+bool CsndProp::ExpandWaveCached( float volInit, idVec3 origin, float minAudThresh )
+{
+	int cacheSize = cv_spr_cache.GetInteger();
+
+	m_NumExpansions++;
+
+	int initArea = gameRenderWorld->GetAreaAtPoint( origin );
+
+	if ( cacheSize <= 0 || initArea < 0 )
+	{
+		if ( cacheSize <= 0 )
+		{
+			ClearWaveCache();
+		}
+		return ExpandWave( volInit, origin, minAudThresh );
+	}
+
+	float maxLoss = volInit - minAudThresh;
+
+	if ( m_WaveCache.Num() > cacheSize )
+	{
+		m_WaveCache.SetNum( cacheSize );
+	}
+
+	// look for the expansions from this area, else pick a free slot,
+	// an outdated one, or the least recently used one
+	int slot = -1;
+	for ( int i = 0 ; i < m_WaveCache.Num() ; i++ )
+	{
+		if ( m_WaveCache[i].portLossEpoch == m_PortLossEpoch && m_WaveCache[i].initArea == initArea )
+		{
+			slot = i;
+			break;
+		}
+	}
+	if ( slot < 0 && m_WaveCache.Num() < cacheSize )
+	{
+		slot = m_WaveCache.Num();
+		m_WaveCache.SetNum( slot + 1 );
+		m_WaveCache[slot].initArea = -1;
+	}
+	if ( slot < 0 )
+	{
+		for ( int i = 0 ; i < m_WaveCache.Num() ; i++ )
+		{
+			if ( m_WaveCache[i].portLossEpoch != m_PortLossEpoch )
+			{
+				slot = i;
+				break;
+			}
+			if ( slot < 0 || m_WaveCache[i].lastUsed < m_WaveCache[slot].lastUsed )
+			{
+				slot = i;
+			}
+		}
+	}
+
+	SsndArea *pSndArea = &m_sndAreas[ initArea ];
+	SWaveTree &tree = m_WaveCache[slot];
+
+	if ( tree.initArea != initArea || tree.portLossEpoch != m_PortLossEpoch || tree.maxLoss < maxLoss )
+	{
+		// expand a bit further than needed, so that slightly louder sounds reuse it too
+		tree.initArea = initArea;
+		tree.maxLoss = maxLoss + s_WAVETREE_LOSS_MARGIN;
+		tree.portLossEpoch = m_PortLossEpoch;
+		tree.Roots.SetNum( pSndArea->numPortals );
+		for ( int i = 0 ; i < pSndArea->numPortals ; i++ )
+		{
+			BuildWaveRoot( initArea, i, tree.maxLoss, tree.Roots[i] );
+		}
+		DM_LOG(LC_SOUND, LT_DEBUG)LOGSTRING("Expanded wavefront tree from area %d up to loss %f [dB]\r", initArea, tree.maxLoss );
+	}
+	else
+	{
+		DM_LOG(LC_SOUND, LT_DEBUG)LOGSTRING("Reusing wavefront tree from area %d\r", initArea );
+	}
+	tree.lastUsed = m_NumExpansions;
+
+	// clear the visited settings on m_EventAreas from previous propagations
+	for ( int i = 0 ; i < m_numAreas ; i++ )
+	{
+		m_EventAreas[i].bVisited = false;
+	}
+	m_VisitedAreasInd.Clear();
+
+	bool bFinished = true;
+	float LossMult = m_AreaPropsG[ initArea ].LossMult;
+
+	for ( int i = 0 ; i < tree.Roots.Num() ; i++ )
+	{
+		const SWaveRoot &root = tree.Roots[i];
+
+		// only this part depends on the sound origin, the rest comes from the tree
+		float initDist = InitialPortalDist( origin, pSndArea, i );
+		float initAtt = LossMult * initDist;
+
+		for ( int j = 0 ; j < root.Labels.Num() ; j++ )
+		{
+			const SWaveLabel &label = root.Labels[j];
+
+			if ( j > 0 && ( label.bDominated || label.minLoss > maxLoss ) )
+			{
+				continue;
+			}
+
+			float tempDist = initDist + label.Dist;
+			float tempAtt = initAtt + label.Att;
+			float tempLoss = PathLoss( tempDist, tempAtt );
+
+			// the initial portal is always set, see ExpandWave
+			if ( j > 0 && (volInit - tempLoss) < minAudThresh )
+			{
+				continue;
+			}
+
+			int area = label.area;
+			SEventArea *pEventArea = &m_EventAreas[ area ];
+			if ( !pEventArea->bVisited )
+			{
+				for ( int k = 0 ; k < m_sndAreas[ area ].numPortals ; k++ )
+				{
+					pEventArea->PortalDat[k].Loss = idMath::INFINITY;
+				}
+				pEventArea->EntryPorts.Clear();
+				pEventArea->bVisited = true;
+				m_VisitedAreasInd.Append( area );
+			}
+
+			if ( label.bEntry )
+			{
+				pEventArea->EntryPorts.AddUnique( label.port );
+			}
+
+			SPortEvent *pPortEv = &pEventArea->PortalDat[ label.port ];
+			if ( tempLoss < pPortEv->Loss )
+			{
+				pPortEv->Loss = tempLoss;
+				pPortEv->Dist = tempDist;
+				pPortEv->Att = tempAtt;
+				if ( label.PrevLabel < 0 )
+				{
+					pPortEv->PrevPort = NULL;
+				}
+				else
+				{
+					const SWaveLabel &prev = root.Labels[ label.PrevLabel ];
+					pPortEv->PrevPort = &m_EventAreas[ prev.area ].PortalDat[ prev.port ];
+				}
+			}
+
+			if ( j == 0 )
+			{
+				// the wave does not leave the initial area through this portal
+				if ( !( (volInit - tempLoss) > minAudThresh ) )
+				{
+					break;
+				}
+				bFinished = bFinished && root.bFinished;
+			}
+		}
+	}
+
+	if ( !m_EventAreas[ initArea ].bVisited )
+	{
+		// area without portals
+		m_EventAreas[ initArea ].EntryPorts.Clear();
+		m_EventAreas[ initArea ].bVisited = true;
+		m_VisitedAreasInd.Append( initArea );
+	}
+
+	// paths from different initial portals are mixed, so count the floods
+	// along the final path (DetailedMin follows PrevPort that many times)
+	for ( int i = 0 ; i < m_VisitedAreasInd.Num() ; i++ )
+	{
+		int area = m_VisitedAreasInd[i];
+		for ( int j = 0 ; j < m_sndAreas[ area ].numPortals ; j++ )
+		{
+			SPortEvent *pPortEv = &m_EventAreas[ area ].PortalDat[j];
+			if ( pPortEv->Loss == idMath::INFINITY )
+			{
+				continue;
+			}
+			pPortEv->Floods = 1;
+			for ( const SPortEvent *pPrev = pPortEv->PrevPort ; pPrev && pPortEv->Floods < s_MAX_FLOODNODES ; pPrev = pPrev->PrevPort )
+			{
+				pPortEv->Floods++;
+			}
+		}
+	}
+
+	return bFinished;
+}
+
+void CsndProp::BuildWaveRoot( int initArea, int port, float maxLoss, SWaveRoot &root )
+{
+	idList<int> queue; // entry labels to flood from
+	idList<int> slotStart; // first portal slot of each area
+	idList< idList<int> > entryLabels, exitLabels; // labels not dominated so far, per portal slot
+
+	slotStart.SetNum( m_numAreas + 1 );
+	slotStart[0] = 0;
+	for ( int i = 0 ; i < m_numAreas ; i++ )
+	{
+		slotStart[i + 1] = slotStart[i] + m_sndAreas[i].numPortals;
+	}
+	entryLabels.SetNum( slotStart[ m_numAreas ] );
+	exitLabels.SetNum( slotStart[ m_numAreas ] );
+
+	root.Labels.Clear();
+	root.bFinished = true;
+
+	// the loss depends on the sound origin, so keep every path to a portal
+	// unless another one has both less distance and less attenuation
+	auto AddLabel = [&]( idList<int> &labels, const SWaveLabel &label ) -> int {
+		for ( int i = 0 ; i < labels.Num() ; i++ )
+		{
+			const SWaveLabel &other = root.Labels[ labels[i] ];
+			if ( other.Dist <= label.Dist && other.Att <= label.Att )
+			{
+				return -1;
+			}
+		}
+		for ( int i = labels.Num() - 1 ; i >= 0 ; i-- )
+		{
+			SWaveLabel &other = root.Labels[ labels[i] ];
+			if ( label.Dist <= other.Dist && label.Att <= other.Att )
+			{
+				other.bDominated = true;
+				labels.RemoveIndex( i );
+			}
+		}
+		int index = root.Labels.Append( label );
+		labels.Append( index );
+		return index;
+	};
+
+	// leave an area through a portal and flood into the area on the other side
+	auto Flood = [&]( SWaveLabel label ) {
+		if ( AddLabel( exitLabels[ slotStart[ label.area ] + label.port ], label ) < 0 )
+		{
+			return;
+		}
+
+		const SsndPortal *pPortal = &m_sndAreas[ label.area ].portals[ label.port ];
+		const SPortData *pPortData = &m_PortData[ pPortal->handle - 1 ];
+		label.area = pPortal->to;
+		label.port = ( pPortData->Areas[0] == pPortal->to ) ? pPortData->LocalIndex[0] : pPortData->LocalIndex[1];
+		label.bEntry = true;
+
+		int index = AddLabel( entryLabels[ slotStart[ label.area ] + label.port ], label );
+		if ( index >= 0 )
+		{
+			queue.Append( index );
+		}
+	};
+
+	// the initial portal, the part from the sound origin is added for each sound
+	SWaveLabel label;
+	label.area = initArea;
+	label.port = port;
+	label.Dist = 0.0f;
+	label.Att = m_PortData[ m_sndAreas[ initArea ].portals[port].handle - 1 ].lossAI;
+	label.minLoss = -idMath::INFINITY;
+	label.PrevLabel = -1;
+	label.bEntry = false;
+	label.bDominated = false;
+	Flood( label );
+
+	for ( int head = 0 ; head < queue.Num() ; head++ )
+	{
+		if ( root.Labels.Num() >= s_MAX_WAVETREE_LABELS )
+		{
+			root.bFinished = false;
+			break;
+		}
+
+		// copy, since root.Labels grows below
+		const SWaveLabel entry = root.Labels[ queue[head] ];
+		if ( entry.bDominated )
+		{
+			continue;
+		}
+
+		SsndArea *pSndArea = &m_sndAreas[ entry.area ];
+		for ( int i = 0 ; i < pSndArea->numPortals ; i++ )
+		{
+			// do not flood back thru same portal we came in
+			if ( i == entry.port )
+			{
+				continue;
+			}
+
+			float AddedDist = pSndArea->portalDists->GetRev( entry.port, i );
+			label.area = entry.area;
+			label.port = i;
+			label.Dist = entry.Dist + AddedDist;
+			label.Att = entry.Att + AddedDist * m_AreaPropsG[ entry.area ].LossMult;
+			label.Att += m_PortData[ pSndArea->portals[i].handle - 1 ].lossAI;
+			label.PrevLabel = queue[head];
+			label.bEntry = false;
+
+			// the sound origin only adds distance and attenuation, so
+			// with a falloff the loss is least for an origin at the initial portal
+			label.minLoss = ( m_SndGlobals.Falloff_Ind >= 0 && label.Dist > 0 ) ? PathLoss( label.Dist, label.Att ) : -idMath::INFINITY;
+			if ( label.minLoss > maxLoss )
+			{
+				continue;
+			}
+
+			Flood( label );
+		}
+	}
+}
+
+void CsndProp::UpdatePopulated( void )
+{
+	for ( int i = 0 ; i < m_PopAreasInd.Num() ; i++ )
+	{
+		int area = m_PopAreasInd[i];
+		SPopArea *pPopArea = &m_PopAreas[area];
+		const SEventArea *pEventArea = &m_EventAreas[area];
+
+		pPopArea->bVisited = pEventArea->bVisited;
+		if ( pEventArea->bVisited )
+		{
+			pPopArea->VisitedPorts = pEventArea->EntryPorts;
+		}
+	}
+}
+
+void CsndProp::ClearWaveCache( void )
+{
+	m_WaveCache.Clear();
+}
+
 void CsndProp::ProcessPopulated( float volInit, idVec3 origin, SSprParms *propParms )
 {
 	float LeastLoss, TestLoss, tempDist, tempAtt, tempLoss;
@@ -1769,6 +2142,9 @@ void CsndProp::SetPortalAILoss( int handle, float value ) // grayman #3042 - spe
 
 	// update the portal loss info timestamp
 	m_TimeStampPortLoss = gameLocal.time;
+
+	// cached wavefront expansions are outdated now
+	m_PortLossEpoch++;
 }
 
 void CsndProp::SetPortalPlayerLoss( int handle, float value ) // grayman #3042 - specific to Player
@@ -1991,3 +2367,223 @@ bool CsndProp::ExpandWaveFast( float volInit, idVec3 origin, float MaxDist, int
 }
 
 */
+
+
+#include "../tests/testing.h"
+
+class CsndPropTest {
+public:
+	struct Snapshot {
+		bool finished;
+		idList<int> areas;
+		idList<SPortEvent> ports;
+		idList<int> entryPorts;
+	};
+
+	static bool MapLoaded( void ) {
+		CsndProp *sp = gameLocal.m_sndProp;
+		return sp && gameRenderWorld && sp->m_bLoadSuccess && sp->m_numAreas > 0;
+	}
+
+	static void GetOrigins( idList<idVec3> &origins, int maxCount ) {
+		CsndProp *sp = gameLocal.m_sndProp;
+		for ( int a = 0; a < sp->m_numAreas && origins.Num() < maxCount; a++ ) {
+			idVec3 origin = sp->m_sndAreas[a].center;
+			if ( gameRenderWorld->GetAreaAtPoint( origin ) >= 0 ) {
+				origins.Append( origin );
+			}
+		}
+	}
+
+	static void TakeSnapshot( Snapshot &snap, bool finished ) {
+		CsndProp *sp = gameLocal.m_sndProp;
+		snap.finished = finished;
+		snap.areas.Clear();
+		snap.ports.Clear();
+		snap.entryPorts.Clear();
+		for ( int a = 0; a < sp->m_numAreas; a++ ) {
+			const SEventArea &ev = sp->m_EventAreas[a];
+			if ( !ev.bVisited ) {
+				continue;
+			}
+			snap.areas.Append( a );
+			for ( int p = 0; p < sp->m_sndAreas[a].numPortals; p++ ) {
+				snap.ports.Append( ev.PortalDat[p] );
+			}
+			snap.entryPorts.Append( ev.EntryPorts );
+			snap.entryPorts.Append( -1 );
+		}
+	}
+
+	static bool SameInts( const idList<int> &a, const idList<int> &b ) {
+		return a.Num() == b.Num() && memcmp( a.Ptr(), b.Ptr(), a.Num() * sizeof( int ) ) == 0;
+	}
+
+	static void CheckEqual( const Snapshot &a, const Snapshot &b ) {
+		CHECK( a.finished == b.finished );
+		REQUIRE( SameInts( a.areas, b.areas ) );
+		REQUIRE( a.ports.Num() == b.ports.Num() );
+		for ( int i = 0; i < a.ports.Num(); i++ ) {
+			const SPortEvent &pa = a.ports[i], &pb = b.ports[i];
+			CHECK( pa.Loss == pb.Loss );
+			if ( pa.Loss == idMath::INFINITY ) {
+				continue;	// not reached by the wave, rest is garbage
+			}
+			CHECK( pa.Dist == pb.Dist );
+			CHECK( pa.Att == pb.Att );
+			CHECK( pa.Floods == pb.Floods );
+			CHECK( pa.PrevPort == pb.PrevPort );
+		}
+		CHECK( SameInts( a.entryPorts, b.entryPorts ) );
+	}
+
+	// cached expansion keeps all paths which can be best for some origin,
+	// so it reaches the same areas and finds the same or lower losses
+	static void CheckBound( const Snapshot &fresh, const Snapshot &cached ) {
+		if ( !fresh.finished || !cached.finished ) {
+			return;
+		}
+		REQUIRE( SameInts( fresh.areas, cached.areas ) );
+		REQUIRE( fresh.ports.Num() == cached.ports.Num() );
+		for ( int i = 0; i < fresh.ports.Num(); i++ ) {
+			if ( fresh.ports[i].Loss != idMath::INFINITY ) {
+				CHECK( cached.ports[i].Loss <= fresh.ports[i].Loss + 0.01f );
+			}
+		}
+	}
+
+	// DetailedMin follows PrevPort as many times as Floods says
+	static void CheckChains( void ) {
+		CsndProp *sp = gameLocal.m_sndProp;
+		for ( int a = 0; a < sp->m_numAreas; a++ ) {
+			const SEventArea &ev = sp->m_EventAreas[a];
+			if ( !ev.bVisited ) {
+				continue;
+			}
+			for ( int p = 0; p < sp->m_sndAreas[a].numPortals; p++ ) {
+				const SPortEvent &port = ev.PortalDat[p];
+				if ( port.Loss == idMath::INFINITY ) {
+					continue;
+				}
+				if ( port.PrevPort ) {
+					CHECK( port.PrevPort->Loss <= port.Loss );
+					CHECK( ( port.Floods == port.PrevPort->Floods + 1 || port.Floods == s_MAX_FLOODNODES ) );
+				} else {
+					CHECK( port.Floods == 1 );
+				}
+			}
+		}
+	}
+
+	static bool Expand( bool cached, float vol, const idVec3 &origin, float thresh ) {
+		CsndProp *sp = gameLocal.m_sndProp;
+		return cached ? sp->ExpandWaveCached( vol, origin, thresh ) : sp->ExpandWave( vol, origin, thresh );
+	}
+
+	static int CacheSize( void ) {
+		return gameLocal.m_sndProp->m_WaveCache.Num();
+	}
+	static void ClearCache( void ) {
+		gameLocal.m_sndProp->ClearWaveCache();
+	}
+};
+
+TEST_CASE("SndProp:WaveCacheMatchesExpansion") {
+	if ( !CsndPropTest::MapLoaded() ) {
+		MESSAGE( "No map with sound propagation data loaded, test skipped" );
+		return;
+	}
+	idTestCVar sprCache( cv_spr_cache, 16 );
+	CsndPropTest::ClearCache();
+
+	idList<idVec3> origins;
+	CsndPropTest::GetOrigins( origins, 32 );
+	static const float VOLUMES[] = { 40.0f, 60.0f, 90.0f };
+	static const float THRESH = 20.0f;
+
+	for ( int i = 0; i < origins.Num(); i++ ) {
+		CsndPropTest::ClearCache();
+		for ( float vol : VOLUMES ) {
+			CsndPropTest::Snapshot fresh, miss, hit;
+			CsndPropTest::TakeSnapshot( fresh, CsndPropTest::Expand( false, vol, origins[i], THRESH ) );
+
+			// louder sounds expand the tree of the same area further
+			CsndPropTest::TakeSnapshot( miss, CsndPropTest::Expand( true, vol, origins[i], THRESH ) );
+			CsndPropTest::CheckBound( fresh, miss );
+			CsndPropTest::CheckChains();
+			REQUIRE( CsndPropTest::CacheSize() == 1 );
+
+			// spoil event data with another sound, then restore from cache
+			CsndPropTest::Expand( false, vol, origins[( i + 1 ) % origins.Num()], THRESH );
+			CsndPropTest::TakeSnapshot( hit, CsndPropTest::Expand( true, vol, origins[i], THRESH ) );
+			CsndPropTest::CheckEqual( miss, hit );
+			CHECK( CsndPropTest::CacheSize() == 1 );
+
+			// another origin in the same area reuses the tree
+			int area = gameRenderWorld->GetAreaAtPoint( origins[i] );
+			for ( int k = 0; k < 3; k++ ) {
+				idVec3 moved = origins[i];
+				moved[k] += 16.0f;
+				if ( gameRenderWorld->GetAreaAtPoint( moved ) != area ) {
+					continue;
+				}
+				CsndPropTest::TakeSnapshot( fresh, CsndPropTest::Expand( false, vol, moved, THRESH ) );
+				CsndPropTest::TakeSnapshot( hit, CsndPropTest::Expand( true, vol, moved, THRESH ) );
+				CsndPropTest::CheckBound( fresh, hit );
+				CsndPropTest::CheckChains();
+				CHECK( CsndPropTest::CacheSize() == 1 );
+			}
+		}
+	}
+
+	// changing door loss must invalidate cached expansions
+	if ( origins.Num() > 0 && gameRenderWorld->NumPortals() > 0 ) {
+		CsndProp *sp = gameLocal.m_sndProp;
+		for ( int handle = 1; handle <= gameRenderWorld->NumPortals(); handle++ ) {
+			float oldLoss = sp->GetPortalAILoss( handle );
+			CsndPropTest::Snapshot fresh, cached;
+			CsndPropTest::Expand( true, 60.0f, origins[0], THRESH );
+			sp->SetPortalAILoss( handle, oldLoss + 15.0f );
+			CsndPropTest::TakeSnapshot( fresh, CsndPropTest::Expand( false, 60.0f, origins[0], THRESH ) );
+			CsndPropTest::TakeSnapshot( cached, CsndPropTest::Expand( true, 60.0f, origins[0], THRESH ) );
+			CsndPropTest::CheckBound( fresh, cached );
+			sp->SetPortalAILoss( handle, oldLoss );
+		}
+	}
+
+	CsndPropTest::ClearCache();
+}
+
+TEST_CASE("SndProp:WaveCachePerformance"
+	* doctest::skip()
+) {
+	if ( !CsndPropTest::MapLoaded() ) {
+		MESSAGE( "No map with sound propagation data loaded, test skipped" );
+		return;
+	}
+	idTestCVar sprCache( cv_spr_cache );
+
+	// typical gameplay: a few sound sources (AI footsteps, machinery) moving around a bit
+	idList<idVec3> origins;
+	CsndPropTest::GetOrigins( origins, 8 );
+	static const int REPEATS = 200;
+
+	for ( int mode = 0; mode < 2; mode++ ) {
+		cv_spr_cache.SetInteger( mode ? 16 : 0 );
+		CsndPropTest::ClearCache();
+		double start = Sys_GetClockTicks();
+		for ( int r = 0; r < REPEATS; r++ ) {
+			for ( int i = 0; i < origins.Num(); i++ ) {
+				idVec3 origin = origins[i];
+				origin.x += ( r % 8 ) * 4.0f;
+				CsndPropTest::Expand( true, 60.0f, origin, 20.0f );
+			}
+		}
+		double sec = ( Sys_GetClockTicks() - start ) / Sys_ClockTicksPerSecond();
+		MESSAGE( va( "%s: %0.3lf ms for %d expansions from %d origins",
+			mode ? "Cached" : "Uncached", 1e+3 * sec, REPEATS * origins.Num(), origins.Num()
+		) );
+	}
+
+	CsndPropTest::ClearCache();
+}
@@ -105,8 +105,64 @@ typedef struct SEventArea_s
 
 	SPortEvent	*PortalDat; // Array of event data for each portal in the area
 
+	idList<int>	EntryPorts; // local portals that the sound flooded in on
+
 } SEventArea;
 
+/**
+* Portal event reached by a cached wavefront expansion from one portal of the
+* initial area. Distance and attenuation are counted from that portal, the part
+* from the sound origin to the portal is added for each sound.
+**/
+typedef struct SWaveLabel_s
+{
+	int			area; // area of the portal event
+
+	int			port; // local portal index in the area
+
+	float		Dist; // distance from the initial portal [m]
+
+	float		Att; // attenuation from the initial portal, including its portal loss
+
+	float		minLoss; // lower bound of the loss at the portal for any sound origin
+
+	int			PrevLabel; // label of the portal visited immediately before, -1 if none
+
+	bool		bEntry; // the wave floods into the area through this portal
+
+	bool		bDominated; // another path reaches the portal with less distance and attenuation
+
+} SWaveLabel;
+
+/**
+* Wavefront expansion from one portal of the initial area
+**/
+typedef struct SWaveRoot_s
+{
+	bool				bFinished; // expansion was not stopped by the label limit
+
+	idList<SWaveLabel>	Labels; // the first label is the initial portal itself
+
+} SWaveRoot;
+
+/**
+* Wavefront expansions from all portals of an area, reused by every sound
+* starting in that area until portal losses change.
+**/
+typedef struct SWaveTree_s
+{
+	int				initArea; // area of the sound origins
+
+	float			maxLoss; // paths with larger loss are not expanded
+
+	int				portLossEpoch; // value of m_PortLossEpoch when expansion was done
+
+	int				lastUsed; // propagation counter when this entry was last used
+
+	idList<SWaveRoot> Roots; // one per portal of initArea
+
+} SWaveTree;
+
 /**
 * Expansion queue entry for the wavefront expansion algorithm
 **/
@@ -130,6 +186,7 @@ typedef struct SExpQue_s
 
 
 class CsndProp : public CsndPropBase {
+	friend class CsndPropTest;
 
 public:
 	CsndProp( void );
@@ -184,6 +241,39 @@ protected:
 	**/
 	bool ExpandWave(float volInit, idVec3 origin, float minAudThresh);
 
+	/**
+	* Same as ExpandWave, but reuses the expansions from the portals of the initial area
+	* done for a previous sound in that area, if portal losses did not change since then.
+	* Only the distances from the origin to the portals of the initial area are computed.
+	**/
+	bool ExpandWaveCached(float volInit, idVec3 origin, float minAudThresh);
+
+	/**
+	* Expand the wave from local portal port of area initArea into root, following
+	*	all paths with loss below maxLoss for some sound origin in initArea.
+	**/
+	void BuildWaveRoot( int initArea, int port, float maxLoss, SWaveRoot &root );
+
+	/**
+	* Distance [m] from origin to the given portal of the area it is in
+	**/
+	float InitialPortalDist( const idVec3 &origin, SsndArea *pSndArea, int port );
+
+	/**
+	* Loss of the wave at a portal reached after given distance and attenuation
+	**/
+	float PathLoss( float dist, float att ) const;
+
+	/**
+	* Copy entry portals from visited event areas to the populated areas.
+	**/
+	void UpdatePopulated( void );
+
+	/**
+	* Forget all cached wavefront expansions
+	**/
+	void ClearWaveCache( void );
+
 	/**
 	* Faster and less accurate wavefront expansion algorithm.
 	* Only visits areas once.
@@ -266,6 +356,27 @@ protected:
 	**/
 	int				m_TimeStampPortLoss;
 
+	/**
+	* Incremented every time AI portal losses change.
+	* Cached wavefront expansions are valid only for the same value.
+	**/
+	int				m_PortLossEpoch;
+
+	/**
+	* Number of wavefront expansions done (including cached ones)
+	**/
+	int				m_NumExpansions;
+
+	/**
+	* Areas visited during the last wavefront expansion
+	**/
+	idList<int>		m_VisitedAreasInd;
+
+	/**
+	* Wavefront expansions from recently used areas, see tdm_spr_cache
+	**/
+	idList<SWaveTree> m_WaveCache;
+
 	/**
 	* Populated areas : List of indices of AI populated areas for this expansion
 	**/
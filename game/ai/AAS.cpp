@@ -47,6 +47,10 @@ idAASLocal::idAASLocal( void )
 {
 	elevatorSystem = new eas::tdmEAS(this);
 	file = NULL;
+	routeJobsActive = false;
+	storedStateHash = 0;
+	routingStateHash = 0;
+	routingStateChanged = true;
 }
 
 /*
@@ -99,6 +103,7 @@ idAASLocal::Shutdown
 void idAASLocal::Shutdown( void ) {
 	if ( file ) {
 		elevatorSystem->Clear();
+		WriteRoutingCacheFile();
 		ShutdownRouting();
 		RemoveAllObstacles();
 		AASFileManager->FreeAAS( file );
@@ -423,6 +428,7 @@ void idAASLocal::SetAreaTravelFlag( int index, int flag )
 	if (file != NULL)
 	{
 		file->SetAreaTravelFlag(index, flag);
+		routingStateChanged = true;
 	}
 }
 
@@ -431,6 +437,7 @@ void idAASLocal::RemoveAreaTravelFlag( int index, int flag )
 	if (file != NULL)
 	{
 		file->RemoveAreaTravelFlag(index, flag);
+		routingStateChanged = true;
 	}
 }
 
@@ -467,6 +474,7 @@ CFrobDoor* idAASLocal::GetDoor(int areaNum) const
 void idAASLocal::Save(idSaveGame* savefile) const
 {
 	elevatorSystem->Save(savefile);
+	WriteRoutingCacheFile();
 }
 
 void idAASLocal::Restore(idRestoreGame* savefile)
@@ -69,6 +69,13 @@ public:
 
 typedef int aasHandle_t;
 
+typedef struct aasRouteResult_s {
+	bool						found;			// true if there is a route towards the goal
+	int							travelTime;		// travel time towards the goal
+	idReachability *			reach;			// first reachability to use
+	CFrobDoor *					firstDoor;		// first door on the route (NULL otherwise)
+} aasRouteResult_t;
+
 /**
 * This is the typedef for a reachability tracking list
 */
@@ -163,6 +170,21 @@ public:
 	// Get the travel time and first reachability to be used towards the goal, returns true if there is a path.
 	virtual bool				RouteToGoalArea( int areaNum, const idVec3 origin, int goalAreaNum, int travelFlags, int &travelTime, idReachability **reach, CFrobDoor** firstDoor, idActor* actor ) const = 0;
 
+	/**
+	 * Asynchronous version of RouteToGoalArea. The query is queued and solved on the job threads
+	 * together with all other queued queries during the next RunRouteRequests(), the result is
+	 * picked up with GetRouteResult() afterwards. The result is the same RouteToGoalArea() would give.
+	 *
+	 * @returns a handle for the request, which must be released with GetRouteResult() or CancelRouteRequest().
+	 */
+	virtual aasHandle_t			QueueRouteRequest( int areaNum, const idVec3 &origin, int goalAreaNum, int travelFlags, idActor* actor ) = 0;
+								// Returns true and releases the request if its result is available.
+	virtual bool				GetRouteResult( aasHandle_t handle, aasRouteResult_t &result ) = 0;
+								// Releases a request, whether it was solved or not.
+	virtual void				CancelRouteRequest( aasHandle_t handle ) = 0;
+								// Solves all queued route requests, called once per frame before the entities think.
+	virtual void				RunRouteRequests( void ) = 0;
+
 	/**
 	 * greebo: Tries to set up a walk path from areaNum/origin to goalAreaNum/goalOrigin for the given travel flags.
 	 *
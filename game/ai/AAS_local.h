@@ -73,6 +73,20 @@ private:
 };
 
 
+class idRouteRequest {
+	friend class idAASLocal;
+
+private:
+	int							state;					// free, queued or solved
+	int							areaNum;				// start area
+	idVec3						origin;					// start point
+	int							goalAreaNum;			// goal area
+	int							travelFlags;			// allowed travel flags
+	idActor *					actor;					// actor the route is for (can be NULL)
+	aasRouteResult_t			result;					// result once solved
+};
+
+
 class CMultiStateMover;
 namespace eas { class tdmEAS; }
 
@@ -109,6 +123,10 @@ public:
 	virtual void				RemoveAllObstacles( void ) override;
 	virtual int					TravelTimeToGoalArea( int areaNum, const idVec3 &origin, int goalAreaNum, int travelFlags, idActor* actor ) const override;
 	virtual bool				RouteToGoalArea( int areaNum, const idVec3 origin, int goalAreaNum, int travelFlags, int &travelTime, idReachability **reach, CFrobDoor** firstDoor, idActor* actor ) const override;
+	virtual aasHandle_t			QueueRouteRequest( int areaNum, const idVec3 &origin, int goalAreaNum, int travelFlags, idActor* actor ) override;
+	virtual bool				GetRouteResult( aasHandle_t handle, aasRouteResult_t &result ) override;
+	virtual void				CancelRouteRequest( aasHandle_t handle ) override;
+	virtual void				RunRouteRequests( void ) override;
 	virtual bool				WalkPathToGoal( aasPath_t &path, int areaNum, const idVec3 &origin, int goalAreaNum, const idVec3 &goalOrigin, int travelFlags, int &travelTime, idActor* actor ) override; // grayman #3548
 	virtual bool				WalkPathValid( int areaNum, const idVec3 &origin, int goalAreaNum, const idVec3 &goalOrigin, int travelFlags, idVec3 &endPos, int &endAreaNum, idActor* actor) const override;
 	virtual bool				FlyPathToGoal( aasPath_t &path, int areaNum, const idVec3 &origin, int goalAreaNum, const idVec3 &goalOrigin, int travelFlags, idActor* actor ) const override; // grayman #4412
@@ -183,6 +201,12 @@ public:
 	virtual void Save(idSaveGame* savefile) const override;
 	virtual void Restore(idRestoreGame* savefile) override;
 
+	// The most recently used routing caches are kept in a file next to the AAS file,
+	// so that routing is warm when the map is loaded again (aas_routingCacheFile)
+	void WriteRoutingCacheFile( const char *fileName = NULL ) const;
+	void ReadRoutingCacheFile( const char *fileName = NULL );
+	idStr RoutingCacheFileName( void ) const;
+
 private:
 	idAASFile *					file;
 	idStr						name;
@@ -205,6 +229,28 @@ private:	// routing data
 	mutable idRoutingCache *	cacheListEnd;			// end of list with cache sorted from oldest to newest
 	mutable int					totalCacheMemory;		// total cache memory used
 	idList<idRoutingObstacle *>	obstacleList;			// list with obstacles
+	idList<idRouteRequest>		routeRequests;			// queued and solved asynchronous route requests
+	idList<idRoutingUpdate *>	routeJobUpdates;		// memory used to update the routing cache on each route job, area updates followed by portal updates
+	mutable idSysMutex			routingCacheMutex;		// guards the cache index and lists while route jobs run
+	bool						routeJobsActive;		// true while route jobs run, the caches are then only added and never deleted
+
+	typedef struct storedRoutingCache_s {
+		int						type;					// portal or area cache
+		int						size;					// size of cache
+		int						cluster;				// cluster of the cache
+		int						areaNum;				// area of the cache
+		int						travelFlags;			// combinations of the travel flags
+		unsigned short			startTravelTime;		// travel time to start with
+		int						offset;					// reachabilities followed by travel times in storedCacheData
+	} storedRoutingCache_t;
+
+	idList<byte>				storedCacheData;		// routing cache read from the cache file
+	idList<storedRoutingCache_t> storedCaches;			// caches in the file from most to least recently used
+	idHashIndex					storedCacheHash;		// stored caches by area and travel flags
+	unsigned int				storedStateHash;		// routing state the stored caches were made for
+	mutable unsigned int		routingStateHash;		// current routing state
+	mutable bool				routingStateChanged;	// routingStateHash must be recalculated
+	mutable idSysInterlockedInteger storedCacheHits;	// caches created from the stored caches
 
 	// greebo: This is TDM's EAS "Elevator Awareness System" :)
 	eas::tdmEAS*				elevatorSystem;
@@ -232,6 +278,16 @@ private:	// routing
 	void						UpdatePortalRoutingCache( idRoutingCache *portalCache ) const;
 	idRoutingCache *			GetPortalRoutingCache( int clusterNum, int areaNum, int travelFlags ) const;
 	void						RemoveRoutingCacheUsingArea( int areaNum );
+	idRoutingCache *			FindRoutingCache( idRoutingCache **list, int travelFlags ) const;
+	idRoutingCache *			PublishRoutingCache( idRoutingCache **list, idRoutingCache *cache ) const;
+	void						SolveRouteRequest( idRouteRequest &request ) const;
+	unsigned int				RoutingStateHash( void ) const;
+	bool						StoredRoutingCacheUsable( void ) const;
+	bool						HasRoutingCache( int type, int clusterNum, int areaNum, int travelFlags ) const;
+	idRoutingCache *			LoadStoredRoutingCache( int type, int clusterNum, int areaNum, int travelFlags ) const;
+	void						FreeStoredRoutingCache( void );
+	void						FreeRouteJobUpdates( void );
+	static void					RouteRequestJob( void *data );
 
 public:
 	virtual void				DisableArea( int areaNum ) override;
@@ -253,6 +309,9 @@ private:	// pathing
 
 public:	// debug
 	const idBounds &			DefaultSearchBounds( void ) const;
+	void						ClearRoutingCache( void );
+	int							NumStoredRoutingCaches( void ) const { return storedCaches.Num(); }
+	int							NumStoredRoutingCacheHits( void ) const { return storedCacheHits.GetValue(); }
 	void						DrawCone( const idVec3 &origin, const idVec3 &dir, float radius, const idVec4 &color ) const;
 	void						DrawArea( int areaNum ) const;
 	void						DrawFace( int faceNum, bool side ) const;
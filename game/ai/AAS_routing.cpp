@@ -36,6 +36,27 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 
 #define LEDGE_TRAVELTIME_PENALTY	250
 
+#define ROUTING_CACHE_FILE_ID		"TDMRoutingCache"
+#define ROUTING_CACHE_FILE_VERSION	1
+
+#define ROUTE_REQUEST_FREE			0
+#define ROUTE_REQUEST_QUEUED		1
+#define ROUTE_REQUEST_SOLVED		2
+
+// memory used to update the routing cache by the route job running on this thread, NULL on other threads
+static thread_local idRoutingUpdate *routeJobAreaUpdate = NULL;
+static thread_local idRoutingUpdate *routeJobPortalUpdate = NULL;
+
+typedef struct routeRequestJob_s {
+	const idAASLocal *			aas;
+	idRouteRequest **			requests;		// all queued requests
+	int							numRequests;
+	int							first;			// this job solves requests first, first + stride, ...
+	int							stride;
+	idRoutingUpdate *			areaUpdate;
+	idRoutingUpdate *			portalUpdate;
+} routeRequestJob_t;
+
 /*
 ============
 idRoutingCache::idRoutingCache
@@ -251,6 +272,7 @@ void idAASLocal::SetupRoutingCache( void ) {
 
 	cacheListStart = cacheListEnd = NULL;
 	totalCacheMemory = 0;
+	routingStateChanged = true;
 }
 
 /*
@@ -315,11 +337,29 @@ void idAASLocal::ShutdownRoutingCache( void ) {
 	portalUpdate = NULL;
 	Mem_Free( goalAreaTravelTimes );
 	goalAreaTravelTimes = NULL;
+	FreeRouteJobUpdates();
+	FreeStoredRoutingCache();
+	routeRequests.Clear();
 
 	cacheListStart = cacheListEnd = NULL;
 	totalCacheMemory = 0;
 }
 
+/*
+============
+idAASLocal::ClearRoutingCache
+============
+*/
+void idAASLocal::ClearRoutingCache( void ) {
+	if ( !file ) {
+		return;
+	}
+	for ( int i = 0; i < file->GetNumClusters(); i++ ) {
+		DeleteClusterCache( i );
+	}
+	DeletePortalCache();
+}
+
 /*
 ============
 idAASLocal::SetupRouting
@@ -328,6 +368,7 @@ idAASLocal::SetupRouting
 bool idAASLocal::SetupRouting( void ) {
 	CalculateAreaTravelTimes();
 	SetupRoutingCache();
+	ReadRoutingCacheFile();
 	return true;
 }
 
@@ -379,6 +420,9 @@ idAASLocal::RemoveRoutingCacheUsingArea
 void idAASLocal::RemoveRoutingCacheUsingArea( int areaNum ) {
 	int clusterNum;
 
+	// all changes of area or reachability state pass here
+	routingStateChanged = true;
+
 	clusterNum = file->GetArea( areaNum ).cluster;
 	if ( clusterNum > 0 ) {
 		// remove all the cache in the cluster the area is in
@@ -776,8 +820,10 @@ void idAASLocal::UpdateAreaRoutingCache( idRoutingCache *areaCache ) const {
 	unsigned short startAreaTravelTimes[MAX_REACH_PER_AREA];
 	memset( startAreaTravelTimes, 0, sizeof( startAreaTravelTimes ) );
 
+	idRoutingUpdate* updates = routeJobAreaUpdate ? routeJobAreaUpdate : areaUpdate;
+
 	// initialize first update
-	idRoutingUpdate* curUpdate = &areaUpdate[clusterAreaNum];
+	idRoutingUpdate* curUpdate = &updates[clusterAreaNum];
 
 	curUpdate->areaNum = areaCache->areaNum;
 	curUpdate->areaTravelTimes = startAreaTravelTimes;
@@ -843,7 +889,7 @@ void idAASLocal::UpdateAreaRoutingCache( idRoutingCache *areaCache ) const {
 
 				areaCache->travelTimes[clusterAreaNum] = t;
 				areaCache->reachabilities[clusterAreaNum] = reach->number; // reversed reachability used to get into this area
-				idRoutingUpdate* nextUpdate = &areaUpdate[clusterAreaNum];
+				idRoutingUpdate* nextUpdate = &updates[clusterAreaNum];
 				nextUpdate->areaNum = nextAreaNum;
 				nextUpdate->tmpTravelTime = t;
 				nextUpdate->areaTravelTimes = reach->areaTravelTimes;
@@ -873,6 +919,61 @@ void idAASLocal::UpdateAreaRoutingCache( idRoutingCache *areaCache ) const {
 	}
 }
 
+/*
+============
+idAASLocal::FindRoutingCache
+
+  find the cache for the travel flags in an area or portal cache list, links it as the newest cache
+============
+*/
+idRoutingCache *idAASLocal::FindRoutingCache( idRoutingCache **list, int travelFlags ) const {
+	idRoutingCache *cache;
+	idScopedCriticalSection lock;
+
+	if ( routeJobsActive ) {
+		lock.Lock( routingCacheMutex );
+	}
+	// check if cache without undesired travel flags already exists
+	for ( cache = *list; cache; cache = cache->next ) {
+		if ( cache->travelFlags == travelFlags ) {
+			LinkCache( cache );
+			break;
+		}
+	}
+	return cache;
+}
+
+/*
+============
+idAASLocal::PublishRoutingCache
+
+  add a freshly updated cache to an area or portal cache list
+  while route jobs run another job may have added the same cache meanwhile, then that one is used
+============
+*/
+idRoutingCache *idAASLocal::PublishRoutingCache( idRoutingCache **list, idRoutingCache *cache ) const {
+	idScopedCriticalSection lock;
+
+	if ( routeJobsActive ) {
+		lock.Lock( routingCacheMutex );
+		for ( idRoutingCache *other = *list; other; other = other->next ) {
+			if ( other->travelFlags == cache->travelFlags ) {
+				delete cache;
+				LinkCache( other );
+				return other;
+			}
+		}
+	}
+	cache->prev = NULL;
+	cache->next = *list;
+	if ( *list ) {
+		(*list)->prev = cache;
+	}
+	*list = cache;
+	LinkCache( cache );
+	return cache;
+}
+
 /*
 ============
 idAASLocal::GetAreaRoutingCache
@@ -880,35 +981,28 @@ idAASLocal::GetAreaRoutingCache
 */
 idRoutingCache *idAASLocal::GetAreaRoutingCache( int clusterNum, int areaNum, int travelFlags ) const {
 	int clusterAreaNum;
-	idRoutingCache *cache, *clusterCache;
+	idRoutingCache *cache, **clusterCache;
 
 	// number of the area in the cluster
 	clusterAreaNum = ClusterAreaNum( clusterNum, areaNum );
 	// pointer to the cache for the area in the cluster
-	clusterCache = areaCacheIndex[clusterNum][clusterAreaNum];
-	// check if cache without undesired travel flags already exists
-	for ( cache = clusterCache; cache; cache = cache->next ) {
-		if ( cache->travelFlags == travelFlags ) {
-			break;
-		}
-	}
+	clusterCache = &areaCacheIndex[clusterNum][clusterAreaNum];
+	cache = FindRoutingCache( clusterCache, travelFlags );
 	// if no cache found
 	if ( !cache ) {
-		cache = new idRoutingCache( file->GetCluster( clusterNum ).numReachableAreas );
-		cache->type = CACHETYPE_AREA;
-		cache->cluster = clusterNum;
-		cache->areaNum = areaNum;
-		cache->startTravelTime = 1;
-		cache->travelFlags = travelFlags;
-		cache->prev = NULL;
-		cache->next = clusterCache;
-		if ( clusterCache ) {
-			clusterCache->prev = cache;
+		// the cache is updated before it is added, so that route jobs can update different caches at the same time
+		cache = LoadStoredRoutingCache( CACHETYPE_AREA, clusterNum, areaNum, travelFlags );
+		if ( !cache ) {
+			cache = new idRoutingCache( file->GetCluster( clusterNum ).numReachableAreas );
+			cache->type = CACHETYPE_AREA;
+			cache->cluster = clusterNum;
+			cache->areaNum = areaNum;
+			cache->startTravelTime = 1;
+			cache->travelFlags = travelFlags;
+			UpdateAreaRoutingCache( cache );
 		}
-		areaCacheIndex[clusterNum][clusterAreaNum] = cache;
-		UpdateAreaRoutingCache( cache );
+		cache = PublishRoutingCache( clusterCache, cache );
 	}
-	LinkCache( cache );
 	return cache;
 }
 
@@ -924,8 +1018,9 @@ void idAASLocal::UpdatePortalRoutingCache( idRoutingCache *portalCache ) const {
 	const aasCluster_t *cluster;
 	idRoutingCache *cache;
 	idRoutingUpdate *updateListStart, *updateListEnd, *curUpdate, *nextUpdate;
+	idRoutingUpdate *updates = routeJobPortalUpdate ? routeJobPortalUpdate : portalUpdate;
 
-	curUpdate = &portalUpdate[ file->GetNumPortals() ];
+	curUpdate = &updates[ file->GetNumPortals() ];
 	curUpdate->cluster = portalCache->cluster;
 	curUpdate->areaNum = portalCache->areaNum;
 	curUpdate->tmpTravelTime = portalCache->startTravelTime;
@@ -988,7 +1083,7 @@ void idAASLocal::UpdatePortalRoutingCache( idRoutingCache *portalCache ) const {
 			{
 				portalCache->travelTimes[portalNum] = t;
 				portalCache->reachabilities[portalNum] = cache->reachabilities[clusterAreaNum];
-				nextUpdate = &portalUpdate[portalNum];
+				nextUpdate = &updates[portalNum];
 				if ( portal->clusters[0] == curUpdate->cluster ) {
 					nextUpdate->cluster = portal->clusters[1];
 				}
@@ -1025,29 +1120,21 @@ idAASLocal::GetPortalRoutingCache
 idRoutingCache *idAASLocal::GetPortalRoutingCache( int clusterNum, int areaNum, int travelFlags ) const {
 	idRoutingCache *cache;
 
-	// check if cache without undesired travel flags already exists
-	for ( cache = portalCacheIndex[areaNum]; cache; cache = cache->next ) {
-		if ( cache->travelFlags == travelFlags ) {
-			break;
-		}
-	}
+	cache = FindRoutingCache( &portalCacheIndex[areaNum], travelFlags );
 	// if no cache found
 	if ( !cache ) {
-		cache = new idRoutingCache( file->GetNumPortals() );
-		cache->type = CACHETYPE_PORTAL;
-		cache->cluster = clusterNum;
-		cache->areaNum = areaNum;
-		cache->startTravelTime = 1;
-		cache->travelFlags = travelFlags;
-		cache->prev = NULL;
-		cache->next = portalCacheIndex[areaNum];
-		if ( portalCacheIndex[areaNum] ) {
-			portalCacheIndex[areaNum]->prev = cache;
-		}
-		portalCacheIndex[areaNum] = cache;
-		UpdatePortalRoutingCache( cache );
+		cache = LoadStoredRoutingCache( CACHETYPE_PORTAL, clusterNum, areaNum, travelFlags );
+		if ( !cache ) {
+			cache = new idRoutingCache( file->GetNumPortals() );
+			cache->type = CACHETYPE_PORTAL;
+			cache->cluster = clusterNum;
+			cache->areaNum = areaNum;
+			cache->startTravelTime = 1;
+			cache->travelFlags = travelFlags;
+			UpdatePortalRoutingCache( cache );
+		}
+		cache = PublishRoutingCache( &portalCacheIndex[areaNum], cache );
 	}
-	LinkCache( cache );
 	return cache;
 }
 
@@ -1061,7 +1148,8 @@ bool idAASLocal::RouteToGoalArea( int areaNum, const idVec3 origin, int goalArea
 								  CFrobDoor** firstDoor, idActor* actor ) const
 {
 #ifdef TIMING_BUILD
-	if (actor != NULL)
+	// the actor timers are not thread safe, routes solved on the job threads are not timed
+	if (actor != NULL && !routeJobsActive)
 	{
 		START_SCOPED_TIMING(actor->actorRouteToGoalTimer, scopedRouteToGoalTimer);
 	}
@@ -1095,7 +1183,8 @@ bool idAASLocal::RouteToGoalArea( int areaNum, const idVec3 origin, int goalArea
 		return false;
 	}
 
-	while( totalCacheMemory > MAX_ROUTING_CACHE_MEMORY ) {
+	// route jobs make room before they start, caches in use by other jobs must not be deleted
+	while( !routeJobsActive && totalCacheMemory > MAX_ROUTING_CACHE_MEMORY ) {
 		DeleteOldestCache();
 	}
 
@@ -1287,6 +1376,449 @@ bool idAASLocal::RouteToGoalArea( int areaNum, const idVec3 origin, int goalArea
 	return true;
 }
 
+/*
+============
+idAASLocal::RoutingCacheFileName
+============
+*/
+idStr idAASLocal::RoutingCacheFileName( void ) const {
+	idStr fileName = file->GetName();
+	fileName += ".routing";
+	return fileName;
+}
+
+/*
+============
+idAASLocal::RoutingStateHash
+
+  the routing cache depends on the area travel flags and the reachability travel types, which change
+  when areas are disabled and with obstacles
+============
+*/
+unsigned int idAASLocal::RoutingStateHash( void ) const {
+	unsigned int hash = 2166136261u;
+
+	for ( int i = 0; i < file->GetNumAreas(); i++ ) {
+		hash = ( hash ^ (unsigned int)file->GetArea( i ).travelFlags ) * 16777619u;
+		for ( const idReachability *reach = file->GetArea( i ).reach; reach; reach = reach->next ) {
+			hash = ( hash ^ (unsigned int)reach->travelType ) * 16777619u;
+		}
+	}
+	return hash;
+}
+
+/*
+============
+idAASLocal::StoredRoutingCacheUsable
+
+  the stored caches are only valid while the routing state is the same as when they were written
+============
+*/
+bool idAASLocal::StoredRoutingCacheUsable( void ) const {
+	if ( storedCaches.Num() == 0 ) {
+		return false;
+	}
+	if ( routingStateChanged ) {
+		if ( routeJobsActive ) {
+			return false;
+		}
+		routingStateHash = RoutingStateHash();
+		routingStateChanged = false;
+	}
+	return routingStateHash == storedStateHash;
+}
+
+/*
+============
+idAASLocal::HasRoutingCache
+============
+*/
+bool idAASLocal::HasRoutingCache( int type, int clusterNum, int areaNum, int travelFlags ) const {
+	const idRoutingCache *cache;
+
+	if ( type == CACHETYPE_AREA ) {
+		cache = areaCacheIndex[clusterNum][ClusterAreaNum( clusterNum, areaNum )];
+	} else {
+		cache = portalCacheIndex[areaNum];
+	}
+	for ( ; cache; cache = cache->next ) {
+		if ( cache->travelFlags == travelFlags ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+============
+idAASLocal::LoadStoredRoutingCache
+
+  creates a cache from the cache file instead of updating it
+============
+*/
+idRoutingCache *idAASLocal::LoadStoredRoutingCache( int type, int clusterNum, int areaNum, int travelFlags ) const {
+	if ( !StoredRoutingCacheUsable() ) {
+		return NULL;
+	}
+
+	int key = storedCacheHash.GenerateKey( areaNum, travelFlags );
+	for ( int i = storedCacheHash.First( key ); i != -1; i = storedCacheHash.Next( i ) ) {
+		const storedRoutingCache_t &stored = storedCaches[i];
+		if ( stored.type != type || stored.areaNum != areaNum || stored.travelFlags != travelFlags ) {
+			continue;
+		}
+		if ( type == CACHETYPE_AREA && stored.cluster != clusterNum ) {
+			continue;
+		}
+		idRoutingCache *cache = new idRoutingCache( stored.size );
+		cache->type = stored.type;
+		cache->cluster = stored.cluster;
+		cache->areaNum = stored.areaNum;
+		cache->startTravelTime = stored.startTravelTime;
+		cache->travelFlags = stored.travelFlags;
+		memcpy( cache->reachabilities, &storedCacheData[stored.offset], stored.size * sizeof( cache->reachabilities[0] ) );
+		memcpy( cache->travelTimes, &storedCacheData[stored.offset + stored.size], stored.size * sizeof( cache->travelTimes[0] ) );
+		storedCacheHits.Increment();
+		return cache;
+	}
+	return NULL;
+}
+
+/*
+============
+idAASLocal::FreeStoredRoutingCache
+============
+*/
+void idAASLocal::FreeStoredRoutingCache( void ) {
+	storedCacheData.Clear();
+	storedCaches.Clear();
+	storedCacheHash.Clear();
+	storedStateHash = 0;
+	storedCacheHits.SetValue( 0 );
+}
+
+/*
+============
+idAASLocal::WriteRoutingCacheFile
+
+  writes the caches from most to least recently used until the size limit is reached, stored caches
+  which were not needed since the file was read are kept after the ones in use,
+  the file is written next to the AAS file unless a name is given
+============
+*/
+void idAASLocal::WriteRoutingCacheFile( const char *fileName ) const {
+	int maxSize = aas_routingCacheFile.GetInteger() * 1024;
+
+	if ( !file || maxSize <= 0 || !areaCacheIndex ) {
+		return;
+	}
+
+	idList<const idRoutingCache *> caches;
+	idList<int> stored;
+	int size = 0;
+	for ( const idRoutingCache *cache = cacheListEnd; cache; cache = cache->time_prev ) {
+		size += cache->Size();
+		if ( size > maxSize ) {
+			break;
+		}
+		caches.Append( cache );
+	}
+	if ( size <= maxSize && StoredRoutingCacheUsable() ) {
+		for ( int i = 0; i < storedCaches.Num(); i++ ) {
+			const storedRoutingCache_t &s = storedCaches[i];
+			if ( HasRoutingCache( s.type, s.cluster, s.areaNum, s.travelFlags ) ) {
+				continue;
+			}
+			size += sizeof( idRoutingCache ) + s.size * ( sizeof( byte ) + sizeof( unsigned short ) );
+			if ( size > maxSize ) {
+				break;
+			}
+			stored.Append( i );
+		}
+	}
+
+	idFile *f = fileSystem->OpenFileWrite( fileName ? idStr( fileName ) : RoutingCacheFileName() );
+	if ( !f ) {
+		return;
+	}
+	f->WriteString( ROUTING_CACHE_FILE_ID );
+	f->WriteInt( ROUTING_CACHE_FILE_VERSION );
+	f->WriteUnsignedInt( file->GetCRC() );
+	f->WriteInt( file->GetNumAreas() );
+	f->WriteInt( file->GetNumPortals() );
+	f->WriteInt( file->GetNumClusters() );
+	f->WriteUnsignedInt( RoutingStateHash() );
+	f->WriteInt( caches.Num() + stored.Num() );
+	for ( int i = 0; i < caches.Num(); i++ ) {
+		const idRoutingCache *cache = caches[i];
+		f->WriteInt( cache->type );
+		f->WriteInt( cache->size );
+		f->WriteInt( cache->cluster );
+		f->WriteInt( cache->areaNum );
+		f->WriteInt( cache->travelFlags );
+		f->WriteUnsignedShort( cache->startTravelTime );
+		f->Write( cache->reachabilities, cache->size * sizeof( cache->reachabilities[0] ) );
+		for ( int j = 0; j < cache->size; j++ ) {
+			f->WriteUnsignedShort( cache->travelTimes[j] );
+		}
+	}
+	for ( int i = 0; i < stored.Num(); i++ ) {
+		const storedRoutingCache_t &s = storedCaches[stored[i]];
+		f->WriteInt( s.type );
+		f->WriteInt( s.size );
+		f->WriteInt( s.cluster );
+		f->WriteInt( s.areaNum );
+		f->WriteInt( s.travelFlags );
+		f->WriteUnsignedShort( s.startTravelTime );
+		f->Write( &storedCacheData[s.offset], s.size * sizeof( byte ) );
+		for ( int j = 0; j < s.size; j++ ) {
+			unsigned short t;
+			memcpy( &t, &storedCacheData[s.offset + s.size + j * sizeof( t )], sizeof( t ) );
+			f->WriteUnsignedShort( t );
+		}
+	}
+	fileSystem->CloseFile( f );
+}
+
+/*
+============
+idAASLocal::ReadRoutingCacheFile
+
+  only reads the file, caches are created from it when they are first needed
+============
+*/
+void idAASLocal::ReadRoutingCacheFile( const char *fileName ) {
+	FreeStoredRoutingCache();
+
+	if ( !file || aas_routingCacheFile.GetInteger() <= 0 ) {
+		return;
+	}
+
+	idStr cacheFileName = fileName ? idStr( fileName ) : RoutingCacheFileName();
+	idFile *f = fileSystem->OpenFileRead( cacheFileName );
+	if ( !f ) {
+		return;
+	}
+
+	idStr id;
+	int version, numAreas, numPortals, numClusters, numCaches;
+	unsigned int crc;
+	f->ReadString( id );
+	f->ReadInt( version );
+	f->ReadUnsignedInt( crc );
+	f->ReadInt( numAreas );
+	f->ReadInt( numPortals );
+	f->ReadInt( numClusters );
+	f->ReadUnsignedInt( storedStateHash );
+	f->ReadInt( numCaches );
+	if ( id != ROUTING_CACHE_FILE_ID || version != ROUTING_CACHE_FILE_VERSION || crc != file->GetCRC() ||
+			numAreas != file->GetNumAreas() || numPortals != file->GetNumPortals() || numClusters != file->GetNumClusters() ) {
+		fileSystem->CloseFile( f );
+		FreeStoredRoutingCache();
+		return;
+	}
+
+	storedCacheData.SetGranularity( 1024 * 1024 );
+	for ( int i = 0; i < numCaches; i++ ) {
+		storedRoutingCache_t s;
+		f->ReadInt( s.type );
+		f->ReadInt( s.size );
+		f->ReadInt( s.cluster );
+		f->ReadInt( s.areaNum );
+		f->ReadInt( s.travelFlags );
+		f->ReadUnsignedShort( s.startTravelTime );
+
+		// the file is only trusted as far as it matches the AAS
+		bool valid;
+		if ( s.type == CACHETYPE_AREA ) {
+			valid = s.cluster > 0 && s.cluster < numClusters && s.areaNum > 0 && s.areaNum < numAreas &&
+					s.size == file->GetCluster( s.cluster ).numReachableAreas;
+		} else {
+			valid = s.type == CACHETYPE_PORTAL && s.areaNum > 0 && s.areaNum < numAreas && s.size == numPortals;
+		}
+		if ( !valid || f->Length() - f->Tell() < s.size * (int)( sizeof( byte ) + sizeof( unsigned short ) ) ) {
+			common->Warning( "%s: bad routing cache, ignored\n", cacheFileName.c_str() );
+			FreeStoredRoutingCache();
+			break;
+		}
+
+		s.offset = storedCacheData.Num();
+		storedCacheData.AssureSize( s.offset + s.size * ( sizeof( byte ) + sizeof( unsigned short ) ) );
+		f->Read( &storedCacheData[s.offset], s.size * sizeof( byte ) );
+		for ( int j = 0; j < s.size; j++ ) {
+			unsigned short t;
+			f->ReadUnsignedShort( t );
+			memcpy( &storedCacheData[s.offset + s.size + j * sizeof( t )], &t, sizeof( t ) );
+		}
+
+		storedCacheHash.Add( storedCacheHash.GenerateKey( s.areaNum, s.travelFlags ), storedCaches.Append( s ) );
+	}
+	fileSystem->CloseFile( f );
+	routingStateChanged = true;
+}
+
+/*
+============
+idAASLocal::SolveRouteRequest
+============
+*/
+void idAASLocal::SolveRouteRequest( idRouteRequest &request ) const {
+	aasRouteResult_t &result = request.result;
+
+	result.found = RouteToGoalArea( request.areaNum, request.origin, request.goalAreaNum, request.travelFlags,
+									result.travelTime, &result.reach, &result.firstDoor, request.actor );
+	request.state = ROUTE_REQUEST_SOLVED;
+}
+
+/*
+============
+idAASLocal::QueueRouteRequest
+============
+*/
+aasHandle_t idAASLocal::QueueRouteRequest( int areaNum, const idVec3 &origin, int goalAreaNum, int travelFlags, idActor* actor ) {
+	int handle;
+
+	for ( handle = 0; handle < routeRequests.Num(); handle++ ) {
+		if ( routeRequests[handle].state == ROUTE_REQUEST_FREE ) {
+			break;
+		}
+	}
+	if ( handle == routeRequests.Num() ) {
+		routeRequests.Alloc();
+	}
+
+	idRouteRequest &request = routeRequests[handle];
+	request.state = ROUTE_REQUEST_QUEUED;
+	request.areaNum = areaNum;
+	request.origin = origin;
+	request.goalAreaNum = goalAreaNum;
+	request.travelFlags = travelFlags;
+	request.actor = actor;
+	memset( &request.result, 0, sizeof( request.result ) );
+
+	// trivial and invalid requests don't use the routing cache, answer them right away
+	if ( !file || areaNum == goalAreaNum ||
+			areaNum <= 0 || areaNum >= file->GetNumAreas() || goalAreaNum <= 0 || goalAreaNum >= file->GetNumAreas() ) {
+		SolveRouteRequest( request );
+	}
+	return handle;
+}
+
+/*
+============
+idAASLocal::GetRouteResult
+============
+*/
+bool idAASLocal::GetRouteResult( aasHandle_t handle, aasRouteResult_t &result ) {
+	if ( handle < 0 || handle >= routeRequests.Num() || routeRequests[handle].state != ROUTE_REQUEST_SOLVED ) {
+		return false;
+	}
+	result = routeRequests[handle].result;
+	routeRequests[handle].state = ROUTE_REQUEST_FREE;
+	return true;
+}
+
+/*
+============
+idAASLocal::CancelRouteRequest
+============
+*/
+void idAASLocal::CancelRouteRequest( aasHandle_t handle ) {
+	if ( handle >= 0 && handle < routeRequests.Num() ) {
+		routeRequests[handle].state = ROUTE_REQUEST_FREE;
+	}
+}
+
+/*
+============
+idAASLocal::FreeRouteJobUpdates
+============
+*/
+void idAASLocal::FreeRouteJobUpdates( void ) {
+	for ( int i = 0; i < routeJobUpdates.Num(); i++ ) {
+		Mem_Free( routeJobUpdates[i] );
+	}
+	routeJobUpdates.Clear();
+}
+
+/*
+============
+idAASLocal::RouteRequestJob
+============
+*/
+void idAASLocal::RouteRequestJob( void *data ) {
+	routeRequestJob_t *job = (routeRequestJob_t *)data;
+
+	routeJobAreaUpdate = job->areaUpdate;
+	routeJobPortalUpdate = job->portalUpdate;
+	for ( int i = job->first; i < job->numRequests; i += job->stride ) {
+		job->aas->SolveRouteRequest( *job->requests[i] );
+	}
+	routeJobAreaUpdate = NULL;
+	routeJobPortalUpdate = NULL;
+}
+
+/*
+============
+idAASLocal::RunRouteRequests
+
+  the routing cache is the only state written while the jobs run, everything else the routing
+  reads (areas, doors, forbidden areas) stays untouched because the game waits for the jobs
+============
+*/
+void idAASLocal::RunRouteRequests( void ) {
+	idList<idRouteRequest *> queued;
+	int i;
+
+	for ( i = 0; i < routeRequests.Num(); i++ ) {
+		if ( routeRequests[i].state == ROUTE_REQUEST_QUEUED ) {
+			queued.Append( &routeRequests[i] );
+		}
+	}
+	if ( queued.Num() == 0 ) {
+		return;
+	}
+
+	// make room now, the jobs only add caches
+	while( totalCacheMemory > MAX_ROUTING_CACHE_MEMORY ) {
+		DeleteOldestCache();
+	}
+	// the jobs can't update the routing state hash
+	StoredRoutingCacheUsable();
+
+	int numJobs = idMath::Imax( 1, idMath::Imin( queued.Num(), parallelJobManager->GetNumProcessingUnits() ) );
+	while ( routeJobUpdates.Num() < numJobs ) {
+		routeJobUpdates.Append( (idRoutingUpdate *) Mem_ClearedAlloc( ( file->GetNumAreas() + file->GetNumPortals() + 1 ) * sizeof( idRoutingUpdate ) ) );
+	}
+
+	idList<routeRequestJob_t> jobs;
+	jobs.SetNum( numJobs );
+	for ( i = 0; i < numJobs; i++ ) {
+		jobs[i].aas = this;
+		jobs[i].requests = queued.Ptr();
+		jobs[i].numRequests = queued.Num();
+		jobs[i].first = i;
+		jobs[i].stride = numJobs;
+		jobs[i].areaUpdate = routeJobUpdates[i];
+		jobs[i].portalUpdate = routeJobUpdates[i] + file->GetNumAreas();
+	}
+
+	routeJobsActive = true;
+	if ( numJobs > 1 ) {
+		RegisterJob( RouteRequestJob, "aasRouteRequests" );
+		idParallelJobList *joblist = parallelJobManager->AllocJobList( JOBLIST_UTILITY, JOBLIST_PRIORITY_HIGH, numJobs, 0, nullptr );
+		for ( i = 0; i < numJobs; i++ ) {
+			joblist->AddJob( RouteRequestJob, &jobs[i] );
+		}
+		joblist->Submit( nullptr, JOBLIST_PARALLELISM_REALTIME );
+		joblist->Wait();
+		parallelJobManager->FreeJobList( joblist );
+	} else {
+		RouteRequestJob( &jobs[0] );
+	}
+	routeJobsActive = false;
+}
+
 /*
 ============
 idAASLocal::TravelTimeToGoalArea
@@ -1796,3 +2328,235 @@ int	idAASLocal::GetAreaInCluster(int clusterNum)
 
 	return -1;
 }
+
+
+#include "../tests/testing.h"
+
+struct aasRouteQuery_t {
+	int					areaNum;
+	idVec3				origin;
+	int					goalAreaNum;
+	aasRouteResult_t	result;
+};
+
+// random routes between walkable areas, many of them between different clusters
+static void MakeRouteQueries( const idAAS *aas, int count, idList<aasRouteQuery_t> &queries ) {
+	idList<int> areas;
+	for ( int i = 1; i < aas->GetNumAreas(); i++ ) {
+		if ( aas->AreaFlags( i ) & AREA_REACHABLE_WALK ) {
+			areas.Append( i );
+		}
+	}
+	queries.Clear();
+	if ( areas.Num() < 2 ) {
+		return;
+	}
+	idRandom rnd( 0x4a45 );
+	for ( int i = 0; i < count; i++ ) {
+		aasRouteQuery_t &query = queries.Alloc();
+		query.areaNum = areas[rnd.RandomInt( areas.Num() )];
+		query.origin = aas->AreaCenter( query.areaNum );
+		query.goalAreaNum = areas[rnd.RandomInt( areas.Num() )];
+		memset( &query.result, 0, sizeof( query.result ) );
+	}
+}
+
+// the AAS of the loaded map, without a map the first AAS file found is loaded on its own
+static idAASLocal *AcquireTestAAS( void ) {
+	if ( gameLocal.GetLocalPlayer() ) {
+		return static_cast<idAASLocal *>( gameLocal.GetAAS( 0 ) );
+	}
+	const idDict *dict = gameLocal.FindEntityDefDict( "aas_types", false );
+	if ( !dict ) {
+		return NULL;
+	}
+	for ( const idKeyValue *kv = dict->MatchPrefix( "type" ); kv != NULL; kv = dict->MatchPrefix( "type", kv ) ) {
+		idFileList *files = fileSystem->ListFiles( "maps", va( ".%s", kv->GetValue().c_str() ), true );
+		idStr fileName = files->GetNumFiles() > 0 ? idStr( "maps/" ) + files->GetFile( 0 ) : idStr();
+		fileSystem->FreeFileList( files );
+		if ( fileName.Length() == 0 ) {
+			continue;
+		}
+		idAAS *aas = idAAS::Alloc();
+		if ( aas->Init( fileName, 0 ) ) {
+			return static_cast<idAASLocal *>( aas );
+		}
+		delete aas;
+	}
+	return NULL;
+}
+
+static void ReleaseTestAAS( idAASLocal *aas ) {
+	if ( !aas || gameLocal.GetLocalPlayer() ) {
+		return;
+	}
+	// shutting down writes the routing cache file, which a standalone AAS must not touch
+	idTestCVar cacheFileSize( aas_routingCacheFile, 0 );
+	delete aas;
+}
+
+static void SolveRouteQueries( idAAS *aas, idList<aasRouteQuery_t> &queries, int travelFlags, bool async ) {
+	if ( async ) {
+		idList<aasHandle_t> handles;
+		for ( int i = 0; i < queries.Num(); i++ ) {
+			handles.Append( aas->QueueRouteRequest( queries[i].areaNum, queries[i].origin, queries[i].goalAreaNum, travelFlags, NULL ) );
+		}
+		aas->RunRouteRequests();
+		for ( int i = 0; i < queries.Num(); i++ ) {
+			REQUIRE( aas->GetRouteResult( handles[i], queries[i].result ) );
+		}
+	} else {
+		for ( int i = 0; i < queries.Num(); i++ ) {
+			aasRouteResult_t &result = queries[i].result;
+			result.found = aas->RouteToGoalArea( queries[i].areaNum, queries[i].origin, queries[i].goalAreaNum, travelFlags,
+												 result.travelTime, &result.reach, &result.firstDoor, NULL );
+		}
+	}
+}
+
+TEST_CASE("AAS:AsyncRoutesMatchSync") {
+	idAASLocal *aas = AcquireTestAAS();
+	if ( !aas ) {
+		MESSAGE( "No AAS found, test skipped" );
+		return;
+	}
+	const int travelFlags = TFL_WALK | TFL_AIR | TFL_DOOR;
+	idList<aasRouteQuery_t> syncQueries, asyncQueries;
+	MakeRouteQueries( aas, 2000, syncQueries );
+	if ( syncQueries.Num() == 0 ) {
+		ReleaseTestAAS( aas );
+		MESSAGE( "No walkable areas in the AAS, test skipped" );
+		return;
+	}
+	asyncQueries = syncQueries;
+
+	// both start from an empty cache, so the jobs build the caches concurrently
+	aas->ClearRoutingCache();
+	SolveRouteQueries( aas, asyncQueries, travelFlags, true );
+	aas->ClearRoutingCache();
+	SolveRouteQueries( aas, syncQueries, travelFlags, false );
+
+	int mismatches = 0;
+	for ( int i = 0; i < syncQueries.Num(); i++ ) {
+		const aasRouteResult_t &a = asyncQueries[i].result;
+		const aasRouteResult_t &s = syncQueries[i].result;
+		if ( a.found != s.found || a.travelTime != s.travelTime || a.reach != s.reach || a.firstDoor != s.firstDoor ) {
+			mismatches++;
+		}
+	}
+
+	// requests which were picked up or cancelled free their slot
+	aasHandle_t handle = aas->QueueRouteRequest( syncQueries[0].areaNum, syncQueries[0].origin, syncQueries[0].goalAreaNum, travelFlags, NULL );
+	aas->CancelRouteRequest( handle );
+	aasRouteResult_t result;
+	const bool cancelledResult = aas->GetRouteResult( handle, result );
+	ReleaseTestAAS( aas );
+
+	CHECK( mismatches == 0 );
+	CHECK( !cancelledResult );
+}
+
+TEST_CASE("AAS:AsyncRoutesPerformance" * doctest::skip()) {
+	idAASLocal *aas = AcquireTestAAS();
+	if ( !aas ) {
+		MESSAGE( "No AAS found, test skipped" );
+		return;
+	}
+	idList<aasRouteQuery_t> queries;
+	MakeRouteQueries( aas, 2000, queries );
+	for ( int async = 0; async < 2; async++ ) {
+		aas->ClearRoutingCache();
+		double start = Sys_GetClockTicks();
+		SolveRouteQueries( aas, queries, TFL_WALK | TFL_AIR | TFL_DOOR, async != 0 );
+		double ms = ( Sys_GetClockTicks() - start ) * 1000.0 / Sys_ClockTicksPerSecond();
+		MESSAGE( ( async ? "async" : "sync" ) << ": " << queries.Num() << " routes from an empty cache in " << ms << " ms" );
+	}
+	aas->ClearRoutingCache();
+	ReleaseTestAAS( aas );
+}
+
+// the tests never touch the cache file the map uses
+static idStr RoutingCacheFileTest_FileName( const idAASLocal *aas ) {
+	return aas->RoutingCacheFileName() + "_test";
+}
+
+// solves the routes once to fill the cache, then writes it and starts over with the file only
+static void RoutingCacheFileTest_WriteAndReload( idAASLocal *aas, idList<aasRouteQuery_t> &queries, int travelFlags ) {
+	aas->ClearRoutingCache();
+	SolveRouteQueries( aas, queries, travelFlags, false );
+	aas->WriteRoutingCacheFile( RoutingCacheFileTest_FileName( aas ) );
+	aas->ClearRoutingCache();
+	aas->ReadRoutingCacheFile( RoutingCacheFileTest_FileName( aas ) );
+}
+
+static void RoutingCacheFileTest_Cleanup( idAASLocal *aas ) {
+	fileSystem->RemoveFile( RoutingCacheFileTest_FileName( aas ) );
+	aas->ReadRoutingCacheFile();
+	aas->ClearRoutingCache();
+}
+
+TEST_CASE("AAS:RoutingCacheFileRoundTrip") {
+	idAASLocal *aas = AcquireTestAAS();
+	if ( !aas ) {
+		MESSAGE( "No AAS found, test skipped" );
+		return;
+	}
+	const int travelFlags = TFL_WALK | TFL_AIR | TFL_DOOR;
+	idList<aasRouteQuery_t> before, after;
+	MakeRouteQueries( aas, 500, before );
+	after = before;
+
+	idTestCVar cacheFileSize( aas_routingCacheFile, 64 * 1024 );
+	RoutingCacheFileTest_WriteAndReload( aas, before, travelFlags );
+	const int numStored = aas->NumStoredRoutingCaches();
+	SolveRouteQueries( aas, after, travelFlags, false );
+	const int numHits = aas->NumStoredRoutingCacheHits();
+	RoutingCacheFileTest_Cleanup( aas );
+	ReleaseTestAAS( aas );
+
+	CHECK( numStored > 0 );
+	CHECK( numHits > 0 );
+
+	int mismatches = 0;
+	for ( int i = 0; i < before.Num(); i++ ) {
+		const aasRouteResult_t &a = before[i].result;
+		const aasRouteResult_t &b = after[i].result;
+		if ( a.found != b.found || a.travelTime != b.travelTime || a.reach != b.reach ) {
+			mismatches++;
+		}
+	}
+	CHECK( mismatches == 0 );
+}
+
+TEST_CASE("AAS:RoutingCacheFileFirstQueryLatency" * doctest::skip()) {
+	idAASLocal *aas = AcquireTestAAS();
+	if ( !aas ) {
+		MESSAGE( "No AAS found, test skipped" );
+		return;
+	}
+	const int travelFlags = TFL_WALK | TFL_AIR | TFL_DOOR;
+	idList<aasRouteQuery_t> queries;
+	MakeRouteQueries( aas, 500, queries );
+
+	idTestCVar cacheFileSize( aas_routingCacheFile, 64 * 1024 );
+	for ( int warm = 0; warm < 2; warm++ ) {
+		if ( warm ) {
+			RoutingCacheFileTest_WriteAndReload( aas, queries, travelFlags );
+		} else {
+			aas->ClearRoutingCache();
+		}
+		double worst = 0.0, total = 0.0;
+		for ( int i = 0; i < queries.Num(); i++ ) {
+			idList<aasRouteQuery_t> single;
+			single.Append( queries[i] );
+			double start = Sys_GetClockTicks();
+			SolveRouteQueries( aas, single, travelFlags, false );
+			double ms = ( Sys_GetClockTicks() - start ) * 1000.0 / Sys_ClockTicksPerSecond();
+			worst = Max( worst, ms );
+			total += ms;
+		}
+		MESSAGE( ( warm ? "from cache file" : "empty cache" ) << ": " << queries.Num() << " first queries, " << total / queries.Num() << " ms average, " << worst << " ms worst" );
+	}
+	RoutingCacheFileTest_Cleanup( aas );
+	ReleaseTestAAS( aas );
+}
@@ -431,6 +431,10 @@ idAI::idAI()
 
 	aas					= NULL;
 	travelFlags			= TFL_WALK|TFL_AIR|TFL_DOOR;
+	routeRequest		= -1;
+	routeRequestFromArea = 0;
+	routeRequestToArea	= 0;
+	routeRequestFrame	= 0;
 	lastAreaReevaluationTime = -1;
 	maxAreaReevaluationInterval = 2000; // msec
 	doorRetryTime		= 120000; // msec
@@ -650,6 +654,9 @@ idAI::~idAI
 */
 idAI::~idAI()
 {
+	gameLocal.m_PerceptionScheduler.Remove(entityNumber);
+	CancelTravelDistanceAsync();
+
 	if (m_searchID > 0)
 	{
 		DM_LOG(LC_AI, LT_DEBUG)LOGSTRING("Destroying AI while search still active. Actively leaving search: SearchID=%d, AI=0x%p\r", m_searchID, this);
@@ -3149,6 +3156,7 @@ idAI::SetAAS
 void idAI::SetAAS( void ) {
 	idStr use_aas;
 
+	CancelTravelDistanceAsync();
 	spawnArgs.GetString( "use_aas", NULL, use_aas );
 	aas = gameLocal.GetAAS( use_aas );
 	if ( aas ) {
@@ -3456,6 +3464,76 @@ float idAI::TravelDistance( const idVec3 &start, const idVec3 &end )
 	return travelTime;
 }
 
+/*
+=====================
+idAI::TravelDistanceAsync
+=====================
+*/
+bool idAI::TravelDistanceAsync( const idVec3 &start, const idVec3 &end, float &dist )
+{
+	int fromArea = aas ? PointReachableAreaNum( start ) : 0;
+	int toArea = aas ? PointReachableAreaNum( end ) : 0;
+
+	if ( !cv_ai_opt_async_paths.GetBool() || !fromArea || !toArea || fromArea == toArea )
+	{
+		CancelTravelDistanceAsync();
+		dist = TravelDistance( start, end );
+		return true;
+	}
+
+	if ( routeRequest != -1 && ( routeRequestFromArea != fromArea || routeRequestToArea != toArea ) )
+	{
+		// the query changed (e.g. a moving goal entered another area), the old answer is of no use.
+		// The caller already waited for it, so answer right away instead of starting another wait.
+		CancelTravelDistanceAsync();
+		dist = TravelDistance( start, end );
+		return true;
+	}
+
+	if ( routeRequest == -1 )
+	{
+		routeRequest = aas->QueueRouteRequest( fromArea, start, toArea, travelFlags, this );
+		routeRequestFromArea = fromArea;
+		routeRequestToArea = toArea;
+		routeRequestFrame = gameLocal.framenum;
+	}
+
+	aasRouteResult_t result;
+	if ( aas->GetRouteResult( routeRequest, result ) )
+	{
+		routeRequest = -1;
+		dist = result.found ? result.travelTime : -1;
+		return true;
+	}
+
+	if ( gameLocal.framenum > routeRequestFrame + 1 )
+	{
+		// should have been solved by now (e.g. the AAS was reloaded), don't keep the caller waiting
+		CancelTravelDistanceAsync();
+		dist = TravelDistance( start, end );
+		return true;
+	}
+
+	return false;
+}
+
+/*
+=====================
+idAI::CancelTravelDistanceAsync
+=====================
+*/
+void idAI::CancelTravelDistanceAsync( void )
+{
+	if ( routeRequest != -1 )
+	{
+		if ( aas )
+		{
+			aas->CancelRouteRequest( routeRequest );
+		}
+		routeRequest = -1;
+	}
+}
+
 void idAI::SetStartTime(idVec3 pos)
 {
 	// grayman #3993 - if the new destination is close to the current
@@ -10539,6 +10617,12 @@ void idAI::PerformVisualScan(float timecheck)
 		}
 	}
 
+	// traces below are expensive, wait for our turn if the number of scans per frame is limited
+	if ( !gameLocal.m_PerceptionScheduler.Request(entityNumber, (player->GetPhysics()->GetOrigin() - physicsObj.GetOrigin()).LengthFast(), AI_AlertLevel) )
+	{
+		return;
+	}
+
 	// angua: does not take lighting and FOV into account
 	if (!CanSeeExt(player, false, false))
 	{
@@ -640,6 +640,12 @@ protected:
 	idAAS *					aas;
 	int						travelFlags;
 
+	// route queued by TravelDistanceAsync(), not saved
+	aasHandle_t				routeRequest;
+	int						routeRequestFromArea;
+	int						routeRequestToArea;
+	int						routeRequestFrame;
+
 	idMoveState				move;
 	idMoveState				savedMove;
 
@@ -1580,6 +1586,15 @@ public: // greebo: Made these public for now, I didn't want to write an accessor
 
 	float					TravelDistance( const idVec3 &start, const idVec3 &end );
 
+	/**
+	 * Same as TravelDistance(), for callers which can wait a frame for the answer. The route is queued
+	 * and solved on the job threads together with the routes of the other AI before the next frame's
+	 * thinking. Returns false while the answer is pending, call again with the same positions to pick it up.
+	 * Answers right away through TravelDistance() if tdm_ai_opt_async_paths is off or no routing is needed.
+	 */
+	bool					TravelDistanceAsync( const idVec3 &start, const idVec3 &end, float &dist );
+	void					CancelTravelDistanceAsync( void );
+
 	/**
 	 * greebo: Returns the number of the nearest reachable area for the given point. 
 	 *         Depending on the move type, the call is routed to the AAS->PointReachableAreaNum 
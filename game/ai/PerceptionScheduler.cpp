@@ -0,0 +1,381 @@
+/*****************************************************************************
+The Dark Mod GPL Source Code
+
+This file is part of the The Dark Mod Source Code, originally based
+on the Doom 3 GPL Source Code as published in 2011.
+
+The Dark Mod Source Code is free software: you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version. For details, see LICENSE.TXT.
+
+Project: The Dark Mod (http://www.thedarkmod.com/)
+
+******************************************************************************/
+
+#include "precompiled.h"
+#pragma hdrstop
+
+
+
+#include "PerceptionScheduler.h"
+
+namespace ai
+{
+
+const float PerceptionScheduler::DISTANCE_SCALE = 512.0f;
+
+PerceptionScheduler::PerceptionScheduler()
+{
+	Clear();
+}
+
+void PerceptionScheduler::Clear()
+{
+	_clients.Clear();
+	_frame = 0;
+	_budget = 0;
+	_outstanding = 0;
+	memset(&_stats, 0, sizeof(_stats));
+	memset(&_current, 0, sizeof(_current));
+}
+
+PerceptionScheduler::Client& PerceptionScheduler::GetClient(int client)
+{
+	assert(client >= 0);
+
+	if (client >= _clients.Num())
+	{
+		int oldNum = _clients.Num();
+		_clients.SetNum(client + 1, false);
+		for (int i = oldNum; i < _clients.Num(); i++)
+		{
+			memset(&_clients[i], 0, sizeof(Client));
+			_clients[i].lastRequestFrame = -STALE_FRAMES;
+		}
+	}
+
+	return _clients[client];
+}
+
+void PerceptionScheduler::BeginFrame(int budget)
+{
+	_frame++;
+	_budget = budget;
+
+	int maxWaitEver = _stats.maxWaitEver;
+	_stats = _current;
+	memset(&_current, 0, sizeof(_current));
+
+	// count the waiting clients and take the slots back from the ones which stopped asking
+	idList<int> candidates;
+	for (int i = 0; i < _clients.Num(); i++)
+	{
+		Client& client = _clients[i];
+		bool stale = (_frame - client.lastRequestFrame > STALE_FRAMES);
+
+		if (client.granted && (stale || budget <= 0))
+		{
+			client.granted = false;
+			_outstanding--;
+		}
+
+		if (!client.pending)
+		{
+			continue;
+		}
+
+		if (stale)
+		{
+			client.pending = false;
+			client.waitFrames = 0;
+			continue;
+		}
+
+		client.waitFrames++;
+		_stats.pending++;
+		_stats.maxWait = Max(_stats.maxWait, client.waitFrames);
+
+		// slots only go to the clients expected to ask again this frame, others would hold them unused
+		if (!client.granted && _frame >= client.lastRequestFrame + client.requestInterval)
+		{
+			candidates.Append(i);
+		}
+	}
+	_stats.maxWaitEver = Max(maxWaitEver, _stats.maxWait);
+
+	if (budget <= 0)
+	{
+		return;
+	}
+
+	// hand the free slots to the most urgent clients
+	int freeSlots = budget - _outstanding;
+	if (freeSlots <= 0 || candidates.Num() == 0)
+	{
+		return;
+	}
+
+	if (candidates.Num() > freeSlots)
+	{
+		const idList<Client>& clients = _clients;
+		std::nth_element(candidates.begin(), candidates.begin() + freeSlots, candidates.end(), [&clients](int a, int b) {
+			float urgencyA = clients[a].waitFrames * clients[a].priority;
+			float urgencyB = clients[b].waitFrames * clients[b].priority;
+			return urgencyA > urgencyB || (urgencyA == urgencyB && clients[a].waitFrames > clients[b].waitFrames);
+		});
+		candidates.SetNum(freeSlots);
+	}
+
+	for (int i = 0; i < candidates.Num(); i++)
+	{
+		_clients[candidates[i]].granted = true;
+		_outstanding++;
+	}
+}
+
+bool PerceptionScheduler::Request(int client, float distance, float alertLevel)
+{
+	_current.requests++;
+
+	if (_budget <= 0)
+	{
+		_current.granted++;
+		return true;
+	}
+
+	Client& c = GetClient(client);
+	if (c.lastRequestFrame >= 0 && c.lastRequestFrame < _frame)
+	{
+		c.requestInterval = idMath::Imin(_frame - c.lastRequestFrame, STALE_FRAMES);
+	}
+	c.lastRequestFrame = _frame;
+	c.priority = (1.0f + Max(alertLevel, 0.0f)) / (1.0f + Max(distance, 0.0f) / DISTANCE_SCALE);
+
+	if (c.granted)
+	{
+		c.granted = false;
+		c.pending = false;
+		c.waitFrames = 0;
+		_outstanding--;
+		_current.granted++;
+		return true;
+	}
+
+	// slots neither used nor held for waiting clients are handed out right away
+	if (_current.granted + _outstanding < _budget)
+	{
+		c.pending = false;
+		c.waitFrames = 0;
+		_current.granted++;
+		return true;
+	}
+
+	c.pending = true;
+	_current.deferred++;
+	return false;
+}
+
+void PerceptionScheduler::Remove(int client)
+{
+	if (client < 0 || client >= _clients.Num())
+	{
+		return;
+	}
+
+	Client& c = _clients[client];
+	if (c.granted)
+	{
+		_outstanding--;
+	}
+	memset(&c, 0, sizeof(Client));
+	c.lastRequestFrame = -STALE_FRAMES;
+}
+
+const PerceptionScheduler::Stats& PerceptionScheduler::GetStats() const
+{
+	return _stats;
+}
+
+} // namespace ai
+
+
+#include "../tests/testing.h"
+
+namespace
+{
+
+// synthetic AI thinking every few frames at fixed distance and alert level
+struct SimulatedAI
+{
+	int		thinkInterval;
+	int		thinkOffset;
+	float	distance;
+	float	alertLevel;
+	int		lastGrantFrame;
+	int		maxGap;
+	int		grants;
+};
+
+void SimulatePerception(ai::PerceptionScheduler& scheduler, idList<SimulatedAI>& ais, int budget, int frames, int& maxGrantsPerFrame)
+{
+	maxGrantsPerFrame = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		scheduler.BeginFrame(budget);
+		int grants = 0;
+		for (int i = 0; i < ais.Num(); i++)
+		{
+			SimulatedAI& ai = ais[i];
+			if ((frame + ai.thinkOffset) % ai.thinkInterval != 0)
+			{
+				continue;
+			}
+			if (scheduler.Request(i, ai.distance, ai.alertLevel))
+			{
+				ai.maxGap = Max(ai.maxGap, frame - ai.lastGrantFrame);
+				ai.lastGrantFrame = frame;
+				ai.grants++;
+				grants++;
+			}
+		}
+		maxGrantsPerFrame = Max(maxGrantsPerFrame, grants);
+	}
+}
+
+}
+
+TEST_CASE("PerceptionScheduler:BoundedAndFair")
+{
+	static const int NUM_AI = 200;
+	static const int BUDGET = 10;
+	static const int FRAMES = 2000;
+
+	idRandom rnd;
+	idList<SimulatedAI> ais;
+	for (int i = 0; i < NUM_AI; i++)
+	{
+		SimulatedAI ai;
+		ai.thinkInterval = 1 + rnd.RandomInt(4);
+		ai.thinkOffset = rnd.RandomInt(ai.thinkInterval);
+		ai.distance = 100.0f + rnd.RandomFloat() * 4000.0f;
+		ai.alertLevel = (i % 10 == 0) ? 10.0f : 0.0f;
+		ai.lastGrantFrame = 0;
+		ai.maxGap = 0;
+		ai.grants = 0;
+		ais.Append(ai);
+	}
+
+	ai::PerceptionScheduler scheduler;
+	int maxGrantsPerFrame;
+	SimulatePerception(scheduler, ais, BUDGET, FRAMES, maxGrantsPerFrame);
+
+	// bounded work: never more checks in a frame than the budget
+	CHECK(maxGrantsPerFrame <= BUDGET);
+
+	// the budget is actually used
+	int totalGrants = 0;
+	for (int i = 0; i < NUM_AI; i++)
+	{
+		totalGrants += ais[i].grants;
+	}
+	CHECK(totalGrants >= BUDGET * FRAMES * 3 / 4);
+
+	// fairness: everybody gets checked, nobody waits unreasonably long
+	float nearAlerted = 0.0f, farCalm = 0.0f;
+	int numNearAlerted = 0, numFarCalm = 0;
+	for (int i = 0; i < NUM_AI; i++)
+	{
+		const SimulatedAI& ai = ais[i];
+		CHECK(ai.grants > 0);
+		CHECK(ai.maxGap <= 8 * NUM_AI / BUDGET);
+		if (ai.alertLevel > 0.0f && ai.distance < 1000.0f)
+		{
+			nearAlerted += ai.grants;
+			numNearAlerted++;
+		}
+		else if (ai.alertLevel == 0.0f && ai.distance > 3000.0f)
+		{
+			farCalm += ai.grants;
+			numFarCalm++;
+		}
+	}
+
+	// priority: close alerted AI are checked more often than far calm ones
+	REQUIRE(numNearAlerted > 0);
+	REQUIRE(numFarCalm > 0);
+	CHECK(nearAlerted / numNearAlerted > farCalm / numFarCalm);
+
+	const ai::PerceptionScheduler::Stats& stats = scheduler.GetStats();
+	CHECK(stats.maxWaitEver <= 8 * NUM_AI / BUDGET);
+	CHECK(stats.granted <= BUDGET);
+}
+
+TEST_CASE("PerceptionScheduler:Disabled")
+{
+	ai::PerceptionScheduler scheduler;
+	for (int frame = 0; frame < 10; frame++)
+	{
+		scheduler.BeginFrame(0);
+		for (int i = 0; i < 50; i++)
+		{
+			CHECK(scheduler.Request(i, 100.0f * i, 0.0f));
+		}
+	}
+	CHECK(scheduler.GetStats().deferred == 0);
+	CHECK(scheduler.GetStats().granted == 50);
+}
+
+TEST_CASE("PerceptionScheduler:StaleClientsReleaseSlots")
+{
+	ai::PerceptionScheduler scheduler;
+	scheduler.BeginFrame(1);
+	CHECK(scheduler.Request(0, 0.0f, 0.0f));
+	CHECK(!scheduler.Request(1, 0.0f, 0.0f));
+
+	// client 1 gets the slot held for it, but never comes back to use it
+	scheduler.BeginFrame(1);
+	CHECK(!scheduler.Request(2, 0.0f, 0.0f));
+	for (int frame = 0; frame < 100; frame++)
+	{
+		scheduler.BeginFrame(1);
+	}
+
+	// a new client must not be blocked forever by the unused slot
+	CHECK(scheduler.Request(3, 0.0f, 0.0f));
+}
+
+TEST_CASE("PerceptionScheduler:UndersubscribedNotDeferred")
+{
+	static const int NUM_AI = 5;
+	static const int BUDGET = 10;
+
+	idList<SimulatedAI> ais;
+	for (int i = 0; i < NUM_AI; i++)
+	{
+		SimulatedAI ai;
+		ai.thinkInterval = 1 + i % 2;
+		ai.thinkOffset = 0;
+		ai.distance = 500.0f * i;
+		ai.alertLevel = 0.0f;
+		ai.lastGrantFrame = 0;
+		ai.maxGap = 0;
+		ai.grants = 0;
+		ais.Append(ai);
+	}
+
+	// with fewer AI than slots every check runs when asked for
+	ai::PerceptionScheduler scheduler;
+	int maxGrantsPerFrame;
+	SimulatePerception(scheduler, ais, BUDGET, 100, maxGrantsPerFrame);
+
+	for (int i = 0; i < NUM_AI; i++)
+	{
+		CHECK(ais[i].grants == 100 / ais[i].thinkInterval);
+		CHECK(ais[i].maxGap == ais[i].thinkInterval);
+	}
+	CHECK(maxGrantsPerFrame == NUM_AI);
+	CHECK(scheduler.GetStats().deferred == 0);
+	CHECK(scheduler.GetStats().pending == 0);
+	CHECK(scheduler.GetStats().maxWaitEver == 0);
+}
@@ -0,0 +1,89 @@
+/*****************************************************************************
+The Dark Mod GPL Source Code
+
+This file is part of the The Dark Mod Source Code, originally based
+on the Doom 3 GPL Source Code as published in 2011.
+
+The Dark Mod Source Code is free software: you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version. For details, see LICENSE.TXT.
+
+Project: The Dark Mod (http://www.thedarkmod.com/)
+
+******************************************************************************/
+
+#ifndef __PERCEPTION_SCHEDULER_H__
+#define __PERCEPTION_SCHEDULER_H__
+
+namespace ai
+{
+
+/**
+ * Spreads the visual scans of AI across frames, so that AI thinking on the same
+ * frame do not all trace at once. At most <budget> scans are granted per frame,
+ * requests are granted right away while the budget of the frame is not used up.
+ * Refused clients age every frame they wait, and the ones with the highest
+ * wait * priority get the next free slots, so nobody is starved. Priority grows
+ * with alert level and shrinks with distance to the player.
+ *
+ * Clients are identified by a small integer (the entity number of the AI).
+ */
+class PerceptionScheduler
+{
+public:
+	struct Stats
+	{
+		int requests;		// checks requested during the last frame
+		int granted;		// checks allowed to run during the last frame
+		int deferred;		// checks refused during the last frame
+		int pending;		// clients waiting for a slot
+		int maxWait;		// longest current wait in frames
+		int maxWaitEver;	// longest wait in frames since the last Clear()
+	};
+
+	PerceptionScheduler();
+
+	void Clear();
+
+	// Called once per game frame before entities think.
+	// A budget of zero or less disables scheduling, all requests are granted.
+	void BeginFrame(int budget);
+
+	// Returns true if the client may run its check now.
+	bool Request(int client, float distance, float alertLevel);
+
+	// Forgets a client, e.g. when the AI is removed.
+	void Remove(int client);
+
+	const Stats& GetStats() const;
+
+private:
+	// clients not requesting for this many frames give their slot back
+	static const int STALE_FRAMES = 60;
+	// distance at which the priority is halved
+	static const float DISTANCE_SCALE;
+
+	struct Client
+	{
+		bool	pending;		// last request was refused
+		bool	granted;		// holds a slot for its next request
+		int		waitFrames;		// frames waited since the last granted check
+		int		lastRequestFrame;
+		int		requestInterval;	// frames between the last two requests
+		float	priority;
+	};
+
+	Client& GetClient(int client);
+
+	idList<Client>	_clients;
+	int				_frame;
+	int				_budget;
+	int				_outstanding;	// granted slots not used yet
+	Stats			_stats;			// last finished frame
+	Stats			_current;		// frame in progress
+};
+
+} // namespace ai
+
+#endif /* __PERCEPTION_SCHEDULER_H__ */
@@ -124,7 +124,15 @@ void StayInCoverState::Think(idAI* owner)
 			int ownerAreaNum = owner->PointReachableAreaNum(ownerOrigin, 1.0f);
 			aasPath_t path;
 
-			if (owner->PathToGoal(path, ownerAreaNum, ownerOrigin, enemyAreaNum, enemyOrigin, owner))
+			// The route is solved on the job threads if tdm_ai_opt_async_paths is on, stay in cover
+			// until the answer comes. If there is a route, the path check below finds it in the cache.
+			float travelTime;
+			if (!owner->TravelDistanceAsync(ownerOrigin, enemyOrigin, travelTime))
+			{
+				return;
+			}
+
+			if ((travelTime >= 0) && owner->PathToGoal(path, ownerAreaNum, ownerOrigin, enemyAreaNum, enemyOrigin, owner))
 			{
 				// Get back to combat if we can reach the enemy
 				owner->GetMind()->EndState();
@@ -23,6 +23,10 @@ const int ANIM_NumAnimChannels		= 5;
 const int ANIM_MaxAnimsPerChannel	= 3;
 const int ANIM_MaxSyncedAnims		= 3;
 
+// blend state of an animator, used to share poses between animators playing the same anims in sync
+const int ANIM_PoseKeySize			= 2 + ANIM_NumAnimChannels * ANIM_MaxAnimsPerChannel * ( 7 + ANIM_MaxSyncedAnims );
+typedef idStaticList<int, ANIM_PoseKeySize> idAnimPoseKey;
+
 //
 // animation channels.  make sure to change script/doom_defs.script if you add any channels, or change their order
 //
@@ -473,6 +477,7 @@ private:
 	void						BlendDelta( int fromtime, int totime, idVec3 &blendDelta, float &blendWeight ) const;
 	void						BlendDeltaRotation( int fromtime, int totime, idQuat &blendDelta, float &blendWeight ) const;
 	bool						AddBounds( int currentTime, idBounds &bounds, bool removeOriginOffset ) const;
+	void						AddPoseKey( int currentTime, idAnimPoseKey &key ) const;
 
 public:
 								idAnimBlend();
@@ -637,9 +642,15 @@ public:
 	int							AnimLength( int animnum ) const;
 	const idVec3				&TotalMovementDelta( int animnum ) const;
 
+								// forget the joints shared between animators (see g_animPoseCache)
+	static void					ClearPoseCache( void );
+
 private:
 	void						FreeData( void );
 	void						PushAnims( int channel, int currentTime, int blendTime );
+	void						GetPoseKey( int currentTime, idAnimPoseKey &key ) const;
+	void						TransformJointRange( const idJointQuat *jointFrame, int first, int last );
+	void						TransformDirtyJoints( const idJointQuat *jointFrame, int numJoints );
 
 private:
 	const idDeclModelDef *		modelDef;
@@ -649,6 +660,8 @@ private:
 	idList<jointMod_t *>		jointMods;
 	int							numJoints;
 	idJointMat *				joints;
+	idList<idJointQuat>			lastJointFrame;			// local joints and joint modifications the joints were built from,
+	idList<jointMod_t>			lastJointMods;			// empty unless joints are rebuilt incrementally
 
 	mutable int					lastTransformTime;		// mutable because the value is updated in CreateFrame
 	mutable bool				stoppedAnimatingUpdate;
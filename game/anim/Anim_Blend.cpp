@@ -3026,6 +3026,37 @@ bool idAnimBlend::AddBounds( int currentTime, idBounds &bounds, bool removeOrigi
 	return true;
 }
 
+/*
+=====================
+idAnimBlend::AddPoseKey
+
+Appends everything BlendAnim depends on, so that equal keys produce equal poses.
+=====================
+*/
+void idAnimBlend::AddPoseKey( int currentTime, idAnimPoseKey &key ) const {
+	const idAnim *anim = Anim();
+	if ( !anim ) {
+		key.Append( 0 );
+		return;
+	}
+
+	if ( m_bPaused ) {
+		currentTime = m_PausedTime;
+	}
+
+	float weight = GetWeight( currentTime );
+	key.Append( animNum + 1 );
+	key.Append( *reinterpret_cast<const int *>( &weight ) );
+	key.Append( ( endtime >= 0 ) && ( currentTime >= endtime ) );
+	key.Append( frame );
+	key.Append( cycle );
+	key.Append( AnimTime( currentTime ) );
+	key.Append( allowMove );
+	for ( int i = 0; i < anim->NumAnims(); i++ ) {
+		key.Append( *reinterpret_cast<const int *>( &animWeights[ i ] ) );
+	}
+}
+
 /***********************************************************************
 
 	idDeclModelDef
@@ -3943,6 +3974,156 @@ const idVec3 &idDeclModelDef::GetVisualOffset( void ) const {
 	return offset;
 }
 
+/***********************************************************************
+
+	idAnimPoseCache
+
+	Final joints of the animators created this game frame, keyed by their blend state.
+	Crowds of AI playing the same anims in sync evaluate each pose only once.
+
+***********************************************************************/
+
+class idAnimPoseCache {
+public:
+						idAnimPoseCache();
+
+	bool				Find( int frameNum, const idAnimPoseKey &key, idJointMat *joints, int numJoints );
+	void				Store( int frameNum, const idAnimPoseKey &key, const idJointMat *joints, int numJoints );
+	void				Clear( void );
+	int					NumHits( void ) const { return numHits; }
+
+private:
+	static const int	MAX_POSES = 256;
+
+	struct pose_t {
+		int				keyOffset;
+		int				keyNum;
+		int				jointOffset;
+		int				numJoints;
+	};
+
+	static int			HashKey( const idAnimPoseKey &key );
+	int					FindPose( const idAnimPoseKey &key, int numJoints ) const;
+	void				ClearPoses( void );
+
+	idSysMutex			mutex;
+	int					frameNum = -1;
+	int					numHits = 0;
+	idList<pose_t>		poses;
+	idList<int>			keys;
+	idList<idJointMat>	joints;
+	idHashIndex			hash;
+};
+
+static idAnimPoseCache animPoseCache;
+
+/*
+=====================
+idAnimPoseCache::idAnimPoseCache
+=====================
+*/
+idAnimPoseCache::idAnimPoseCache() {
+	keys.SetGranularity( 1024 );
+	joints.SetGranularity( 1024 );
+}
+
+/*
+=====================
+idAnimPoseCache::HashKey
+=====================
+*/
+int idAnimPoseCache::HashKey( const idAnimPoseKey &key ) {
+	unsigned int h = 0;
+	for ( int i = 0; i < key.Num(); i++ ) {
+		h = ( h ^ key[i] ) * 16777619u;
+	}
+	return ( h ^ ( h >> 16 ) ) & 0x7fffffff;
+}
+
+/*
+=====================
+idAnimPoseCache::FindPose
+=====================
+*/
+int idAnimPoseCache::FindPose( const idAnimPoseKey &key, int numJoints ) const {
+	for ( int i = hash.First( HashKey( key ) ); i != -1; i = hash.Next( i ) ) {
+		const pose_t &pose = poses[i];
+		if ( pose.keyNum == key.Num() && pose.numJoints == numJoints && memcmp( &keys[pose.keyOffset], key.Ptr(), key.Num() * sizeof( int ) ) == 0 ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+=====================
+idAnimPoseCache::Find
+=====================
+*/
+bool idAnimPoseCache::Find( int frameNum, const idAnimPoseKey &key, idJointMat *jointsOut, int numJoints ) {
+	idScopedCriticalSection lock( mutex );
+	if ( frameNum != this->frameNum ) {
+		return false;
+	}
+	int index = FindPose( key, numJoints );
+	if ( index < 0 ) {
+		return false;
+	}
+	SIMDProcessor->Memcpy( jointsOut, &joints[poses[index].jointOffset], numJoints * sizeof( jointsOut[0] ) );
+	numHits++;
+	return true;
+}
+
+/*
+=====================
+idAnimPoseCache::Store
+=====================
+*/
+void idAnimPoseCache::Store( int frameNum, const idAnimPoseKey &key, const idJointMat *jointsIn, int numJoints ) {
+	idScopedCriticalSection lock( mutex );
+	if ( frameNum != this->frameNum ) {
+		ClearPoses();
+		this->frameNum = frameNum;
+	}
+	if ( poses.Num() >= MAX_POSES || FindPose( key, numJoints ) >= 0 ) {
+		return;
+	}
+
+	pose_t &pose = poses.Alloc();
+	pose.keyOffset = keys.Num();
+	pose.keyNum = key.Num();
+	pose.jointOffset = joints.Num();
+	pose.numJoints = numJoints;
+	keys.AssureSize( pose.keyOffset + key.Num() );
+	memcpy( &keys[pose.keyOffset], key.Ptr(), key.Num() * sizeof( int ) );
+	joints.AssureSize( pose.jointOffset + numJoints );
+	SIMDProcessor->Memcpy( &joints[pose.jointOffset], jointsIn, numJoints * sizeof( jointsIn[0] ) );
+	hash.Add( HashKey( key ), poses.Num() - 1 );
+}
+
+/*
+=====================
+idAnimPoseCache::Clear
+=====================
+*/
+void idAnimPoseCache::Clear( void ) {
+	idScopedCriticalSection lock( mutex );
+	ClearPoses();
+}
+
+/*
+=====================
+idAnimPoseCache::ClearPoses
+=====================
+*/
+void idAnimPoseCache::ClearPoses( void ) {
+	frameNum = -1;
+	poses.SetNum( 0, false );
+	keys.SetNum( 0, false );
+	joints.SetNum( 0, false );
+	hash.Clear();
+}
+
 /***********************************************************************
 
 	idAnimator
@@ -3998,7 +4179,7 @@ idAnimator::Allocated
 size_t idAnimator::Allocated( void ) const {
 	size_t	size;
 
-	size = jointMods.Allocated() + numJoints * sizeof( joints[0] ) + jointMods.Num() * sizeof( jointMods[ 0 ] ) + AFPoseJointMods.Allocated() + AFPoseJointFrame.Allocated() + AFPoseJoints.Allocated();
+	size = jointMods.Allocated() + numJoints * sizeof( joints[0] ) + jointMods.Num() * sizeof( jointMods[ 0 ] ) + AFPoseJointMods.Allocated() + AFPoseJointFrame.Allocated() + AFPoseJoints.Allocated() + lastJointFrame.Allocated() + lastJointMods.Allocated();
 
 	return size;
 }
@@ -4102,6 +4283,7 @@ void idAnimator::Restore( idRestoreGame *savefile ) {
 	
 	savefile->ReadInt( numJoints );
 	joints = (idJointMat *) Mem_Alloc16( numJoints * sizeof( joints[0] ) );
+	lastJointFrame.Clear();
 	for ( i = 0; i < numJoints; i++ ) {
 		float *data = joints[i].ToFloatPtr();
 		for ( j = 0; j < 12; j++ ) {
@@ -4178,6 +4360,8 @@ void idAnimator::FreeData( void ) {
 	Mem_Free16( joints );
 	joints = NULL;
 	numJoints = 0;
+	lastJointFrame.Clear();
+	lastJointMods.Clear();
 
 	modelDef = NULL;
 
@@ -4207,6 +4391,31 @@ void idAnimator::PushAnims( int channelNum, int currentTime, int blendTime ) {
 	ForceUpdate();
 }
 
+/*
+=====================
+idAnimator::ClearPoseCache
+=====================
+*/
+void idAnimator::ClearPoseCache( void ) {
+	animPoseCache.Clear();
+}
+
+/*
+=====================
+idAnimator::GetPoseKey
+=====================
+*/
+void idAnimator::GetPoseKey( int currentTime, idAnimPoseKey &key ) const {
+	key.Clear();
+	key.Append( modelDef->Index() );
+	key.Append( removeOriginOffset );
+	for( int i = 0; i < ANIM_NumAnimChannels; i++ ) {
+		for( int j = 0; j < ANIM_MaxAnimsPerChannel; j++ ) {
+			channels[ i ][ j ].AddPoseKey( currentTime, key );
+		}
+	}
+}
+
 /*
 =====================
 idAnimator::SetModel
@@ -4296,6 +4505,7 @@ idRenderModel* idAnimator::SwapLODModel( const char *modelname ) {
 
 	// OK to proceed
 	modelDef = newmodel;
+	lastJointFrame.Clear();
 	// make sure model hasn't been purged
 	modelDef->Touch();
 
@@ -5215,14 +5425,11 @@ idAnimator::CreateFrame
 bool idAnimator::CreateFrame( int currentTime, bool force ) {
 	int					i, j;
 	int					numJoints;
-	int					parentNum;
 	bool				hasAnim;
 	bool				debugInfo;
 	float				baseBlend;
 	float				blendWeight;
 	const idAnimBlend *	blend;
-	const int *			jointParent;
-	const jointMod_t *	jointMod;
 	const idJointQuat *	defaultPose;
 
 	if ( gameLocal.inCinematic && gameLocal.skipCinematic ) {
@@ -5244,7 +5451,7 @@ bool idAnimator::CreateFrame( int currentTime, bool force ) {
 	}
 	
 	// Optional optimisation: Skip animations for dormant entities
-	if (cv_ai_opt_noanims.GetBool() && entity->CheckDormant()) return false;
+	if (cv_ai_opt_noanims.GetBool() && entity && entity->CheckDormant()) return false;
 
 	lastTransformTime = currentTime;
 	stoppedAnimatingUpdate = false;
@@ -5271,6 +5478,19 @@ bool idAnimator::CreateFrame( int currentTime, bool force ) {
 	}
 
 	numJoints = modelDef->Joints().Num();
+
+	// animators in exactly the same blend state share the final joints,
+	// unless AF pose or joint modifications (e.g. head tracking) are applied on top
+	idAnimPoseKey poseKey;
+	bool usePoseCache = g_animPoseCache.GetBool() && !debugInfo && !AFPoseJoints.Num() && !jointMods.Num();
+	if ( usePoseCache ) {
+		GetPoseKey( currentTime, poseKey );
+		if ( animPoseCache.Find( gameLocal.framenum, poseKey, joints, numJoints ) ) {
+			lastJointFrame.Clear();
+			return true;
+		}
+	}
+
 	idJointQuat *jointFrame = ( idJointQuat * )_alloca16( numJoints * sizeof( jointFrame[0] ) );
 	SIMDProcessor->Memcpy( jointFrame, defaultPose, numJoints * sizeof( jointFrame[0] ) );
 
@@ -5341,58 +5561,89 @@ bool idAnimator::CreateFrame( int currentTime, bool force ) {
 		return false;
 	}
 
+	if ( g_animDirtyJoints.GetBool() ) {
+		TransformDirtyJoints( jointFrame, numJoints );
+	} else {
+		lastJointFrame.Clear();
+		TransformJointRange( jointFrame, 0, numJoints - 1 );
+	}
+
+	if ( usePoseCache ) {
+		animPoseCache.Store( gameLocal.framenum, poseKey, joints, numJoints );
+	}
+
+	return true;
+}
+
+/*
+=====================
+idAnimator::TransformJointRange
+
+Converts the local joints first..last to matrices, applies the joint modifications and
+transforms them into model space. Parents outside of the range must be up to date.
+=====================
+*/
+void idAnimator::TransformJointRange( const idJointQuat *jointFrame, int first, int last ) {
+	int					i, j;
+	int					parentNum;
+	const jointMod_t *	jointMod;
+	const int *			jointParent = modelDef->JointParents();
+
 	// convert the joint quaternions to rotation matrices
-	SIMDProcessor->ConvertJointQuatsToJointMats( joints, jointFrame, numJoints );
+	SIMDProcessor->ConvertJointQuatsToJointMats( joints + first, jointFrame + first, last - first + 1 );
 
-	// check if we need to modify the origin
-	if ( jointMods.Num() && ( jointMods[0]->jointnum == 0 ) ) {
-		jointMod = jointMods[0];
+	// skip the joint modifications preceding the range
+	for( j = 0; j < jointMods.Num() && jointMods[j]->jointnum < first; j++ ) {
+	}
 
-		switch( jointMod->transform_axis ) {
-			case JOINTMOD_NONE:
-				break;
+	i = first;
+	if ( first == 0 ) {
+		// check if we need to modify the origin
+		if ( j < jointMods.Num() && ( jointMods[j]->jointnum == 0 ) ) {
+			jointMod = jointMods[j];
 
-			case JOINTMOD_LOCAL:
-				joints[0].SetRotation( jointMod->mat * joints[0].ToMat3() );
-				break;
+			switch( jointMod->transform_axis ) {
+				case JOINTMOD_NONE:
+					break;
+
+				case JOINTMOD_LOCAL:
+					joints[0].SetRotation( jointMod->mat * joints[0].ToMat3() );
+					break;
 			
-			case JOINTMOD_WORLD:
-				joints[0].SetRotation( joints[0].ToMat3() * jointMod->mat );
-				break;
+				case JOINTMOD_WORLD:
+					joints[0].SetRotation( joints[0].ToMat3() * jointMod->mat );
+					break;
 
-			case JOINTMOD_LOCAL_OVERRIDE:
-			case JOINTMOD_WORLD_OVERRIDE:
-				joints[0].SetRotation( jointMod->mat );
-				break;
-		}
+				case JOINTMOD_LOCAL_OVERRIDE:
+				case JOINTMOD_WORLD_OVERRIDE:
+					joints[0].SetRotation( jointMod->mat );
+					break;
+			}
 
-		switch( jointMod->transform_pos ) {
-			case JOINTMOD_NONE:
-				break;
+			switch( jointMod->transform_pos ) {
+				case JOINTMOD_NONE:
+					break;
 
-			case JOINTMOD_LOCAL:
-				joints[0].SetTranslation( joints[0].ToVec3() + jointMod->pos );
-				break;
+				case JOINTMOD_LOCAL:
+					joints[0].SetTranslation( joints[0].ToVec3() + jointMod->pos );
+					break;
 			
-			case JOINTMOD_LOCAL_OVERRIDE:
-			case JOINTMOD_WORLD:
-			case JOINTMOD_WORLD_OVERRIDE:
-				joints[0].SetTranslation( jointMod->pos );
-				break;
+				case JOINTMOD_LOCAL_OVERRIDE:
+				case JOINTMOD_WORLD:
+				case JOINTMOD_WORLD_OVERRIDE:
+					joints[0].SetTranslation( jointMod->pos );
+					break;
+			}
+			j++;
 		}
-		j = 1;
-	} else {
-		j = 0;
-	}
-
-	// add in the model offset
-	joints[0].SetTranslation( joints[0].ToVec3() + modelDef->GetVisualOffset() );
 
-	// pointer to joint info
-	jointParent = modelDef->JointParents();
+		// add in the model offset
+		joints[0].SetTranslation( joints[0].ToVec3() + modelDef->GetVisualOffset() );
+		i = 1;
+	}
 
 	// add in any joint modifications
-	for( i = 1; j < jointMods.Num(); j++, i++ ) {
+	for( ; j < jointMods.Num() && jointMods[j]->jointnum <= last; j++, i++ ) {
 		jointMod = jointMods[j];
 
 		// transform any joints preceding the joint modifier
@@ -5448,10 +5699,67 @@ bool idAnimator::CreateFrame( int currentTime, bool force ) {
 		}
 	}
 
-	// transform the rest of the hierarchy
-	SIMDProcessor->TransformJoints( joints, jointParent, i, numJoints - 1 );
+	// transform the rest of the range
+	SIMDProcessor->TransformJoints( joints, jointParent, i, last );
+}
 
-	return true;
+/*
+=====================
+idAnimator::TransformDirtyJoints
+
+Rebuilds only the joints whose local transform or joint modification changed since
+the previous frame, together with their subtrees. Other joints keep their matrices.
+=====================
+*/
+void idAnimator::TransformDirtyJoints( const idJointQuat *jointFrame, int numJoints ) {
+	if ( lastJointFrame.Num() != numJoints ) {
+		TransformJointRange( jointFrame, 0, numJoints - 1 );
+	} else {
+		const int *jointParent = modelDef->JointParents();
+		bool *dirty = ( bool * )_alloca( numJoints * sizeof( dirty[0] ) );
+		for( int i = 0; i < numJoints; i++ ) {
+			dirty[i] = memcmp( &jointFrame[i], &lastJointFrame[i], sizeof( jointFrame[i] ) ) != 0;
+		}
+
+		// joint modifications which were added, removed or changed (both lists are sorted by joint)
+		int j = 0, k = 0;
+		while( j < jointMods.Num() || k < lastJointMods.Num() ) {
+			if ( k >= lastJointMods.Num() || ( j < jointMods.Num() && jointMods[j]->jointnum < lastJointMods[k].jointnum ) ) {
+				dirty[ jointMods[j++]->jointnum ] = true;
+			} else if ( j >= jointMods.Num() || lastJointMods[k].jointnum < jointMods[j]->jointnum ) {
+				dirty[ lastJointMods[k++].jointnum ] = true;
+			} else {
+				const jointMod_t &mod = *jointMods[j++];
+				const jointMod_t &lastMod = lastJointMods[k++];
+				if ( mod.transform_axis != lastMod.transform_axis || mod.transform_pos != lastMod.transform_pos || mod.mat != lastMod.mat || mod.pos != lastMod.pos ) {
+					dirty[ mod.jointnum ] = true;
+				}
+			}
+		}
+
+		// parents always precede their children
+		for( int i = 1; i < numJoints; i++ ) {
+			dirty[i] |= dirty[ jointParent[i] ];
+		}
+
+		for( int first = 0; first < numJoints; first++ ) {
+			if ( dirty[first] ) {
+				int last = first;
+				while( last + 1 < numJoints && dirty[last + 1] ) {
+					last++;
+				}
+				TransformJointRange( jointFrame, first, last );
+				first = last;
+			}
+		}
+	}
+
+	lastJointFrame.SetNum( numJoints, false );
+	SIMDProcessor->Memcpy( lastJointFrame.Ptr(), jointFrame, numJoints * sizeof( jointFrame[0] ) );
+	lastJointMods.SetNum( jointMods.Num(), false );
+	for( int i = 0; i < jointMods.Num(); i++ ) {
+		lastJointMods[i] = *jointMods[i];
+	}
 }
 
 /*
@@ -6068,3 +6376,188 @@ idRenderModel *idGameEdit::ANIM_CreateMeshForAnim( idRenderModel *model, const c
 
 	return newmodel;
 }
+
+
+#include "../tests/testing.h"
+
+// a model with a skeleton and a few animations, no map needed
+static const idDeclModelDef *AnimTest_FindModelDef( void ) {
+	int num = declManager->GetNumDecls( DECL_MODELDEF );
+	for ( int i = 0; i < num; i++ ) {
+		const idDeclModelDef *modelDef = static_cast<const idDeclModelDef *>( declManager->DeclByIndex( DECL_MODELDEF, i ) );
+		if ( modelDef && modelDef->ModelHandle() && modelDef->NumJoints() > 1 && modelDef->NumAnims() > 4 ) {
+			return modelDef;
+		}
+	}
+	return NULL;
+}
+
+static void AnimTest_CreateFrames( const idList<idAnimator *> &crowd, int time, idList<idJointMat> &poses ) {
+	poses.Clear();
+	for ( int i = 0; i < crowd.Num(); i++ ) {
+		int numJoints;
+		idJointMat *joints;
+		crowd[i]->CreateFrame( time, true );
+		crowd[i]->GetJoints( &numJoints, &joints );
+		for ( int j = 0; j < numJoints; j++ ) {
+			poses.Append( joints[j] );
+		}
+	}
+}
+
+// crowd of animators in a few synced groups, some with torso overlays and some with joint modifications
+static void AnimTest_SpawnSyncedCrowd( const idDeclModelDef *modelDef, int count, int numGroups, idList<idAnimator *> &crowd ) {
+	crowd.Clear();
+	for ( int i = 0; i < count; i++ ) {
+		int group = i % numGroups;
+		// animators without an entity
+		idAnimator *animator = new idAnimator;
+		animator->SetModel( modelDef->GetName() );
+		animator->CycleAnim( ANIMCHANNEL_ALL, 1 + group % ( animator->NumAnims() - 1 ), gameLocal.time - 100 * group, 0 );
+		if ( group % 2 == 1 ) {
+			animator->PlayAnim( ANIMCHANNEL_TORSO, 1 + ( group + 1 ) % ( animator->NumAnims() - 1 ), gameLocal.time + 50, 200 );
+		}
+		if ( i % 7 == 3 && animator->NumJoints() > 1 ) {
+			animator->SetJointAxis( jointHandle_t( 1 ), JOINTMOD_LOCAL, idAngles( 0.0f, 30.0f, 0.0f ).ToMat3() );
+		}
+		crowd.Append( animator );
+	}
+}
+
+TEST_CASE("Anim:PoseCacheMatchesUncached") {
+	const idDeclModelDef *modelDef = AnimTest_FindModelDef();
+	if ( !modelDef ) {
+		MESSAGE( "No animated model found, test skipped" );
+		return;
+	}
+
+	idList<idAnimator *> crowd;
+	AnimTest_SpawnSyncedCrowd( modelDef, 24, 4, crowd );
+	int hits = animPoseCache.NumHits();
+	for ( int frame = 0; frame < 30; frame++ ) {
+		int time = gameLocal.time + frame * USERCMD_MSEC;
+		idList<idJointMat> cached, uncached;
+		{
+			idTestCVar poseCache( g_animPoseCache, true );
+			AnimTest_CreateFrames( crowd, time, cached );
+		}
+		{
+			idTestCVar poseCache( g_animPoseCache, false );
+			AnimTest_CreateFrames( crowd, time, uncached );
+		}
+		REQUIRE( cached.Num() == uncached.Num() );
+		CHECK( memcmp( cached.Ptr(), uncached.Ptr(), cached.Num() * sizeof( idJointMat ) ) == 0 );
+	}
+	// synced animators must have shared their poses
+	CHECK( animPoseCache.NumHits() > hits );
+	crowd.DeleteContents( true );
+}
+
+TEST_CASE("Anim:PoseCacheCrowdPerformance" * doctest::skip()) {
+	const idDeclModelDef *modelDef = AnimTest_FindModelDef();
+	if ( !modelDef ) {
+		MESSAGE( "No animated model found, test skipped" );
+		return;
+	}
+
+	idList<idAnimator *> crowd;
+	AnimTest_SpawnSyncedCrowd( modelDef, 128, 8, crowd );
+	for ( int cache = 0; cache < 2; cache++ ) {
+		idTestCVar poseCache( g_animPoseCache, cache != 0 );
+		idList<idJointMat> poses;
+		double start = Sys_GetClockTicks();
+		for ( int frame = 0; frame < 60; frame++ ) {
+			AnimTest_CreateFrames( crowd, gameLocal.time + frame * USERCMD_MSEC, poses );
+		}
+		double ms = ( Sys_GetClockTicks() - start ) * 1000.0 / Sys_ClockTicksPerSecond();
+		MESSAGE( ( cache ? "cached" : "uncached" ) << ": " << crowd.Num() << " animators, " << ms / 60.0 << " ms per frame" );
+	}
+	crowd.DeleteContents( true );
+}
+
+// half of the crowd holds a single frame, so only the joint modifications move
+static void AnimTest_SpawnHoldingCrowd( const idDeclModelDef *modelDef, int count, idList<idAnimator *> &crowd ) {
+	crowd.Clear();
+	for ( int i = 0; i < count; i++ ) {
+		idAnimator *animator = new idAnimator;
+		animator->SetModel( modelDef->GetName() );
+		int anim = 1 + i % ( animator->NumAnims() - 1 );
+		if ( i % 2 == 0 ) {
+			animator->SetFrame( ANIMCHANNEL_ALL, anim, 1 + i % animator->NumFrames( anim ), gameLocal.time, 0 );
+		} else {
+			animator->CycleAnim( ANIMCHANNEL_ALL, anim, gameLocal.time, 0 );
+		}
+		crowd.Append( animator );
+	}
+}
+
+// turns a joint in the middle of the hierarchy, like AI looking around, and sometimes another one
+static void AnimTest_ModifyJoints( const idList<idAnimator *> &crowd, int frame ) {
+	for ( int i = 0; i < crowd.Num(); i++ ) {
+		idAnimator *animator = crowd[i];
+		jointHandle_t look = jointHandle_t( animator->NumJoints() * 2 / 3 );
+		animator->SetJointAxis( look, JOINTMOD_WORLD, idAngles( 0.0f, 20.0f * idMath::Sin( frame * 0.1f + i ), 0.0f ).ToMat3() );
+		jointHandle_t extra = jointHandle_t( animator->NumJoints() / 3 );
+		if ( ( frame + i ) % 10 < 5 ) {
+			animator->SetJointPos( extra, JOINTMOD_LOCAL, idVec3( 0.0f, 0.0f, 1.0f ) );
+		} else {
+			animator->ClearJoint( extra );
+		}
+	}
+}
+
+TEST_CASE("Anim:DirtyJointsMatchFullRebuild") {
+	const idDeclModelDef *modelDef = AnimTest_FindModelDef();
+	if ( !modelDef ) {
+		MESSAGE( "No animated model found, test skipped" );
+		return;
+	}
+
+	// only the joint rebuild is compared, without the pose cache
+	idTestCVar poseCache( g_animPoseCache, false );
+	idList<idAnimator *> incremental, full;
+	AnimTest_SpawnHoldingCrowd( modelDef, 8, incremental );
+	AnimTest_SpawnHoldingCrowd( modelDef, 8, full );
+	for ( int frame = 0; frame < 40; frame++ ) {
+		int time = gameLocal.time + frame * USERCMD_MSEC;
+		idList<idJointMat> incrementalPoses, fullPoses;
+		AnimTest_ModifyJoints( incremental, frame );
+		AnimTest_ModifyJoints( full, frame );
+		{
+			idTestCVar dirtyJoints( g_animDirtyJoints, true );
+			AnimTest_CreateFrames( incremental, time, incrementalPoses );
+		}
+		{
+			idTestCVar dirtyJoints( g_animDirtyJoints, false );
+			AnimTest_CreateFrames( full, time, fullPoses );
+		}
+		REQUIRE( incrementalPoses.Num() == fullPoses.Num() );
+		CHECK( memcmp( incrementalPoses.Ptr(), fullPoses.Ptr(), fullPoses.Num() * sizeof( idJointMat ) ) == 0 );
+	}
+	incremental.DeleteContents( true );
+	full.DeleteContents( true );
+}
+
+TEST_CASE("Anim:DirtyJointsPerformance" * doctest::skip()) {
+	const idDeclModelDef *modelDef = AnimTest_FindModelDef();
+	if ( !modelDef ) {
+		MESSAGE( "No animated model found, test skipped" );
+		return;
+	}
+
+	idTestCVar poseCache( g_animPoseCache, false );
+	idList<idAnimator *> crowd;
+	AnimTest_SpawnHoldingCrowd( modelDef, 128, crowd );
+	for ( int dirty = 0; dirty < 2; dirty++ ) {
+		idTestCVar dirtyJoints( g_animDirtyJoints, dirty != 0 );
+		idList<idJointMat> poses;
+		double start = Sys_GetClockTicks();
+		for ( int frame = 0; frame < 60; frame++ ) {
+			AnimTest_ModifyJoints( crowd, frame );
+			AnimTest_CreateFrames( crowd, gameLocal.time + frame * USERCMD_MSEC, poses );
+		}
+		double ms = ( Sys_GetClockTicks() - start ) * 1000.0 / Sys_ClockTicksPerSecond();
+		MESSAGE( ( dirty ? "dirty joints" : "full rebuild" ) << ": " << crowd.Num() << " animators, " << ms / 60.0 << " ms per frame" );
+	}
+	crowd.DeleteContents( true );
+}
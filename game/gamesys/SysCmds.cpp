@@ -75,6 +75,19 @@ void Cmd_PrintAIRelations_f( const idCmdArgs &args )
 	return;
 }
 
+/*
+==================
+Cmd_PrintAIPerceptionStats_f
+==================
+*/
+void Cmd_PrintAIPerceptionStats_f( const idCmdArgs &args ) 
+{
+	const ai::PerceptionScheduler::Stats& stats = gameLocal.m_PerceptionScheduler.GetStats();
+	gameLocal.Printf( "budget: %d visual scans per frame\n", cv_ai_opt_perception_budget.GetInteger() );
+	gameLocal.Printf( "last frame: %d requested, %d granted, %d deferred\n", stats.requests, stats.granted, stats.deferred );
+	gameLocal.Printf( "waiting: %d AI, longest wait %d frames, longest wait ever %d frames\n", stats.pending, stats.maxWait, stats.maxWaitEver );
+}
+
 /**
  * greebo: This is a helper command, used in mainmenu_failure.gui
  */
@@ -3701,6 +3714,7 @@ void idGameLocal::InitConsoleCommands( void ) {
 
 	cmdSystem->AddCommand( "tdm_spr_testIO",		Cmd_TestSndIO_f,			CMD_FL_GAME,				"test soundprop file IO (needs a .spr file)" );
 	cmdSystem->AddCommand( "tdm_ai_rel_print",		Cmd_PrintAIRelations_f,		CMD_FL_GAME,				"print the relationship matrix determining relations between AI teams." );
+	cmdSystem->AddCommand( "tdm_ai_perception_stats",	Cmd_PrintAIPerceptionStats_f,	CMD_FL_GAME,			"print how many AI visual scans were deferred by tdm_ai_opt_perception_budget and how long AI waited." );
 
 	cmdSystem->AddCommand( "tdm_attach_offset",		Cmd_AttachmentOffset_f,		CMD_FL_GAME,				"Set the vector offset (x y z) for an attachment on an AI you are looking at.  Usage: tdm_attach_offset <attachment index> <x> <y> <z>" );
 	cmdSystem->AddCommand( "tdm_attach_rot",		Cmd_AttachmentRot_f,		CMD_FL_GAME,				"Set the rotation (pitch yaw roll) for an attachment on an AI you are looking at.  Usage: tdm_attach_rot <atachment index> <pitch> <yaw> <roll>  (NOTE: Rotation is applied before translation, angles are relative to the joint orientation)" );
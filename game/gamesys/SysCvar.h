@@ -62,6 +62,8 @@ extern idCVar cv_ai_opt_interleavethinkmindist;
 extern idCVar cv_ai_opt_interleavethinkmaxdist;
 extern idCVar cv_ai_opt_interleavethinkskippvscheck;
 extern idCVar cv_ai_opt_interleavethinkframes;
+extern idCVar cv_ai_opt_perception_budget;
+extern idCVar cv_ai_opt_async_paths;
 extern idCVar cv_ai_opt_update_enemypos_interleave;
 extern idCVar cv_ai_opt_nomind;
 extern idCVar cv_ai_opt_novisualstim;
@@ -118,6 +120,7 @@ extern idCVar cv_sndprop_disable;
 extern idCVar cv_spr_debug;
 extern idCVar cv_spr_show;
 extern idCVar cv_spr_radius_show;
+extern idCVar cv_spr_cache;
 extern idCVar cv_ko_show;
 extern idCVar cv_ai_animstate_show;
 
@@ -494,6 +497,8 @@ extern idCVar	g_muzzleFlash;
 extern idCVar	g_disasm;
 extern idCVar	g_debugBounds;
 extern idCVar	g_debugAnim;
+extern idCVar	g_animPoseCache;
+extern idCVar	g_animDirtyJoints;
 extern idCVar	g_debugMove;
 extern idCVar	g_debugDamage;
 extern idCVar	g_debugWeapon;
@@ -569,6 +574,7 @@ extern idCVar	af_useLinearTime;
 extern idCVar	af_useImpulseFriction;
 extern idCVar	af_useJointImpulseFriction;
 extern idCVar	af_useSymmetry;
+extern idCVar	af_iterativeLCP;
 extern idCVar	af_skipSelfCollision;
 extern idCVar	af_skipLimits;
 extern idCVar	af_skipFriction;
@@ -595,6 +601,7 @@ extern idCVar	af_showInertia;
 extern idCVar	af_showVelocity;
 extern idCVar	af_showActive;
 extern idCVar	af_testSolid;
+extern idCVar	af_islands;
 
 extern idCVar	rb_showTimings;
 extern idCVar	rb_showBodies;
@@ -602,6 +609,9 @@ extern idCVar	rb_showMass;
 extern idCVar	rb_showInertia;
 extern idCVar	rb_showVelocity;
 extern idCVar	rb_showActive;
+extern idCVar	rb_islands;
+extern idCVar	rb_contactCache;
+extern idCVar	rb_stackSleep;
 
 extern idCVar	pm_jumpheight;
 extern idCVar	pm_stepsize;
@@ -686,6 +696,7 @@ extern idCVar	aas_pullPlayer;
 extern idCVar	aas_randomPullPlayer;
 extern idCVar	aas_goalArea;
 extern idCVar	aas_showPushIntoArea;
+extern idCVar	aas_routingCacheFile;
 
 extern idCVar	net_clientPredictGUI;
 
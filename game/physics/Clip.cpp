@@ -588,6 +588,7 @@ idClip::idClip
 */
 idClip::idClip( void ) {
 	worldBounds.Zero();
+	stableOrder = false;
 	numRotations = numTranslations = numMotions = numRenderModelTraces = numContents = numContacts = 0;
 }
 
@@ -664,6 +665,25 @@ void idClip::Shutdown( void ) {
 	}
 }
 
+/*
+================
+ClipModelOrderedBefore
+
+  Total order on clip models that does not depend on the octree layout.
+================
+*/
+static bool ClipModelOrderedBefore( const idClipModel *a, const idClipModel *b ) {
+	int entA = a->GetEntity() ? a->GetEntity()->entityNumber : MAX_GENTITIES;
+	int entB = b->GetEntity() ? b->GetEntity()->entityNumber : MAX_GENTITIES;
+	if ( entA != entB ) {
+		return entA < entB;
+	}
+	if ( a->GetId() != b->GetId() ) {
+		return a->GetId() < b->GetId();
+	}
+	return a < b;
+}
+
 /*
 ================
 idClip::ClipModelsTouchingBounds
@@ -718,6 +738,17 @@ int idClip::ClipModelsTouchingBounds( const idBounds &bounds, int contentMask, i
 		}
 	}
 
+	if ( stableOrder ) {
+		for ( int i = 1; i < clipModelList.Num(); i++ ) {
+			idClipModel *check = clipModelList[i];
+			int j;
+			for ( j = i; j > 0 && ClipModelOrderedBefore( check, clipModelList[j-1] ); j-- ) {
+				clipModelList[j] = clipModelList[j-1];
+			}
+			clipModelList[j] = check;
+		}
+	}
+
 	return clipModelList.Num();
 }
 
@@ -796,7 +827,7 @@ int idClip::ClipModelsTouchingMovingBounds(
 	assert(n == fractionLowers.Num());
 	for (int i = 0; i < n; i++)
 		for (int j = i+1; j < n; j++)
-			if (fractionLowers[i] > fractionLowers[j]) {
+			if (fractionLowers[i] > fractionLowers[j] || (stableOrder && fractionLowers[i] == fractionLowers[j] && ClipModelOrderedBefore(clipModelList[j], clipModelList[i]))) {
 				idSwap(fractionLowers[i], fractionLowers[j]);
 				idSwap(clipModelList[i], clipModelList[j]);
 			}
@@ -1632,6 +1663,15 @@ void idClip::PrintStatistics( void ) {
 	numRotations = numTranslations = numMotions = numRenderModelTraces = numContents = numContacts = 0;
 }
 
+/*
+============
+idClip::GetNumTraces
+============
+*/
+int idClip::GetNumTraces( void ) const {
+	return numTranslations + numRotations + numMotions + numRenderModelTraces + numContents + numContacts;
+}
+
 /*
 ============
 idClip::DrawClipModel
@@ -323,8 +323,14 @@ public:
 	const idBounds &		GetWorldBounds( void ) const;
 	idClipModel *			DefaultClipModel( void );
 
+							// order touched clip models by entity number instead of octree layout,
+							// so that results do not depend on the order other models were linked in
+	void					SetStableOrder( bool enable );
+
 							// stats and debug drawing
 	void					PrintStatistics( void );
+							// number of traces and contents tests since the statistics were last printed
+	int						GetNumTraces( void ) const;
 	void					DrawClipModels( const idVec3 &eye, const float radius, const idEntity *passEntity );
 	bool					DrawModelContactFeature( const contactInfo_t &contact, const idClipModel *clipModel, int lifetime ) const;
 	void					DrawClipModel( const idClipModel *clipModel, const idVec3 &eye, const float radius ) const;
@@ -335,6 +341,7 @@ private:
 	idClipModel				temporaryClipModel;
 	idClipModel				defaultClipModel;
 	mutable int				touchCount;
+	bool					stableOrder;
 							// statistics
 	int						numTranslations;
 	int						numRotations;
@@ -379,4 +386,8 @@ ID_INLINE idClipModel *idClip::DefaultClipModel( void ) {
 	return &defaultClipModel;
 }
 
+ID_INLINE void idClip::SetStableOrder( bool enable ) {
+	stableOrder = enable;
+}
+
 #endif /* !__CLIP_H__ */
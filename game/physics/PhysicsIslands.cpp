@@ -0,0 +1,851 @@
+/*****************************************************************************
+The Dark Mod GPL Source Code
+
+This file is part of the The Dark Mod Source Code, originally based
+on the Doom 3 GPL Source Code as published in 2011.
+
+The Dark Mod Source Code is free software: you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version. For details, see LICENSE.TXT.
+
+Project: The Dark Mod (http://www.thedarkmod.com/)
+
+******************************************************************************/
+
+#include "precompiled.h"
+#pragma hdrstop
+
+
+
+#include "../Game_local.h"
+#include "../Grabber.h"
+#include "PhysicsIslands.h"
+
+idSysMutex idPhysicsIslands::clipMutex;
+
+/*
+================
+PhysicsIslands_Root
+================
+*/
+static int PhysicsIslands_Root( idList<int> &parent, int i ) {
+	while ( parent[i] != i ) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/*
+================
+idPhysicsIslands::Build
+================
+*/
+int idPhysicsIslands::Build( const idList<idBounds> &bounds, int minJobSize, idList<int> &slotOf, idList<int> &jobStart ) {
+	int num = bounds.Num();
+	int i, j;
+
+	slotOf.SetNum( num );
+	jobStart.SetNum( 0 );
+	if ( num == 0 ) {
+		jobStart.Append( 0 );
+		return 0;
+	}
+
+	// join objects with overlapping bounds, sweeping along the x axis
+	idList<int> parent, sorted;
+	parent.SetNum( num );
+	sorted.SetNum( num );
+	for ( i = 0; i < num; i++ ) {
+		parent[i] = i;
+		sorted[i] = i;
+	}
+	std::sort( sorted.begin(), sorted.end(), [&bounds]( int a, int b ) {
+		return bounds[a][0].x < bounds[b][0].x || ( bounds[a][0].x == bounds[b][0].x && a < b );
+	} );
+	for ( i = 0; i < num; i++ ) {
+		const idBounds &bi = bounds[sorted[i]];
+		for ( j = i + 1; j < num && bounds[sorted[j]][0].x <= bi[1].x; j++ ) {
+			if ( bi.IntersectsBounds( bounds[sorted[j]] ) ) {
+				int a = PhysicsIslands_Root( parent, sorted[i] );
+				int b = PhysicsIslands_Root( parent, sorted[j] );
+				parent[Max( a, b )] = Min( a, b );
+			}
+		}
+	}
+
+	// number islands by their first object, keep the objects of an island in their order
+	idList<int> islandOf, islandStart;
+	islandOf.SetNum( num );
+	int numIslands = 0;
+	for ( i = 0; i < num; i++ ) {
+		int root = PhysicsIslands_Root( parent, i );
+		islandOf[i] = ( root == i ) ? numIslands++ : islandOf[root];
+	}
+	islandStart.SetNum( numIslands + 1 );
+	memset( islandStart.Ptr(), 0, islandStart.Num() * sizeof( int ) );
+	for ( i = 0; i < num; i++ ) {
+		islandStart[islandOf[i] + 1]++;
+	}
+	for ( i = 0; i < numIslands; i++ ) {
+		islandStart[i + 1] += islandStart[i];
+	}
+
+	// merge small islands into jobs
+	for ( i = 0; i < numIslands; i++ ) {
+		if ( jobStart.Num() == 0 || islandStart[i] - jobStart[jobStart.Num() - 1] >= minJobSize ) {
+			jobStart.Append( islandStart[i] );
+		}
+	}
+	jobStart.Append( num );
+
+	for ( i = 0; i < num; i++ ) {
+		slotOf[i] = islandStart[islandOf[i]]++;
+	}
+
+	return numIslands;
+}
+
+/*
+================
+idPhysicsIslands::Run
+================
+*/
+void idPhysicsIslands::Run( jobRun_t jobFunc, const char *jobName, void *steps, int stepSize, const idList<int> &jobStart,
+								int timeStepMSec, int endTimeMSec, bool parallel ) {
+	idList<physicsIslandJob_t> jobs;
+	int i;
+
+	jobs.SetNum( jobStart.Num() - 1 );
+	for ( i = 0; i < jobs.Num(); i++ ) {
+		jobs[i].steps = (byte *)steps + jobStart[i] * stepSize;
+		jobs[i].numSteps = jobStart[i + 1] - jobStart[i];
+		jobs[i].timeStepMSec = timeStepMSec;
+		jobs[i].endTimeMSec = endTimeMSec;
+	}
+
+	gameLocal.clip.SetStableOrder( true );
+	if ( parallel && jobs.Num() > 1 ) {
+		RegisterJob( jobFunc, jobName );
+		idParallelJobList *joblist = parallelJobManager->AllocJobList( JOBLIST_UTILITY, JOBLIST_PRIORITY_HIGH, jobs.Num(), 0, nullptr );
+		for ( i = 0; i < jobs.Num(); i++ ) {
+			joblist->AddJob( jobFunc, &jobs[i] );
+		}
+		joblist->Submit( nullptr, JOBLIST_PARALLELISM_REALTIME );
+		joblist->Wait();
+		parallelJobManager->FreeJobList( joblist );
+	} else {
+		for ( i = 0; i < jobs.Num(); i++ ) {
+			jobFunc( &jobs[i] );
+		}
+	}
+	gameLocal.clip.SetStableOrder( false );
+}
+
+
+#include "../tests/testing.h"
+
+// islands by flood fill over all pairs of overlapping bounds
+static int PhysicsIslandsTest_FloodFill( const idList<idBounds> &bounds, idList<int> &islandOf ) {
+	int numIslands = 0;
+	islandOf.SetNum( bounds.Num() );
+	memset( islandOf.Ptr(), -1, islandOf.Num() * sizeof( int ) );
+	for ( int i = 0; i < bounds.Num(); i++ ) {
+		if ( islandOf[i] >= 0 ) {
+			continue;
+		}
+		idList<int> stack;
+		islandOf[i] = numIslands;
+		stack.Append( i );
+		while ( stack.Num() ) {
+			int j = stack[stack.Num() - 1];
+			stack.RemoveIndex( stack.Num() - 1 );
+			for ( int k = 0; k < bounds.Num(); k++ ) {
+				if ( islandOf[k] < 0 && bounds[j].IntersectsBounds( bounds[k] ) ) {
+					islandOf[k] = numIslands;
+					stack.Append( k );
+				}
+			}
+		}
+		numIslands++;
+	}
+	return numIslands;
+}
+
+TEST_CASE("Physics:IslandsBuild") {
+	idRandom rnd( 0x1517 );
+	for ( int attempt = 0; attempt < 20; attempt++ ) {
+		idList<idBounds> bounds;
+		int num = 1 + rnd.RandomInt( 200 );
+		for ( int i = 0; i < num; i++ ) {
+			idVec3 center( rnd.CRandomFloat() * 512.0f, rnd.CRandomFloat() * 512.0f, rnd.CRandomFloat() * 64.0f );
+			bounds.Append( idBounds( center ).Expand( 4.0f + rnd.RandomFloat() * 24.0f ) );
+		}
+		const int minJobSize = 1 + attempt % 8;
+
+		idList<int> islandOf, slotOf, jobStart;
+		int numIslands = PhysicsIslandsTest_FloodFill( bounds, islandOf );
+		REQUIRE( idPhysicsIslands::Build( bounds, minJobSize, slotOf, jobStart ) == numIslands );
+		REQUIRE( slotOf.Num() == num );
+
+		// islands are numbered by their first object, each island is a range of steps in object order
+		idList<int> objectOf;
+		objectOf.SetNum( num );
+		memset( objectOf.Ptr(), -1, num * sizeof( int ) );
+		for ( int i = 0; i < num; i++ ) {
+			REQUIRE( slotOf[i] >= 0 );
+			REQUIRE( slotOf[i] < num );
+			CHECK( objectOf[slotOf[i]] == -1 );
+			objectOf[slotOf[i]] = i;
+		}
+		for ( int s = 1; s < num; s++ ) {
+			int a = objectOf[s - 1], b = objectOf[s];
+			CHECK( ( islandOf[a] == islandOf[b] ? a < b : islandOf[a] + 1 == islandOf[b] ) );
+		}
+
+		// jobs are made of whole islands, only the last one may be smaller than asked for
+		REQUIRE( jobStart.Num() >= 2 );
+		CHECK( jobStart[0] == 0 );
+		CHECK( jobStart[jobStart.Num() - 1] == num );
+		for ( int j = 0; j + 1 < jobStart.Num(); j++ ) {
+			CHECK( jobStart[j] < jobStart[j + 1] );
+			if ( j > 0 ) {
+				CHECK( islandOf[objectOf[jobStart[j] - 1]] != islandOf[objectOf[jobStart[j]]] );
+			}
+			if ( j + 2 < jobStart.Num() ) {
+				CHECK( jobStart[j + 1] - jobStart[j] >= minJobSize );
+			}
+		}
+	}
+}
+
+/*
+	Spheres falling onto the plane z = 0 stand in for physics objects. A sphere only
+	reads the spheres whose bounds overlap its own, which are all in its island, and
+	pushes itself out of them. The steps of an island depend on their order, just like
+	the steps of real bodies.
+*/
+typedef struct {
+	idVec3					origin;
+	idVec3					velocity;
+	float					radius;
+} physicsIslandsTestSphere_t;
+
+typedef struct {
+	physicsIslandsTestSphere_t *sphere;
+	idList<const physicsIslandsTestSphere_t *> touching;
+} physicsIslandsTestStep_t;
+
+static void PhysicsIslandsTest_SphereJob( void *data ) {
+	physicsIslandJob_t *job = (physicsIslandJob_t *)data;
+	physicsIslandsTestStep_t *steps = (physicsIslandsTestStep_t *)job->steps;
+	float timeStep = MS2SEC( job->timeStepMSec );
+
+	for ( int i = 0; i < job->numSteps; i++ ) {
+		physicsIslandsTestSphere_t &sphere = *steps[i].sphere;
+		sphere.velocity.z -= DEFAULT_GRAVITY * timeStep;
+		sphere.origin += sphere.velocity * timeStep;
+		for ( int j = 0; j < steps[i].touching.Num(); j++ ) {
+			const physicsIslandsTestSphere_t &other = *steps[i].touching[j];
+			idVec3 dir = sphere.origin - other.origin;
+			float dist = dir.Normalize();
+			float depth = sphere.radius + other.radius - dist;
+			if ( depth > 0.0f && dist > 0.0f ) {
+				sphere.origin += depth * dir;
+				sphere.velocity -= Min( sphere.velocity * dir, 0.0f ) * dir;
+			}
+		}
+		if ( sphere.origin.z < sphere.radius ) {
+			sphere.origin.z = sphere.radius;
+			sphere.velocity.z = Max( sphere.velocity.z, -0.5f * sphere.velocity.z );
+		}
+	}
+}
+
+static int PhysicsIslandsTest_StepSpheres( idList<physicsIslandsTestSphere_t> &spheres, int numSteps, bool parallel ) {
+	int firstIslands = 0;
+	for ( int step = 0; step < numSteps; step++ ) {
+		float timeStep = MS2SEC( USERCMD_MSEC );
+		idList<idBounds> bounds;
+		for ( int i = 0; i < spheres.Num(); i++ ) {
+			float move = timeStep * ( spheres[i].velocity.Length() + timeStep * DEFAULT_GRAVITY );
+			bounds.Append( idBounds( spheres[i].origin ).Expand( spheres[i].radius + move + 1.0f ) );
+		}
+		idList<int> slotOf, jobStart;
+		int islands = idPhysicsIslands::Build( bounds, 4, slotOf, jobStart );
+		if ( step == 0 ) {
+			firstIslands = islands;
+		}
+
+		idList<physicsIslandsTestStep_t> steps;
+		steps.SetNum( spheres.Num() );
+		for ( int i = 0; i < spheres.Num(); i++ ) {
+			physicsIslandsTestStep_t &s = steps[slotOf[i]];
+			s.sphere = &spheres[i];
+			s.touching.Clear();
+			for ( int j = 0; j < spheres.Num(); j++ ) {
+				if ( j != i && bounds[i].IntersectsBounds( bounds[j] ) ) {
+					s.touching.Append( &spheres[j] );
+				}
+			}
+		}
+		idPhysicsIslands::Run( PhysicsIslandsTest_SphereJob, "physicsIslandsTest", steps.Ptr(), sizeof( physicsIslandsTestStep_t ), jobStart,
+			USERCMD_MSEC, ( step + 1 ) * USERCMD_MSEC, parallel );
+	}
+	return firstIslands;
+}
+
+TEST_CASE("Physics:IslandsDeterministic") {
+	// piles of spheres dropped onto the plane, some piles close enough to merge
+	idList<physicsIslandsTestSphere_t> spheres[2];
+	idRandom rnd( 0x3a7 );
+	for ( int x = 0; x < 6; x++ ) {
+		for ( int y = 0; y < 6; y++ ) {
+			idVec3 pile( x * 48.0f + ( y % 2 ) * 20.0f, y * 48.0f, 0.0f );
+			for ( int z = 0; z < 4; z++ ) {
+				physicsIslandsTestSphere_t &sphere = spheres[0].Alloc();
+				sphere.radius = 6.0f + rnd.RandomFloat() * 4.0f;
+				sphere.origin = pile + idVec3( rnd.CRandomFloat() * 4.0f, rnd.CRandomFloat() * 4.0f, 8.0f + 18.0f * z );
+				sphere.velocity.Set( rnd.CRandomFloat() * 20.0f, rnd.CRandomFloat() * 20.0f, 0.0f );
+			}
+		}
+	}
+	spheres[1] = spheres[0];
+
+	int serialIslands = PhysicsIslandsTest_StepSpheres( spheres[0], 60, false );
+	int parallelIslands = PhysicsIslandsTest_StepSpheres( spheres[1], 60, true );
+
+	CHECK( serialIslands > 1 );
+	CHECK( serialIslands == parallelIslands );
+	CHECK( memcmp( spheres[0].Ptr(), spheres[1].Ptr(), spheres[0].Num() * sizeof( physicsIslandsTestSphere_t ) ) == 0 );
+	for ( int i = 0; i < spheres[0].Num(); i++ ) {
+		CHECK( spheres[0][i].origin.z >= spheres[0][i].radius );
+	}
+}
+
+/*
+	Tests which step real entities in a small test world built without a map: a floor
+	brush with its top at z = 0 and a ceiling brush, so that the world bounds cover the
+	space above the floor. The tests replace the clip world, so they are skipped while
+	a map is loaded.
+*/
+class idPhysicsIslandsTestMap : public idMapFile {
+public:
+	idPhysicsIslandsTestMap( void ) {
+		name = "maps/physicsislandstest";
+		idMapEntity *worldspawn = new idMapEntity;
+		worldspawn->epairs.Set( "classname", "worldspawn" );
+		worldspawn->AddPrimitive( Slab( -16.0f, 0.0f ) );
+		worldspawn->AddPrimitive( Slab( 1024.0f, 1040.0f ) );
+		AddEntity( worldspawn );
+	}
+
+private:
+	// axial brush covering the whole test world between the given heights
+	static idMapBrush *Slab( float bottom, float top ) {
+		const idPlane planes[6] = {
+			idPlane( 0.0f, 0.0f, 1.0f, -top ),
+			idPlane( 0.0f, 0.0f, -1.0f, bottom ),
+			idPlane( 1.0f, 0.0f, 0.0f, -4096.0f ),
+			idPlane( -1.0f, 0.0f, 0.0f, -4096.0f ),
+			idPlane( 0.0f, 1.0f, 0.0f, -4096.0f ),
+			idPlane( 0.0f, -1.0f, 0.0f, -4096.0f )
+		};
+		idMapBrush *brush = new idMapBrush;
+		for ( int i = 0; i < 6; i++ ) {
+			idMapBrushSide *side = new idMapBrushSide;
+			side->SetPlane( planes[i] );
+			side->SetMaterial( "_default" );
+			brush->AddSide( side );
+		}
+		return brush;
+	}
+};
+
+// box without a model, its physics are set up like in idMoveable::Spawn
+class idPhysicsIslandsTestCrate : public idMoveable {
+public:
+	idPhysicsIslandsTestCrate( const idVec3 &origin, float size ) {
+		gameLocal.RegisterEntity( this );
+		name = va( "physicsIslandsTest_%d", entityNumber );
+		spawnArgs.Set( "no_bounce_sound", "1" );
+
+		physicsObj.SetSelf( this );
+		physicsObj.SetClipModel( new idClipModel( idTraceModel( idBounds( vec3_origin ).Expand( 0.5f * size ) ) ), 0.5f );
+		physicsObj.SetOrigin( origin );
+		physicsObj.SetAxis( mat3_identity );
+		physicsObj.SetBouncyness( 0.6f );
+		physicsObj.SetFriction( 0.6f, 0.6f, 0.05f );
+		physicsObj.SetGravity( idVec3( 0.0f, 0.0f, -DEFAULT_GRAVITY ) );
+		physicsObj.SetContents( CONTENTS_SOLID );
+		physicsObj.SetClipMask( MASK_SOLID | CONTENTS_BODY | CONTENTS_CORPSE | CONTENTS_MOVEABLECLIP );
+		SetPhysics( &physicsObj );
+		BecomeActive( TH_PHYSICS );
+	}
+};
+
+/*
+	Test figure: a tilted chain of three boxes joined by ball and socket joints, which
+	tumbles when it lands. The decl is created from text, so no .af file is needed.
+*/
+static const char *physicsIslandsTestAF =
+	"articulatedFigure physicsIslandsTest {\n"
+	"	body \"a\" { joint \"origin\" model box( ( -6, -6, -6 ), ( 6, 6, 6 ) ) origin ( 0, -14, 0 ) }\n"
+	"	body \"b\" { joint \"origin\" model box( ( -6, -6, -6 ), ( 6, 6, 6 ) ) origin ( 0, 0, 4 ) }\n"
+	"	body \"c\" { joint \"origin\" model box( ( -6, -6, -6 ), ( 6, 6, 6 ) ) origin ( 0, 14, 8 ) }\n"
+	"	ballAndSocketJoint \"ab\" { body1 \"a\" body2 \"b\" anchor ( 0, -7, 2 ) }\n"
+	"	ballAndSocketJoint \"bc\" { body1 \"b\" body2 \"c\" anchor ( 0, 7, 6 ) }\n"
+	"}\n";
+
+static const idDeclAF *PhysicsIslandsTest_FigureDecl( void ) {
+	idDeclAF *decl = static_cast<idDeclAF *>( declManager->CreateNewDecl( DECL_AF, "physicsIslandsTest", "af/physicsislandstest.af" ) );
+	decl->SetText( physicsIslandsTestAF );
+	decl->Invalidate();
+	decl->EnsureNotPurged();
+	return decl;
+}
+
+// figure without a model, its physics are set up from the decl like in idAF::Load
+class idPhysicsIslandsTestFigure : public idAFEntity_Base {
+public:
+	idPhysicsIslandsTestFigure( const idDeclAF *file, const idVec3 &origin ) {
+		gameLocal.RegisterEntity( this );
+		name = va( "physicsIslandsTest_%d", entityNumber );
+		spawnArgs.Set( "no_bounce_sound", "1" );
+
+		idPhysics_AF *physicsObj = af.GetPhysics();
+		physicsObj->SetSelf( this );
+		for ( int i = 0; i < file->bodies.Num(); i++ ) {
+			LoadBody( *file->bodies[i], origin );
+		}
+		// the test figure only uses ball and socket joints without limits
+		for ( int i = 0; i < file->constraints.Num(); i++ ) {
+			const idDeclAF_Constraint *fc = file->constraints[i];
+			idAFConstraint_BallAndSocketJoint *c = new idAFConstraint_BallAndSocketJoint( fc->name, physicsObj->GetBody( fc->body1 ), physicsObj->GetBody( fc->body2 ) );
+			c->SetAnchor( origin + fc->anchor.ToVec3() );
+			c->SetFriction( fc->friction );
+			c->SetNoLimit();
+			physicsObj->AddConstraint( c );
+		}
+
+		physicsObj->SetGravity( idVec3( 0.0f, 0.0f, -DEFAULT_GRAVITY ) );
+		physicsObj->SetClipMask( file->clipMask );
+		physicsObj->SetDefaultFriction( file->defaultLinearFriction, file->defaultAngularFriction, file->defaultContactFriction );
+		physicsObj->SetSuspendSpeed( file->suspendVelocity, file->suspendAcceleration );
+		physicsObj->SetSuspendTolerance( file->noMoveTime, file->noMoveTranslation, file->noMoveRotation );
+		physicsObj->SetSuspendTime( file->minMoveTime, file->maxMoveTime );
+		physicsObj->SetSelfCollision( file->selfCollision );
+		physicsObj->UpdateClipModels();
+		SetPhysics( physicsObj );
+		BecomeActive( TH_PHYSICS );
+	}
+
+private:
+	// box body of the decl, see idAF::LoadBody
+	void LoadBody( const idDeclAF_Body &fb, const idVec3 &offset ) {
+		idTraceModel trm( idBounds( fb.v1.ToVec3(), fb.v2.ToVec3() ) );
+		idMat3 axis = fb.angles.ToMat3();
+		idVec3 origin = offset + fb.origin.ToVec3();
+		idVec3 centerOfMass;
+		idMat3 inertiaTensor;
+		float mass;
+
+		trm.GetMassProperties( 1.0f, mass, centerOfMass, inertiaTensor );
+		trm.Translate( -centerOfMass );
+		origin += centerOfMass * axis;
+
+		idClipModel *clip = new idClipModel( trm );
+		clip->SetContents( fb.contents );
+		clip->Link( gameLocal.clip, this, 0, origin, axis );
+		idAFBody *body = new idAFBody( fb.name, clip, fb.density );
+		body->SetFriction( fb.linearFriction, fb.angularFriction, fb.contactFriction );
+		body->SetClipMask( fb.clipMask & ~CONTENTS_MOVEABLECLIP );
+		body->SetSelfCollision( fb.selfCollision );
+		af.GetPhysics()->AddBody( body );
+	}
+};
+
+// loads the test world and removes it together with the added entities when destroyed
+class idPhysicsIslandsTestWorld {
+public:
+	idPhysicsIslandsTestWorld( void ) {
+		idPhysicsIslandsTestMap mapFile;
+		collisionModelManager->LoadMap( &mapFile );
+		fileSystem->RemoveFile( va( "%s.cm", mapFile.GetName() ) );
+		gameLocal.clip.Init();
+
+		world = static_cast<idWorldspawn *>( idWorldspawn::Type.CreateInstance() );
+		world->entityNumber = ENTITYNUM_WORLD;
+		gameLocal.entities[ENTITYNUM_WORLD] = world;
+		gameLocal.world = world;
+
+		// the physics ask the grabber whether a body is held
+		grabber = NULL;
+		if ( !gameLocal.m_Grabber ) {
+			grabber = static_cast<CGrabber *>( CGrabber::Type.CreateInstance() );
+			gameLocal.m_Grabber = grabber;
+		}
+
+		oldTime = gameLocal.time;
+		gameLocal.time = 0;
+	}
+
+	~idPhysicsIslandsTestWorld( void ) {
+		entities.DeleteContents( true );
+		if ( grabber ) {
+			gameLocal.m_Grabber = NULL;
+			delete grabber;
+		}
+		delete world;
+		gameLocal.time = oldTime;
+		gameLocal.clip.Shutdown();
+		collisionModelManager->FreeMap();
+	}
+
+	idEntity *AddCrate( const idVec3 &origin, float size = 16.0f ) {
+		idEntity *ent = new idPhysicsIslandsTestCrate( origin, size );
+		entities.Append( ent );
+		return ent;
+	}
+
+	idEntity *AddFigure( const idDeclAF *file, const idVec3 &origin ) {
+		idEntity *ent = new idPhysicsIslandsTestFigure( file, origin );
+		entities.Append( ent );
+		return ent;
+	}
+
+	// pose of the clip models of all entities
+	void GetPoses( idList<idVec3> &origins, idList<idMat3> &axes ) const {
+		for ( int i = 0; i < entities.Num(); i++ ) {
+			idPhysics *phys = entities[i]->GetPhysics();
+			for ( int j = 0; j < phys->GetNumClipModels(); j++ ) {
+				origins.Append( phys->GetOrigin( j ) );
+				axes.Append( phys->GetAxis( j ) );
+			}
+		}
+	}
+
+	idList<idEntity *>		entities;
+
+private:
+	idWorldspawn *			world;
+	CGrabber *				grabber;
+	int						oldTime;
+};
+
+// piles of crates dropped onto the floor, the piles are far enough apart to form separate islands
+static void PhysicsIslandsTest_DropPiles( idPhysicsIslandsTestWorld &world ) {
+	for ( int x = -2; x < 2; x++ ) {
+		for ( int y = -2; y < 2; y++ ) {
+			idVec3 column( ( x + 0.5f ) * 96.0f, ( y + 0.5f ) * 96.0f, 0.0f );
+			for ( int z = 0; z < 3; z++ ) {
+				idEntity *ent = world.AddCrate( column + idVec3( z * 4.0f, ( x - y ) * z * 0.5f, 12.0f + 20.0f * z ) );
+				ent->GetPhysics()->SetLinearVelocity( idVec3( 0.0f, 0.0f, -50.0f ) );
+			}
+		}
+	}
+}
+
+// steps the entities in islands, returns the number of islands of the first step
+static int PhysicsIslandsTest_Step( const idList<idEntity *> &entities, bool figures, int numSteps, bool parallel ) {
+	int firstIslands = 0;
+	for ( int step = 0; step < numSteps; step++ ) {
+		gameLocal.time += USERCMD_MSEC;
+		int islands = figures ? idPhysics_AF::EvaluateIslands( entities, USERCMD_MSEC, gameLocal.time, parallel ) :
+								idPhysics_RigidBody::EvaluateIslands( entities, USERCMD_MSEC, gameLocal.time, parallel );
+		if ( step == 0 ) {
+			firstIslands = islands;
+		}
+	}
+	return firstIslands;
+}
+
+TEST_CASE("Physics:RigidBodyIslandsDeterministic") {
+	if ( gameLocal.GameState() != GAMESTATE_NOMAP ) {
+		MESSAGE( "Map loaded, test skipped" );
+		return;
+	}
+
+	idList<idVec3> origins[2];
+	idList<idMat3> axes[2];
+	int islands[2];
+	for ( int parallel = 0; parallel < 2; parallel++ ) {
+		idPhysicsIslandsTestWorld world;
+		PhysicsIslandsTest_DropPiles( world );
+		islands[parallel] = PhysicsIslandsTest_Step( world.entities, false, 90, parallel != 0 );
+		world.GetPoses( origins[parallel], axes[parallel] );
+	}
+
+	CHECK( islands[0] > 1 );
+	CHECK( islands[0] == islands[1] );
+	REQUIRE( origins[0].Num() == origins[1].Num() );
+	for ( int i = 0; i < origins[0].Num(); i++ ) {
+		CHECK( memcmp( &origins[0][i], &origins[1][i], sizeof( idVec3 ) ) == 0 );
+		CHECK( memcmp( &axes[0][i], &axes[1][i], sizeof( idMat3 ) ) == 0 );
+		// fell and landed on the floor or another crate
+		CHECK( origins[0][i].z > 7.0f );
+		CHECK( origins[0][i].z < 48.0f );
+	}
+}
+
+// figures dropped on a grid, far enough apart to form separate islands
+static void PhysicsIslandsTest_DropFigures( idPhysicsIslandsTestWorld &world, const idDeclAF *file, int gridSize ) {
+	float spacing = 4.0f * af_maxLinearVelocity.GetFloat() + 128.0f;
+	for ( int x = -gridSize; x <= gridSize; x++ ) {
+		for ( int y = -gridSize; y <= gridSize; y++ ) {
+			world.AddFigure( file, idVec3( x * spacing, y * spacing, 32.0f ) );
+		}
+	}
+}
+
+TEST_CASE("Physics:AFIslandsDeterministic") {
+	if ( gameLocal.GameState() != GAMESTATE_NOMAP ) {
+		MESSAGE( "Map loaded, test skipped" );
+		return;
+	}
+	const idDeclAF *file = PhysicsIslandsTest_FigureDecl();
+	REQUIRE( file->bodies.Num() == 3 );
+	REQUIRE( file->constraints.Num() == 2 );
+
+	idList<idVec3> origins[2];
+	idList<idMat3> axes[2];
+	int islands[2];
+	for ( int parallel = 0; parallel < 2; parallel++ ) {
+		idTestCVar afIslands( af_islands, parallel + 1 );
+		idPhysicsIslandsTestWorld world;
+		PhysicsIslandsTest_DropFigures( world, file, 1 );
+		islands[parallel] = PhysicsIslandsTest_Step( world.entities, true, 60, parallel != 0 );
+		world.GetPoses( origins[parallel], axes[parallel] );
+	}
+
+	CHECK( islands[0] == 9 );
+	CHECK( islands[0] == islands[1] );
+	REQUIRE( origins[0].Num() == origins[1].Num() );
+	for ( int i = 0; i < origins[0].Num(); i++ ) {
+		CHECK( memcmp( &origins[0][i], &origins[1][i], sizeof( idVec3 ) ) == 0 );
+		CHECK( memcmp( &axes[0][i], &axes[1][i], sizeof( idMat3 ) ) == 0 );
+		// fell and landed on the floor
+		CHECK( origins[0][i].z > 4.0f );
+		CHECK( origins[0][i].z < 32.0f );
+	}
+}
+
+TEST_CASE("Physics:AFIslandsForceTiming") {
+	if ( gameLocal.GameState() != GAMESTATE_NOMAP ) {
+		MESSAGE( "Map loaded, test skipped" );
+		return;
+	}
+	const idDeclAF *file = PhysicsIslandsTest_FigureDecl();
+
+	// a force added while the entities think is applied by the next step of an island stepped figure
+	for ( int islands = 0; islands < 2; islands++ ) {
+		idTestCVar afIslands( af_islands, islands );
+		idPhysicsIslandsTestWorld world;
+		// high above the floor, only the force tells the figures apart
+		idPhysics *pushed = world.AddFigure( file, idVec3( -320.0f, 0.0f, 512.0f ) )->GetPhysics();
+		idPhysics *other = world.AddFigure( file, idVec3( 320.0f, 0.0f, 512.0f ) )->GetPhysics();
+		idVec3 lift( 0.0f, 0.0f, 600.0f * pushed->GetMass() );
+
+		float difference[2];
+		for ( int frame = 0; frame < 2; frame++ ) {
+			gameLocal.time += USERCMD_MSEC;
+			int numIslands = idPhysics_AF::EvaluateIslands( world.entities, USERCMD_MSEC, gameLocal.time, false );
+			CHECK( numIslands == ( islands ? 2 : 0 ) );
+			if ( frame == 0 ) {
+				pushed->AddForce( 0, pushed->GetOrigin( 0 ), lift, idForceApplicationId() );
+			}
+			for ( int i = 0; i < world.entities.Num(); i++ ) {
+				world.entities[i]->GetPhysics()->Evaluate( USERCMD_MSEC, gameLocal.time );
+			}
+			difference[frame] = pushed->GetLinearVelocity( 0 ).z - other->GetLinearVelocity( 0 ).z;
+		}
+
+		if ( islands ) {
+			CHECK( idMath::Fabs( difference[0] ) < 0.01f );
+			CHECK( difference[1] > 1.0f );
+		} else {
+			CHECK( difference[0] > 1.0f );
+		}
+	}
+}
+
+TEST_CASE("Physics:AFIslandsPerformance" * doctest::skip()) {
+	if ( gameLocal.GameState() != GAMESTATE_NOMAP ) {
+		MESSAGE( "Map loaded, test skipped" );
+		return;
+	}
+	const idDeclAF *file = PhysicsIslandsTest_FigureDecl();
+
+	for ( int parallel = 0; parallel < 2; parallel++ ) {
+		idTestCVar afIslands( af_islands, parallel + 1 );
+		idPhysicsIslandsTestWorld world;
+		PhysicsIslandsTest_DropFigures( world, file, 3 );
+		double start = Sys_GetClockTicks();
+		PhysicsIslandsTest_Step( world.entities, true, 60, parallel != 0 );
+		double ms = ( Sys_GetClockTicks() - start ) * 1000.0 / Sys_ClockTicksPerSecond();
+		MESSAGE( ( parallel ? "parallel" : "serial" ) << ": " << world.entities.Num() << " figures, " << ms / 60.0 << " ms per step" );
+	}
+}
+
+// stacks of crates on a grid, bottom to top per stack, with a small gap between the crates
+static void PhysicsIslandsTest_BuildStacks( idPhysicsIslandsTestWorld &world, int gridSize, int height ) {
+	for ( int x = -gridSize; x < gridSize; x++ ) {
+		for ( int y = -gridSize; y < gridSize; y++ ) {
+			for ( int z = 0; z < height; z++ ) {
+				world.AddCrate( idVec3( ( x + 0.5f ) * 48.0f, ( y + 0.5f ) * 48.0f, 8.25f + z * 16.5f ) );
+			}
+		}
+	}
+}
+
+// steps the bodies which are not at rest one by one, returns their number
+static int PhysicsIslandsTest_StepAwake( const idList<idEntity *> &bodies ) {
+	int active = 0;
+	gameLocal.time += USERCMD_MSEC;
+	for ( int i = 0; i < bodies.Num(); i++ ) {
+		idPhysics *phys = bodies[i]->GetPhysics();
+		if ( !phys->IsAtRest() ) {
+			phys->Evaluate( USERCMD_MSEC, gameLocal.time );
+			active++;
+		}
+	}
+	return active;
+}
+
+static bool PhysicsIslandsTest_Settle( const idList<idEntity *> &bodies ) {
+	for ( int i = 0; i < 1000; i++ ) {
+		if ( PhysicsIslandsTest_StepAwake( bodies ) == 0 ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+TEST_CASE("Physics:StackWakesOnImpulse") {
+	if ( gameLocal.GameState() != GAMESTATE_NOMAP ) {
+		MESSAGE( "Map loaded, test skipped" );
+		return;
+	}
+
+	for ( int withSleep = 0; withSleep < 2; withSleep++ ) {
+		idTestCVar contactCache( rb_contactCache, true );
+		idTestCVar stackSleep( rb_stackSleep, withSleep != 0 );
+		idPhysicsIslandsTestWorld world;
+		PhysicsIslandsTest_BuildStacks( world, 1, 3 );
+		idList<idEntity *> stack;
+		for ( int i = 0; i < 3; i++ ) {
+			stack.Append( world.entities[i] );
+		}
+		REQUIRE( PhysicsIslandsTest_Settle( world.entities ) );
+		for ( int i = 1; i < 3; i++ ) {
+			CHECK( stack[i]->GetPhysics()->GetOrigin().z > stack[i - 1]->GetPhysics()->GetOrigin().z + 8.0f );
+		}
+
+		// a settled stack stays asleep without tracing anything, every body is evaluated as if it was active
+		int traces = gameLocal.clip.GetNumTraces();
+		for ( int i = 0; i < 30; i++ ) {
+			gameLocal.time += USERCMD_MSEC;
+			for ( int j = 0; j < world.entities.Num(); j++ ) {
+				world.entities[j]->GetPhysics()->Evaluate( USERCMD_MSEC, gameLocal.time );
+			}
+		}
+		for ( int j = 0; j < world.entities.Num(); j++ ) {
+			CHECK( world.entities[j]->GetPhysics()->IsAtRest() );
+		}
+		CHECK( gameLocal.clip.GetNumTraces() == traces );
+
+		// knock the bottom body away, everything above it has to follow
+		idPhysics *bottom = stack[0]->GetPhysics();
+		stack[0]->ApplyImpulse( gameLocal.world, 0, bottom->GetOrigin(), idVec3( 300.0f * bottom->GetMass(), 0.0f, 0.0f ) );
+		CHECK( !bottom->IsAtRest() );
+
+		bool woke[3] = { true, false, false };
+		for ( int i = 0; i < 60; i++ ) {
+			PhysicsIslandsTest_StepAwake( world.entities );
+			for ( int j = 1; j < 3; j++ ) {
+				woke[j] |= !stack[j]->GetPhysics()->IsAtRest();
+			}
+		}
+		CHECK( woke[1] );
+		CHECK( woke[2] );
+	}
+}
+
+TEST_CASE("Physics:ContactCacheMatchesTrace") {
+	if ( gameLocal.GameState() != GAMESTATE_NOMAP ) {
+		MESSAGE( "Map loaded, test skipped" );
+		return;
+	}
+
+	idTestCVar contactCache( rb_contactCache, false );
+	idTestCVar stackSleep( rb_stackSleep, false );
+	idPhysicsIslandsTestWorld world;
+	idEntity *crate = world.AddCrate( idVec3( 0.0f, 0.0f, 8.25f ) );
+	REQUIRE( PhysicsIslandsTest_Settle( world.entities ) );
+
+	idPhysics *phys = crate->GetPhysics();
+	idList<contactInfo_t> traced;
+	crate->ApplyImpulse( gameLocal.world, 0, phys->GetOrigin(), vec3_origin );
+	phys->EvaluateContacts();
+	for ( int i = 0; i < phys->GetNumContacts(); i++ ) {
+		traced.Append( phys->GetContact( i ) );
+	}
+	REQUIRE( traced.Num() > 0 );
+
+	// without moving, the cached contacts must be reused until the cache runs out and must match the trace
+	rb_contactCache.SetBool( true );
+	int reused = 0;
+	for ( int i = 0; i < 8; i++ ) {
+		int traces = gameLocal.clip.GetNumTraces();
+		phys->EvaluateContacts();
+		if ( gameLocal.clip.GetNumTraces() == traces ) {
+			reused++;
+		}
+		REQUIRE( phys->GetNumContacts() == traced.Num() );
+		for ( int j = 0; j < traced.Num(); j++ ) {
+			const contactInfo_t &contact = phys->GetContact( j );
+			CHECK( traced[j].entityNum == contact.entityNum );
+			CHECK( traced[j].point.Compare( contact.point, 0.01f ) );
+			CHECK( traced[j].normal.Compare( contact.normal, 0.001f ) );
+		}
+	}
+	CHECK( reused > 0 );
+
+	// lifting the body off the floor must not reuse the floor contacts
+	phys->Translate( idVec3( 0.0f, 0.0f, 8.0f ) );
+	int traces = gameLocal.clip.GetNumTraces();
+	phys->EvaluateContacts();
+	CHECK( gameLocal.clip.GetNumTraces() > traces );
+	CHECK( phys->GetNumContacts() == 0 );
+}
+
+TEST_CASE("Physics:StackSettlePerformance"
+	* doctest::skip()
+) {
+	if ( gameLocal.GameState() != GAMESTATE_NOMAP ) {
+		MESSAGE( "Map loaded, test skipped" );
+		return;
+	}
+
+	for ( int enabled = 0; enabled < 2; enabled++ ) {
+		idTestCVar contactCache( rb_contactCache, enabled != 0 );
+		idTestCVar stackSleep( rb_stackSleep, enabled != 0 );
+		idPhysicsIslandsTestWorld world;
+		PhysicsIslandsTest_BuildStacks( world, 4, 5 );
+
+		int steps = 0, bodySteps = 0;
+		int traces = gameLocal.clip.GetNumTraces();
+		double start = Sys_GetClockTicks();
+		for ( ; steps < 1000; steps++ ) {
+			int active = PhysicsIslandsTest_StepAwake( world.entities );
+			if ( active == 0 ) {
+				break;
+			}
+			bodySteps += active;
+		}
+		double ms = ( Sys_GetClockTicks() - start ) * 1000.0 / Sys_ClockTicksPerSecond();
+		MESSAGE( ( enabled ? "cached" : "traced" ) << ": " << world.entities.Num() << " crates settled after " << steps << " steps, "
+			<< bodySteps << " body steps, " << gameLocal.clip.GetNumTraces() - traces << " traces, " << ms << " ms" );
+	}
+}
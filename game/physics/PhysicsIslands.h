@@ -0,0 +1,57 @@
+/*****************************************************************************
+The Dark Mod GPL Source Code
+
+This file is part of the The Dark Mod Source Code, originally based
+on the Doom 3 GPL Source Code as published in 2011.
+
+The Dark Mod Source Code is free software: you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version. For details, see LICENSE.TXT.
+
+Project: The Dark Mod (http://www.thedarkmod.com/)
+
+******************************************************************************/
+
+#ifndef __PHYSICS_ISLANDS_H__
+#define __PHYSICS_ISLANDS_H__
+
+/*
+===============================================================================
+
+	Physics islands
+
+	Physics objects whose bounds for the next step do not overlap cannot touch each
+	other during that step. Objects with overlapping bounds are joined into islands,
+	and small islands are merged into jobs. Jobs can be stepped in parallel, while
+	the objects of an island are always stepped one by one in their original order,
+	so the result does not depend on the number of threads.
+
+	The steps of the objects are kept in one array, island by island. A job steps
+	a contiguous range of that array.
+
+===============================================================================
+*/
+
+typedef struct physicsIslandJob_s {
+	void *					steps;				// first step of the job
+	int						numSteps;
+	int						timeStepMSec;
+	int						endTimeMSec;
+} physicsIslandJob_t;
+
+class idPhysicsIslands {
+public:
+							// Joins objects with overlapping bounds into islands, returns the number of islands.
+							// slotOf[i] is the index of the step of object i, jobStart[j] the index of the first
+							// step of job j, with an extra entry for the end of the last job.
+	static int				Build( const idList<idBounds> &bounds, int minJobSize, idList<int> &slotOf, idList<int> &jobStart );
+							// Runs jobFunc for every job, in parallel jobs if requested.
+							// The clip world keeps a stable order of clip models while the jobs run.
+	static void				Run( jobRun_t jobFunc, const char *jobName, void *steps, int stepSize, const idList<int> &jobStart,
+								int timeStepMSec, int endTimeMSec, bool parallel );
+
+	static idSysMutex		clipMutex;			// serializes clip world access of island jobs
+};
+
+#endif /* !__PHYSICS_ISLANDS_H__ */
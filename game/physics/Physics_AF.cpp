@@ -20,6 +20,7 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 
 #include "../Game_local.h"
 #include "../Grabber.h"
+#include "PhysicsIslands.h"
 
 CLASS_DECLARATION( idPhysics_Base, idPhysics_AF )
 END_CLASS
@@ -31,6 +32,7 @@ const float LCP_EPSILON						= 1e-7f;
 const float LIMIT_LCP_EPSILON				= 1e-4f;
 const float CONTACT_LCP_EPSILON				= 1e-6f;
 const float CENTER_OF_MASS_EPSILON			= 1e-2f;
+const float WARM_START_CONTACT_EPSILON		= 1.0f;
 #ifdef MOD_WATERPHYSICS
 const float NO_MOVE_TIME					= 2.0f;
 // ishtvan test: move impulse threshold back to D3 default or below
@@ -61,11 +63,48 @@ static const float MAX_GRABBER_EXT_ANGVEL		= 5.0f;
 #define AF_TIMINGS
 
 #ifdef AF_TIMINGS
-static int lastTimerReset = 0;
-static int numArticulatedFigures = 0;
-static idTimer timer_total, timer_pc, timer_ac, timer_collision, timer_lcp;
+// per thread, figures stepped in island jobs must not share timers
+static thread_local int lastTimerReset = 0;
+static thread_local int numArticulatedFigures = 0;
+static thread_local idTimer timer_total, timer_pc, timer_ac, timer_collision, timer_lcp;
 #endif
 
+/*
+	Island stepping
+
+	Figures stepped in an island job only change their own state and the clip world.
+	Impacts, collision sounds and stims, contact links, coming to rest and the like are
+	recorded as events of the step, and replayed on the main thread once all islands are done.
+	Clip world queries from the jobs are serialized, the collision model manager is not thread-safe.
+*/
+typedef enum {
+	AFISLAND_CONTACTS,				// contact entity links of the old and new contacts
+	AFISLAND_COLLISION,				// impulse for the entity collided with and Collide callback
+	AFISLAND_REST,					// entity side of coming to rest
+	AFISLAND_ACTIVATE_CONTACTS,		// activation of contact entities
+	AFISLAND_OUTSIDE_WORLD,			// warning about leaving the world bounds
+	AFISLAND_DEBUG_DRAW
+} AFIslandEvent_t;
+
+typedef struct AFIslandCollision_s {
+	trace_t					trace;
+	idVec3					velocity;			// relative velocity at the collision point
+	idVec3					impulse;			// impulse for the entity collided with
+} AFIslandCollision_t;
+
+typedef struct AFIslandStep_s {
+	idEntityPtr<idEntity>	owner;				// entity of the figure
+	idPhysics_AF *			physics;
+	bool					moved;				// result of Evaluate
+	idList<AFIslandEvent_t>	events;				// in the order they happened
+	idList<AFIslandCollision_t> collisions;		// one for each AFISLAND_COLLISION event
+	idList<int>				oldContacts;		// entity numbers of the contacts replaced
+} AFIslandStep_t;
+
+static const int	AF_ISLAND_JOB_MIN_FIGURES = 2;		// islands are merged into jobs of at least this many figures
+static const float	AF_ISLAND_CONTACT_EPSILON = 2.0f;	// contact search distance of EvaluateContacts
+static const float	AF_ISLAND_BOUNDS_MARGIN = 1.0f;		// added to the bounds a figure can reach during a step
+
 
 
 //===============================================================
@@ -5368,12 +5407,24 @@ void idPhysics_AF::AuxiliaryForces( float timeStep ) {
 		}
 	}
 
+	// large constraint sets use the iterative solver warm started with the multipliers of the previous frame
+	idLCP *solver = lcp;
+	if ( af_iterativeLCP.GetInteger() > 0 && numAuxConstraints >= af_iterativeLCP.GetInteger() ) {
+		for ( k = 0, i = 0; i < auxiliaryConstraints.Num(); i++ ) {
+			constraint = auxiliaryConstraints[i];
+			for ( j = 0; j < constraint->J1.GetNumRows(); j++, k++ ) {
+				lm[k] = constraint->lm[j];
+			}
+		}
+		solver = iterativeLcp;
+	}
+
 #ifdef AF_TIMINGS
 	timer_lcp.Start();
 #endif
 
 	// calculate lagrange multipliers for auxiliary constraints
-	if ( !lcp->Solve( jmk, lm, rhs, lo, hi, boxIndex ) ) {
+	if ( !solver->Solve( jmk, lm, rhs, lo, hi, boxIndex ) ) {
 		return;		// bad monkey!
 	}
 
@@ -5593,28 +5644,8 @@ bool idPhysics_AF::CollisionImpulse( float timeStep, idAFBody *body, trace_t &co
 	ent->GetImpactInfo( self, collision.c.id, collision.c.point, &info );
 
 	// Update moved by and set in motion by actor
-	if ( self->m_SetInMotionByActor.GetEntity() && !ent->m_droppedByAI ) // grayman #3075 - don't pass these settings along if dropped by an AI
-	{
-		ent->m_SetInMotionByActor = self->m_SetInMotionByActor.GetEntity();
-		ent->m_MovedByActor = self->m_MovedByActor.GetEntity();
-	}
-
-	// Note: Actors should not overwrite the moved by other actors when they are hit with something
-	// So only overwrite if MovedByActor is NULL
-	if ( ent->IsType(idActor::Type) 
-		&& self->m_SetInMotionByActor.GetEntity() == NULL
-		&& !(static_cast<idActor *>(ent)->IsKnockedOut() || ent->health < 0) )
-	{
-		self->m_SetInMotionByActor = (idActor *) ent;
-		self->m_MovedByActor = (idActor *) ent;
-	}
-
-	if ( self->IsType(idActor::Type) 
-		&& ent->m_SetInMotionByActor.GetEntity() == NULL
-		&& !(static_cast<idActor *>(self)->IsKnockedOut() || self->health < 0) )
-	{
-		ent->m_SetInMotionByActor = (idActor *) self;
-		ent->m_MovedByActor = (idActor *) self;
+	if ( !islandStep ) {
+		CollisionSetInMotion( ent );
 	}
 
 	// collision point relative to the body center of mass
@@ -5641,6 +5672,16 @@ bool idPhysics_AF::CollisionImpulse( float timeStep, idAFBody *body, trace_t &co
 	}
 	impulse = (impulseNumerator / impulseDenominator) * collision.c.normal;
 
+	if ( islandStep ) {
+		// idAFEntity_Base::Collide never stops the figure, so the callback can wait for the commit
+		AFIslandCollision_t &c = islandStep->collisions.Alloc();
+		c.trace = collision;
+		c.velocity = velocity;
+		c.impulse = impulse;
+		islandStep->events.Append( AFISLAND_COLLISION );
+		return false;
+	}
+
 	// apply impact to other entity
 	ent->ApplyImpulse( self, collision.c.id, collision.c.point, -impulse );
 
@@ -5648,6 +5689,37 @@ bool idPhysics_AF::CollisionImpulse( float timeStep, idAFBody *body, trace_t &co
 	return self->Collide( collision, velocity );
 }
 
+/*
+================
+idPhysics_AF::CollisionSetInMotion
+================
+*/
+void idPhysics_AF::CollisionSetInMotion( idEntity *ent ) {
+	if ( self->m_SetInMotionByActor.GetEntity() && !ent->m_droppedByAI ) // grayman #3075 - don't pass these settings along if dropped by an AI
+	{
+		ent->m_SetInMotionByActor = self->m_SetInMotionByActor.GetEntity();
+		ent->m_MovedByActor = self->m_MovedByActor.GetEntity();
+	}
+
+	// Note: Actors should not overwrite the moved by other actors when they are hit with something
+	// So only overwrite if MovedByActor is NULL
+	if ( ent->IsType(idActor::Type) 
+		&& self->m_SetInMotionByActor.GetEntity() == NULL
+		&& !(static_cast<idActor *>(ent)->IsKnockedOut() || ent->health < 0) )
+	{
+		self->m_SetInMotionByActor = (idActor *) ent;
+		self->m_MovedByActor = (idActor *) ent;
+	}
+
+	if ( self->IsType(idActor::Type) 
+		&& ent->m_SetInMotionByActor.GetEntity() == NULL
+		&& !(static_cast<idActor *>(self)->IsKnockedOut() || self->health < 0) )
+	{
+		ent->m_SetInMotionByActor = (idActor *) self;
+		ent->m_MovedByActor = (idActor *) self;
+	}
+}
+
 /*
 ================
 idPhysics_AF::ApplyCollisions
@@ -5760,6 +5832,11 @@ void idPhysics_AF::CheckForCollisions( float timeStep ) {
 		return;
 	}
 
+	idScopedCriticalSection lock;
+	if ( islandStep ) {
+		lock.Lock( idPhysicsIslands::clipMutex );
+	}
+
 	for ( i = 0; i < bodies.Num(); i++ ) {
 		body = bodies[i];
 
@@ -5846,7 +5923,17 @@ bool idPhysics_AF::EvaluateContacts( void ) {
 	EvaluateBodies( current.lastTimeStep );
 
 	// remove all existing contacts
-	ClearContacts();
+	if ( islandStep ) {
+		// contact entities are updated when the island is committed
+		islandStep->oldContacts.SetNum( contacts.Num() );
+		for ( i = 0; i < contacts.Num(); i++ ) {
+			islandStep->oldContacts[i] = contacts[i].entityNum;
+		}
+		islandStep->events.Append( AFISLAND_CONTACTS );
+		contacts.SetNum( 0, false );
+	} else {
+		ClearContacts();
+	}
 
 	contactBodies.SetNum( 0, false );
 
@@ -5854,6 +5941,11 @@ bool idPhysics_AF::EvaluateContacts( void ) {
 		return false;
 	}
 
+	idScopedCriticalSection lock;
+	if ( islandStep ) {
+		lock.Lock( idPhysicsIslands::clipMutex );
+	}
+
 	// find all the contacts
 	for ( i = 0; i < bodies.Num(); i++ ) {
 		body = bodies[i];
@@ -5911,7 +6003,9 @@ bool idPhysics_AF::EvaluateContacts( void ) {
 
 	}
 
-	AddContactEntitiesForContacts();
+	if ( !islandStep ) {
+		AddContactEntitiesForContacts();
+	}
 
 	return ( contacts.Num() != 0 );
 }
@@ -5930,6 +6024,13 @@ void idPhysics_AF::SetupContactConstraints( void ) {
 
 	// setup contact constraints
 	for ( i = 0; i < contacts.Num(); i++ ) {
+		// keep the multiplier of the previous frame as a warm start only if the contact persisted
+		const idAFConstraint_Contact *old = contactConstraints[i];
+		if ( old->body1 != bodies[contactBodies[i]] || old->GetContact().entityNum != contacts[i].entityNum ||
+				( old->GetContact().point - contacts[i].point ).LengthSqr() > Square( WARM_START_CONTACT_EPSILON ) ) {
+			contactConstraints[i]->lm.Zero();
+		}
+
 		// add contact constraint
 		contactConstraints[i]->physics = this;
 		if ( contacts[i].entityNum == self->entityNumber ) {
@@ -5979,8 +6080,17 @@ void idPhysics_AF::AddGravity( void ) {
 	idVec3 grav( this->liquidDensity * this->gravityVector );
 	float waterLevel,wDensity = 0;
 	bool inWater,bodyBuoyancy = 0;
+	float waterLevelf;
+
+	{
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
+		waterLevelf = this->SetWaterLevelf();
+	}
 
-	if( this->SetWaterLevelf() == 1.0f ) {
+	if( waterLevelf == 1.0f ) {
 		wDensity = this->water->GetDensity();
 		bodyBuoyancy = af_useBodyDensityBuoyancy.GetBool();
 	}
@@ -6283,6 +6393,22 @@ void idPhysics_AF::Rest( void ) {
 		bodies[i]->current->externalForce.Zero();
 	}
 
+	if ( islandStep ) {
+		// the entity is deactivated when it runs its physics, see Evaluate
+		islandStep->events.Append( AFISLAND_REST );
+		return;
+	}
+
+	self->BecomeInactive( TH_PHYSICS );
+	RestEntity();
+}
+
+/*
+================
+idPhysics_AF::RestEntity
+================
+*/
+void idPhysics_AF::RestEntity( void ) {
 	// grayman #4609 - AF has come to rest. If this is at mission start,
 	// set nextSoundTime so it becomes okay for him to
 	// make suspicious propagated sounds from this time forward.
@@ -6293,7 +6419,6 @@ void idPhysics_AF::Rest( void ) {
 		af->nextSoundTime = gameLocal.time;
 	}
 
-	self->BecomeInactive( TH_PHYSICS );
 	self->m_SetInMotionByActor = NULL;
 	//self->m_droppedByAI = false; // grayman #1330 // grayman #3075 - keep the designation for use while resting
 	
@@ -6484,7 +6609,7 @@ idPhysics_AF::GetBounds
 */
 const idBounds &idPhysics_AF::GetBounds( int id ) const {
 	int i;
-	static idBounds relBounds;
+	thread_local static idBounds relBounds;
 
 	if ( id >= 0 && id < bodies.Num() ) {
 		return bodies[id]->GetClipModel()->GetBounds();
@@ -6513,7 +6638,7 @@ idPhysics_AF::GetAbsBounds
 */
 const idBounds &idPhysics_AF::GetAbsBounds( int id ) const {
 	int i;
-	static idBounds absBounds;
+	thread_local static idBounds absBounds;
 
 	if ( id >= 0 && id < bodies.Num() ) {
 		return bodies[id]->GetClipModel()->GetAbsBounds();
@@ -6540,6 +6665,15 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 {
 	float timeStep;
 
+	// already stepped with its island this frame, see EvaluateIslands
+	if ( islandStepTime == endTimeMSec ) {
+		islandStepTime = -1;
+		if ( current.atRest >= 0 ) {
+			self->BecomeInactive( TH_PHYSICS );
+		}
+		return islandStepMoved;
+	}
+
 	if ( timeScaleRampStart < MS2SEC( endTimeMSec ) && timeScaleRampEnd > MS2SEC( endTimeMSec ) ) {
 		timeStep = MS2SEC( timeStepMSec ) * ( MS2SEC( endTimeMSec ) - timeScaleRampStart ) / ( timeScaleRampEnd - timeScaleRampStart );
 	} else if ( af_timeScale.GetFloat() != 1.0f ) {
@@ -6585,7 +6719,11 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 
 	// if the simulation is suspended because the figure is at rest
 	if ( current.atRest >= 0 || timeStep <= 0.0f ) {
-		DebugDraw();
+		if ( islandStep ) {
+			islandStep->events.Append( AFISLAND_DEBUG_DRAW );
+		} else {
+			DebugDraw();
+		}
 		return false;
 	}
 
@@ -6600,6 +6738,10 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 
 	if( ((idAFEntity_Base *) self )->CollidesWithTeam() )
 	{
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
 		for ( part = self->GetTeamMaster(); part != NULL; part = part->GetNextTeamEntity() ) 
 		{
 			if ( part != self && part->GetPhysics() ) 
@@ -6672,7 +6814,11 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 	Evolve( timeStep );
 
 	// debug graphics
-	DebugDraw();
+	if ( islandStep ) {
+		islandStep->events.Append( AFISLAND_DEBUG_DRAW );
+	} else {
+		DebugDraw();
+	}
 
 	// clear external forces on all bodies
 	for ( int i = 0; i < bodies.Num(); i++ ) {
@@ -6708,6 +6854,10 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 
 	// make sure all clip models are disabled in case they were enabled for self collision
 	if ( selfCollision && !af_skipSelfCollision.GetBool() ) {
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
 		DisableClip();
 	}
 
@@ -6720,6 +6870,8 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 	// test if the simulation can be suspended because the whole figure is at rest
 	if ( comeToRest && TestIfAtRest( timeStep ) ) {
 		Rest();
+	} else if ( islandStep ) {
+		islandStep->events.Append( AFISLAND_ACTIVATE_CONTACTS );
 	} else {
 		ActivateContactEntities();
 	}
@@ -6732,8 +6884,12 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 	current.pushVelocity.Zero();
 
 	if ( IsOutsideWorld() ) {
-		gameLocal.Warning( "articulated figure moved outside world bounds for entity '%s' type '%s' at (%s)",
-							self->name.c_str(), self->GetType()->classname, bodies[0]->current->worldOrigin.ToString(0) );
+		if ( islandStep ) {
+			islandStep->events.Append( AFISLAND_OUTSIDE_WORLD );
+		} else {
+			gameLocal.Warning( "articulated figure moved outside world bounds for entity '%s' type '%s' at (%s)",
+								self->name.c_str(), self->GetType()->classname, bodies[0]->current->worldOrigin.ToString(0) );
+		}
 		Rest();
 	}
 
@@ -6777,6 +6933,10 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 
 	if( ((idAFEntity_Base *) self )->CollidesWithTeam() )
 	{
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
 		for ( part = self->GetTeamMaster(); part != NULL; part = part->GetNextTeamEntity() )  
 		{
 			if ( part != self && part->GetPhysics() ) 
@@ -6792,6 +6952,282 @@ bool idPhysics_AF::Evaluate( int timeStepMSec, int endTimeMSec )
 	return true;
 }
 
+/*
+================
+AF_IslandReadOnly
+
+  True if island jobs can collide with the entity: they only ask it for impact info.
+================
+*/
+static bool AF_IslandReadOnly( idEntity *ent ) {
+	if ( ent == NULL || ent == gameLocal.world ) {
+		return true;
+	}
+	if ( ent->IsType( idAFAttachment::Type ) ) {
+		return false;
+	}
+	// figures driven by animation set up their pose when asked for impact info, ragdolls do not
+	if ( ent->IsType( idAFEntity_Base::Type ) ) {
+		return ent->GetPhysics()->IsType( idPhysics_AF::Type );
+	}
+	const idTypeInfo *type = ent->GetPhysics()->GetType();
+	return ( type == &idPhysics_Static::Type || type == &idPhysics_StaticMulti::Type || type == &idPhysics_RigidBody::Type );
+}
+
+/*
+================
+idPhysics_AF::CanEvaluateInIsland
+================
+*/
+bool idPhysics_AF::CanEvaluateInIsland( void ) const {
+	// the player overrides Collide, bound figures read their master while evaluated
+	if ( !self || self->GetPhysics() != this || !self->IsType( idAFEntity_Base::Type ) || self->IsType( idPlayer::Type ) ) {
+		return false;
+	}
+	if ( !( self->thinkFlags & TH_PHYSICS ) || ( self->GetTeamMaster() && self->GetTeamMaster() != self ) || self == gameLocal.m_Grabber->GetSelected() ) {
+		return false;
+	}
+	if ( masterBody || current.atRest >= 0 || bodies.Num() == 0 ) {
+		return false;
+	}
+#ifdef MOD_WATERPHYSICS
+	if ( water ) {
+		return false;
+	}
+#endif
+	// the island bounds rely on the velocity cap, the timers are shared
+	if ( af_maxLinearVelocity.GetFloat() <= 0.0f || af_showTimings.GetBool() ) {
+		return false;
+	}
+	// suspensions trace the world while the constraints are evaluated
+	for ( int i = 0; i < constraints.Num(); i++ ) {
+		if ( constraints[i]->GetType() == CONSTRAINT_SUSPENSION ) {
+			return false;
+		}
+	}
+	for ( int i = 0; i < bodies.Num(); i++ ) {
+		if ( !bodies[i]->clipModel->IsLinked() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+================
+idPhysics_AF::GetIslandBounds
+
+  Bounds of everything the figure can touch during the next step.
+================
+*/
+idBounds idPhysics_AF::GetIslandBounds( void ) const {
+	// whatever the constraint forces, Evolve caps the distance a body moves in a step
+	float reach = 2.0f * af_maxLinearVelocity.GetFloat() + AF_ISLAND_CONTACT_EPSILON + AF_ISLAND_BOUNDS_MARGIN;
+	idBounds bounds, b;
+
+	bounds.Clear();
+	for ( int i = 0; i < bodies.Num(); i++ ) {
+		// bodies rotate around their origin
+		b = idBounds( bodies[i]->current->worldOrigin );
+		b.ExpandSelf( bodies[i]->clipModel->GetBounds().GetRadius() + reach );
+		bounds += b;
+	}
+	// liquids are looked for in the bounds of the whole figure
+	b = GetBounds() + GetOrigin();
+	b.ExpandSelf( reach );
+	bounds += b;
+	return bounds;
+}
+
+/*
+================
+idPhysics_AF::CommitIslandStep
+
+  Replays the side effects recorded by an island step.
+================
+*/
+void idPhysics_AF::CommitIslandStep( const AFIslandStep_t &step ) {
+	idEntity *ent;
+	int numCollisions = 0;
+
+	for ( int i = 0; i < step.events.Num(); i++ ) {
+		switch ( step.events[i] ) {
+			case AFISLAND_CONTACTS:
+				for ( int j = 0; j < step.oldContacts.Num(); j++ ) {
+					ent = gameLocal.entities[step.oldContacts[j]];
+					if ( ent ) {
+						ent->RemoveContactEntity( self );
+					}
+				}
+				AddContactEntitiesForContacts();
+				break;
+			case AFISLAND_COLLISION: {
+				const AFIslandCollision_t &c = step.collisions[numCollisions++];
+				ent = gameLocal.entities[c.trace.c.entityNum];
+				if ( ent ) {
+					CollisionSetInMotion( ent );
+					ent->ApplyImpulse( self, c.trace.c.id, c.trace.c.point, -c.impulse );
+				}
+				self->Collide( c.trace, c.velocity );
+				break;
+			}
+			case AFISLAND_REST:
+				RestEntity();
+				break;
+			case AFISLAND_ACTIVATE_CONTACTS:
+				ActivateContactEntities();
+				break;
+			case AFISLAND_OUTSIDE_WORLD:
+				gameLocal.Warning( "articulated figure moved outside world bounds for entity '%s' type '%s' at (%s)",
+									self->name.c_str(), self->GetType()->classname, bodies[0]->current->worldOrigin.ToString(0) );
+				break;
+			case AFISLAND_DEBUG_DRAW:
+				DebugDraw();
+				break;
+		}
+	}
+}
+
+/*
+================
+idPhysics_AF::EvaluateIslandJob
+================
+*/
+void idPhysics_AF::EvaluateIslandJob( void *data ) {
+	physicsIslandJob_t *job = (physicsIslandJob_t *)data;
+	AFIslandStep_t *steps = (AFIslandStep_t *)job->steps;
+	idEntity *part;
+
+	for ( int i = 0; i < job->numSteps; i++ ) {
+		AFIslandStep_t &step = steps[i];
+		idPhysics_AF *physics = step.physics;
+
+		// team handling of idEntity::RunPhysics
+		idPhysicsIslands::clipMutex.Lock();
+		for ( part = physics->self; part != NULL; part = part->GetNextTeamEntity() ) {
+			if ( !part->fl.solidForTeam ) {
+				part->GetPhysics()->DisableClip();
+			}
+		}
+		idPhysicsIslands::clipMutex.Unlock();
+
+		physics->islandStep = &step;
+		physics->islandStepTime = -1;
+		step.moved = physics->Evaluate( job->timeStepMSec, job->endTimeMSec );
+		physics->islandStep = NULL;
+
+		idPhysicsIslands::clipMutex.Lock();
+		for ( part = physics->self; part != NULL; part = part->GetNextTeamEntity() ) {
+			part->GetPhysics()->EnableClip();
+		}
+		idPhysicsIslands::clipMutex.Unlock();
+	}
+}
+
+/*
+================
+idPhysics_AF::EvaluateIslands
+================
+*/
+int idPhysics_AF::EvaluateIslands( const idList<idEntity *> &entities, int timeStepMSec, int endTimeMSec, bool parallel ) {
+	idList<idPhysics_AF *> figures;
+	idList<idBounds> bounds;
+	idList<int> figureOfEntity;
+	idClip_ClipModelList clipModels;
+	int i, j;
+
+	// stepping ahead of think delays the forces added during think, only do it when asked for
+	if ( af_islands.GetInteger() <= 0 || timeStepMSec <= 0 ) {
+		return 0;
+	}
+
+	figureOfEntity.SetNum( MAX_GENTITIES );
+	memset( figureOfEntity.Ptr(), -1, MAX_GENTITIES * sizeof( int ) );
+
+	for ( i = 0; i < entities.Num(); i++ ) {
+		idPhysics *physics = entities[i]->GetPhysics();
+		if ( physics->GetType() != &idPhysics_AF::Type ) {
+			continue;
+		}
+		idPhysics_AF *figure = static_cast<idPhysics_AF *>( physics );
+		if ( !figure->CanEvaluateInIsland() ) {
+			continue;
+		}
+		figureOfEntity[entities[i]->entityNumber] = figures.Num();
+		figures.Append( figure );
+		bounds.Append( figure->GetIslandBounds() );
+	}
+
+	// figures which may touch anything that is not read-only for the jobs run their physics as usual
+	int numFigures = 0;
+	for ( i = 0; i < figures.Num(); i++ ) {
+		idPhysics_AF *figure = figures[i];
+		idEntity *self = figure->self;
+		bool collideWithTeam = static_cast<idAFEntity_Base *>( self )->CollidesWithTeam();
+		int contentMask = 0;
+		for ( j = 0; j < figure->bodies.Num(); j++ ) {
+			contentMask |= figure->bodies[j]->clipMask;
+		}
+#ifdef MOD_WATERPHYSICS
+		contentMask |= MASK_WATER;
+#endif
+		gameLocal.clip.ClipModelsTouchingBounds( bounds[i], contentMask, clipModels );
+		for ( j = 0; j < clipModels.Num(); j++ ) {
+			idEntity *owner = clipModels[j]->GetEntity();
+			if ( owner == self || ( owner && figureOfEntity[owner->entityNumber] >= 0 ) ) {
+				continue;
+			}
+			if ( AF_IslandReadOnly( owner ) ) {
+				continue;
+			}
+			// team mates are either disabled during the step, or attachments asking the figure for impact info
+			if ( owner->GetTeamMaster() == self && ( ( !owner->fl.solidForTeam && !collideWithTeam ) ||
+					( owner->IsType( idAFAttachment::Type ) && static_cast<idAFAttachment *>( owner )->GetBody() == self ) ) ) {
+				continue;
+			}
+			break;
+		}
+		if ( j < clipModels.Num() ) {
+			continue;
+		}
+		figures[numFigures] = figure;
+		bounds[numFigures] = bounds[i];
+		numFigures++;
+	}
+	figures.SetNum( numFigures );
+	bounds.SetNum( numFigures );
+	if ( numFigures == 0 ) {
+		return 0;
+	}
+
+	idList<int> stepOfFigure, jobStart;
+	int numIslands = idPhysicsIslands::Build( bounds, AF_ISLAND_JOB_MIN_FIGURES, stepOfFigure, jobStart );
+
+	idList<AFIslandStep_t> steps;
+	steps.SetNum( numFigures );
+	for ( i = 0; i < numFigures; i++ ) {
+		AFIslandStep_t &step = steps[stepOfFigure[i]];
+		step.owner = figures[i]->self;
+		step.physics = figures[i];
+		step.moved = false;
+	}
+
+	idPhysicsIslands::Run( EvaluateIslandJob, "articulatedFigureIsland", steps.Ptr(), sizeof( AFIslandStep_t ), jobStart, timeStepMSec, endTimeMSec, parallel );
+
+	// apply side effects in entity order, as if the figures had been evaluated one by one
+	for ( i = 0; i < numFigures; i++ ) {
+		const AFIslandStep_t &step = steps[stepOfFigure[i]];
+		if ( !step.owner.GetEntity() ) {
+			continue;	// removed by the side effects of another figure
+		}
+		step.physics->CommitIslandStep( step );
+		step.physics->islandStepTime = endTimeMSec;
+		step.physics->islandStepMoved = step.moved;
+	}
+
+	return numIslands;
+}
+
 /*
 ================
 idPhysics_AF::UpdateTime
@@ -6991,6 +7427,11 @@ idPhysics_AF::idPhysics_AF( void ) {
 	masterBody = NULL;
 
 	lcp = idLCP::AllocSymmetric();
+	iterativeLcp = idLCP::AllocIterative();
+
+	islandStep = NULL;
+	islandStepTime = -1;
+	islandStepMoved = false;
 
 	memset( &current, 0, sizeof( current ) );
 	current.atRest = -1;
@@ -7085,6 +7526,7 @@ idPhysics_AF::~idPhysics_AF( void ) {
 	}
 
 	delete lcp;
+	delete iterativeLcp;
 
 	if ( masterBody ) {
 		delete masterBody;
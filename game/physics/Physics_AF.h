@@ -829,6 +829,8 @@ typedef struct AFCollision_s {
 	idAFBody *				body;
 } AFCollision_t;
 
+struct AFIslandStep_s;
+
 
 class idPhysics_AF : public idPhysics_Base {
 
@@ -1011,6 +1013,16 @@ public:	// common physics interface
 	int						GetNumOrigConstraints( void ) { return m_NumOrigConstraints; };
 	void					SetNumOrigConstraints( int num ) { m_NumOrigConstraints = num; };
 
+	/**
+	* Evaluates the articulated figures among the given entities ahead of their think, split into
+	* islands of figures which can touch each other during this step. Islands are stepped in parallel
+	* jobs if requested, impacts, sounds and other side effects are applied afterwards in the order
+	* of the list. The later Evaluate call of a stepped figure only returns the result, so forces
+	* added during think apply one frame late. Does nothing unless af_islands is set.
+	* Returns the number of islands.
+	**/
+	static int				EvaluateIslands( const idList<idEntity *> &entities, int timeStepMSec, int endTimeMSec, bool parallel );
+
 private:
 							// articulated figure
 	idList<idAFTree *>		trees;							// tree structures
@@ -1089,6 +1101,12 @@ private:
 
 	idAFBody *				masterBody;						// master body
 	idLCP *					lcp;							// linear complementarity problem solver
+	idLCP *					iterativeLcp;					// warm started solver for large constraint sets, see af_iterativeLCP
+
+							// island stepping (see EvaluateIslands)
+	struct AFIslandStep_s *	islandStep;						// records side effects while evaluated in an island job
+	int						islandStepTime;					// end time of the island step done this frame, -1 if none
+	bool					islandStepMoved;				// result of the island step
 
 private:
 	bool					IsClosedLoop( const idAFBody *body1, const idAFBody *body2 ) const;
@@ -1112,8 +1130,15 @@ private:
 	void					SwapStates( void );
 	bool					TestIfAtRest( float timeStep );
 	void					Rest( void );
+	void					RestEntity( void );
+	void					CollisionSetInMotion( idEntity *ent );
 	void					AddPushVelocity( const idVec6 &pushVelocity );
 	void					DebugDraw( void );
+
+	bool					CanEvaluateInIsland( void ) const;
+	idBounds				GetIslandBounds( void ) const;
+	void					CommitIslandStep( const struct AFIslandStep_s &step );
+	static void				EvaluateIslandJob( void *data );
 };
 
 #endif /* !__PHYSICS_AF_H__ */
@@ -21,6 +21,7 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 #include "../Game_local.h"
 #include "../Grabber.h"
 #include "../MeleeWeapon.h" // grayman #3992
+#include "PhysicsIslands.h"
 
 CLASS_DECLARATION( idPhysics_Base, idPhysics_RigidBody )
 END_CLASS
@@ -40,6 +41,76 @@ static const float MAX_GRABBER_EXT_ANGVEL		= 5.0f;
 
 #undef RB_TIMINGS
 
+/*
+	Island stepping
+
+	Bodies stepped in an island job only change their own state and the clip world.
+	Everything else they do to entities and the game is recorded as events of the step,
+	and replayed on the main thread once all islands are done.
+	Even with a single worker this differs from stepping the bodies during think: an
+	impulse or activation from one body reaches another body which was already stepped
+	this frame only in its next step, and forces added while entities think apply from
+	the next frame on. Both are one frame late, which is why island stepping is optional.
+	The collision model manager stamps polygons with a global check count and sets up
+	trace models in a shared slot, so clip world queries from the jobs are serialized.
+*/
+typedef enum {
+	RBISLAND_COLLIDE,				// set in motion by actor and Collide callback for the collision
+	RBISLAND_CHECK_COLLISION,		// grabber check for the entity collided with
+	RBISLAND_CONTACTS,				// contact entity links of the old and new contacts
+	RBISLAND_REST,					// entity side of coming to rest
+	RBISLAND_ACTIVATE_CONTACTS,		// activation of contact entities
+	RBISLAND_IMPACT,				// impulse for the entity collided with
+	RBISLAND_OUTSIDE_WORLD,			// warning about leaving the world bounds
+	RBISLAND_DEBUG_DRAW
+} rigidBodyIslandEvent_t;
+
+typedef struct rigidBodyIslandStep_s {
+	idEntityPtr<idEntity>	owner;				// entity of the body
+	idPhysics_RigidBody *	body;
+	bool					moved;				// result of Evaluate
+	idList<rigidBodyIslandEvent_t> events;		// in the order they happened
+	trace_t					collision;			// collision of the step
+	idVec3					collisionVelocity;	// relative velocity at the collision point
+	idVec3					impulse;			// impulse for the entity collided with
+	idList<int>				oldContacts;		// entity numbers of the contacts replaced
+} rigidBodyIslandStep_t;
+
+static const int	ISLAND_JOB_MIN_BODIES = 8;		// islands are merged into jobs of at least this many bodies
+static const float	ISLAND_BOUNDS_MARGIN = 1.0f;	// added to the bounds a body can reach during a step
+
+/*
+===============================================================================
+
+	Contact caching and stack sleeping
+
+	Contacts are traced against the clip world in every step of a body that is not
+	at rest, which dominates the cost of bodies that almost rest and of bodies carried
+	by movers. With rb_contactCache the contacts of the last trace are kept together
+	with the pose of every clip model they touch. As long as the pose of the body
+	relative to each of those clip models is unchanged, the contacts are moved along
+	with the touched clip models instead of being traced again. Since something could
+	come within contact range without colliding, the cache is only reused a few times
+	in a row. A collision impulse drops it right away.
+
+	A moving body activates the bodies resting on it in every step. With rb_stackSleep
+	they are only activated after a collision or a push, or once the body has moved or
+	turned noticeably since it last activated them, so a stack stays asleep while a body
+	below it jitters in place.
+
+	Both work per body. Contacts are not kept per pair of bodies, and resting bodies
+	go to sleep and wake up one by one, not as whole islands. Pushers still clip
+	against every body they move (see idPush). Both cvars are off by default.
+
+===============================================================================
+*/
+
+static const int	CONTACT_CACHE_MAX_REUSES = 7;			// trace again after reusing the cached contacts this often
+static const float	CONTACT_CACHE_ORIGIN_EPSILON = 0.01f;	// allowed change of the position relative to a touched clip model
+static const float	CONTACT_CACHE_AXIS_EPSILON = 1e-4f;		// allowed change of the orientation relative to a touched clip model
+static const float	STACK_WAKE_ORIGIN_EPSILON = 0.25f;		// movement that activates the contact entities
+static const float	STACK_WAKE_AXIS_EPSILON = 1e-2f;		// rotation that activates the contact entities
+
 #ifdef RB_TIMINGS
 static int lastTimerReset = 0;
 static int numRigidBodies = 0;
@@ -216,8 +287,17 @@ void idPhysics_RigidBody::Integrate( float deltaTime, rigidBodyPState_t &next )
 	next.i.orientation.OrthoNormalizeSelf();
 
 #ifdef MOD_WATERPHYSICS
+	float waterLevel;
+	{
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
+		waterLevel = this->SetWaterLevelf();
+	}
+
 	// apply a water gravity if the body is in water
-	if ( this->SetWaterLevelf() != 0.0f )
+	if ( waterLevel != 0.0f )
 	{
 		idVec3 bCenter;
 		idVec3 bForce(gravityVector),rForce(-gravityVector);
@@ -472,19 +552,8 @@ bool idPhysics_RigidBody::CollisionImpulse( const trace_t &collision, idVec3 &im
 	}
 
 	// Update moved by and set in motion by actor
-	if( self->m_SetInMotionByActor.GetEntity() != NULL )
-	{
-		ent->m_SetInMotionByActor = self->m_SetInMotionByActor.GetEntity();
-		ent->m_MovedByActor = self->m_MovedByActor.GetEntity();
-	}
-	// Note: Actors should not overwrite the moved by other actors when they are hit with something
-	// So only overwrite if MovedByActor is NULL
-	if ( ent->IsType(idActor::Type) 
-		&& self->m_SetInMotionByActor.GetEntity() == NULL
-		&& !(static_cast<idActor *>(ent)->IsKnockedOut() || ent->health < 0) )
-	{
-		self->m_SetInMotionByActor = (idActor *) ent;
-		self->m_MovedByActor = (idActor *) ent;
+	if ( !islandStep ) {
+		CollisionSetInMotion( ent );
 	}
 
 	// collision point relative to the body center of mass
@@ -553,10 +622,40 @@ bool idPhysics_RigidBody::CollisionImpulse( const trace_t &collision, idVec3 &im
 		current.i.angularMomentum *= 0.5f;
 	}
 
+	if ( islandStep ) {
+		// idMoveable::Collide never stops the body, so the callback can wait for the commit
+		islandStep->collision = collision;
+		islandStep->collisionVelocity = velocity;
+		islandStep->events.Append( RBISLAND_COLLIDE );
+		return false;
+	}
+
 	// callback to self to let the entity know about the collision
 	return self->Collide( collision, velocity );
 }
 
+/*
+================
+idPhysics_RigidBody::CollisionSetInMotion
+================
+*/
+void idPhysics_RigidBody::CollisionSetInMotion( idEntity *ent ) {
+	if( self->m_SetInMotionByActor.GetEntity() != NULL )
+	{
+		ent->m_SetInMotionByActor = self->m_SetInMotionByActor.GetEntity();
+		ent->m_MovedByActor = self->m_MovedByActor.GetEntity();
+	}
+	// Note: Actors should not overwrite the moved by other actors when they are hit with something
+	// So only overwrite if MovedByActor is NULL
+	if ( ent->IsType(idActor::Type) 
+		&& self->m_SetInMotionByActor.GetEntity() == NULL
+		&& !(static_cast<idActor *>(ent)->IsKnockedOut() || ent->health < 0) )
+	{
+		self->m_SetInMotionByActor = (idActor *) ent;
+		self->m_MovedByActor = (idActor *) ent;
+	}
+}
+
 /*
 ================
 idPhysics_RigidBody::CheckForCollisions
@@ -574,6 +673,11 @@ bool idPhysics_RigidBody::CheckForCollisions( const float deltaTime, rigidBodyPS
 	trace_t waterCollision;
 #endif
 	bool collided = false;
+	idScopedCriticalSection lock;
+
+	if ( islandStep ) {
+		lock.Lock( idPhysicsIslands::clipMutex );
+	}
 
 #ifdef TEST_COLLISION_DETECTION
 	bool startsolid;
@@ -1175,6 +1279,16 @@ idPhysics_RigidBody::idPhysics_RigidBody( void ) {
 	isBlocked = false;
 	propagateImpulseLock = false;
 
+	islandStep = NULL;
+	islandStepTime = -1;
+	islandStepMoved = false;
+
+	cachedOrigin.Zero();
+	cachedAxis.Identity();
+	cachedReuses = -1;
+	wakeOrigin.Zero();
+	wakeAxis.Identity();
+
 	memset(&collisionTrace, 0, sizeof(collisionTrace));
 
 	// tels
@@ -1282,6 +1396,25 @@ void idPhysics_RigidBody::Save( idSaveGame *savefile ) const {
 	savefile->WriteVec3( externalForce );
 	savefile->WriteVec3( externalTorque );
 	savefile->WriteVec3( externalForcePoint );
+
+	savefile->WriteInt( cachedContacts.Num() );
+	for ( int i = 0; i < cachedContacts.Num(); i++ ) {
+		savefile->WriteContactInfo( cachedContacts[i] );
+	}
+	savefile->WriteInt( cachedPartners.Num() );
+	for ( int i = 0; i < cachedPartners.Num(); i++ ) {
+		savefile->WriteInt( cachedPartners[i].entityNum );
+		savefile->WriteInt( cachedPartners[i].spawnId );
+		savefile->WriteInt( cachedPartners[i].id );
+		savefile->WriteVec3( cachedPartners[i].origin );
+		savefile->WriteMat3( cachedPartners[i].axis );
+	}
+	savefile->WriteVec3( cachedOrigin );
+	savefile->WriteMat3( cachedAxis );
+	savefile->WriteInt( cachedReuses );
+
+	savefile->WriteVec3( wakeOrigin );
+	savefile->WriteMat3( wakeAxis );
 }
 
 /*
@@ -1329,6 +1462,28 @@ void idPhysics_RigidBody::Restore( idRestoreGame *savefile ) {
 	savefile->ReadVec3( externalForce );
 	savefile->ReadVec3( externalTorque );
 	savefile->ReadVec3( externalForcePoint );
+
+	int num;
+	savefile->ReadInt( num );
+	cachedContacts.SetNum( num );
+	for ( int i = 0; i < num; i++ ) {
+		savefile->ReadContactInfo( cachedContacts[i] );
+	}
+	savefile->ReadInt( num );
+	cachedPartners.SetNum( num );
+	for ( int i = 0; i < num; i++ ) {
+		savefile->ReadInt( cachedPartners[i].entityNum );
+		savefile->ReadInt( cachedPartners[i].spawnId );
+		savefile->ReadInt( cachedPartners[i].id );
+		savefile->ReadVec3( cachedPartners[i].origin );
+		savefile->ReadMat3( cachedPartners[i].axis );
+	}
+	savefile->ReadVec3( cachedOrigin );
+	savefile->ReadMat3( cachedAxis );
+	savefile->ReadInt( cachedReuses );
+
+	savefile->ReadVec3( wakeOrigin );
+	savefile->ReadMat3( wakeAxis );
 }
 
 /*
@@ -1351,6 +1506,7 @@ void idPhysics_RigidBody::SetClipModel( idClipModel *model, const float density,
 		delete clipModel;
 	}
 	clipModel = model;
+	cachedReuses = -1;
 	clipModel->Link( gameLocal.clip, self, 0, current.i.position, current.i.orientation );
 
 	// get mass properties from the trace model
@@ -1483,8 +1639,24 @@ void idPhysics_RigidBody::Rest( void )
 	current.atRest = gameLocal.time;
 	current.i.linearMomentum.Zero();
 	current.i.angularMomentum.Zero();
+
+	if ( islandStep ) {
+		// the entity is deactivated when it runs its physics, see Evaluate
+		islandStep->events.Append( RBISLAND_REST );
+		return;
+	}
+
 	self->BecomeInactive( TH_PHYSICS );
+	RestEntity();
+}
 
+/*
+================
+idPhysics_RigidBody::RestEntity
+================
+*/
+void idPhysics_RigidBody::RestEntity( void ) 
+{
 	// grayman #2908 - if this is a mine, we can't NULL m_SetInMotionByActor
 	// because we need that if the mine ever kills someone
 
@@ -1657,6 +1829,15 @@ bool idPhysics_RigidBody::Evaluate( int timeStepMSec, int endTimeMSec ) {
 	bool collided = false;
 	bool cameToRest = false;
 
+	// already stepped with its island this frame, see EvaluateIslands
+	if ( islandStepTime == endTimeMSec ) {
+		islandStepTime = -1;
+		if ( current.atRest >= 0 ) {
+			self->BecomeInactive( TH_PHYSICS );
+		}
+		return islandStepMoved;
+	}
+
 	// greebo: For now, we aren't blocked
 	isBlocked = false;
 
@@ -1739,7 +1920,13 @@ bool idPhysics_RigidBody::Evaluate( int timeStepMSec, int endTimeMSec ) {
 //	current.i.linearMomentum -= current.pushVelocity.SubVec3( 0 ) * mass;
 //	current.i.angularMomentum -= current.pushVelocity.SubVec3( 1 ) * inertiaTensor;
 
-	clipModel->Unlink();
+	{
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
+		clipModel->Unlink();
+	}
 
 	next = current;
 	
@@ -1772,14 +1959,28 @@ bool idPhysics_RigidBody::Evaluate( int timeStepMSec, int endTimeMSec ) {
 		idEntity* ent = gameLocal.entities[collision.c.entityNum];
 		if (ent && ( ent != gameLocal.world ) )
 		{
-			self->CheckCollision(ent);
+			if ( islandStep ) {
+				islandStep->events.Append( RBISLAND_CHECK_COLLISION );
+			} else {
+				self->CheckCollision(ent);
+			}
 		}
 	}
 
 	// update the position of the clip model
-	clipModel->Link( gameLocal.clip, self, clipModel->GetId(), current.i.position, current.i.orientation );
+	{
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
+		clipModel->Link( gameLocal.clip, self, clipModel->GetId(), current.i.position, current.i.orientation );
+	}
 
-	DebugDraw();
+	if ( islandStep ) {
+		islandStep->events.Append( RBISLAND_DEBUG_DRAW );
+	} else {
+		DebugDraw();
+	}
 
 	if ( !noContact )
 	{
@@ -1815,9 +2016,14 @@ bool idPhysics_RigidBody::Evaluate( int timeStepMSec, int endTimeMSec ) {
 		}
 	}
 
-	if ( current.atRest < 0 )
+	// a body moved by a pusher carries the bodies resting on it along
+	if ( current.atRest < 0 && ShouldActivateContactEntities( collided || current.pushVelocity != vec6_origin ) )
 	{
-		ActivateContactEntities();
+		if ( islandStep ) {
+			islandStep->events.Append( RBISLAND_ACTIVATE_CONTACTS );
+		} else {
+			ActivateContactEntities();
+		}
 	}
 
 	if ( collided )
@@ -1826,13 +2032,18 @@ bool idPhysics_RigidBody::Evaluate( int timeStepMSec, int endTimeMSec ) {
 		ent = gameLocal.entities[collision.c.entityNum];
 		if ( ent && ( !cameToRest || !ent->IsAtRest() ) )
 		{
-			// apply impact to other entity
-			ent->ApplyImpulse( self, collision.c.id, collision.c.point, -impulse );
-
-			if (ent->m_SetInMotionByActor.GetEntity() == NULL)
-			{
-				ent->m_SetInMotionByActor = self->m_SetInMotionByActor;
-				ent->m_MovedByActor = self->m_MovedByActor;
+			if ( islandStep ) {
+				islandStep->impulse = impulse;
+				islandStep->events.Append( RBISLAND_IMPACT );
+			} else {
+				// apply impact to other entity
+				ent->ApplyImpulse( self, collision.c.id, collision.c.point, -impulse );
+
+				if (ent->m_SetInMotionByActor.GetEntity() == NULL)
+				{
+					ent->m_SetInMotionByActor = self->m_SetInMotionByActor;
+					ent->m_MovedByActor = self->m_MovedByActor;
+				}
 			}
 		}
 
@@ -1889,8 +2100,12 @@ bool idPhysics_RigidBody::Evaluate( int timeStepMSec, int endTimeMSec ) {
 	current.lastTimeStep = timeStep;
 
 	if ( IsOutsideWorld() ) {
-		gameLocal.Warning( "rigid body moved outside world bounds for entity '%s' type '%s' at (%s)",
-					self->name.c_str(), self->GetType()->classname, current.i.position.ToString(0) );
+		if ( islandStep ) {
+			islandStep->events.Append( RBISLAND_OUTSIDE_WORLD );
+		} else {
+			gameLocal.Warning( "rigid body moved outside world bounds for entity '%s' type '%s' at (%s)",
+						self->name.c_str(), self->GetType()->classname, current.i.position.ToString(0) );
+		}
 		Rest();
 	}
 
@@ -1927,6 +2142,245 @@ bool idPhysics_RigidBody::Evaluate( int timeStepMSec, int endTimeMSec ) {
 	return true; // grayman #2478
 }
 
+/*
+================
+RigidBody_IslandReadOnly
+
+  True if the entity can be touched by island jobs: they only read its impact info.
+================
+*/
+static bool RigidBody_IslandReadOnly( idEntity *ent ) {
+	if ( ent == NULL || ent == gameLocal.world ) {
+		return true;
+	}
+	// articulated figures set up their pose when asked for impact info
+	if ( ent->IsType( idActor::Type ) || ent->IsType( idAFEntity_Base::Type ) || ent->IsType( idAFAttachment::Type ) ) {
+		return false;
+	}
+	const idTypeInfo *type = ent->GetPhysics()->GetType();
+	return ( type == &idPhysics_Static::Type || type == &idPhysics_StaticMulti::Type || type == &idPhysics_RigidBody::Type );
+}
+
+/*
+================
+idPhysics_RigidBody::CanEvaluateInIsland
+================
+*/
+bool idPhysics_RigidBody::CanEvaluateInIsland( void ) const {
+	// subclasses may stop the body in Collide or move it before running physics
+	if ( !self || self->GetType() != &idMoveable::Type || self->GetPhysics() != this ) {
+		return false;
+	}
+	if ( !( self->thinkFlags & TH_PHYSICS ) || self->GetTeamMaster() || self == gameLocal.m_Grabber->GetSelected() ) {
+		return false;
+	}
+	if ( hasMaster || dropToFloor || current.atRest >= 0 || !clipModel || !clipModel->IsLinked() ) {
+		return false;
+	}
+#ifdef MOD_WATERPHYSICS
+	if ( water ) {
+		return false;
+	}
+#endif
+	return true;
+}
+
+/*
+================
+idPhysics_RigidBody::GetIslandBounds
+
+  Bounds of everything the body can touch during the next step.
+================
+*/
+idBounds idPhysics_RigidBody::GetIslandBounds( int timeStepMSec ) const {
+	idVec3 force, torque;
+	float timeStep = MS2SEC( timeStepMSec );
+
+	current.forceApplications.ComputeTotal( current.i.position + centerOfMass * current.i.orientation, &force, &torque );
+
+	// the euler step moves the center of mass with the current velocity, collisions only shorten the move
+	float move = timeStep * ( inverseMass * current.i.linearMomentum.Length() + timeStep * ( gravityVector.Length() + inverseMass * force.Length() ) );
+	// the body rotates around its center of mass, which may be off the origin
+	float radius = clipModel->GetBounds().GetRadius() + 2.0f * centerOfMass.Length();
+
+	idBounds bounds( current.i.position );
+	bounds.ExpandSelf( radius + 2.0f * move + CONTACT_EPSILON + ISLAND_BOUNDS_MARGIN );
+	return bounds;
+}
+
+/*
+================
+idPhysics_RigidBody::CommitIslandStep
+
+  Replays the side effects recorded by an island step.
+================
+*/
+void idPhysics_RigidBody::CommitIslandStep( const rigidBodyIslandStep_t &step ) {
+	idEntity *ent;
+
+	for ( int i = 0; i < step.events.Num(); i++ ) {
+		switch ( step.events[i] ) {
+			case RBISLAND_COLLIDE:
+				ent = gameLocal.entities[step.collision.c.entityNum];
+				if ( ent ) {
+					CollisionSetInMotion( ent );
+				}
+				self->Collide( step.collision, step.collisionVelocity );
+				break;
+			case RBISLAND_CHECK_COLLISION:
+				ent = gameLocal.entities[step.collision.c.entityNum];
+				if ( ent && ent != gameLocal.world ) {
+					self->CheckCollision( ent );
+				}
+				break;
+			case RBISLAND_CONTACTS:
+				for ( int j = 0; j < step.oldContacts.Num(); j++ ) {
+					ent = gameLocal.entities[step.oldContacts[j]];
+					if ( ent ) {
+						ent->RemoveContactEntity( self );
+					}
+				}
+				AddContactEntitiesForContacts();
+				break;
+			case RBISLAND_REST:
+				RestEntity();
+				break;
+			case RBISLAND_ACTIVATE_CONTACTS:
+				ActivateContactEntities();
+				break;
+			case RBISLAND_IMPACT:
+				ent = gameLocal.entities[step.collision.c.entityNum];
+				if ( ent ) {
+					ent->ApplyImpulse( self, step.collision.c.id, step.collision.c.point, -step.impulse );
+					if ( ent->m_SetInMotionByActor.GetEntity() == NULL ) {
+						ent->m_SetInMotionByActor = self->m_SetInMotionByActor;
+						ent->m_MovedByActor = self->m_MovedByActor;
+					}
+				}
+				break;
+			case RBISLAND_OUTSIDE_WORLD:
+				gameLocal.Warning( "rigid body moved outside world bounds for entity '%s' type '%s' at (%s)",
+							self->name.c_str(), self->GetType()->classname, current.i.position.ToString(0) );
+				break;
+			case RBISLAND_DEBUG_DRAW:
+				DebugDraw();
+				break;
+		}
+	}
+}
+
+/*
+================
+idPhysics_RigidBody::EvaluateIslandJob
+================
+*/
+void idPhysics_RigidBody::EvaluateIslandJob( void *data ) {
+	physicsIslandJob_t *job = (physicsIslandJob_t *)data;
+	rigidBodyIslandStep_t *steps = (rigidBodyIslandStep_t *)job->steps;
+
+	for ( int i = 0; i < job->numSteps; i++ ) {
+		rigidBodyIslandStep_t &step = steps[i];
+		idPhysics_RigidBody *body = step.body;
+
+		body->islandStep = &step;
+		body->islandStepTime = -1;
+		step.moved = body->Evaluate( job->timeStepMSec, job->endTimeMSec );
+		body->islandStep = NULL;
+	}
+}
+
+/*
+================
+idPhysics_RigidBody::EvaluateIslands
+================
+*/
+int idPhysics_RigidBody::EvaluateIslands( const idList<idEntity *> &entities, int timeStepMSec, int endTimeMSec, bool parallel ) {
+	idList<idPhysics_RigidBody *> bodies;
+	idList<idBounds> bounds;
+	idList<int> bodyOfEntity;
+	idClip_ClipModelList clipModels;
+	int i, j;
+
+	if ( timeStepMSec <= 0 ) {
+		return 0;
+	}
+
+	bodyOfEntity.SetNum( MAX_GENTITIES );
+	memset( bodyOfEntity.Ptr(), -1, MAX_GENTITIES * sizeof( int ) );
+
+	for ( i = 0; i < entities.Num(); i++ ) {
+		idPhysics *physics = entities[i]->GetPhysics();
+		if ( physics->GetType() != &idPhysics_RigidBody::Type ) {
+			continue;
+		}
+		idPhysics_RigidBody *body = static_cast<idPhysics_RigidBody *>( physics );
+		if ( !body->CanEvaluateInIsland() ) {
+			continue;
+		}
+		bodyOfEntity[entities[i]->entityNumber] = bodies.Num();
+		bodies.Append( body );
+		bounds.Append( body->GetIslandBounds( timeStepMSec ) );
+	}
+
+	// bodies which may touch anything that is not read-only for the jobs run their physics as usual
+	int numBodies = 0;
+	for ( i = 0; i < bodies.Num(); i++ ) {
+		idPhysics_RigidBody *body = bodies[i];
+		int contentMask = body->clipMask;
+#ifdef MOD_WATERPHYSICS
+		contentMask |= MASK_WATER;
+#endif
+		gameLocal.clip.ClipModelsTouchingBounds( bounds[i], contentMask, clipModels );
+		for ( j = 0; j < clipModels.Num(); j++ ) {
+			idEntity *owner = clipModels[j]->GetEntity();
+			if ( owner == body->self || ( owner && bodyOfEntity[owner->entityNumber] >= 0 ) ) {
+				continue;
+			}
+			if ( !RigidBody_IslandReadOnly( owner ) ) {
+				break;
+			}
+		}
+		if ( j < clipModels.Num() ) {
+			continue;
+		}
+		bodies[numBodies] = body;
+		bounds[numBodies] = bounds[i];
+		numBodies++;
+	}
+	bodies.SetNum( numBodies );
+	bounds.SetNum( numBodies );
+	if ( numBodies == 0 ) {
+		return 0;
+	}
+
+	idList<int> stepOfBody, jobStart;
+	int numIslands = idPhysicsIslands::Build( bounds, ISLAND_JOB_MIN_BODIES, stepOfBody, jobStart );
+
+	idList<rigidBodyIslandStep_t> steps;
+	steps.SetNum( numBodies );
+	for ( i = 0; i < numBodies; i++ ) {
+		rigidBodyIslandStep_t &step = steps[stepOfBody[i]];
+		step.owner = bodies[i]->self;
+		step.body = bodies[i];
+		step.moved = false;
+	}
+
+	idPhysicsIslands::Run( EvaluateIslandJob, "rigidBodyIsland", steps.Ptr(), sizeof( rigidBodyIslandStep_t ), jobStart, timeStepMSec, endTimeMSec, parallel );
+
+	// apply side effects in entity order, as if the bodies had been evaluated one by one
+	for ( i = 0; i < numBodies; i++ ) {
+		const rigidBodyIslandStep_t &step = steps[stepOfBody[i]];
+		if ( !step.owner.GetEntity() ) {
+			continue;	// removed by the side effects of another body
+		}
+		step.body->CommitIslandStep( step );
+		step.body->islandStepTime = endTimeMSec;
+		step.body->islandStepMoved = step.moved;
+	}
+
+	return numIslands;
+}
+
 /*
 ================
 idPhysics_RigidBody::UpdateTime
@@ -2004,6 +2458,9 @@ void idPhysics_RigidBody::ApplyImpulse( const int id, const idVec3 &point, const
 	current.i.linearMomentum += impulse;
 	current.i.angularMomentum += ( point - ( current.i.position + centerOfMass * current.i.orientation ) ).Cross( impulse );
 
+	// something hit the body, it might touch it from now on
+	cachedReuses = -1;
+
 	Activate();
 }
 
@@ -2352,27 +2809,190 @@ idPhysics_RigidBody::EvaluateContacts
 ================
 */
 bool idPhysics_RigidBody::EvaluateContacts( void ) {
-	ClearContacts();
+	if ( islandStep ) {
+		// contact entities are updated when the island is committed
+		islandStep->oldContacts.SetNum( contacts.Num() );
+		for ( int i = 0; i < contacts.Num(); i++ ) {
+			islandStep->oldContacts[i] = contacts[i].entityNum;
+		}
+		islandStep->events.Append( RBISLAND_CONTACTS );
+		contacts.SetNum( 0, false );
+	} else {
+		ClearContacts();
+	}
 
-	idVec6 dir;
-	dir.SubVec3(0) = current.i.linearMomentum + current.lastTimeStep * gravityVector * mass;
-	dir.SubVec3(1) = current.i.angularMomentum;
-	dir.SubVec3(0).Normalize();
-	dir.SubVec3(1).Normalize();
-	int num;
-	contactInfo_t carr[CONTACTS_MAX_NUMBER];
-	num = gameLocal.clip.Contacts(
-		carr, CONTACTS_MAX_NUMBER, clipModel->GetOrigin(),
-		dir, CONTACT_EPSILON, clipModel, clipModel->GetAxis(), clipMask, self
-	);
-	contacts.SetNum( num, false );
-	memcpy( contacts.Ptr(), carr, num * sizeof(carr[0]) );
+	{
+		idScopedCriticalSection lock;
+		if ( islandStep ) {
+			lock.Lock( idPhysicsIslands::clipMutex );
+		}
 
-	AddContactEntitiesForContacts();
+		if ( !rb_contactCache.GetBool() || !GetCachedContacts() ) {
+			idVec6 dir;
+			dir.SubVec3(0) = current.i.linearMomentum + current.lastTimeStep * gravityVector * mass;
+			dir.SubVec3(1) = current.i.angularMomentum;
+			dir.SubVec3(0).Normalize();
+			dir.SubVec3(1).Normalize();
+			contactInfo_t carr[CONTACTS_MAX_NUMBER];
+			int num = gameLocal.clip.Contacts(
+				carr, CONTACTS_MAX_NUMBER, clipModel->GetOrigin(),
+				dir, CONTACT_EPSILON, clipModel, clipModel->GetAxis(), clipMask, self
+			);
+			contacts.SetNum( num, false );
+			memcpy( contacts.Ptr(), carr, num * sizeof(carr[0]) );
+
+			if ( rb_contactCache.GetBool() ) {
+				CacheContacts();
+			}
+		}
+	}
+
+	if ( !islandStep ) {
+		AddContactEntitiesForContacts();
+	}
 
 	return ( contacts.Num() != 0 );
 }
 
+/*
+================
+RigidBody_ContactPartnerPose
+
+  Pose of the clip model touched by a contact, false if it is gone.
+================
+*/
+static bool RigidBody_ContactPartnerPose( const rigidBodyContactPartner_t &partner, idVec3 &origin, idMat3 &axis ) {
+	idEntity *ent = gameLocal.entities[partner.entityNum];
+	if ( !ent || gameLocal.spawnIds[partner.entityNum] != partner.spawnId ) {
+		return false;
+	}
+	if ( ent == gameLocal.world ) {
+		origin.Zero();
+		axis.Identity();
+		return true;
+	}
+	idPhysics *phys = ent->GetPhysics();
+	if ( partner.id >= 0 && partner.id < phys->GetNumClipModels() && phys->GetClipModel( partner.id ) ) {
+		// the clip model may already be linked at a new position while the entity is pushing
+		origin = phys->GetClipModel( partner.id )->GetOrigin();
+		axis = phys->GetClipModel( partner.id )->GetAxis();
+	} else {
+		origin = phys->GetOrigin();
+		axis = phys->GetAxis();
+	}
+	return true;
+}
+
+/*
+================
+idPhysics_RigidBody::GetCachedContacts
+
+  Sets the contacts from the cache if the body did not move relative to anything it touched.
+================
+*/
+bool idPhysics_RigidBody::GetCachedContacts( void ) {
+	idVec3 origin;
+	idMat3 axis;
+
+	if ( cachedReuses < 0 || cachedReuses >= CONTACT_CACHE_MAX_REUSES || cachedPartners.Num() == 0 ) {
+		return false;
+	}
+
+	// the current pose of every touched clip model, the body must have kept its pose relative to them
+	idVec3 *origins = (idVec3 *) _alloca16( cachedPartners.Num() * sizeof( idVec3 ) );
+	idMat3 *axes = (idMat3 *) _alloca16( cachedPartners.Num() * sizeof( idMat3 ) );
+	for ( int i = 0; i < cachedPartners.Num(); i++ ) {
+		const rigidBodyContactPartner_t &partner = cachedPartners[i];
+		if ( !RigidBody_ContactPartnerPose( partner, origin, axis ) ) {
+			return false;
+		}
+		idVec3 oldLocalOrigin = ( cachedOrigin - partner.origin ) * partner.axis.Transpose();
+		idVec3 localOrigin = ( current.i.position - origin ) * axis.Transpose();
+		if ( !localOrigin.Compare( oldLocalOrigin, CONTACT_CACHE_ORIGIN_EPSILON ) ) {
+			return false;
+		}
+		idMat3 oldLocalAxis = cachedAxis * partner.axis.Transpose();
+		idMat3 localAxis = current.i.orientation * axis.Transpose();
+		if ( !localAxis.Compare( oldLocalAxis, CONTACT_CACHE_AXIS_EPSILON ) ) {
+			return false;
+		}
+		origins[i] = origin;
+		axes[i] = axis;
+	}
+
+	// move the contacts along with the clip models they touch
+	contacts.SetNum( cachedContacts.Num(), false );
+	for ( int i = 0; i < cachedContacts.Num(); i++ ) {
+		contactInfo_t &contact = contacts[i];
+		contact = cachedContacts[i];
+		int j;
+		for ( j = 0; j < cachedPartners.Num(); j++ ) {
+			if ( cachedPartners[j].entityNum == contact.entityNum && cachedPartners[j].id == contact.id ) {
+				break;
+			}
+		}
+		const rigidBodyContactPartner_t &partner = cachedPartners[j];
+		contact.point = origins[j] + ( ( contact.point - partner.origin ) * partner.axis.Transpose() ) * axes[j];
+		contact.normal = ( contact.normal * partner.axis.Transpose() ) * axes[j];
+		contact.dist = contact.point * contact.normal;
+	}
+
+	cachedReuses++;
+	return true;
+}
+
+/*
+================
+idPhysics_RigidBody::CacheContacts
+================
+*/
+void idPhysics_RigidBody::CacheContacts( void ) {
+	cachedContacts = contacts;
+	cachedOrigin = current.i.position;
+	cachedAxis = current.i.orientation;
+	cachedReuses = 0;
+
+	cachedPartners.SetNum( 0, false );
+	for ( int i = 0; i < contacts.Num(); i++ ) {
+		int j;
+		for ( j = 0; j < cachedPartners.Num(); j++ ) {
+			if ( cachedPartners[j].entityNum == contacts[i].entityNum && cachedPartners[j].id == contacts[i].id ) {
+				break;
+			}
+		}
+		if ( j < cachedPartners.Num() ) {
+			continue;
+		}
+		rigidBodyContactPartner_t &partner = cachedPartners.Alloc();
+		partner.entityNum = contacts[i].entityNum;
+		partner.spawnId = gameLocal.spawnIds[contacts[i].entityNum];
+		partner.id = contacts[i].id;
+		if ( !RigidBody_ContactPartnerPose( partner, partner.origin, partner.axis ) ) {
+			cachedReuses = -1;
+			return;
+		}
+	}
+}
+
+/*
+================
+idPhysics_RigidBody::ShouldActivateContactEntities
+
+  True if the entities in contact with the body must be activated after a step.
+  A collision or a push always activates them.
+================
+*/
+bool idPhysics_RigidBody::ShouldActivateContactEntities( bool collidedOrPushed ) {
+	if ( rb_stackSleep.GetBool() && !collidedOrPushed &&
+			current.i.position.Compare( wakeOrigin, STACK_WAKE_ORIGIN_EPSILON ) &&
+				current.i.orientation.Compare( wakeAxis, STACK_WAKE_AXIS_EPSILON ) ) {
+		return false;
+	}
+	wakeOrigin = current.i.position;
+	wakeAxis = current.i.orientation;
+	return true;
+}
+
 /*
 ================
 idPhysics_RigidBody::SetPushed
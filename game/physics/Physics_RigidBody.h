@@ -44,6 +44,16 @@ typedef struct rigidBodyPState_s {
 	rigidBodyIState_t		i;							// state used for integration
 } rigidBodyPState_t;
 
+typedef struct rigidBodyContactPartner_s {
+	int						entityNum;					// entity touched by cached contacts
+	int						spawnId;					// spawn id of that entity when the contacts were cached
+	int						id;							// id of the touched clip model
+	idVec3					origin;						// pose of the touched clip model when the contacts were cached
+	idMat3					axis;
+} rigidBodyContactPartner_t;
+
+struct rigidBodyIslandStep_s;
+
 class idPhysics_RigidBody : public idPhysics_Base {
 
 public:
@@ -156,6 +166,16 @@ public:	// common physics interface
 	virtual void			WriteToSnapshot( idBitMsgDelta &msg ) const override;
 	virtual void			ReadFromSnapshot( const idBitMsgDelta &msg ) override;
 
+	/**
+	 * Evaluates the moveables among the given entities ahead of their think, split into islands:
+	 * groups of bodies which can touch each other during this step. Islands are stepped in
+	 * parallel jobs if requested, side effects on other entities are applied afterwards in the
+	 * order of the list. The later Evaluate call of a stepped body only returns the result.
+	 * Side effects between bodies and forces added during think are therefore one frame late.
+	 * Returns the number of islands.
+	 */
+	static int				EvaluateIslands( const idList<idEntity *> &entities, int timeStepMSec, int endTimeMSec, bool parallel );
+
 private:
 	// state of the rigid body
 	rigidBodyPState_t		current;
@@ -205,6 +225,22 @@ private:
 
 	bool					propagateImpulseLock;
 
+	// island stepping (see EvaluateIslands)
+	struct rigidBodyIslandStep_s *islandStep;		// records side effects while evaluated in an island job
+	int						islandStepTime;			// end time of the island step done this frame, -1 if none
+	bool					islandStepMoved;		// result of the island step
+
+	// contact caching (see rb_contactCache)
+	idList<contactInfo_t>	cachedContacts;			// contacts found by the last trace
+	idList<rigidBodyContactPartner_t> cachedPartners;	// clip models touched by the cached contacts
+	idVec3					cachedOrigin;			// pose of the body when the contacts were cached
+	idMat3					cachedAxis;
+	int						cachedReuses;			// number of times the cached contacts were reused, -1 if none cached
+
+	// stack sleeping (see rb_stackSleep)
+	idVec3					wakeOrigin;				// pose at which the contact entities were last activated
+	idMat3					wakeAxis;
+
 #ifdef MOD_WATERPHYSICS
 	// buoyancy
 	int					noMoveTime;	// MOD_WATERPHYSICS suspend simulation if hardly any movement for this many seconds
@@ -226,7 +262,17 @@ private:
 	bool					TestIfAtRest( void ) const;
 #endif 		// MOD_WATERPHYSICS
 	void					Rest( void );
+	void					RestEntity( void );
+	void					CollisionSetInMotion( idEntity *ent );
 	void					DebugDraw( void );
+	bool					GetCachedContacts( void );
+	void					CacheContacts( void );
+	bool					ShouldActivateContactEntities( bool collidedOrPushed );
+
+	bool					CanEvaluateInIsland( void ) const;
+	idBounds				GetIslandBounds( int timeStepMSec ) const;
+	void					CommitIslandStep( const struct rigidBodyIslandStep_s &step );
+	static void				EvaluateIslandJob( void *data );
 
 #ifdef MOD_WATERPHYSICS
 	// Buoyancy stuff
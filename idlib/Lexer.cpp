@@ -218,7 +218,10 @@ void idLexer::Error( const char *str, ... ) {
 	va_end(ap);
 
 	if ( idLexer::flags & LEXFL_NOFATALERRORS ) {
-		idLib::common->Warning( "file %s, line %d: %s", idLexer::displayFilename.c_str(), idLexer::line, text );
+		idStr message = idStr( "file " ) + idLexer::displayFilename + ", line " + idLexer::line + ": " + text;
+		if ( !idLexerMessages::Add( message ) ) {
+			idLib::common->Warning( "%s", message.c_str() );
+		}
 	} else {
 		idLib::common->Error( "file %s, line %d: %s", idLexer::displayFilename.c_str(), idLexer::line, text );
 	}
@@ -240,7 +243,56 @@ void idLexer::Warning( const char *str, ... ) {
 	va_start( ap, str );
 	vsprintf( text, str, ap );
 	va_end( ap );
-	idLib::common->Warning( "file %s, line %d: %s", idLexer::displayFilename.c_str(), idLexer::line, text );
+	idStr message = idStr( "file " ) + idLexer::displayFilename + ", line " + idLexer::line + ": " + text;
+	if ( !idLexerMessages::Add( message ) ) {
+		idLib::common->Warning( "%s", message.c_str() );
+	}
+}
+
+thread_local idLexerMessages *idLexerMessages::current = NULL;
+
+/*
+================
+idLexerMessages::idLexerMessages
+================
+*/
+idLexerMessages::idLexerMessages( void ) {
+	prev = current;
+	current = this;
+}
+
+/*
+================
+idLexerMessages::~idLexerMessages
+================
+*/
+idLexerMessages::~idLexerMessages( void ) {
+	assert( current == this );
+	current = prev;
+}
+
+/*
+================
+idLexerMessages::Print
+================
+*/
+void idLexerMessages::Print( const idList<idStr> &messages ) {
+	for ( int i = 0; i < messages.Num(); i++ ) {
+		idLib::common->Warning( "%s", messages[i].c_str() );
+	}
+}
+
+/*
+================
+idLexerMessages::Add
+================
+*/
+bool idLexerMessages::Add( const char *text ) {
+	if ( !current ) {
+		return false;
+	}
+	current->messages.Append( text );
+	return true;
 }
 
 /*
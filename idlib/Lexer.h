@@ -347,6 +347,38 @@ private:
 	int				NumLinesCrossed( void );
 };
 
+/*
+===============================================================================
+
+	idLexerMessages
+
+	While it exists, the warnings (and non-fatal errors) of all lexers and parsers
+	on the creating thread are collected in it instead of being printed.
+	Lets text be parsed on a job thread, or ahead of time, with the messages
+	printed later in a deterministic order.
+
+===============================================================================
+*/
+
+class idLexerMessages {
+public:
+							idLexerMessages( void );
+							~idLexerMessages( void );
+
+	const idList<idStr> &	GetMessages( void ) const { return messages; }
+
+							// prints the messages as warnings
+	static void				Print( const idList<idStr> &messages );
+							// returns false if messages are not collected on this thread
+	static bool				Add( const char *text );
+
+private:
+	idList<idStr>			messages;
+	idLexerMessages *		prev;
+
+	static thread_local idLexerMessages *current;
+};
+
 ID_INLINE const char *idLexer::GetFileName( void ) {
 	return idLexer::filename;
 }
@@ -417,6 +417,7 @@ void idParser::PushScript( idLexer *script ) {
 	//push the script on the script stack
 	script->next = idParser::scriptstack;
 	idParser::scriptstack = script;
+	idParser::sourceFiles.AddUnique( script->GetFileName() );
 }
 
 /*
@@ -434,6 +435,32 @@ int idParser::ReadSourceToken( idToken *token ) {
 		return false;
 	}
 	changedScript = 0;
+	// read next preprocessed token from stream
+	if ( !idParser::tokens && idParser::tokenStream ) {
+		if ( idParser::tokenStreamPos >= idParser::tokenStream->entries.Num() ) {
+			return false;
+		}
+		const idParserTokenStream::entry_t &entry = idParser::tokenStream->entries[idParser::tokenStreamPos++];
+		*static_cast<idStr *>(token) = entry.text;
+		token->type = entry.type;
+		token->subtype = entry.subtype;
+		token->line = entry.line;
+		token->linesCrossed = entry.linesCrossed;
+		token->flags = entry.flags;
+		token->intvalue = entry.intvalue;
+		token->floatvalue = entry.floatvalue;
+		token->whiteSpaceStart_p = NULL;
+		token->whiteSpaceEnd_p = NULL;
+		token->next = NULL;
+		// report same location as the parser which has recorded the stream
+		script = idParser::scriptstack;
+		if ( script->filename != idParser::tokenStream->fileNames[entry.file] ) {
+			script->filename = idParser::tokenStream->fileNames[entry.file];
+			script->displayFilename = idParser::tokenStream->displayFileNames[entry.file];
+		}
+		script->line = entry.sourceLine;
+		return true;
+	}
 	// if there's no token already available
 	while( !idParser::tokens ) {
 		// if there's a token to read from the script
@@ -2404,6 +2431,11 @@ idParser::ReadToken
 int idParser::ReadToken( idToken *token ) {
 	define_t *define;
 
+	if ( idParser::tokenStream ) {
+		// tokens are already preprocessed
+		return idParser::ReadSourceToken( token );
+	}
+
 	while(1) {
 		if ( !idParser::ReadSourceToken( token ) ) {
 			return false;
@@ -3093,6 +3125,8 @@ int idParser::LoadFile( const char *filename, bool OSPath ) {
 	script->next = NULL;
 	idParser::OSPath = OSPath;
 	idParser::filename = filename;
+	idParser::sourceFiles.Clear();
+	idParser::sourceFiles.Append( script->GetFileName() );
 	idParser::scriptstack = script;
 	idParser::tokens = NULL;
 	idParser::indentstack = NULL;
@@ -3128,6 +3162,7 @@ int idParser::LoadMemory(const char *ptr, int length, const char *name ) {
 	script->SetPunctuations( idParser::punctuations );
 	script->next = NULL;
 	idParser::filename = name;
+	idParser::sourceFiles.Clear();
 	idParser::scriptstack = script;
 	idParser::tokens = NULL;
 	idParser::indentstack = NULL;
@@ -3142,6 +3177,36 @@ int idParser::LoadMemory(const char *ptr, int length, const char *name ) {
 	return true;
 }
 
+/*
+================
+idParser::LoadTokenStream
+================
+*/
+int idParser::LoadTokenStream( const idParserTokenStream *stream, const char *name ) {
+	idLexer *script;
+
+	if ( idParser::loaded ) {
+		idLib::common->FatalError("idParser::LoadTokenStream: another source already loaded");
+		return false;
+	}
+	// empty script only keeps current file name and line for error reporting
+	script = new idLexer( "", 0, name );
+	script->SetFlags( idParser::flags );
+	script->SetPunctuations( idParser::punctuations );
+	script->next = NULL;
+	idParser::filename = name;
+	idParser::sourceFiles = stream->sourceFiles;
+	idParser::scriptstack = script;
+	idParser::tokens = NULL;
+	idParser::indentstack = NULL;
+	idParser::skip = 0;
+	idParser::tokenStream = stream;
+	idParser::tokenStreamPos = 0;
+	idParser::loaded = true;
+	idLexerMessages::Print( stream->messages );
+	return true;
+}
+
 /*
 ================
 idParser::FreeSource
@@ -3188,6 +3253,8 @@ void idParser::FreeSource( bool keepDefines ) {
 			definehash = NULL;
 		}
 	}
+	tokenStream = NULL;
+	tokenStreamPos = 0;
 	loaded = false;
 }
 
@@ -3249,6 +3316,8 @@ idParser::idParser() {
 	this->defines = NULL;
 	this->tokens = NULL;
 	this->marker_p = NULL;
+	this->tokenStream = NULL;
+	this->tokenStreamPos = 0;
 }
 
 /*
@@ -3267,6 +3336,8 @@ idParser::idParser( int flags ) {
 	this->defines = NULL;
 	this->tokens = NULL;
 	this->marker_p = NULL;
+	this->tokenStream = NULL;
+	this->tokenStreamPos = 0;
 }
 
 /*
@@ -3285,6 +3356,8 @@ idParser::idParser( const char *filename, int flags, bool OSPath ) {
 	this->defines = NULL;
 	this->tokens = NULL;
 	this->marker_p = NULL;
+	this->tokenStream = NULL;
+	this->tokenStreamPos = 0;
 	LoadFile( filename, OSPath );
 }
 
@@ -3304,6 +3377,8 @@ idParser::idParser( const char *ptr, int length, const char *name, int flags ) {
 	this->defines = NULL;
 	this->tokens = NULL;
 	this->marker_p = NULL;
+	this->tokenStream = NULL;
+	this->tokenStreamPos = 0;
 	LoadMemory( ptr, length, name );
 }
 
@@ -3316,3 +3391,166 @@ idParser::~idParser( void ) {
 	idParser::FreeSource( false );
 }
 
+
+/*
+================
+idParserTokenStream::Clear
+================
+*/
+void idParserTokenStream::Clear( void ) {
+	entries.Clear();
+	fileNames.Clear();
+	displayFileNames.Clear();
+	sourceFiles.Clear();
+	messages.Clear();
+}
+
+/*
+================
+idParserTokenStream::Record
+================
+*/
+void idParserTokenStream::Record( idParser &src ) {
+	idToken token;
+	int lastFile = -1;
+
+	Clear();
+	// the messages are printed when the stream is loaded
+	idLexerMessages capture;
+	while ( src.ReadToken( &token ) ) {
+		entry_t &entry = entries.Alloc();
+		entry.text = token;
+		entry.type = token.type;
+		entry.subtype = token.subtype;
+		entry.line = token.line;
+		entry.linesCrossed = token.linesCrossed;
+		entry.flags = token.flags;
+		// note: values of evaluated tokens (e.g. $evalfloat) can differ from their text
+		entry.intvalue = token.GetUnsignedIntValue();
+		entry.floatvalue = token.GetDoubleValue();
+		if ( token.type == TT_NUMBER ) {
+			entry.subtype |= TT_VALUESVALID;
+		}
+		entry.sourceLine = src.GetLineNum();
+
+		// tokens come in long runs from the same file
+		const char *fileName = src.GetFileName();
+		if ( lastFile < 0 || fileNames[lastFile] != fileName ) {
+			lastFile = fileNames.FindIndex( fileName );
+			if ( lastFile < 0 ) {
+				lastFile = fileNames.Append( fileName );
+				displayFileNames.Append( src.GetDisplayFileName() );
+			}
+		}
+		entry.file = lastFile;
+	}
+	sourceFiles = src.GetSourceFiles();
+	messages = capture.GetMessages();
+}
+
+/*
+================
+idParserTokenStream::WriteToFile
+================
+*/
+void idParserTokenStream::WriteToFile( idFile *f ) const {
+	int i;
+
+	f->WriteInt( fileNames.Num() );
+	for ( i = 0; i < fileNames.Num(); i++ ) {
+		f->WriteString( fileNames[i] );
+		f->WriteString( displayFileNames[i] );
+	}
+	f->WriteInt( sourceFiles.Num() );
+	for ( i = 0; i < sourceFiles.Num(); i++ ) {
+		f->WriteString( sourceFiles[i] );
+	}
+	f->WriteInt( messages.Num() );
+	for ( i = 0; i < messages.Num(); i++ ) {
+		f->WriteString( messages[i] );
+	}
+	f->WriteInt( entries.Num() );
+	for ( i = 0; i < entries.Num(); i++ ) {
+		const entry_t &entry = entries[i];
+		f->WriteString( entry.text );
+		f->WriteInt( entry.type );
+		f->WriteInt( entry.subtype );
+		f->WriteInt( entry.line );
+		f->WriteInt( entry.linesCrossed );
+		f->WriteInt( entry.flags );
+		f->WriteUnsignedInt( entry.intvalue );
+		unsigned int halves[2];
+		static_assert( sizeof( halves ) == sizeof( entry.floatvalue ), "" );
+		memcpy( halves, &entry.floatvalue, sizeof( halves ) );
+		f->WriteUnsignedInt( halves[0] );
+		f->WriteUnsignedInt( halves[1] );
+		f->WriteInt( entry.file );
+		f->WriteInt( entry.sourceLine );
+	}
+}
+
+/*
+================
+idParserTokenStream::ReadFromFile
+================
+*/
+bool idParserTokenStream::ReadFromFile( idFile *f ) {
+	int i, num = -1;
+
+	Clear();
+
+	f->ReadInt( num );
+	if ( num < 0 ) {
+		return false;
+	}
+	fileNames.SetNum( num );
+	displayFileNames.SetNum( num );
+	for ( i = 0; i < num; i++ ) {
+		f->ReadString( fileNames[i] );
+		f->ReadString( displayFileNames[i] );
+	}
+	num = -1;
+	f->ReadInt( num );
+	if ( num < 0 ) {
+		return false;
+	}
+	sourceFiles.SetNum( num );
+	for ( i = 0; i < num; i++ ) {
+		f->ReadString( sourceFiles[i] );
+	}
+	num = -1;
+	f->ReadInt( num );
+	if ( num < 0 ) {
+		return false;
+	}
+	messages.SetNum( num );
+	for ( i = 0; i < num; i++ ) {
+		f->ReadString( messages[i] );
+	}
+	num = -1;
+	f->ReadInt( num );
+	if ( num < 0 ) {
+		return false;
+	}
+	entries.SetNum( num );
+	for ( i = 0; i < num; i++ ) {
+		entry_t &entry = entries[i];
+		f->ReadString( entry.text );
+		f->ReadInt( entry.type );
+		f->ReadInt( entry.subtype );
+		f->ReadInt( entry.line );
+		f->ReadInt( entry.linesCrossed );
+		f->ReadInt( entry.flags );
+		f->ReadUnsignedInt( entry.intvalue );
+		unsigned int halves[2];
+		f->ReadUnsignedInt( halves[0] );
+		f->ReadUnsignedInt( halves[1] );
+		memcpy( &entry.floatvalue, halves, sizeof( halves ) );
+		f->ReadInt( entry.file );
+		if ( f->ReadInt( entry.sourceLine ) != sizeof( int ) || entry.file < 0 || entry.file >= fileNames.Num() ) {
+			Clear();
+			return false;
+		}
+	}
+	return true;
+}
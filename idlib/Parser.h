@@ -59,6 +59,56 @@ typedef struct indent_s {
 	struct indent_s	*next;						// next indent on the indent stack
 } indent_t;
 
+class idParser;
+
+/*
+===============================================================================
+
+	Preprocessed token stream
+
+	Holds all tokens returned by idParser after preprocessing (includes, defines,
+	conditional compilation), along with file name and line reported for each of them.
+	The stream can be saved to file, and idParser can later read tokens from it
+	without loading and preprocessing the source text again.
+	Warnings issued while preprocessing are kept too, and printed whenever the stream is loaded.
+
+===============================================================================
+*/
+
+class idParserTokenStream {
+public:
+	void			Clear( void );
+					// read all tokens from the loaded source until its end
+	void			Record( idParser &src );
+	int				Num( void ) const { return entries.Num(); }
+					// names of all files loaded while recording (including files with no tokens, e.g. with only defines)
+	const idList<idStr> &GetSourceFiles( void ) const { return sourceFiles; }
+	void			WriteToFile( idFile *f ) const;
+	bool			ReadFromFile( idFile *f );
+
+private:
+	friend class idParser;
+
+	typedef struct {
+		idStr		text;
+		int			type;
+		int			subtype;
+		int			line;
+		int			linesCrossed;
+		int			flags;
+		unsigned int intvalue;
+		double		floatvalue;
+		int			file;						// index in fileNames
+		int			sourceLine;					// what idParser::GetLineNum returned after reading the token
+	} entry_t;
+
+	idList<entry_t>	entries;
+	idList<idStr>	fileNames;
+	idList<idStr>	displayFileNames;
+	idList<idStr>	sourceFiles;
+	idList<idStr>	messages;					// preprocessor warnings and errors
+};
+
 
 class idParser {
 
@@ -75,6 +125,9 @@ public:
 					// load a source from the given memory with the given length
 					// NOTE: the ptr is expected to point at a valid C string: ptr[length] == '\0'
 	int				LoadMemory( const char *ptr, int length, const char *name );
+					// read preprocessed tokens from the given stream instead of a source, prints its preprocessor messages
+					// note: the stream must stay alive until the source is freed
+	int				LoadTokenStream( const idParserTokenStream *stream, const char *name );
 					// free the current source
 	void			FreeSource( bool keepDefines = false );
 					// returns true if a source is loaded
@@ -171,6 +224,8 @@ public:
 					// stgatilov: returns string representation of macro value
 					// it is just concatenation of all replacement tokens (useful for constants)
 	idStr			GetDefineValueString(const char *name);
+					// returns names of all files loaded into this source, including the ones loaded with #include
+	const idList<idStr> &GetSourceFiles( void ) const { return sourceFiles; }
 
 private:
 	int				loaded;						// set when a source file is loaded from file or memory
@@ -186,6 +241,9 @@ private:
 	indent_t *		indentstack;				// stack with indents
 	int				skip;						// > 0 if skipping conditional code
 	const char*		marker_p;
+	idList<idStr>	sourceFiles;				// all files loaded into this source
+	const idParserTokenStream *tokenStream;		// if set, preprocessed tokens are read from here
+	int				tokenStreamPos;				// next token in tokenStream
 
 	static define_t *globaldefines;				// list with global defines added to every source loaded
 
@@ -1577,6 +1577,126 @@ bool idLCP_Symmetric::Solve( const idMatX &o_m, idVecX &o_x, const idVecX &o_b,
 }
 
 
+//===============================================================
+//
+//  idLCP_GaussSeidel
+//
+//  Projected Gauss-Seidel: every sweep solves each row for its own
+//  variable with all others fixed and clamps it to its bounds.
+//  Cost per sweep is O(n^2) instead of the O(n^3) worst case of the
+//  pivoting solvers, and starting from the previous frame's solution
+//  usually leaves only a few sweeps to do. The result is approximate
+//  when maxIterations is reached before convergence.
+//
+//===============================================================
+
+const float LCP_ITERATIVE_EPSILON		= 1e-4f;
+
+class idLCP_GaussSeidel : public idLCP {
+public:
+	virtual bool	Solve( const idMatX &o_m, idVecX &o_x, const idVecX &o_b, const idVecX &o_lo, const idVecX &o_hi, const int *o_boxIndex ) override;
+};
+
+/*
+============
+idLCP_GaussSeidel::Solve
+
+  o_x on input is the initial guess
+============
+*/
+bool idLCP_GaussSeidel::Solve( const idMatX &o_m, idVecX &o_x, const idVecX &o_b, const idVecX &o_lo, const idVecX &o_hi, const int *o_boxIndex ) {
+	int i, j, n, iteration, numIgnored;
+	float dot, lo, hi, x, delta, maxDelta, maxForce;
+	float *invDiagonal;
+	int *order;
+
+	n = o_m.GetNumRows();
+
+	assert( ((n+3)&~3) == o_m.GetNumColumns() || n == o_m.GetNumColumns() );
+	assert( o_x.GetSize() == n );
+	assert( o_b.GetSize() == n );
+	assert( o_lo.GetSize() == n );
+	assert( o_hi.GetSize() == n );
+
+	// solve the variables without box index first, the others take their bounds from them
+	order = (int *) _alloca16( n * sizeof( int ) );
+	for ( i = j = 0; i < n; i++ ) {
+		if ( !o_boxIndex || o_boxIndex[i] == -1 ) {
+			order[j++] = i;
+		}
+	}
+	for ( i = 0; i < n && j < n; i++ ) {
+		if ( o_boxIndex[i] != -1 ) {
+			order[j++] = i;
+		}
+	}
+
+	// variables without a positive diagonal cannot be solved for and exert no force
+	invDiagonal = (float *) _alloca16( n * sizeof( float ) );
+	numIgnored = 0;
+	for ( i = 0; i < n; i++ ) {
+		if ( o_m[i][i] > LCP_DELTA_FORCE_EPSILON ) {
+			invDiagonal[i] = 1.0f / o_m[i][i];
+		} else {
+			invDiagonal[i] = 0.0f;
+			numIgnored++;
+		}
+		if ( FLOAT_IS_NAN( o_x[i] ) || invDiagonal[i] == 0.0f ) {
+			o_x[i] = 0.0f;
+		}
+	}
+
+	for ( iteration = 0; iteration < maxIterations; iteration++ ) {
+		maxDelta = 0.0f;
+		maxForce = 0.0f;
+
+		for ( j = 0; j < n; j++ ) {
+			i = order[j];
+
+			if ( o_boxIndex && o_boxIndex[i] != -1 ) {
+				lo = -idMath::Fabs( o_lo[i] * o_x[o_boxIndex[i]] );
+				hi = idMath::Fabs( o_hi[i] * o_x[o_boxIndex[i]] );
+			} else {
+				lo = o_lo[i];
+				hi = o_hi[i];
+			}
+
+			SIMDProcessor->Dot( dot, o_m[i], o_x.ToFloatPtr(), n );
+			x = o_x[i] + ( o_b[i] - dot ) * invDiagonal[i];
+			if ( x < lo ) {
+				x = lo;
+			} else if ( x > hi ) {
+				x = hi;
+			}
+
+			delta = idMath::Fabs( x - o_x[i] );
+			if ( delta > maxDelta ) {
+				maxDelta = delta;
+			}
+			if ( idMath::Fabs( x ) > maxForce ) {
+				maxForce = idMath::Fabs( x );
+			}
+			o_x[i] = x;
+		}
+
+		if ( maxDelta <= LCP_ITERATIVE_EPSILON * Max( maxForce, 1.0f ) ) {
+			break;
+		}
+	}
+
+	if ( lcp_showFailures.GetBool() ) {
+		if ( numIgnored ) {
+			idLib::common->Printf( "idLCP_GaussSeidel::Solve: %d of %d variables ignored\n", numIgnored, n );
+		}
+		if ( iteration >= maxIterations ) {
+			idLib::common->Printf( "idLCP_GaussSeidel::Solve: no convergence after %d iterations\n", maxIterations );
+		}
+	}
+
+	return true;
+}
+
+
 //===============================================================
 //
 //	idLCP
@@ -1605,6 +1725,17 @@ idLCP *idLCP::AllocSymmetric( void ) {
 	return lcp;
 }
 
+/*
+============
+idLCP::AllocIterative
+============
+*/
+idLCP *idLCP::AllocIterative( void ) {
+	idLCP *lcp = new idLCP_GaussSeidel;
+	lcp->SetMaxIterations( 64 );
+	return lcp;
+}
+
 /*
 ============
 idLCP::~idLCP
@@ -1630,3 +1761,171 @@ idLCP::GetMaxIterations
 int idLCP::GetMaxIterations( void ) {
 	return maxIterations;
 }
+
+
+#include "../tests/testing.h"
+
+// random problem shaped like those built by idPhysics_AF: A = J * J^T + epsilon with
+// unbounded, one sided (contact), box indexed (friction) and limited rows
+static void LCP_RandomProblem( idRandom &rnd, int n, idMatX &A, idVecX &b, idVecX &lo, idVecX &hi, int *boxIndex ) {
+	idMatX J;
+	J.SetSize( n, n + 6 );
+	for ( int i = 0; i < J.GetNumRows(); i++ ) {
+		for ( int j = 0; j < J.GetNumColumns(); j++ ) {
+			J[i][j] = rnd.CRandomFloat();
+		}
+	}
+	A.SetSize( n, n );
+	for ( int i = 0; i < n; i++ ) {
+		for ( int j = 0; j < n; j++ ) {
+			float dot = 0.0f;
+			for ( int k = 0; k < J.GetNumColumns(); k++ ) {
+				dot += J[i][k] * J[j][k];
+			}
+			A[i][j] = dot;
+		}
+		A[i][i] += 0.01f;
+	}
+	b.SetSize( n );
+	lo.SetSize( n );
+	hi.SetSize( n );
+	for ( int i = 0; i < n; i++ ) {
+		b[i] = 10.0f * rnd.CRandomFloat();
+		boxIndex[i] = -1;
+		switch( i & 3 ) {
+			case 0: lo[i] = -idMath::INFINITY; hi[i] = idMath::INFINITY; break;
+			case 1: lo[i] = 0.0f; hi[i] = idMath::INFINITY; break;
+			case 2: lo[i] = 0.5f; hi[i] = 0.5f; boxIndex[i] = i - 1; break;
+			case 3: lo[i] = -5.0f; hi[i] = 5.0f; break;
+		}
+	}
+}
+
+// largest violation of the complementarity conditions by x
+static float LCP_Residual( const idMatX &A, const idVecX &x, const idVecX &b, const idVecX &lo, const idVecX &hi, const int *boxIndex ) {
+	float residual = 0.0f;
+	for ( int i = 0; i < x.GetSize(); i++ ) {
+		float l = lo[i], h = hi[i];
+		if ( boxIndex[i] != -1 ) {
+			l = -idMath::Fabs( lo[i] * x[boxIndex[i]] );
+			h = idMath::Fabs( hi[i] * x[boxIndex[i]] );
+		}
+		float t = -b[i];
+		for ( int j = 0; j < x.GetSize(); j++ ) {
+			t += A[i][j] * x[j];
+		}
+		float epsilon = 1e-3f * ( 1.0f + idMath::Fabs( x[i] ) );
+		bool atLo = x[i] <= l + epsilon;
+		bool atHi = x[i] >= h - epsilon;
+		if ( x[i] < l - epsilon || x[i] > h + epsilon ) {
+			residual = Max( residual, Min( idMath::Fabs( x[i] - l ), idMath::Fabs( x[i] - h ) ) );
+		} else if ( atLo && atHi ) {
+			continue;
+		} else if ( atLo ) {
+			residual = Max( residual, -t );
+		} else if ( atHi ) {
+			residual = Max( residual, t );
+		} else {
+			residual = Max( residual, idMath::Fabs( t ) );
+		}
+	}
+	return residual;
+}
+
+TEST_CASE("LCP:IterativeMatchesPivoting") {
+	idLCP *pivoting = idLCP::AllocSymmetric();
+	idLCP *iterative = idLCP::AllocIterative();
+	iterative->SetMaxIterations( 1000 );
+	idRandom rnd;
+
+	static const int sizes[] = { 4, 8, 24, 48 };
+	for ( int size : sizes ) {
+		for ( int attempt = 0; attempt < 10; attempt++ ) {
+			idMatX A;
+			idVecX b, lo, hi, x1, x2;
+			int *boxIndex = (int *)_alloca16( size * sizeof( int ) );
+			LCP_RandomProblem( rnd, size, A, b, lo, hi, boxIndex );
+
+			x1.Zero( size );
+			REQUIRE( pivoting->Solve( A, x1, b, lo, hi, boxIndex ) );
+			x2.Zero( size );
+			REQUIRE( iterative->Solve( A, x2, b, lo, hi, boxIndex ) );
+
+			float pivotingResidual = LCP_Residual( A, x1, b, lo, hi, boxIndex );
+			float iterativeResidual = LCP_Residual( A, x2, b, lo, hi, boxIndex );
+			CHECK( iterativeResidual <= Max( 10.0f * pivotingResidual, 1e-2f ) );
+		}
+	}
+
+	delete pivoting;
+	delete iterative;
+}
+
+TEST_CASE("LCP:IterativeWarmStart") {
+	idLCP *iterative = idLCP::AllocIterative();
+	idRandom rnd;
+
+	idMatX A;
+	idVecX b, lo, hi, x;
+	int boxIndex[32];
+	LCP_RandomProblem( rnd, 32, A, b, lo, hi, boxIndex );
+
+	iterative->SetMaxIterations( 1000 );
+	x.Zero( 32 );
+	iterative->Solve( A, x, b, lo, hi, boxIndex );
+	float residual = LCP_Residual( A, x, b, lo, hi, boxIndex );
+	CHECK( residual <= 1e-2f );
+
+	// starting from the solution a single sweep must not lose it
+	iterative->SetMaxIterations( 1 );
+	iterative->Solve( A, x, b, lo, hi, boxIndex );
+	CHECK( LCP_Residual( A, x, b, lo, hi, boxIndex ) <= Max( 2.0f * residual, 1e-2f ) );
+
+	// while a single sweep from zero is far off
+	x.Zero( 32 );
+	iterative->Solve( A, x, b, lo, hi, boxIndex );
+	CHECK( LCP_Residual( A, x, b, lo, hi, boxIndex ) > 1e-2f );
+
+	delete iterative;
+}
+
+TEST_CASE("LCP:IterativePerformance"
+	* doctest::skip()
+) {
+	idLCP *pivoting = idLCP::AllocSymmetric();
+	idLCP *iterative = idLCP::AllocIterative();
+	idRandom rnd;
+
+	for ( int size = 16; size <= 256; size *= 2 ) {
+		static const int REPEATS = 20;
+		idMatX A;
+		idVecX b, lo, hi, x;
+		int *boxIndex = (int *)Mem_Alloc( size * sizeof( int ) );
+		LCP_RandomProblem( rnd, size, A, b, lo, hi, boxIndex );
+
+		idTimer pivotingTimer, coldTimer, warmTimer;
+		for ( int r = 0; r < REPEATS; r++ ) {
+			x.Zero( size );
+			pivotingTimer.Start();
+			pivoting->Solve( A, x, b, lo, hi, boxIndex );
+			pivotingTimer.Stop();
+
+			x.Zero( size );
+			coldTimer.Start();
+			iterative->Solve( A, x, b, lo, hi, boxIndex );
+			coldTimer.Stop();
+
+			// next frame: slightly different right hand side, previous solution as the guess
+			b *= 1.01f;
+			warmTimer.Start();
+			iterative->Solve( A, x, b, lo, hi, boxIndex );
+			warmTimer.Stop();
+			b *= 1.0f / 1.01f;
+		}
+		MESSAGE( size << " rows: pivoting " << pivotingTimer.Milliseconds() / REPEATS << " ms, iterative " << coldTimer.Milliseconds() / REPEATS << " ms, warm started " << warmTimer.Milliseconds() / REPEATS << " ms" );
+		Mem_Free( boxIndex );
+	}
+
+	delete pivoting;
+	delete iterative;
+}
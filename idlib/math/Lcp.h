@@ -43,6 +43,11 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
   Before calculating any of the bounded x[i] with boxIndex[i] != -1 the
   solver calculates all unbounded x[i] and all x[i] with boxIndex[i] == -1.
 
+  The iterative solver uses projected Gauss-Seidel sweeps starting from
+  the x passed in, so the previous solution of a similar problem can be
+  used as a warm start. It stops after maxIterations sweeps even if the
+  solution has not converged.
+
 ===============================================================================
 */
 
@@ -50,6 +55,7 @@ class idLCP {
 public:
 	static idLCP *	AllocSquare( void );		// A must be a square matrix
 	static idLCP *	AllocSymmetric( void );		// A must be a symmetric matrix
+	static idLCP *	AllocIterative( void );		// approximate, x on input is used as the initial guess
 
 	virtual			~idLCP( void );
 
@@ -2044,9 +2044,10 @@ private:
 	int				alloced;				// floats allocated, if -1 then mat points to data set with SetData
 	float *			mat;					// memory the matrix is stored
 
-	static float	temp[MATX_MAX_TEMP+4];	// used to store intermediate results
-	static float *	tempPtr;				// pointer to 16 byte aligned temporary memory
-	static int		tempIndex;				// index into memory pool, wraps around
+	// per thread, so that physics jobs can use temporaries concurrently
+	// constant initialized, so that the first access from a thread needs no initialization
+	alignas( 16 ) static thread_local float	temp[MATX_MAX_TEMP];	// used to store intermediate results
+	static thread_local int		tempIndex;				// index into memory pool, wraps around
 
 private:
 	void			SetTempSize( int rows, int columns );
@@ -2070,7 +2071,7 @@ ID_INLINE idMatX::idMatX( void ) {
 
 ID_INLINE idMatX::~idMatX( void ) {
 	// if not temp memory
-	if ( mat != NULL && ( mat < idMatX::tempPtr || mat > idMatX::tempPtr + MATX_MAX_TEMP ) && alloced != -1 ) {
+	if ( mat != NULL && ( mat < idMatX::temp || mat > idMatX::temp + MATX_MAX_TEMP ) && alloced != -1 ) {
 		Mem_Free16( mat );
 	}
 }
@@ -2317,7 +2318,7 @@ ID_INLINE bool idMatX::operator!=( const idMatX &a ) const {
 }
 
 ID_INLINE void idMatX::SetSize( int rows, int columns ) {
-	assert( mat < idMatX::tempPtr || mat > idMatX::tempPtr + MATX_MAX_TEMP );
+	assert( mat < idMatX::temp || mat > idMatX::temp + MATX_MAX_TEMP );
 	int alloc = ( rows * columns + 3 ) & ~3;
 	if ( alloc > alloced && alloced != -1 ) {
 		if ( mat != NULL ) {
@@ -2339,7 +2340,7 @@ ID_INLINE void idMatX::SetTempSize( int rows, int columns ) {
 	if ( idMatX::tempIndex + newSize > MATX_MAX_TEMP ) {
 		idMatX::tempIndex = 0;
 	}
-	mat = idMatX::tempPtr + idMatX::tempIndex;
+	mat = idMatX::temp + idMatX::tempIndex;
 	idMatX::tempIndex += newSize;
 	alloced = newSize;
 	numRows = rows;
@@ -2348,7 +2349,7 @@ ID_INLINE void idMatX::SetTempSize( int rows, int columns ) {
 }
 
 ID_INLINE void idMatX::SetData( int rows, int columns, float *data ) {
-	assert( mat < idMatX::tempPtr || mat > idMatX::tempPtr + MATX_MAX_TEMP );
+	assert( mat < idMatX::temp || mat > idMatX::temp + MATX_MAX_TEMP );
 	if ( mat != NULL && alloced != -1 ) {
 		Mem_Free16( mat );
 	}
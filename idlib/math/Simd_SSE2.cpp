@@ -306,6 +306,124 @@ int idSIMD_SSE2::CreateVertexProgramShadowCache( idVec4 *shadowVerts, const idDr
 	return numVerts * 2;
 }
 
+//intrinsics port of ID's SSE slerp, which is only available in 32-bit MSVC builds
+//four joints are transposed into SoA registers and blended together
+//atan2 and sin are approximated with the same polynomials as in ID's code
+void idSIMD_SSE2::BlendJoints( idJointQuat *joints, const idJointQuat *blendJoints, const float lerp, const int *index, const int numJoints ) {
+	if ( lerp <= 0.0f ) {
+		return;
+	}
+	if ( lerp >= 1.0f ) {
+		for ( int i = 0; i < numJoints; i++ ) {
+			int j = index[i];
+			joints[j] = blendJoints[j];
+		}
+		return;
+	}
+
+	static_assert(sizeof(idJointQuat) == 28 && OFFSETOF(idJointQuat, t) == 16, "SSE2 BlendJoints relies on idJointQuat layout");
+
+	const __m128 vLerp = _mm_set1_ps( lerp );
+	const __m128 one = _mm_set1_ps( 1.0f );
+	const __m128 tiny = _mm_set1_ps( 1e-10f );
+	const __m128 halfPI = _mm_set1_ps( idMath::HALF_PI );
+	const __m128 signMask = _mm_castsi128_ps( _mm_set1_epi32( 0x80000000 ) );
+
+	for ( int i = 0; i < numJoints; i += 4 ) {
+		// the last group repeats its last joint to fill all lanes
+		float *dst[4];
+		const float *src[4];
+		for ( int k = 0; k < 4; k++ ) {
+			int j = index[ Min( i + k, numJoints - 1 ) ];
+			dst[k] = joints[j].q.ToFloatPtr();
+			src[k] = blendJoints[j].q.ToFloatPtr();
+		}
+
+		// q is loaded as (x, y, z, w), t is loaded as (w, x, y, z) to stay within the joint
+		__m128 qx = _mm_loadu_ps( dst[0] ), qy = _mm_loadu_ps( dst[1] ), qz = _mm_loadu_ps( dst[2] ), qw = _mm_loadu_ps( dst[3] );
+		__m128 bx = _mm_loadu_ps( src[0] ), by = _mm_loadu_ps( src[1] ), bz = _mm_loadu_ps( src[2] ), bw = _mm_loadu_ps( src[3] );
+		__m128 tw = _mm_loadu_ps( dst[0] + 3 ), tx = _mm_loadu_ps( dst[1] + 3 ), ty = _mm_loadu_ps( dst[2] + 3 ), tz = _mm_loadu_ps( dst[3] + 3 );
+		__m128 sw = _mm_loadu_ps( src[0] + 3 ), sx = _mm_loadu_ps( src[1] + 3 ), sy = _mm_loadu_ps( src[2] + 3 ), sz = _mm_loadu_ps( src[3] + 3 );
+		_MM_TRANSPOSE4_PS( qx, qy, qz, qw );
+		_MM_TRANSPOSE4_PS( bx, by, bz, bw );
+		_MM_TRANSPOSE4_PS( tw, tx, ty, tz );
+		_MM_TRANSPOSE4_PS( sw, sx, sy, sz );
+
+		tx = _mm_add_ps( tx, _mm_mul_ps( _mm_sub_ps( sx, tx ), vLerp ) );
+		ty = _mm_add_ps( ty, _mm_mul_ps( _mm_sub_ps( sy, ty ), vLerp ) );
+		tz = _mm_add_ps( tz, _mm_mul_ps( _mm_sub_ps( sz, tz ), vLerp ) );
+
+		__m128 cosom = _mm_add_ps(
+			_mm_add_ps( _mm_mul_ps( qx, bx ), _mm_mul_ps( qy, by ) ),
+			_mm_add_ps( _mm_mul_ps( qz, bz ), _mm_mul_ps( qw, bw ) )
+		);
+		__m128 signBit = _mm_and_ps( cosom, signMask );
+		cosom = _mm_xor_ps( cosom, signBit );
+
+		__m128 sqrSinom = _mm_max_ps( _mm_sub_ps( one, _mm_mul_ps( cosom, cosom ) ), tiny );
+		__m128 sinom = _mm_sqrt_ps( sqrSinom );
+		__m128 invSinom = _mm_div_ps( one, sinom );
+
+		// omega = atan2( sinom, cosom ), both arguments are non-negative
+		__m128 minArg = _mm_min_ps( cosom, sinom );
+		__m128 maxArg = _mm_max_ps( cosom, sinom );
+		__m128 swapped = _mm_cmpeq_ps( cosom, minArg );
+		__m128 a = _mm_xor_ps( _mm_div_ps( minArg, maxArg ), _mm_and_ps( swapped, signMask ) );
+		__m128 a2 = _mm_mul_ps( a, a );
+		__m128 p = _mm_set1_ps( 0.0028662257f );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), _mm_set1_ps( -0.0161657367f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), _mm_set1_ps( 0.0429096138f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), _mm_set1_ps( -0.0752896400f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), _mm_set1_ps( 0.1065626393f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), _mm_set1_ps( -0.1420889944f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), _mm_set1_ps( 0.1999355085f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), _mm_set1_ps( -0.3333314528f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, a2 ), one );
+		__m128 omega = _mm_add_ps( _mm_mul_ps( p, a ), _mm_and_ps( swapped, halfPI ) );
+
+		__m128 omega1 = _mm_mul_ps( omega, vLerp );
+		__m128 omega0 = _mm_sub_ps( omega, omega1 );
+
+		// sin( x ) for x in [0, PI/2]
+		#define SIN_ZERO_HALF_PI( dst, x ) \
+			__m128 dst; \
+			{ \
+				__m128 x2 = _mm_mul_ps( x, x ); \
+				__m128 s = _mm_set1_ps( -2.39e-08f ); \
+				s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( 2.7526e-06f ) ); \
+				s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( -1.98409e-04f ) ); \
+				s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( 8.3333315e-03f ) ); \
+				s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( -1.666666664e-01f ) ); \
+				s = _mm_add_ps( _mm_mul_ps( s, x2 ), one ); \
+				dst = _mm_mul_ps( s, x ); \
+			}
+		SIN_ZERO_HALF_PI( sin0, omega0 );
+		SIN_ZERO_HALF_PI( sin1, omega1 );
+		#undef SIN_ZERO_HALF_PI
+
+		__m128 scale0 = _mm_mul_ps( sin0, invSinom );
+		__m128 scale1 = _mm_xor_ps( _mm_mul_ps( sin1, invSinom ), signBit );
+
+		qx = _mm_add_ps( _mm_mul_ps( qx, scale0 ), _mm_mul_ps( bx, scale1 ) );
+		qy = _mm_add_ps( _mm_mul_ps( qy, scale0 ), _mm_mul_ps( by, scale1 ) );
+		qz = _mm_add_ps( _mm_mul_ps( qz, scale0 ), _mm_mul_ps( bz, scale1 ) );
+		qw = _mm_add_ps( _mm_mul_ps( qw, scale0 ), _mm_mul_ps( bw, scale1 ) );
+
+		tw = qw;
+		_MM_TRANSPOSE4_PS( qx, qy, qz, qw );
+		_MM_TRANSPOSE4_PS( tw, tx, ty, tz );
+		// duplicated lanes of the last group store the same values, t store overlaps q.w with the same value
+		_mm_storeu_ps( dst[3] + 3, tz );
+		_mm_storeu_ps( dst[3], qw );
+		_mm_storeu_ps( dst[2] + 3, ty );
+		_mm_storeu_ps( dst[2], qz );
+		_mm_storeu_ps( dst[1] + 3, tx );
+		_mm_storeu_ps( dst[1], qy );
+		_mm_storeu_ps( dst[0] + 3, tw );
+		_mm_storeu_ps( dst[0], qx );
+	}
+}
+
 void idSIMD_SSE2::TracePointCull( byte *cullBits, byte &totalOr, const float radius, const idPlane *planes, const idDrawVert *verts, const int numVerts ) {
 	__m128 pA = _mm_loadu_ps(planes[0].ToFloatPtr());
 	__m128 pB = _mm_loadu_ps(planes[1].ToFloatPtr());
@@ -1129,4 +1247,107 @@ void idSIMD_SSE2::CompressDXT5FromRGBA8( const byte *srcPtr, int width, int heig
 	ProcessWithKernel<8, 2>( Dxt5Kernel32x4, srcPtr, width, height, stride, dstPtr );
 }
 
+#include "../tests/testing.h"
+
+// random pose, some joints are copied from (or negated) reference pose to hit nearly identical rotations
+static void BlendJoints_RandomPose( idRandom &rnd, idJointQuat *pose, const idJointQuat *reference, int numJoints ) {
+	for ( int i = 0; i < numJoints; i++ ) {
+		idAngles angles( rnd.CRandomFloat() * 180.0f, rnd.CRandomFloat() * 180.0f, rnd.CRandomFloat() * 180.0f );
+		pose[i].q = angles.ToQuat();
+		pose[i].t.Set( rnd.CRandomFloat() * 100.0f, rnd.CRandomFloat() * 100.0f, rnd.CRandomFloat() * 100.0f );
+		if ( reference && rnd.RandomInt( 4 ) == 0 ) {
+			pose[i].q = reference[i].q;
+			if ( rnd.RandomInt( 2 ) ) {
+				pose[i].q.x += rnd.CRandomFloat() * 1e-4f;
+				pose[i].q.Normalize();
+			}
+			if ( rnd.RandomInt( 2 ) ) {
+				pose[i].q = -pose[i].q;
+			}
+		}
+	}
+}
+
+static float BlendJoints_MaxDifference( const idJointQuat *a, const idJointQuat *b, int numJoints ) {
+	float maxDiff = 0.0f;
+	for ( int i = 0; i < numJoints; i++ ) {
+		for ( int c = 0; c < 4; c++ ) {
+			maxDiff = Max( maxDiff, idMath::Fabs( a[i].q[c] - b[i].q[c] ) );
+		}
+		for ( int c = 0; c < 3; c++ ) {
+			maxDiff = Max( maxDiff, idMath::Fabs( a[i].t[c] - b[i].t[c] ) / Max( idMath::Fabs( a[i].t[c] ), 1.0f ) );
+		}
+	}
+	return maxDiff;
+}
+
+TEST_CASE("SIMD:BlendJointsMatchesGeneric") {
+	static const int MAX_JOINTS = 75;
+	static const int NUM_ANIMS = 4;
+	idSIMD_Generic generic;
+	idSIMD_SSE2 sse2;
+	idRandom rnd;
+
+	idJointQuat base[MAX_JOINTS], anims[NUM_ANIMS][MAX_JOINTS];
+	idJointQuat genericPose[MAX_JOINTS], ssePose[MAX_JOINTS];
+	int index[MAX_JOINTS];
+
+	for ( int test = 0; test < 100; test++ ) {
+		int numJoints = 1 + rnd.RandomInt( MAX_JOINTS );
+		BlendJoints_RandomPose( rnd, base, nullptr, numJoints );
+		for ( int a = 0; a < NUM_ANIMS; a++ ) {
+			BlendJoints_RandomPose( rnd, anims[a], base, numJoints );
+		}
+		memcpy( genericPose, base, numJoints * sizeof( base[0] ) );
+		memcpy( ssePose, base, numJoints * sizeof( base[0] ) );
+
+		// mix several anims in sequence like idAnimBlend::BlendAnim does, each on a random subset of joints
+		for ( int a = 0; a < NUM_ANIMS; a++ ) {
+			int numIndex = 0;
+			for ( int j = 0; j < numJoints; j++ ) {
+				if ( a == 0 || rnd.RandomInt( 3 ) ) {
+					index[numIndex++] = j;
+				}
+			}
+			float lerp = rnd.RandomFloat();
+			if ( test % 10 == 0 ) {
+				lerp = ( a & 1 ) ? 1.0f : 0.0f;
+			}
+			generic.BlendJoints( genericPose, anims[a], lerp, index, numIndex );
+			sse2.BlendJoints( ssePose, anims[a], lerp, index, numIndex );
+			CHECK( BlendJoints_MaxDifference( genericPose, ssePose, numJoints ) < 1e-4f );
+		}
+	}
+}
+
+TEST_CASE("SIMD:BlendJointsPerformance"
+	* doctest::skip()
+) {
+	static const int NUM_JOINTS = 100;
+	static const int REPEATS = 100000;
+	idSIMD_Generic generic;
+	idSIMD_SSE2 sse2;
+	idRandom rnd;
+
+	idJointQuat base[NUM_JOINTS], anim[NUM_JOINTS], pose[NUM_JOINTS];
+	int index[NUM_JOINTS];
+	BlendJoints_RandomPose( rnd, base, nullptr, NUM_JOINTS );
+	BlendJoints_RandomPose( rnd, anim, base, NUM_JOINTS );
+	for ( int j = 0; j < NUM_JOINTS; j++ ) {
+		index[j] = j;
+	}
+
+	idSIMDProcessor *processors[2] = { &generic, &sse2 };
+	for ( idSIMDProcessor *processor : processors ) {
+		idTimer timer;
+		timer.Start();
+		for ( int r = 0; r < REPEATS; r++ ) {
+			memcpy( pose, base, sizeof( pose ) );
+			processor->BlendJoints( pose, anim, 0.3f + 0.4f * ( r & 1 ), index, NUM_JOINTS );
+		}
+		timer.Stop();
+		MESSAGE( processor->GetName() << ": " << timer.Milliseconds() * 1000.0 / REPEATS << " us per " << NUM_JOINTS << " joints" );
+	}
+}
+
 #endif
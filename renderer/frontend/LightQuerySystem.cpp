@@ -22,6 +22,13 @@ idCVar r_lqsParallel(
 	"r_lqsParallel", "0", CVAR_BOOL | CVAR_RENDERER, 
 	"Process queries in LightQuerySystem in parallel?"
 );
+idCVar r_lqsBatched(
+	"r_lqsBatched", "1", CVAR_BOOL | CVAR_RENDERER,
+	"Evaluate all pending queries in LightQuerySystem together, one light at a time?"
+);
+
+// max number of points lit by one light processed together (and in one job)
+static const int LIGHT_BATCH_SIZE = 64;
 
 // ==================================================================================
 
@@ -73,13 +80,236 @@ void LightQuerySystem::Forget( lightQuery_t query ) {
 void LightQuerySystem::Think( const viewDef_t *viewDef ) {
 	TRACE_CPU_SCOPE( "LQS::Think" );
 
+	int count[3] = {0};
+	idList<LightQuery*> pending;
+	pending.Reserve( queries.Num() );
+	for ( int i = 0; i < queries.Num(); i++ ) {
+		LightQuery &qr = queries[i];
+		count[qr.status + 1]++;
+		if ( qr.status != 0 )
+			continue;
+		pending.AddGrow( &qr );
+	}
+
+	if ( r_lqsBatched.GetBool() ) {
+		idList<idVec3> positions;
+		idList<const idList<qhandle_t>*> ignoredEntities;
+		idList<idVec3> results;
+		positions.SetNum( pending.Num() );
+		ignoredEntities.SetNum( pending.Num() );
+		results.SetNum( pending.Num() );
+
+		// sample points on animated models are costly to find, so they are updated in jobs as single queries are
+		struct PosJob {
+			const LightQuerySystem *system;
+			LightQuery *const *queries;
+			int count;
+
+			static void Invoke( void *param ) {
+				const PosJob *job = (const PosJob*)(param);
+				for ( int i = 0; i < job->count; i++ )
+					job->queries[i]->position = job->system->UpdateSamplePos( *job->queries[i] );
+			}
+		};
+		idList<PosJob> posJobs;
+		for ( int i = 0; i < pending.Num(); i += LIGHT_BATCH_SIZE )
+			posJobs.AddGrow( { this, pending.Ptr() + i, idMath::Imin( LIGHT_BATCH_SIZE, pending.Num() - i ) } );
+		if ( r_lqsParallel.GetBool() && posJobs.Num() > 1 ) {
+			RegisterJob( PosJob::Invoke, "lightQuerySamplePos" );
+			idParallelJobList *joblist = tr.frontEndJobList;
+			for ( PosJob &j : posJobs )
+				joblist->AddJob( PosJob::Invoke, &j );
+			joblist->Submit( nullptr, JOBLIST_PARALLELISM_REALTIME );
+			joblist->Wait();
+		} else {
+			for ( PosJob &j : posJobs )
+				PosJob::Invoke( &j );
+		}
+
+		for ( int i = 0; i < pending.Num(); i++ ) {
+			positions[i] = pending[i]->position;
+			ignoredEntities[i] = &pending[i]->ignoredEntities;
+		}
+
+		ComputeLightAtPoints( viewDef, pending.Num(), positions.Ptr(), ignoredEntities.Ptr(), results.Ptr() );
+
+		for ( int i = 0; i < pending.Num(); i++ ) {
+			pending[i]->resultValue = results[i];
+			pending[i]->status = 1;
+		}
+	} else {
+		struct Job {
+			const LightQuerySystem *system;
+			const viewDef_t *viewDef;
+			LightQuery *query;
+
+			void Run() const {
+				system->RecomputeQuery( *query, viewDef );
+			}
+			static void Invoke( void *param ) {
+				const Job *job = (const Job*)(param);
+				job->Run();
+			}
+		};
+
+		idList<Job> jobs;
+		jobs.Reserve( pending.Num() );
+		for ( LightQuery *qr : pending )
+			jobs.AddGrow( { this, viewDef, qr } );
+
+		if ( r_lqsParallel.GetBool() ) {
+			RegisterJob( Job::Invoke, "lightQuery" );
+			idParallelJobList *joblist = tr.frontEndJobList;
+			for ( Job &j : jobs )
+				joblist->AddJob( Job::Invoke, &j );
+			joblist->Submit( nullptr, JOBLIST_PARALLELISM_REALTIME );
+			joblist->Wait();
+		} else {
+			for ( Job &j : jobs )
+				j.Run();
+		}
+	}
+
+	TRACE_ATTACH_FORMAT( "dead: %d\npending: %d\nfinished: %d\n", count[0], count[1], count[2] )
+}
+
+void LightQuerySystem::ComputeLightAtPoints( const viewDef_t *viewDef, int count, const idVec3 *positions, const idList<qhandle_t> *const *ignoredEntities, idVec3 *results ) const {
+	TRACE_CPU_SCOPE( "LQS::ComputeLightAtPoints" );
+
+	// parameters of enabled light stage, same for all points
+	struct StageParams {
+		const shaderStage_t *stage;
+		idMat4 texMatrix;
+		idVec3 color;
+	};
+	// light and all the points it can reach
+	struct LitPoints {
+		const idRenderLightLocal *light = nullptr;
+		idList<int> points;
+		int firstStage = 0;
+		int numStages = 0;
+		int firstResult = 0;		// index of light value at points[0] in lightValues
+	};
+
+	// light reaching a point: index in litPoints, and index of the point in its list
+	struct PointLight {
+		int lit, index;
+	};
+
+	// find lights reaching every point, exactly as in ComputeQuery
+	// lights of point p are pointLights[pointLightsStart[p] .. pointLightsStart[p+1])
+	idList<int> lightToLit;
+	lightToLit.SetNum( world->lightDefs.Num() );
+	for ( int i = 0; i < lightToLit.Num(); i++ )
+		lightToLit[i] = -1;
+	idList<LitPoints> litPoints;
+	idList<int> pointLightsStart;
+	idList<PointLight> pointLights;
+	pointLightsStart.SetNum( count + 1 );
+
+	for ( int p = 0; p < count; p++ ) {
+		pointLightsStart[p] = pointLights.Num();
+
+		int areaList[16];
+		idBounds box( positions[p] );
+		box.ExpandSelf( POS_TOLERANCE );
+		int areaCnt = world->FindAreasInBounds( box, areaList, 16 );
+
+		idFlexList<int, 128> processedLights;
+		for ( int i = 0; i < areaCnt; i++ ) {
+			const portalArea_t &area = world->portalAreas[areaList[i]];
+			for ( int lightIdx : area.lightRefs ) {
+				const idRenderLightLocal *light = world->lightDefs[lightIdx];
+				if ( processedLights.Find( lightIdx ) )
+					continue;
+				processedLights.AddGrow( lightIdx );
+
+				if ( !light->globalLightBounds.ContainsPoint( positions[p] ) )
+					continue;
+				if ( !IsLightUsable( light ) )
+					continue;
+
+				int &lit = lightToLit[lightIdx];
+				if ( lit < 0 ) {
+					lit = litPoints.Num();
+					litPoints.Alloc().light = light;
+				}
+				int k = litPoints[lit].points.Append( p );
+				pointLights.AddGrow( { lit, k } );
+			}
+		}
+	}
+	pointLightsStart[count] = pointLights.Num();
+
+	// evaluate material of every light once
+	idList<StageParams> stages;
+	idList<float> lightRegisters;
+	viewLight_t viewLight;
+	int numLightValues = 0;
+	for ( LitPoints &lit : litPoints ) {
+		const idMaterial *lightShader = lit.light->lightShader;
+		lightRegisters.SetNum( lightShader->GetNumRegisters(), false );
+		lightShader->EvaluateRegisters( lightRegisters.Ptr(), lit.light->parms.shaderParms, viewDef, lit.light->parms.referenceSound );
+		viewLight.shaderRegisters = lightRegisters.Ptr();
+
+		lit.firstStage = stages.Num();
+		for ( int lightStageNum = 0; lightStageNum < lightShader->GetNumStages(); lightStageNum++ ) {
+			const shaderStage_t *lightStage = lightShader->GetStage( lightStageNum );
+			if ( !viewLight.IsStageEnabled( lightStage ) ) {
+				continue;
+			}
+			StageParams &params = stages.Alloc();
+			params.stage = lightStage;
+			params.texMatrix = viewLight.GetTextureMatrix( lightStage );
+			idVec4 lightColor = viewLight.GetStageColor( lightStage );
+			lightColor.ToVec3().MaxCW( vec3_zero );
+			params.color = lightColor.ToVec3();
+		}
+		lit.numStages = stages.Num() - lit.firstStage;
+
+		lit.firstResult = numLightValues;
+		numLightValues += lit.points.Num();
+	}
+
+	// compute value of every light at the points it reaches
 	struct Job {
 		const LightQuerySystem *system;
 		const viewDef_t *viewDef;
-		LightQuery *query;
+		const LitPoints *lit;
+		const StageParams *stages;
+		int first, num;
+		const idVec3 *positions;
+		const idList<qhandle_t> *const *ignoredEntities;
+		idVec3 *lightValues;
 
 		void Run() const {
-			system->RecomputeQuery( *query, viewDef );
+			const idRenderLightLocal *light = lit->light;
+			idVec3 pos[LIGHT_BATCH_SIZE];
+			float dist[4][LIGHT_BATCH_SIZE];
+			for ( int i = 0; i < num; i++ )
+				pos[i] = positions[lit->points[first + i]];
+			// texcoords of light projection & falloff for all points
+			for ( int d = 0; d < 4; d++ )
+				SIMDProcessor->Dot( dist[d], light->lightProject[d], pos, num );
+
+			for ( int i = 0; i < num; i++ ) {
+				int p = lit->points[first + i];
+				const idList<qhandle_t> *ignored = ignoredEntities ? ignoredEntities[p] : nullptr;
+				idVec4 texCoord( dist[0][i], dist[1][i], dist[3][i], dist[2][i] );	// note: z/w swapped
+
+				idVec3 res = vec3_zero;
+				for ( int s = 0; s < lit->numStages; s++ ) {
+					const StageParams &params = stages[lit->firstStage + s];
+					idVec3 addedColor = system->SampleLightStage( light, params.stage, params.texMatrix, texCoord );
+					addedColor.MulCW( params.color );
+					if ( addedColor.Max() == 0.0f )
+						continue;
+					if ( system->IsLightBlocked( viewDef, light, pos[i], ignored ) )
+						continue;
+					res += addedColor;
+				}
+				lightValues[lit->firstResult + first + i] = res;
+			}
 		}
 		static void Invoke( void *param ) {
 			const Job *job = (const Job*)(param);
@@ -87,20 +317,18 @@ void LightQuerySystem::Think( const viewDef_t *viewDef ) {
 		}
 	};
 
+	idList<idVec3> lightValues;
+	lightValues.SetNum( numLightValues );
 	idList<Job> jobs;
-	jobs.Reserve( queries.Num() );
-
-	int count[3] = {0};
-	for ( int i = 0; i < queries.Num(); i++ ) {
-		LightQuery &qr = queries[i];
-		count[qr.status + 1]++;
-		if ( qr.status != 0 )
-			continue;
-		jobs.AddGrow( { this, viewDef, &qr } );
+	for ( const LitPoints &lit : litPoints ) {
+		for ( int first = 0; first < lit.points.Num(); first += LIGHT_BATCH_SIZE ) {
+			int num = idMath::Imin( lit.points.Num() - first, LIGHT_BATCH_SIZE );
+			jobs.AddGrow( { this, viewDef, &lit, stages.Ptr(), first, num, positions, ignoredEntities, lightValues.Ptr() } );
+		}
 	}
 
-	if ( r_lqsParallel.GetBool() ) {
-		RegisterJob( Job::Invoke, "lightQuery" );
+	if ( r_lqsParallel.GetBool() && jobs.Num() > 1 ) {
+		RegisterJob( Job::Invoke, "lightQueryBatch" );
 		idParallelJobList *joblist = tr.frontEndJobList;
 		for ( Job &j : jobs )
 			joblist->AddJob( Job::Invoke, &j );
@@ -111,7 +339,17 @@ void LightQuerySystem::Think( const viewDef_t *viewDef ) {
 			j.Run();
 	}
 
-	TRACE_ATTACH_FORMAT( "dead: %d\npending: %d\nfinished: %d\n", count[0], count[1], count[2] )
+	// sum lights in the same order as ComputeQuery does
+	for ( int p = 0; p < count; p++ ) {
+		idVec3 totalLight( 0.0f );
+		for ( int i = pointLightsStart[p]; i < pointLightsStart[p + 1]; i++ ) {
+			const LitPoints &lit = litPoints[pointLights[i].lit];
+			totalLight += lightValues[lit.firstResult + pointLights[i].index];
+		}
+		results[p] = totalLight;
+	}
+
+	TRACE_ATTACH_FORMAT( "points: %d\nlights: %d\njobs: %d\n", count, litPoints.Num(), jobs.Num() )
 }
 
 // ==================================================================================
@@ -174,18 +412,26 @@ idVec3 LightQuerySystem::ComputeQuery( const LightQuery &query, Context &ctx ) c
 	return totalLight;
 }
 
-idVec3 LightQuerySystem::ComputeQueryLight( const LightQuery &query, Context &ctx, const idRenderLightLocal *light ) const {
-	if ( !light->globalLightBounds.ContainsPoint( query.position ) )
-		return vec3_zero;
-
+bool LightQuerySystem::IsLightUsable( const idRenderLightLocal *light ) const {
 	const idMaterial *lightShader = light->lightShader;
 
 	if ( !lightShader )
-		return vec3_zero;
+		return false;
 	if ( lightShader->IsFogLight() || lightShader->IsBlendLight() )
-		return vec3_zero;
+		return false;
 	if ( light->parms.suppressLightInViewID == VID_LIGHTGEM )
-		return vec3_zero;	// TODO: idLight::IsSeenByAI() is false
+		return false;	// TODO: idLight::IsSeenByAI() is false
+
+	return true;
+}
+
+idVec3 LightQuerySystem::ComputeQueryLight( const LightQuery &query, Context &ctx, const idRenderLightLocal *light ) const {
+	if ( !light->globalLightBounds.ContainsPoint( query.position ) )
+		return vec3_zero;
+	if ( !IsLightUsable( light ) )
+		return vec3_zero;
+
+	const idMaterial *lightShader = light->lightShader;
 
 	// follows code from R_AddLightSurfaces
 	// (where registers are evaluated during rendering)
@@ -230,6 +476,21 @@ idVec3 LightQuerySystem::ComputeQueryLightStage( const LightQuery &query, Contex
 		lightProjectionFalloff[2].Distance( query.position )
 	);
 
+	idVec3 addedColor = SampleLightStage( light, lightStage, texMatrix, texCoord );
+
+	// multiply by color from material/entity
+	addedColor.MulCW( lightColor.ToVec3() );
+
+	if ( addedColor.Max() == 0.0f )
+		return vec3_zero;
+
+	if ( IsLightBlocked( ctx.viewDef, light, query.position, &query.ignoredEntities ) )
+		return vec3_zero;
+
+	return addedColor;
+}
+
+idVec3 LightQuerySystem::SampleLightStage( const idRenderLightLocal *light, const shaderStage_t *lightStage, const idMat4 &texMatrix, const idVec4 &texCoord ) const {
 	idVec3 addedColor;
 	if ( light->lightShader->IsCubicLight() ) {
 
@@ -311,54 +572,234 @@ idVec3 LightQuerySystem::ComputeQueryLightStage( const LightQuery &query, Contex
 		addedColor.MulCW( falloff );
 	}
 
-	// multiply by color from material/entity
-	addedColor.MulCW( lightColor.ToVec3() );
-
-	if ( addedColor.Max() == 0.0f )
-		return vec3_zero;
+	return addedColor;
+}
 
+bool LightQuerySystem::IsLightBlocked( const viewDef_t *viewDef, const idRenderLightLocal *light, const idVec3 &position, const idList<qhandle_t> *ignoredEntities ) const {
 	bool lightNoShadows = light->parms.noShadows || !light->lightShader->LightCastsShadows();
-	if ( !lightNoShadows ) {
-		auto Filter = [&](const qhandle_t *rhandle, const renderEntity_t *rent, const idRenderModel *rmodel, const idMaterial *material) -> bool {
-			// ignore entity? (e.g. checking illumination of body with attachments)
-			if ( rhandle ) {
-				if ( query.ignoredEntities.Find( *rhandle ) )
-					return false;
-			}
+	if ( lightNoShadows )
+		return false;
+
+	auto Filter = [&](const qhandle_t *rhandle, const renderEntity_t *rent, const idRenderModel *rmodel, const idMaterial *material) -> bool {
+		// ignore entity? (e.g. checking illumination of body with attachments)
+		if ( rhandle && ignoredEntities ) {
+			if ( ignoredEntities->Find( *rhandle ) )
+				return false;
+		}
+
+		if ( rent ) {
+			// noshadows on entity?
+			if ( rent->noShadow )
+				return false;
+			// suppress settings (e.g. player shadow)
+			// note: see similar code in idInteraction::AddActiveInteraction
+			if ( rent->suppressShadowInViewID && rent->suppressShadowInViewID == viewDef->renderView.viewID )
+				return false;
+			if ( rent->suppressShadowInLightID && rent->suppressShadowInLightID == light->parms.lightId )
+				return false;
+		}
+
+		if ( material ) {
+			// noshadows on material?
+			if ( !material->SurfaceCastsShadow() )
+				return false;
+		}
+
+		return true;
+	};
+
+	// cast shadow ray from light source
+	// but remove a bit of length near ray end
+	idVec3 start = light->globalLightOrigin;
+	idVec3 end = position;
+	float lenSq = ( end - start ).LengthSqr();
+	if ( lenSq > POS_TOLERANCE * POS_TOLERANCE ) {
+		end += ( start - end ).Normalized() * POS_TOLERANCE;
+		modelTrace_t trace;
+		if ( world->TraceAll( trace, start, end, true, 0.0f, LambdaToFuncPtr( Filter ), &Filter ) )
+			return true;
+	}
+
+	return false;
+}
+
+
+#include "../tests/testing.h"
+
+class LightQuerySystemTest {
+public:
+	idRenderWorldLocal *world = nullptr;
+	viewDef_t viewDef;
+	idList<idVec3> points;
+
+	LightQuerySystemTest() {
+		world = (idRenderWorldLocal*)renderSystem->AllocRenderWorld();
+		world->InitFromMap( nullptr );
+		memset( &viewDef, 0, sizeof( viewDef ) );
+		viewDef.renderWorld = world;
+	}
+	~LightQuerySystemTest() {
+		renderSystem->FreeRenderWorld( world );
+	}
 
-			if ( rent ) {
-				// noshadows on entity?
-				if ( rent->noShadow )
-					return false;
-				// suppress settings (e.g. player shadow)
-				// note: see similar code in idInteraction::AddActiveInteraction
-				if ( rent->suppressShadowInViewID && rent->suppressShadowInViewID == ctx.viewDef->renderView.viewID )
-					return false;
-				if ( rent->suppressShadowInLightID && rent->suppressShadowInLightID == light->parms.lightId )
-					return false;
+	// synthetic light set: point and projected lights of various colors and sizes, some overlapping
+	void AddLights( idRandom &rnd, int num ) {
+		for ( int i = 0; i < num; i++ ) {
+			renderLight_t parms;
+			memset( &parms, 0, sizeof( parms ) );
+			parms.origin = idVec3( rnd.CRandomFloat(), rnd.CRandomFloat(), rnd.CRandomFloat() ) * 500.0f;
+			parms.axis = mat3_identity;
+			parms.shaderParms[SHADERPARM_RED] = rnd.RandomFloat();
+			parms.shaderParms[SHADERPARM_GREEN] = rnd.RandomFloat();
+			parms.shaderParms[SHADERPARM_BLUE] = rnd.RandomFloat();
+			parms.shaderParms[SHADERPARM_ALPHA] = 1.0f;
+			if ( i % 3 != 2 ) {
+				parms.pointLight = true;
+				parms.lightRadius = idVec3( 100.0f + 300.0f * rnd.RandomFloat(), 100.0f + 300.0f * rnd.RandomFloat(), 100.0f + 300.0f * rnd.RandomFloat() );
+			} else {
+				parms.pointLight = false;
+				parms.target = idVec3( 0.0f, 0.0f, -400.0f );
+				parms.right = idVec3( 200.0f, 0.0f, 0.0f );
+				parms.up = idVec3( 0.0f, 200.0f, 0.0f );
 			}
+			world->AddLightDef( &parms );
+		}
+		LoadLightImages();
+	}
 
-			if ( material ) {
-				// noshadows on material?
-				if ( !material->SurfaceCastsShadow() )
-					return false;
+	// light textures must be in memory, otherwise queries return zero until next frame
+	void LoadLightImages() {
+		for ( const idRenderLightLocal *light : world->lightDefs ) {
+			if ( !light )
+				continue;
+			for ( int s = 0; s < light->lightShader->GetNumStages(); s++ ) {
+				if ( idImage *img = light->lightShader->GetStage( s )->texture.image ) {
+					if ( idImageAsset *asset = img->AsAsset() )
+						globalImages->EnsureImageCpuResident( asset );
+				}
 			}
+			if ( light->falloffImage )
+				globalImages->EnsureImageCpuResident( light->falloffImage );
+		}
+	}
 
-			return true;
-		};
+	void AddPoints( idRandom &rnd, int num ) {
+		for ( int i = 0; i < num; i++ ) {
+			points.AddGrow( idVec3( rnd.CRandomFloat(), rnd.CRandomFloat(), rnd.CRandomFloat() ) * 800.0f );
+		}
+	}
 
-		// cast shadow ray from light source
-		// but remove a bit of length near ray end
-		idVec3 start = light->globalLightOrigin;
-		idVec3 end = query.position;
-		float lenSq = ( end - start ).LengthSqr();
-		if ( lenSq > POS_TOLERANCE * POS_TOLERANCE ) {
-			end += ( start - end ).Normalized() * POS_TOLERANCE;
-			modelTrace_t trace;
-			if ( world->TraceAll( trace, start, end, true, 0.0f, LambdaToFuncPtr( Filter ), &Filter ) )
-				return vec3_zero;
+	// evaluates points one by one with per-query code
+	void ComputeReference( idList<idVec3> &results ) {
+		LightQuerySystem::Context ctx;
+		ctx.viewDef = &viewDef;
+		results.SetNum( points.Num() );
+		for ( int i = 0; i < points.Num(); i++ ) {
+			LightQuerySystem::LightQuery query;
+			query.position = points[i];
+			results[i] = world->lightQuerySystem->ComputeQuery( query, ctx );
 		}
 	}
 
-	return addedColor;
+	void ComputeBatched( idList<idVec3> &results ) {
+		results.SetNum( points.Num() );
+		world->lightQuerySystem->ComputeLightAtPoints( &viewDef, points.Num(), points.Ptr(), nullptr, results.Ptr() );
+	}
+};
+
+TEST_CASE("LightQuerySystem:BatchMatchesSingle") {
+	idTestCVar lqsParallel( r_lqsParallel );
+	idRandom rnd( 4242 );
+	LightQuerySystemTest test;
+	test.AddLights( rnd, 30 );
+	test.AddPoints( rnd, 2000 );
+
+	idList<idVec3> reference;
+	test.ComputeReference( reference );
+	int litPoints = 0;
+	for ( int i = 0; i < reference.Num(); i++ ) {
+		if ( reference[i].Max() > 0.0f )
+			litPoints++;
+	}
+	// synthetic set must light a good share of points, but not all of them
+	CHECK( litPoints > reference.Num() / 10 );
+	CHECK( litPoints < reference.Num() );
+
+	idList<idVec3> batched[2];
+	for ( int parallel = 0; parallel < 2; parallel++ ) {
+		r_lqsParallel.SetBool( parallel != 0 );
+		test.ComputeBatched( batched[parallel] );
+	}
+
+	for ( int i = 0; i < reference.Num(); i++ ) {
+		// plane distances are computed with SIMD in batch, so they can differ in last bits
+		CHECK( batched[0][i].Compare( reference[i], 1e-4f * ( 1.0f + reference[i].Max() ) ) );
+		// jobs must not change anything
+		CHECK( batched[0][i] == batched[1][i] );
+	}
+}
+
+TEST_CASE("LightQuerySystem:LightColor") {
+	idRandom rnd( 1234 );
+	LightQuerySystemTest test;
+	// two identical point lights, second one is twice as bright
+	for ( int k = 0; k < 2; k++ ) {
+		renderLight_t parms;
+		memset( &parms, 0, sizeof( parms ) );
+		parms.origin = idVec3( k * 2000.0f, 0.0f, 0.0f );
+		parms.axis = mat3_identity;
+		parms.pointLight = true;
+		parms.lightRadius = idVec3( 300.0f );
+		parms.shaderParms[SHADERPARM_RED] = 0.4f * ( k + 1 );
+		parms.shaderParms[SHADERPARM_GREEN] = 0.2f * ( k + 1 );
+		parms.shaderParms[SHADERPARM_BLUE] = 0.1f * ( k + 1 );
+		parms.shaderParms[SHADERPARM_ALPHA] = 1.0f;
+		test.world->AddLightDef( &parms );
+	}
+	test.LoadLightImages();
+
+	for ( int i = 0; i < 100; i++ ) {
+		idVec3 offset( rnd.CRandomFloat(), rnd.CRandomFloat(), rnd.CRandomFloat() );
+		test.points.AddGrow( offset * 250.0f );
+		test.points.AddGrow( offset * 250.0f + idVec3( 2000.0f, 0.0f, 0.0f ) );
+	}
+	// far from both lights
+	test.points.AddGrow( idVec3( 1000.0f, 0.0f, 0.0f ) );
+
+	idList<idVec3> results;
+	test.ComputeBatched( results );
+	int litPoints = 0;
+	for ( int i = 0; i < 100; i++ ) {
+		const idVec3 &a = results[2 * i + 0];
+		const idVec3 &b = results[2 * i + 1];
+		CHECK( b.Compare( a * 2.0f, 1e-3f ) );
+		if ( a.Max() > 0.0f )
+			litPoints++;
+	}
+	CHECK( litPoints > 0 );
+	CHECK( results[200] == vec3_zero );
+}
+
+TEST_CASE("LightQuerySystem:Performance"
+	* doctest::skip()
+) {
+	idTestCVar lqsParallel( r_lqsParallel );
+	idRandom rnd( 777 );
+	LightQuerySystemTest test;
+	test.AddLights( rnd, 100 );
+	test.AddPoints( rnd, 20000 );
+
+	idList<idVec3> results;
+	double start = Sys_GetClockTicks();
+	test.ComputeReference( results );
+	double sec = ( Sys_GetClockTicks() - start ) / Sys_ClockTicksPerSecond();
+	MESSAGE( va( "Single: %0.3lf ms for %d points", 1e+3 * sec, test.points.Num() ) );
+
+	for ( int parallel = 0; parallel < 2; parallel++ ) {
+		r_lqsParallel.SetBool( parallel != 0 );
+		start = Sys_GetClockTicks();
+		test.ComputeBatched( results );
+		sec = ( Sys_GetClockTicks() - start ) / Sys_ClockTicksPerSecond();
+		MESSAGE( va( "Batched%s: %0.3lf ms for %d points", parallel ? " + jobs" : "", 1e+3 * sec, test.points.Num() ) );
+	}
 }
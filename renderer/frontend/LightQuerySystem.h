@@ -30,6 +30,10 @@ public:
 	void Forget( lightQuery_t query );
 	void Think( const viewDef_t *viewDef );
 
+	// evaluates light at many points together, processing all points lit by a light at once
+	// ignoredEntities is either null, or has a (possibly null) list of ignored entities for every point
+	void ComputeLightAtPoints( const viewDef_t *viewDef, int count, const idVec3 *positions, const idList<qhandle_t> *const *ignoredEntities, idVec3 *results ) const;
+
 private:
 	struct LightQuery {
 		// -1 = dead, 0 = pending, 1 = finished
@@ -56,6 +60,11 @@ private:
 	idVec3 ComputeQueryLight( const LightQuery &query, Context &ctx, const idRenderLightLocal *light ) const;
 	idVec3 ComputeQueryLightStage( const LightQuery &query, Context &ctx, const idRenderLightLocal *light, const shaderStage_t *lightStage ) const;
 	idVec3 UpdateSamplePos( const LightQuery &query ) const;
+	bool IsLightUsable( const idRenderLightLocal *light ) const;
+	idVec3 SampleLightStage( const idRenderLightLocal *light, const shaderStage_t *lightStage, const idMat4 &texMatrix, const idVec4 &texCoord ) const;
+	bool IsLightBlocked( const viewDef_t *viewDef, const idRenderLightLocal *light, const idVec3 &position, const idList<qhandle_t> *ignoredEntities ) const;
+
+	friend class LightQuerySystemTest;
 
 	const idRenderWorldLocal *world = nullptr;
 	idList<LightQuery> queries;
@@ -267,6 +267,7 @@ idRenderWorldLocal::idRenderWorldLocal() {
 	//numInterAreaPortals = 0;
 
 	interactionTable.Init();
+	portalStateCount = 0;
 
 	lightQuerySystem = new LightQuerySystem();
 	lightQuerySystem->Init( this );
@@ -982,7 +983,10 @@ void idRenderWorldLocal::SetPortalPlayerLoss( qhandle_t portal, float loss ) //
 	{
 		common->Error( "SetPortalPlayerLoss: bad portal number %i", portal );
 	}
-	doublePortals[portal-1].lossPlayer = loss; // grayman #3042
+	if ( doublePortals[portal-1].lossPlayer != loss ) {
+		doublePortals[portal-1].lossPlayer = loss; // grayman #3042
+		portalStateCount++;
+	}
 
 	if ( session->writeDemo )
 	{
@@ -993,6 +997,15 @@ void idRenderWorldLocal::SetPortalPlayerLoss( qhandle_t portal, float loss ) //
 	}
 }
 
+/*
+==============
+GetPortalStateCount
+==============
+*/
+int idRenderWorldLocal::GetPortalStateCount( void ) const {
+	return portalStateCount;
+}
+
 /*
 ===============
 GetAreaAtPoint
@@ -385,6 +385,10 @@ public:
 	// grayman #3042 - set portal sound loss (in dB)
 	virtual void			SetPortalPlayerLoss( qhandle_t portal, float loss ) = 0;
 
+	// incremented every time portal state or sound loss changes, or a new map is loaded
+	// used by sound system to invalidate cached portal flood
+	virtual int				GetPortalStateCount( void ) const = 0;
+
 	// returns true only if a chain of portals without the given connection bits set
 	// exists between the two areas (a door doesn't separate them, etc)
 	virtual	bool			AreasAreConnected( int areaNum1, int areaNum2, portalConnection_t connection ) = 0;
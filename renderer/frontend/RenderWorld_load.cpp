@@ -224,6 +224,7 @@ void idRenderWorldLocal::SetupAreaRefs() {
 	int		i;
 
 	connectedAreaNum = 0;
+	portalStateCount++;
 	for ( i = 0; i < portalAreas.Num(); i++ ) {
 		portalAreas[i].areaNum = i;
 		assert(portalAreas[i].entityRefs.Num() == 0);
@@ -165,6 +165,7 @@ public:
 	virtual	int				NumPortalsInArea( int areaNum ) override;
 	// grayman #3042 - set portal sound loss (in dB)
 	virtual void			SetPortalPlayerLoss( qhandle_t portal, float loss ) override;
+	virtual int				GetPortalStateCount( void ) const override;
 
 	virtual exitPortal_t	GetPortal( int areaNum, int portalNum ) override;
 
@@ -212,6 +213,7 @@ public:
 	idList<portalArea_t> portalAreas;
 	//int						numPortalAreas;
 	int						connectedAreaNum;		// incremented every time a door portal state changes
+	int						portalStateCount;		// incremented every time portal state or sound loss changes
 
 	idList<doublePortal_t>	doublePortals;
 	//int						numInterAreaPortals;
@@ -24,6 +24,7 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 
 idCVar r_maxShadowMapLight( "r_maxShadowMapLight", "1000", CVAR_ARCHIVE | CVAR_RENDERER, "lights bigger than this will be force-sent to stencil" );
 idCVar r_useParallelAddModels( "r_useParallelAddModels", "1", CVAR_RENDERER | CVAR_BOOL | CVAR_ARCHIVE, "parallelize R_AddModelSurfaces in frontend using jobs" );
+idCVar r_useBatchedSkinning( "r_useBatchedSkinning", "1", CVAR_RENDERER | CVAR_BOOL | CVAR_ARCHIVE, "instantiate visible MD5 models before R_AddModelSurfaces and skin them all together in parallel jobs (needs r_useParallelAddModels)" );
 idCVarBool r_useClipPlaneCulling( "r_useClipPlaneCulling", "1", CVAR_RENDERER, "cull surfaces behind mirrors" );
 
 /*
@@ -1145,6 +1146,23 @@ bool R_IssueEntityDefCallback( idRenderEntityLocal *def ) {
 	return update;
 }
 
+/*
+===================
+R_CheckDynamicModelBounds
+===================
+*/
+static void R_CheckDynamicModelBounds( const idRenderEntityLocal *def ) {
+	idBounds b = def->cachedDynamicModel->Bounds();
+	if (	b[0][0] < def->referenceBounds[0][0] - CHECK_BOUNDS_EPSILON ||
+			b[0][1] < def->referenceBounds[0][1] - CHECK_BOUNDS_EPSILON ||
+			b[0][2] < def->referenceBounds[0][2] - CHECK_BOUNDS_EPSILON ||
+			b[1][0] > def->referenceBounds[1][0] + CHECK_BOUNDS_EPSILON ||
+			b[1][1] > def->referenceBounds[1][1] + CHECK_BOUNDS_EPSILON ||
+			b[1][2] > def->referenceBounds[1][2] + CHECK_BOUNDS_EPSILON ) {
+		common->Printf( "entity %i dynamic model exceeded reference bounds\n", def->index );
+	}
+}
+
 /*
 ===================
 R_EntityDefDynamicModel
@@ -1153,9 +1171,12 @@ Issues a deferred entity callback if necessary.
 If the model isn't dynamic, it returns the original.
 Returns the cached dynamic model if present, otherwise creates
 it and any necessary overlays
+
+If skinningBatch is not NULL, then skinning of MD5 models is queued
+into it, and the returned model is not usable until it is executed.
 ===================
 */
-idRenderModel *R_EntityDefDynamicModel( idRenderEntityLocal *def ) {
+idRenderModel *R_EntityDefDynamicModel( idRenderEntityLocal *def, idMD5SkinningBatch *skinningBatch ) {
 	idScopedCriticalSection lock (def->mutex);
 
 	bool callbackUpdate = false;
@@ -1186,7 +1207,12 @@ idRenderModel *R_EntityDefDynamicModel( idRenderEntityLocal *def ) {
 	if ( !def->dynamicModel ) {
 
 		// instantiate the snapshot of the dynamic model, possibly reusing memory from the cached snapshot
-		def->cachedDynamicModel = model->InstantiateDynamicModel( &def->parms, tr.viewDef, def->cachedDynamicModel );
+		idRenderModelMD5 *md5Model = skinningBatch ? dynamic_cast<idRenderModelMD5*>( model ) : nullptr;
+		if ( md5Model ) {
+			def->cachedDynamicModel = md5Model->InstantiateDynamicModelDeferred( &def->parms, tr.viewDef, def->cachedDynamicModel, skinningBatch );
+		} else {
+			def->cachedDynamicModel = model->InstantiateDynamicModel( &def->parms, tr.viewDef, def->cachedDynamicModel );
+		}
 
 		if ( def->cachedDynamicModel ) {
 
@@ -1197,16 +1223,9 @@ idRenderModel *R_EntityDefDynamicModel( idRenderEntityLocal *def ) {
 				idRenderModelOverlay::RemoveOverlaySurfacesFromModel( def->cachedDynamicModel );
 			}
 
-			if ( r_checkBounds.GetBool() ) {
-				idBounds b = def->cachedDynamicModel->Bounds();
-				if (	b[0][0] < def->referenceBounds[0][0] - CHECK_BOUNDS_EPSILON ||
-						b[0][1] < def->referenceBounds[0][1] - CHECK_BOUNDS_EPSILON ||
-						b[0][2] < def->referenceBounds[0][2] - CHECK_BOUNDS_EPSILON ||
-						b[1][0] > def->referenceBounds[1][0] + CHECK_BOUNDS_EPSILON ||
-						b[1][1] > def->referenceBounds[1][1] + CHECK_BOUNDS_EPSILON ||
-						b[1][2] > def->referenceBounds[1][2] + CHECK_BOUNDS_EPSILON ) {
-					common->Printf( "entity %i dynamic model exceeded reference bounds\n", def->index );
-				}
+			// deferred models get their bounds when the skinning batch is executed, R_AddModelSurfaces checks them then
+			if ( r_checkBounds.GetBool() && !md5Model ) {
+				R_CheckDynamicModelBounds( def );
 			}
 		}
 		def->dynamicModel = def->cachedDynamicModel;
@@ -1682,6 +1701,48 @@ void R_AddPreparedSurfaces( viewEntity_t *vEntity ) {
 	}
 }
 
+static idMD5SkinningBatch md5SkinningBatch;
+
+/*
+===================
+R_InstantiateSingleModel
+
+Instantiates dynamic model of visible MD5 entity in advance, queuing its skinning into batch.
+R_AddSingleModel will then find up-to-date model without doing any work.
+Entities which are skipped here are instantiated later as usual.
+===================
+*/
+static void R_InstantiateSingleModel( viewEntity_t *vEntity ) {
+	idRenderEntityLocal& def = *vEntity->entityDef;
+
+	if ( r_skipModels.GetInteger() != 0 || r_skipEntities.GetBool() || tr.viewDef->areaNum < 0 ) {
+		return;
+	}
+	if ( !def.parms.hModel || def.parms.hModel->IsDynamicModel() != DM_CACHED ) {
+		return;
+	}
+	// overlays are built from skinned vertices, so they need immediate skinning
+	if ( def.overlay && !r_skipOverlays.GetBool() ) {
+		return;
+	}
+	if ( R_CullXray( def ) ) {
+		return;
+	}
+
+	// entities only casting shadows may be culled away later, don't waste time on them
+	idScreenRect scissorRect = vEntity->scissorRect;
+	if ( r_useEntityScissors.GetBool() ) {
+		scissorRect.IntersectWithZ( R_CalcEntityScissorRectangle( vEntity ) );
+	}
+	if ( scissorRect.IsEmpty() ) {
+		return;
+	}
+
+	R_EntityDefDynamicModel( &def, &md5SkinningBatch );
+}
+
+REGISTER_PARALLEL_JOB( R_InstantiateSingleModel, "R_InstantiateSingleModel" );
+
 /*
 ===================
 R_AddModelSurfaces
@@ -1701,6 +1762,25 @@ void R_AddModelSurfaces( void ) {
 	tr.viewDef->maxDrawSurfs = 0;	// will be set to INITIAL_DRAWSURFS on R_AddDrawSurf
 
 	if ( r_useParallelAddModels.GetBool() && r_materialOverride.GetString()[0] == '\0' ) {
+		if ( r_useBatchedSkinning.GetBool() ) {
+			// instantiate animated models first, then skin all of them together
+			// this way a single heavy entity does not stall the R_AddSingleModel jobs
+			for ( viewEntity_t *vEntity = tr.viewDef->viewEntitys; vEntity; vEntity = vEntity->next ) {
+				tr.frontEndJobList->AddJob( (jobRun_t)R_InstantiateSingleModel, vEntity );
+			}
+			tr.frontEndJobList->Submit();
+			tr.frontEndJobList->Wait();
+			md5SkinningBatch.Execute( tr.frontEndJobList );
+			if ( r_checkBounds.GetBool() ) {
+				// bounds of the models instantiated above are only known now
+				for ( viewEntity_t *vEntity = tr.viewDef->viewEntitys; vEntity; vEntity = vEntity->next ) {
+					const idRenderEntityLocal *def = vEntity->entityDef;
+					if ( def->cachedDynamicModel && def->dynamicModelFrameCount == tr.frameCount && dynamic_cast<idRenderModelMD5*>( def->parms.hModel ) ) {
+						R_CheckDynamicModelBounds( def );
+					}
+				}
+			}
+		}
 		for ( viewEntity_t *vEntity = tr.viewDef->viewEntitys; vEntity; vEntity = vEntity->next ) {
 			tr.frontEndJobList->AddJob( (jobRun_t)R_AddSingleModel, vEntity );
 		}
@@ -45,6 +45,15 @@ idCVar r_cinematic_log_flush("r_cinematic_log_flush", 0, CVAR_RENDERER | CVAR_BO
 	"Flush log file for cinematics: make sure all messages are written on crash."
 );
 
+idCVar r_cinematic_decodeThread("r_cinematic_decodeThread", "1", CVAR_RENDERER | CVAR_BOOL | CVAR_ARCHIVE,
+	"Decode video frames ahead of time in background thread. "
+	"If disabled, frames are decoded on the thread which requests image (usually backend)."
+);
+idCVar r_cinematic_decodeQueueSize("r_cinematic_decodeQueueSize", "8", CVAR_RENDERER | CVAR_INTEGER | CVAR_ARCHIVE,
+	"Maximum number of RGBA frames decoded ahead by background thread (see r_cinematic_decodeThread).",
+	2, 64
+);
+
 idCVar r_cinematic_checkImmediately("r_cinematic_checkImmediately", 0, CVAR_RENDERER | CVAR_BOOL | CVAR_ARCHIVE, 
 	"Immediately check that video file can be opened when its material is parsed. "
 	"Note: by default (when = 0) it is only checked that file exists."
@@ -208,6 +217,26 @@ public:
 };
 
 
+class idCinematicFFMpeg::DecodeThread : public idSysThread
+{
+private:
+	idCinematicFFMpeg* _owner;
+
+public:
+	DecodeThread(idCinematicFFMpeg* owner) : _owner(owner) {}
+
+	virtual int Run() override {
+		while (!IsTerminating()) {
+			if (!_owner->DecodeAheadStep()) {
+				//queue is full or video has ended: wait until frames are consumed
+				_owner->_decodeWorkSignal.Wait(100);
+			}
+		}
+		return 0;
+	}
+};
+
+
 bool idCinematicFFMpeg::IsDecoderOpened() const {
 	//note: normally, either all these things are present, or all are absent
 	return _file && _customIOContext && _formatContext && _videoDecoderContext && _swScaleContext;
@@ -522,8 +551,11 @@ idCinematicFFMpeg::PacketNode *idCinematicFFMpeg::GetPacket_Locking(PacketQueue
 }
 
 bool idCinematicFFMpeg::FetchFrames(AVMediaType type, double discardTime) {
-	if (type == AVMEDIA_TYPE_VIDEO)
-		DiscardOldFrames(discardTime);
+	//note: with decode thread, only consumer may free frames (see PickReadyFrame)
+	if (type == AVMEDIA_TYPE_VIDEO) {
+		if (!_decodeThread)
+			DiscardOldFrames(discardTime);
+	}
 	else
 		DiscardOldSamples(discardTime);
 
@@ -616,19 +648,18 @@ void idCinematicFFMpeg::ProcessDecodedFrame(AVMediaType type, AVFrame *decodedFr
 }
 
 void idCinematicFFMpeg::ProcessDecodedVideoFrame(AVFrame *decodedFrame, double timestamp, double duration, bool first) {
-	if (!_videoFrames._dead.Peek()) {
+	//reuse dead frame buffer if possible
+	_framesMutex.Lock();
+	DecodedFrame *frame = _videoFrames._dead.Get();
+	_framesMutex.Unlock();
+
+	if (!frame) {
 		TIMER_START(allocImage);
 		//no free frame buffers, allocate a new one
-		DecodedFrame *newFrame = new DecodedFrame();
-		newFrame->_image = (byte*)Mem_Alloc16(_framebufferWidth * _framebufferHeight * 4 + 16);
-		_videoFrames._dead.Add(newFrame);
+		frame = new DecodedFrame();
+		frame->_image = (byte*)Mem_Alloc16(_framebufferWidth * _framebufferHeight * 4 + 16);
 		TIMER_END_LOG(allocImage, "Allocated RGBA image buffer");
 	}
-	assert(_videoFrames._dead.Peek());
-
-	//reuse dead (or use new) frame buffer
-	DecodedFrame *frame = _videoFrames._dead.Get();
-	_videoFrames._alive.Add(frame);
 
 	TIMER_START(swsScale);
 	// Note: AV_PIX_FMT_RGBA format is non-planar
@@ -647,6 +678,10 @@ void idCinematicFFMpeg::ProcessDecodedVideoFrame(AVFrame *decodedFrame, double t
 	frame->_timestamp = timestamp;
 	frame->_duration = duration;
 	frame->_first = first;
+	//note: conversion is done outside lock, so that consumer is not blocked by it
+	_framesMutex.Lock();
+	_videoFrames._alive.Add(frame);
+	_framesMutex.Unlock();
 	//keep track of the total video time (for looping)
 	if (_loopNumber == 0 && _loopDuration < timestamp + duration)
 		_loopDuration = timestamp + duration;
@@ -824,7 +859,11 @@ idCinematicFFMpeg::idCinematicFFMpeg() :
 	_tempVideoFrame(NULL),
 	_tempAudioFrame(NULL),
 	_soundTimeOffset(DBL_MAX),
-	_lastVideoTime(DBL_MAX)
+	_lastVideoTime(DBL_MAX),
+	_decodeThread(NULL),
+	_decodeTime(0.0),
+	_decodeEnded(false),
+	_maxQueuedFrames(0)
 {
 	if (r_cinematic_log.GetBool() || r_cinematic_log_ffmpeg.GetBool())
 		InitLogFile();
@@ -836,6 +875,7 @@ idCinematicFFMpeg::~idCinematicFFMpeg() {
 
 void idCinematicFFMpeg::Close() {
 	CALL_START("Close");
+	StopDecodeThread();
 	Sys_EnterCriticalSection(CRITICAL_SECTION_DECODER);
 
 	CloseDecoder();
@@ -895,6 +935,7 @@ cinData_t idCinematicFFMpeg::ImageForTime(int milliseconds) {
 	if (!IsDecoderOpened_Locking()) {
 		//never called ImageForTime or ResetTime before
 		//so we open decoder and start video right now
+		StopDecodeThread();
 		Sys_EnterCriticalSection(CRITICAL_SECTION_DECODER);
 		bool ok = OpenDecoder();
 		res.imageWidth = _framebufferWidth;
@@ -916,6 +957,15 @@ cinData_t idCinematicFFMpeg::ImageForTime(int milliseconds) {
 	_lastVideoTime = videoTime;
 	Sys_LeaveCriticalSection(CRITICAL_SECTION_CLOCK);
 
+	if (!_decodeThread && r_cinematic_decodeThread.GetBool())
+		StartDecodeThread(videoTime);
+
+	if (_decodeThread) {
+		PickReadyFrame(videoTime, res);
+		CALL_END_LOG();
+		return res;
+	}
+
 	DiscardOldFrames(videoTime);
 	DecodedFrame *prevFrame = NULL, *nextFrame = NULL;
 	double ratio = 0.0;
@@ -945,7 +995,8 @@ bool idCinematicFFMpeg::IncrementLap(double videoTime) {
 	if (_loopDuration <= 0.001)
 		return false;
 
-	//note: no critical section is necessary, because without audio a cinematic is single-threaded
+	//note: without audio, decoder is only used by one thread (either caller or decode thread)
+	//the caller of IncrementLap should lock decoder if the other thread may check IsDecoderOpened_Locking
 	CloseDecoder();
 	do {
 		_loopNumber++;
@@ -956,6 +1007,108 @@ bool idCinematicFFMpeg::IncrementLap(double videoTime) {
 	return ok;
 }
 
+void idCinematicFFMpeg::StartDecodeThread(double videoTime) {
+	assert(!_decodeThread);
+	_decodeTime = videoTime;
+	_decodeEnded = false;
+	_maxQueuedFrames = r_cinematic_decodeQueueSize.GetInteger();
+	_decodeWorkSignal.Clear();
+	_frameReadySignal.Clear();
+
+	_decodeThread = new DecodeThread(this);
+	_decodeThread->StartThread(va("Cinematic:%s", _path.c_str()), CORE_ANY, THREAD_BELOW_NORMAL);
+	LogPrintf("Started decode thread (%d frames ahead)", _maxQueuedFrames);
+}
+
+void idCinematicFFMpeg::StopDecodeThread() {
+	if (!_decodeThread)
+		return;
+	_decodeThread->StopThread(false);
+	_decodeWorkSignal.Raise();
+	_decodeThread->WaitForThread();
+	delete _decodeThread;
+	_decodeThread = NULL;
+	LogPrintf("Stopped decode thread");
+}
+
+bool idCinematicFFMpeg::DecodeAheadStep() {
+	double decodeTime;
+	{
+		idScopedCriticalSection lock(_framesMutex);
+		if (_decodeEnded)
+			return false;
+		int queued = 0;
+		for (DecodedFrame *frame = _videoFrames._alive.Peek(); frame; frame = frame->_next)
+			queued++;
+		if (queued >= _maxQueuedFrames)
+			return false;
+		decodeTime = _decodeTime;
+	}
+
+	TIMER_START(decodeAhead);
+	bool ok = FetchFrames(AVMEDIA_TYPE_VIDEO, decodeTime);
+	if (!ok) {
+		LogPrintf("Video ended: no more frames");
+		if (_looping) {
+			Sys_EnterCriticalSection(CRITICAL_SECTION_DECODER);
+			ok = IncrementLap(decodeTime);
+			Sys_LeaveCriticalSection(CRITICAL_SECTION_DECODER);
+		}
+		if (!ok) {
+			idScopedCriticalSection lock(_framesMutex);
+			_decodeEnded = true;
+		}
+	}
+	TIMER_END_LOG(decodeAhead, "Decoded ahead");
+
+	_frameReadySignal.Raise();
+	return ok;
+}
+
+void idCinematicFFMpeg::PickReadyFrame(double videoTime, cinData_t &res) {
+	DecodedFrame *prevFrame = NULL, *nextFrame = NULL;
+	bool ended = false;
+
+	while (true) {
+		_framesMutex.Lock();
+		_decodeTime = videoTime;
+		//frames before the one displayed at videoTime are no longer needed
+		//note: the last frame is never released, since we might have to show it until decoder catches up
+		while (DecodedFrame *frame = _videoFrames._alive.Peek()) {
+			if (!frame->_next || frame->_next->_timestamp > videoTime)
+				break;
+			_videoFrames._dead.Add(_videoFrames._alive.Get());
+		}
+		prevFrame = _videoFrames._alive.Peek();
+		nextFrame = prevFrame ? prevFrame->_next : NULL;
+		ended = _decodeEnded;
+		_framesMutex.Unlock();
+
+		//some frames were released: let decoder continue
+		_decodeWorkSignal.Raise();
+
+		//note: we only block until the very first frame is decoded
+		if (prevFrame || ended)
+			break;
+		_frameReadySignal.Wait(10);
+	}
+
+	if (ended && (!prevFrame || (!nextFrame && prevFrame->_timestamp + prevFrame->_duration < videoTime))) {
+		LogPrintf("Video ended: no more frames");
+		_finished = true;
+		return;
+	}
+
+	res.status = FMV_PLAY;
+	res.image = prevFrame->_image;
+	if (nextFrame) {
+		double ratio = (videoTime - prevFrame->_timestamp) / (nextFrame->_timestamp - prevFrame->_timestamp + 1e-9);
+		if (ratio >= 0.5)
+			res.image = nextFrame->_image;
+	}
+	LogPrintf("Picked frame with timestamp %0.3lf", (res.image == prevFrame->_image ? prevFrame : nextFrame)->_timestamp);
+}
+
 int idCinematicFFMpeg::GetRealSoundOffset(int sampleOffset44k) const {
 	int soundTimeOffset44k = 0;
 	if (_soundTimeOffset < DBL_MAX)
@@ -1009,6 +1162,8 @@ cinStatus_t idCinematicFFMpeg::GetStatus() const {
 //it has weird value and it is not used in original ROQ code...
 void idCinematicFFMpeg::ResetTime(int someBogusTime) {
 	CALL_START("ResetTime(%d)", someBogusTime);
+	//note: decode thread is restarted on next ImageForTime
+	StopDecodeThread();
 	Sys_EnterCriticalSection(CRITICAL_SECTION_DECODER);
 
 	_ResetTime();
@@ -1056,3 +1211,97 @@ void idCinematicFFMpeg::_ResetTime() {
 		LogPrintf("Purged all data and reopened decoder");
 	}
 }
+
+
+#include "../tests/testing.h"
+
+static idStr FindTestVideo() {
+	static const char *extensions[] = {".mp4", ".m4v", ".avi", ".roq"};
+	idStr result;
+	for (int e = 0; e < sizeof(extensions) / sizeof(extensions[0]) && result.IsEmpty(); e++) {
+		idFileList *files = fileSystem->ListFiles("video", extensions[e], true, true);
+		if (files->GetNumFiles() > 0)
+			result = files->GetFile(0);
+		fileSystem->FreeFileList(files);
+	}
+	return result;
+}
+
+static unsigned int HashCinematicImage(const cinData_t &data) {
+	if (!data.image)
+		return 0;
+	return MD5_BlockChecksum(data.image, data.imageWidth * data.imageHeight * 4);
+}
+
+TEST_CASE("CinematicFFMpeg:DecodeThread") {
+	//note: no GPU is used, we only look at RGBA frames produced by decoder
+	idStr path = FindTestVideo();
+	if (path.IsEmpty()) {
+		MESSAGE("No video files found in video/ directory, test skipped");
+		return;
+	}
+	MESSAGE("Testing on video " << path.c_str());
+
+	static const int START_MS = 1000;
+	static const int STEP_MS = 15;
+	static const int DURATION_MS = 3000;
+	static const int WAIT_LIMIT_MS = 2000;
+	idTestCVar decodeThread(r_cinematic_decodeThread);
+
+	//reference: decode synchronously
+	r_cinematic_decodeThread.SetBool(false);
+	idList<unsigned int> reference;
+	{
+		idCinematicFFMpeg cin;
+		REQUIRE(cin.InitFromFile(path.c_str(), false, false));
+		for (int t = 0; t < DURATION_MS; t += STEP_MS) {
+			cinData_t data = cin.ImageForTime(START_MS + t);
+			if (data.status != FMV_PLAY)
+				break;
+			reference.Append(HashCinematicImage(data));
+		}
+		cin.Close();
+	}
+	REQUIRE(reference.Num() > 0);
+
+	//decode in background thread and compare
+	//every step is a seek forward in time, so that decoder has to skip frames
+	r_cinematic_decodeThread.SetBool(true);
+	for (int stride = 1; stride <= 8; stride *= 2) {
+		idCinematicFFMpeg cin;
+		REQUIRE(cin.InitFromFile(path.c_str(), false, false));
+
+		int lastPos = 0;
+		for (int i = 0; i < reference.Num(); i += stride) {
+			//decoder may be behind, then we see older frames for a while
+			int waited = 0;
+			unsigned int hash;
+			while (true) {
+				cinData_t data = cin.ImageForTime(START_MS + i * STEP_MS);
+				CHECK(data.status == FMV_PLAY);
+				hash = HashCinematicImage(data);
+
+				//frames must go in the same order as in reference
+				int pos = lastPos;
+				while (pos < reference.Num() && reference[pos] != hash)
+					pos++;
+				CHECK(pos <= i);
+				if (pos <= i)
+					lastPos = pos;
+
+				if (hash == reference[i] || waited >= WAIT_LIMIT_MS)
+					break;
+				Sys_Sleep(1);
+				waited++;
+			}
+			CHECK(hash == reference[i]);
+		}
+
+		//restart from the beginning
+		cin.Close();
+		cinData_t data = cin.ImageForTime(START_MS);
+		CHECK(data.status == FMV_PLAY);
+		CHECK(HashCinematicImage(data) == reference[0]);
+		cin.Close();
+	}
+}
@@ -80,6 +80,16 @@ private: // methods
 	// reopens decoder to repeat video from the beginning
 	bool IncrementLap(double videoTime);
 
+	// starts/stops background thread which decodes video frames ahead of time
+	void StartDecodeThread(double videoTime);
+	void StopDecodeThread();
+	// (called on decode thread) decodes next portion of video if frames queue is not full
+	// returns false if there is nothing to do now
+	bool DecodeAheadStep();
+	// implementation of ImageForTime when decode thread is running:
+	// only picks the nearest frame already decoded
+	void PickReadyFrame(double videoTime, cinData_t &res);
+
 private: // members
 
 	static const int CRITICAL_SECTION_PACKETS = CRITICAL_SECTION_ONE;
@@ -128,6 +138,23 @@ private: // members
 	//set to true when video has ended
 	bool _finished;
 
+	//=== background decoding (r_cinematic_decodeThread)
+
+	class DecodeThread;
+	DecodeThread* _decodeThread;
+	// protects _videoFrames, _decodeTime and _decodeEnded while decode thread is running
+	idSysMutex _framesMutex;
+	// decode thread should decode frames for this video time (and a few frames after it)
+	double _decodeTime;
+	// decode thread has reached end of video
+	bool _decodeEnded;
+	// how many decoded frames may be queued at most
+	int _maxQueuedFrames;
+	// raised to wake decode thread up
+	idSysSignal _decodeWorkSignal;
+	// raised by decode thread when new frame is ready or video has ended
+	idSysSignal _frameReadySignal;
+
 	//=== decoder data (including AV libs)
 
 	// The virtual file we're streaming from
@@ -141,6 +141,9 @@ public:
 
  	void						ParseMesh( idLexer &parser, int numJoints, const idJointMat *joints, idBounds *jointBounds );
 	void						UpdateSurface( const struct renderEntity_s *ent, const idJointMat *joints, modelSurface_t *surf ) const;
+	// UpdateSurface is split into these two steps, so that skinning can be deferred to idMD5SkinningBatch
+	void						PrepareSurface( modelSurface_t *surf ) const;
+	void						DeformSurface( const struct renderEntity_s *ent, const idJointMat *joints, srfTriangles_t *tri ) const;
 	idBounds					CalcBounds( const idJointMat *joints );
 	int							NearestJoint( int a, int b, int c ) const;
 	int							NumVerts( void ) const;
@@ -186,6 +189,10 @@ public:
 	virtual idVec3				GetSamplePosition( const struct renderEntity_s *ent, const samplePointOnModel_t &sample ) const override;
 	virtual const idMaterial *	GetSampleMaterial( const struct renderEntity_s *ent, const samplePointOnModel_t &sample ) const override;
 
+	// same as InstantiateDynamicModel, but if skinningBatch is not NULL, then vertex skinning is only queued to it
+	// the returned model has no valid vertices and bounds until the batch is executed
+	idRenderModel *				InstantiateDynamicModelDeferred( const struct renderEntity_s *ent, const struct viewDef_s *view, idRenderModel *cachedModel, class idMD5SkinningBatch *skinningBatch );
+
 private:
 	idList<idMD5Joint>			joints;
 	idList<idJointQuat>			defaultPose;
@@ -197,6 +204,45 @@ private:
 	void						ParseJoint( idLexer &parser, idMD5Joint *joint, idJointQuat *defaultPose );
 };
 
+/*
+===============================================================================
+
+	Batched MD5 skinning
+
+	Collects MD5 meshes which need CPU vertex skinning (possibly from several threads),
+	then skins all of them at once, spreading the work over job threads.
+
+===============================================================================
+*/
+
+class idMD5SkinningBatch {
+public:
+	void						Clear();
+	int							Num() const { return tasks.Num(); }
+
+	// thread-safe
+	void						AddMesh( const idMD5Mesh *mesh, const struct renderEntity_s *ent, srfTriangles_t *tri, idRenderModelStatic *model );
+	// skins all added meshes and adds their bounds to their models
+	// if jobList is NULL, then everything is done on the calling thread
+	void						Execute( idParallelJobList *jobList );
+
+	struct skinTask_t {
+		const idMD5Mesh *		mesh;
+		const struct renderEntity_s *ent;
+		srfTriangles_t *		tri;
+		idRenderModelStatic *	model;
+	};
+	struct skinJob_t {
+		const skinTask_t *		tasks;
+		int						num;
+	};
+
+private:
+	idList<skinTask_t>			tasks;
+	idList<skinJob_t>			jobs;
+	idSysMutex					mutex;
+};
+
 /*
 ===============================================================================
 
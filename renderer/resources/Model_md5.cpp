@@ -272,7 +272,19 @@ idMD5Mesh::UpdateSurface
 ====================
 */
 void idMD5Mesh::UpdateSurface( const struct renderEntity_s *ent, const idJointMat *entJoints, modelSurface_t *surf ) const {
-	int i, base;
+	PrepareSurface( surf );
+	DeformSurface( ent, entJoints, surf->geometry );
+}
+
+/*
+====================
+idMD5Mesh::PrepareSurface
+
+Allocates triangle surface and sets all the data which does not depend on pose.
+====================
+*/
+void idMD5Mesh::PrepareSurface( modelSurface_t *surf ) const {
+	int i;
 	srfTriangles_t *tri;
 
 	if ( r_showDynamic.GetBool() ) {
@@ -322,6 +334,18 @@ void idMD5Mesh::UpdateSurface( const struct renderEntity_s *ent, const idJointMa
 			tri->verts[i].st = texCoords[i];
 		}
 	}
+}
+
+/*
+====================
+idMD5Mesh::DeformSurface
+
+Skins vertices of surface previously set up by PrepareSurface.
+Only touches the given surface, so it can be called for different surfaces in parallel.
+====================
+*/
+void idMD5Mesh::DeformSurface( const struct renderEntity_s *ent, const idJointMat *entJoints, srfTriangles_t *tri ) const {
+	int i, base;
 
 	if ( ent->shaderParms[ SHADERPARM_MD5_SKINSCALE ] != 0.0f ) {
 		TransformScaledVerts( tri->verts, entJoints, ent->shaderParms[ SHADERPARM_MD5_SKINSCALE ] );
@@ -765,6 +789,15 @@ idRenderModelMD5::InstantiateDynamicModel
 ====================
 */
 idRenderModel *idRenderModelMD5::InstantiateDynamicModel( const struct renderEntity_s *ent, const struct viewDef_s *view, idRenderModel *cachedModel ) {
+	return InstantiateDynamicModelDeferred( ent, view, cachedModel, nullptr );
+}
+
+/*
+====================
+idRenderModelMD5::InstantiateDynamicModelDeferred
+====================
+*/
+idRenderModel *idRenderModelMD5::InstantiateDynamicModelDeferred( const struct renderEntity_s *ent, const struct viewDef_s *view, idRenderModel *cachedModel, idMD5SkinningBatch *skinningBatch ) {
 	TRACE_CPU_SCOPE_TEXT( "InstantiateDynamicModel", ent ? GetTraceLabel(*ent) : "[null]" )
 
 	int					i, surfaceNum;
@@ -848,6 +881,13 @@ idRenderModel *idRenderModelMD5::InstantiateDynamicModel( const struct renderEnt
 			surf->id = i;
 		}
 
+		if ( skinningBatch ) {
+			// bounds will be added when the batch is executed
+			mesh->PrepareSurface( surf );
+			skinningBatch->AddMesh( mesh, ent, surf->geometry, staticModel );
+			continue;
+		}
+
 		mesh->UpdateSurface( ent, ent->joints, surf );
 
 		staticModel->bounds.AddPoint( surf->geometry->bounds[0] );
@@ -1074,3 +1114,256 @@ int	idRenderModelMD5::Memory() const {
 	}
     return static_cast<int>(total);
 }
+
+/***********************************************************************
+
+	idMD5SkinningBatch
+
+***********************************************************************/
+
+// don't split skinning into jobs smaller than this (in vertices)
+static const int SKINNING_JOB_MIN_VERTS = 2048;
+// stay well below the capacity of frontEndJobList
+static const int SKINNING_MAX_JOBS = 4096;
+
+/*
+====================
+idMD5SkinningBatch::Clear
+====================
+*/
+void idMD5SkinningBatch::Clear() {
+	tasks.Clear();
+	jobs.Clear();
+}
+
+/*
+====================
+idMD5SkinningBatch::AddMesh
+====================
+*/
+void idMD5SkinningBatch::AddMesh( const idMD5Mesh *mesh, const struct renderEntity_s *ent, srfTriangles_t *tri, idRenderModelStatic *model ) {
+	skinTask_t task = { mesh, ent, tri, model };
+	idScopedCriticalSection lock( mutex );
+	tasks.AddGrow( task );
+}
+
+/*
+====================
+R_MD5SkinJob
+====================
+*/
+static void R_MD5SkinJob( idMD5SkinningBatch::skinJob_t *job ) {
+	TRACE_CPU_SCOPE_FORMAT( "MD5SkinJob", "%d", job->num );
+	for ( int i = 0; i < job->num; i++ ) {
+		const idMD5SkinningBatch::skinTask_t &task = job->tasks[i];
+		task.mesh->DeformSurface( task.ent, task.ent->joints, task.tri );
+	}
+}
+
+REGISTER_PARALLEL_JOB( R_MD5SkinJob, "R_MD5SkinJob" );
+
+/*
+====================
+idMD5SkinningBatch::Execute
+====================
+*/
+void idMD5SkinningBatch::Execute( idParallelJobList *jobList ) {
+	TRACE_CPU_SCOPE_FORMAT( "MD5SkinningBatch", "%d", tasks.Num() );
+
+	if ( tasks.Num() == 0 ) {
+		return;
+	}
+
+	// split tasks into consecutive chunks of roughly equal vertex count
+	int totalVerts = 0;
+	for ( int i = 0; i < tasks.Num(); i++ ) {
+		totalVerts += tasks[i].tri->numVerts;
+	}
+	int jobVerts = idMath::Imax( SKINNING_JOB_MIN_VERTS, totalVerts / SKINNING_MAX_JOBS + 1 );
+
+	jobs.Clear();
+	for ( int i = 0; i < tasks.Num(); ) {
+		skinJob_t job = { &tasks[i], 0 };
+		int verts = 0;
+		while ( i < tasks.Num() && verts < jobVerts ) {
+			verts += tasks[i].tri->numVerts;
+			job.num++;
+			i++;
+		}
+		jobs.AddGrow( job );
+	}
+
+	if ( jobList && jobs.Num() > 1 ) {
+		for ( int i = 0; i < jobs.Num(); i++ ) {
+			jobList->AddJob( (jobRun_t)R_MD5SkinJob, &jobs[i] );
+		}
+		jobList->Submit();
+		jobList->Wait();
+	} else {
+		for ( int i = 0; i < jobs.Num(); i++ ) {
+			R_MD5SkinJob( &jobs[i] );
+		}
+	}
+
+	// deformed surfaces are ready, now snapshot models can get their bounds
+	for ( int i = 0; i < tasks.Num(); i++ ) {
+		const skinTask_t &task = tasks[i];
+		task.model->bounds.AddPoint( task.tri->bounds[0] );
+		task.model->bounds.AddPoint( task.tri->bounds[1] );
+	}
+
+	Clear();
+}
+
+
+#include "../tests/testing.h"
+
+// generates text of a random md5 mesh block (as inside .md5mesh file)
+static idStr GenerateTestMD5Mesh( idRandom &rnd, int numJoints, int gridSize ) {
+	idStr text;
+	int numVerts = ( gridSize + 1 ) * ( gridSize + 1 );
+	text += "{\n\tname \"test\"\n\tshader \"_default\"\n";
+	text += va( "\tnumverts %d\n", numVerts );
+	for ( int v = 0; v < numVerts; v++ ) {
+		idVec2 st( float( v % ( gridSize + 1 ) ) / gridSize, float( v / ( gridSize + 1 ) ) / gridSize );
+		text += va( "\tvert %d ( %f %f ) %d %d\n", v, st.x, st.y, 2 * v, 2 );
+	}
+	text += va( "\tnumtris %d\n", gridSize * gridSize * 2 );
+	for ( int y = 0; y < gridSize; y++ ) {
+		for ( int x = 0; x < gridSize; x++ ) {
+			int q = y * gridSize + x;
+			int v00 = y * ( gridSize + 1 ) + x;
+			int v01 = v00 + 1, v10 = v00 + gridSize + 1, v11 = v10 + 1;
+			text += va( "\ttri %d %d %d %d\n", 2 * q + 0, v00, v10, v01 );
+			text += va( "\ttri %d %d %d %d\n", 2 * q + 1, v01, v10, v11 );
+		}
+	}
+	text += va( "\tnumweights %d\n", 2 * numVerts );
+	for ( int v = 0; v < numVerts; v++ ) {
+		float bias = rnd.RandomFloat();
+		for ( int k = 0; k < 2; k++ ) {
+			idVec3 ofs( rnd.CRandomFloat(), rnd.CRandomFloat(), rnd.CRandomFloat() );
+			ofs *= 50.0f;
+			text += va( "\tweight %d %d %f ( %f %f %f )\n", 2 * v + k, rnd.RandomInt( numJoints ), ( k ? 1.0f - bias : bias ), ofs.x, ofs.y, ofs.z );
+		}
+	}
+	text += "}\n";
+	return text;
+}
+
+TEST_CASE("MD5Skinning:BatchMatchesSerial") {
+	static const int NUM_JOINTS = 20;
+	static const int NUM_MESHES = 50;
+	static const int NUM_ENTITIES = 30;
+
+	idRandom rnd( 1337 );
+
+	idList<idJointMat> bindPose;
+	bindPose.SetNum( NUM_JOINTS );
+	for ( int j = 0; j < NUM_JOINTS; j++ ) {
+		bindPose[j].SetRotation( mat3_identity );
+		bindPose[j].SetTranslation( vec3_origin );
+	}
+	idList<idBounds> jointBounds;
+	jointBounds.SetNum( NUM_JOINTS );
+	for ( int j = 0; j < NUM_JOINTS; j++ ) {
+		jointBounds[j].Clear();
+	}
+
+	// parse random meshes of various size
+	idList<idMD5Mesh> meshes;
+	meshes.SetNum( NUM_MESHES );
+	for ( int m = 0; m < NUM_MESHES; m++ ) {
+		idStr text = GenerateTestMD5Mesh( rnd, NUM_JOINTS, 1 + rnd.RandomInt( 40 ) );
+		idLexer parser( LEXFL_ALLOWPATHNAMES | LEXFL_NOSTRINGESCAPECHARS );
+		parser.LoadMemory( text.c_str(), text.Length(), "md5skinning_test" );
+		meshes[m].ParseMesh( parser, NUM_JOINTS, bindPose.Ptr(), jointBounds.Ptr() );
+	}
+
+	// entities with random poses, each has several meshes
+	idList<idJointMat> poses;
+	poses.SetNum( NUM_ENTITIES * NUM_JOINTS );
+	idList<renderEntity_t> ents;
+	ents.SetNum( NUM_ENTITIES );
+	for ( int e = 0; e < NUM_ENTITIES; e++ ) {
+		for ( int j = 0; j < NUM_JOINTS; j++ ) {
+			idAngles angles( rnd.CRandomFloat() * 180.0f, rnd.CRandomFloat() * 180.0f, rnd.CRandomFloat() * 180.0f );
+			idVec3 trans( rnd.CRandomFloat(), rnd.CRandomFloat(), rnd.CRandomFloat() );
+			poses[e * NUM_JOINTS + j].SetRotation( angles.ToMat3() );
+			poses[e * NUM_JOINTS + j].SetTranslation( trans * 100.0f );
+		}
+		memset( &ents[e], 0, sizeof( ents[e] ) );
+		ents[e].joints = &poses[e * NUM_JOINTS];
+		ents[e].numJoints = NUM_JOINTS;
+		if ( e % 5 == 0 ) {
+			ents[e].shaderParms[SHADERPARM_MD5_SKINSCALE] = 0.5f + rnd.RandomFloat();
+		}
+	}
+	struct instance_t {
+		int mesh, ent;
+	};
+	idList<instance_t> instances;
+	for ( int e = 0; e < NUM_ENTITIES; e++ ) {
+		for ( int k = 0; k < 4; k++ ) {
+			instance_t inst = { rnd.RandomInt( NUM_MESHES ), e };
+			instances.Append( inst );
+		}
+	}
+	int n = instances.Num();
+
+	// skin every instance immediately
+	idList<modelSurface_t> serialSurfs;
+	serialSurfs.SetNum( n );
+	memset( serialSurfs.Ptr(), 0, n * sizeof( serialSurfs[0] ) );
+	for ( int i = 0; i < n; i++ ) {
+		const renderEntity_t &ent = ents[instances[i].ent];
+		meshes[instances[i].mesh].UpdateSurface( &ent, ent.joints, &serialSurfs[i] );
+	}
+
+	// skin everything in one batch, with and without jobs
+	for ( int parallel = 0; parallel < 2; parallel++ ) {
+		idRenderModelStatic model;
+		model.InitEmpty( "_MD5_SkinningTest_" );
+		idBounds serialBounds;
+		serialBounds.Clear();
+
+		idList<modelSurface_t> batchSurfs;
+		batchSurfs.SetNum( n );
+		memset( batchSurfs.Ptr(), 0, n * sizeof( batchSurfs[0] ) );
+		idMD5SkinningBatch batch;
+		for ( int i = 0; i < n; i++ ) {
+			const renderEntity_t &ent = ents[instances[i].ent];
+			meshes[instances[i].mesh].PrepareSurface( &batchSurfs[i] );
+			batch.AddMesh( &meshes[instances[i].mesh], &ent, batchSurfs[i].geometry, &model );
+			serialBounds.AddBounds( serialSurfs[i].geometry->bounds );
+		}
+		CHECK( batch.Num() == n );
+		batch.Execute( parallel ? tr.frontEndJobList : nullptr );
+		CHECK( batch.Num() == 0 );
+
+		CHECK( model.bounds[0] == serialBounds[0] );
+		CHECK( model.bounds[1] == serialBounds[1] );
+		for ( int i = 0; i < n; i++ ) {
+			const srfTriangles_t *a = serialSurfs[i].geometry;
+			const srfTriangles_t *b = batchSurfs[i].geometry;
+			REQUIRE( a->numVerts == b->numVerts );
+			bool equal = true;
+			for ( int v = 0; v < a->numVerts; v++ ) {
+				if ( a->verts[v].xyz != b->verts[v].xyz || a->verts[v].normal != b->verts[v].normal || a->verts[v].st != b->verts[v].st ) {
+					equal = false;
+				}
+			}
+			CHECK( equal );
+			CHECK( a->bounds[0] == b->bounds[0] );
+			CHECK( a->bounds[1] == b->bounds[1] );
+		}
+
+		for ( int i = 0; i < n; i++ ) {
+			R_FreeStaticTriSurf( batchSurfs[i].geometry );
+		}
+	}
+
+	for ( int i = 0; i < n; i++ ) {
+		R_FreeStaticTriSurf( serialSurfs[i].geometry );
+	}
+}
@@ -268,6 +268,18 @@ public:
 	int						DecodeOGG( idSoundSample *sample, int sampleOffset44k, int sampleCount44k, float *dest );
 	int						DecodeCinematics( idSoundSample *sample, int sampleOffset44k, int sampleCount44k, float *dest );
 
+	bool					ReadFromStream( int &sampleOffset44k, int &sampleCount44k, float *&dest );
+	void					ResetStream( idSoundSample *sample, int sampleOffset44k );
+	int						StreamAheadSamples( void );
+	int						StreamAheadStep( void );
+
+	static void				StartStreamThread( void );
+	static void				StopStreamThread( void );
+	static bool				StreamAheadAll( void );
+
+	int						streamHits;			// number of Decode calls served entirely from stream buffer
+	int						streamMisses;		// number of Decode calls which had to decode synchronously
+
 private:
 	bool					failed;				// set if decoding failed
 	int						lastFormat;			// last format being decoded
@@ -278,10 +290,41 @@ private:
 
 	OggVorbis_File			ogg;				// OggVorbis file
 	int						oggStream;			// stgatilov: ogg->stream in original D3 with hacked libogg
+
+	// ring buffer of 44kHz samples decoded ahead by stream thread
+	// samples [streamStart, streamEnd) of lastSample are stored at positions modulo streamBuffer.Num()
+	// decoder state is protected by CRITICAL_SECTION_ONE, while stream positions are protected by streamMutex
+	idList<float>			streamBuffer;
+	int						streamStart;
+	int						streamEnd;
+	bool					streaming;			// registered in streamingDecoders
+	idSysMutex				streamMutex;
 };
 
 idBlockAlloc<idSampleDecoderLocal, 64>		sampleDecoderAllocator;
 
+// decoders which are decoded ahead by stream thread (protected by CRITICAL_SECTION_ONE)
+static idList<idSampleDecoderLocal*>		streamingDecoders;
+
+const int STREAM_CHUNK_SAMPLES				= 4096;		// 44kHz samples decoded at once by stream thread
+
+class idSampleStreamThread : public idSysThread {
+public:
+	idSysSignal				workSignal;
+
+	virtual int Run() override {
+		while ( !IsTerminating() ) {
+			if ( !idSampleDecoderLocal::StreamAheadAll() ) {
+				// all buffers are full: wait until mixer consumes something
+				workSignal.Wait( 10 );
+			}
+		}
+		return 0;
+	}
+};
+
+static idSampleStreamThread *				sampleStreamThread = NULL;
+
 /*
 ====================
 idSampleDecoder::Init
@@ -295,6 +338,8 @@ void idSampleDecoder::Init( void ) {
 	decoderMemoryAllocator.Init();
 	decoderMemoryAllocator.SetLockMemory( true );
 	decoderMemoryAllocator.SetFixedBlocks( idSoundSystemLocal::s_realTimeDecoding.GetBool() ? 10 : 1 );
+
+	idSampleDecoderLocal::StartStreamThread();
 }
 
 /*
@@ -303,6 +348,7 @@ idSampleDecoder::Shutdown
 ====================
 */
 void idSampleDecoder::Shutdown( void ) {
+	idSampleDecoderLocal::StopStreamThread();
 	decoderMemoryAllocator.Shutdown();
 	sampleDecoderAllocator.Shutdown();
 }
@@ -358,6 +404,11 @@ void idSampleDecoderLocal::Clear( void ) {
 	lastSample = NULL;
 	lastSampleOffset = 0;
 	lastDecodeTime = 0;
+	streamStart = 0;
+	streamEnd = 0;
+	streaming = false;
+	streamHits = 0;
+	streamMisses = 0;
 }
 
 /*
@@ -380,6 +431,15 @@ void idSampleDecoderLocal::ClearDecoder( void ) {
 		}
 	}
 
+	if ( streaming ) {
+		streamingDecoders.Remove( this );
+	}
+	{
+		idScopedCriticalSection lock( streamMutex );
+		streamBuffer.ClearFree();
+		streamStart = streamEnd = 0;
+	}
+
 	Clear();
 
 	Sys_LeaveCriticalSection( CRITICAL_SECTION_ONE );
@@ -422,6 +482,11 @@ void idSampleDecoderLocal::Decode( idSoundSample *sample, int sampleOffset44k, i
 		return;
 	}
 
+	// if stream thread has already decoded these samples, just copy them
+	if ( streaming && ReadFromStream( sampleOffset44k, sampleCount44k, dest ) ) {
+		return;
+	}
+
 	// samples can be decoded both from the sound thread and the main thread for shakes
 	Sys_EnterCriticalSection( CRITICAL_SECTION_ONE );
 
@@ -432,6 +497,9 @@ void idSampleDecoderLocal::Decode( idSoundSample *sample, int sampleOffset44k, i
 		}
 		case WAVE_FORMAT_TAG_OGG: {
 			readSamples44k = DecodeOGG( sample, sampleOffset44k, sampleCount44k, dest );
+			if ( !failed && lastSample == sample ) {
+				ResetStream( sample, sampleOffset44k + readSamples44k );
+			}
 			break;
 		}
 		case WAVE_FORMAT_TAG_STREAM_CINEMATICS: {
@@ -573,3 +641,369 @@ int idSampleDecoderLocal::DecodeOGG( idSoundSample *sample, int sampleOffset44k,
 
 	return ( readSamples << shift );
 }
+
+/*
+===================================================================================
+
+  Decoding ahead in background thread.
+
+  Long OGG sounds are decoded on demand from compressed data when played (s_realTimeDecoding).
+  Stream thread keeps ring buffer of every such decoder filled s_decodeAheadMs ahead,
+  so that in the common case mixer only has to copy PCM data.
+  Whenever mixer asks for samples which are not in ring buffer (e.g. sound starts or loops),
+  they are decoded synchronously and stream is restarted from the new position.
+
+===================================================================================
+*/
+
+/*
+====================
+idSampleDecoderLocal::StartStreamThread
+====================
+*/
+void idSampleDecoderLocal::StartStreamThread( void ) {
+	assert( !sampleStreamThread );
+	sampleStreamThread = new idSampleStreamThread();
+	sampleStreamThread->StartThread( "SoundStream", CORE_ANY, THREAD_ABOVE_NORMAL );
+}
+
+/*
+====================
+idSampleDecoderLocal::StopStreamThread
+====================
+*/
+void idSampleDecoderLocal::StopStreamThread( void ) {
+	if ( !sampleStreamThread ) {
+		return;
+	}
+	sampleStreamThread->StopThread( false );
+	sampleStreamThread->workSignal.Raise();
+	sampleStreamThread->WaitForThread();
+	delete sampleStreamThread;
+	sampleStreamThread = NULL;
+
+	Sys_EnterCriticalSection( CRITICAL_SECTION_ONE );
+	for ( int i = 0; i < streamingDecoders.Num(); i++ ) {
+		streamingDecoders[i]->streaming = false;
+	}
+	streamingDecoders.Clear();
+	Sys_LeaveCriticalSection( CRITICAL_SECTION_ONE );
+}
+
+/*
+====================
+idSampleDecoderLocal::ReadFromStream
+
+Copies samples from the beginning of the requested range which are already in ring buffer.
+Returns true if the whole range has been copied, otherwise the arguments are advanced past the copied part.
+====================
+*/
+bool idSampleDecoderLocal::ReadFromStream( int &sampleOffset44k, int &sampleCount44k, float *&dest ) {
+	idScopedCriticalSection lock( streamMutex );
+
+	if ( sampleOffset44k < streamStart || sampleOffset44k >= streamEnd ) {
+		streamMisses++;
+		return false;
+	}
+
+	int count = Min( sampleCount44k, streamEnd - sampleOffset44k );
+	int size = streamBuffer.Num();
+	int pos = sampleOffset44k % size;
+	int first = Min( count, size - pos );
+	memcpy( dest, streamBuffer.Ptr() + pos, first * sizeof( dest[0] ) );
+	memcpy( dest + first, streamBuffer.Ptr(), ( count - first ) * sizeof( dest[0] ) );
+
+	// mixer never goes back, so free space for stream thread
+	streamStart = sampleOffset44k + count;
+	sampleStreamThread->workSignal.Raise();
+
+	sampleOffset44k += count;
+	sampleCount44k -= count;
+	dest += count;
+	if ( sampleCount44k > 0 ) {
+		streamMisses++;
+		return false;
+	}
+	streamHits++;
+	return true;
+}
+
+/*
+====================
+idSampleDecoderLocal::ResetStream
+
+Called after synchronous decoding, which has left OGG decoder at given position.
+====================
+*/
+void idSampleDecoderLocal::ResetStream( idSoundSample *sample, int sampleOffset44k ) {
+	int aheadMs = idSoundSystemLocal::s_decodeAheadMs.GetInteger();
+	int channels = sample->objectInfo.nChannels;
+	int lengthMs = int( sample->LengthIn44kHzSamples() / ( channels * 44.1 ) );
+	bool enable = sampleStreamThread && aheadMs > 0 && lengthMs > idSoundSystemLocal::s_decodeAheadMinLength.GetInteger();
+
+	if ( !enable ) {
+		if ( streaming ) {
+			streamingDecoders.Remove( this );
+			streaming = false;
+		}
+		return;
+	}
+
+	// round capacity up to whole chunks, keep one chunk as free space for stream thread
+	int capacity = ( int( aheadMs * 44.1 ) * channels + STREAM_CHUNK_SAMPLES - 1 ) / STREAM_CHUNK_SAMPLES * STREAM_CHUNK_SAMPLES;
+	capacity += STREAM_CHUNK_SAMPLES;
+
+	{
+		idScopedCriticalSection lock( streamMutex );
+		if ( streamBuffer.Num() != capacity ) {
+			streamBuffer.SetNum( capacity, false );
+		}
+		streamStart = streamEnd = sampleOffset44k;
+	}
+
+	if ( !streaming ) {
+		streamingDecoders.Append( this );
+		streaming = true;
+	}
+	sampleStreamThread->workSignal.Raise();
+}
+
+/*
+====================
+idSampleDecoderLocal::StreamAheadSamples
+====================
+*/
+int idSampleDecoderLocal::StreamAheadSamples( void ) {
+	idScopedCriticalSection lock( streamMutex );
+	return streamEnd - streamStart;
+}
+
+/*
+====================
+idSampleDecoderLocal::StreamAheadStep
+
+Decodes one chunk at the end of the ring buffer.
+Must be called under CRITICAL_SECTION_ONE, returns number of samples decoded.
+====================
+*/
+int idSampleDecoderLocal::StreamAheadStep( void ) {
+	int start, end;
+	{
+		idScopedCriticalSection lock( streamMutex );
+		start = streamStart;
+		end = streamEnd;
+	}
+
+	idSoundSample *sample = lastSample;
+	int size = streamBuffer.Num();
+	int unit = sample->objectInfo.nChannels << ( 22050 / sample->objectInfo.nSamplesPerSec );
+	if ( end % unit != 0 ) {
+		return 0;
+	}
+
+	int count = Min( STREAM_CHUNK_SAMPLES, size - ( end - start ) );
+	count = Min( count, sample->LengthIn44kHzSamples() - end );
+	count -= count % unit;
+	if ( count <= 0 ) {
+		return 0;
+	}
+
+	float chunk[STREAM_CHUNK_SAMPLES];
+	int readSamples44k = DecodeOGG( sample, end, count, chunk );
+	if ( failed || readSamples44k <= 0 ) {
+		return 0;
+	}
+
+	// mixer reads only [streamStart, streamEnd), so we can write past the end without lock
+	int pos = end % size;
+	int first = Min( readSamples44k, size - pos );
+	memcpy( streamBuffer.Ptr() + pos, chunk, first * sizeof( chunk[0] ) );
+	memcpy( streamBuffer.Ptr(), chunk + first, ( readSamples44k - first ) * sizeof( chunk[0] ) );
+
+	{
+		idScopedCriticalSection lock( streamMutex );
+		streamEnd = end + readSamples44k;
+	}
+	return readSamples44k;
+}
+
+/*
+====================
+idSampleDecoderLocal::StreamAheadAll
+
+Called from stream thread: decodes one chunk for the decoder which has least data buffered.
+Returns false if there is nothing to do.
+====================
+*/
+bool idSampleDecoderLocal::StreamAheadAll( void ) {
+	TRACE_CPU_SCOPE( "Sound:StreamAhead" )
+
+	Sys_EnterCriticalSection( CRITICAL_SECTION_ONE );
+
+	idSampleDecoderLocal *best = NULL;
+	float bestMs = FLT_MAX;
+	for ( int i = 0; i < streamingDecoders.Num(); i++ ) {
+		idSampleDecoderLocal *decoder = streamingDecoders[i];
+		if ( decoder->failed || decoder->lastSample == NULL ) {
+			continue;
+		}
+		if ( decoder->streamEnd >= decoder->lastSample->LengthIn44kHzSamples() ) {
+			continue;	// decoded up to the end
+		}
+		int buffered = decoder->StreamAheadSamples();
+		if ( buffered + STREAM_CHUNK_SAMPLES > decoder->streamBuffer.Num() ) {
+			continue;	// full
+		}
+		float ms = buffered / ( decoder->lastSample->objectInfo.nChannels * 44.1f );
+		if ( ms < bestMs ) {
+			bestMs = ms;
+			best = decoder;
+		}
+	}
+
+	int decoded = 0;
+	if ( best ) {
+		decoded = best->StreamAheadStep();
+	}
+
+	Sys_LeaveCriticalSection( CRITICAL_SECTION_ONE );
+
+	return decoded > 0;
+}
+
+
+#include "../tests/testing.h"
+
+static void FindLongOggSamples( idList<idSoundSample*> &samples, int maxCount ) {
+	static const int MAX_FILES_CHECKED = 64;
+	idFileList *files = fileSystem->ListFilesTree( "sound", ".ogg", true );
+	for ( int i = 0; i < files->GetNumFiles() && i < MAX_FILES_CHECKED && samples.Num() < maxCount; i++ ) {
+		idSoundSample *sample = soundSystemLocal.soundCache->FindSound( files->GetFile( i ) );
+		if ( sample->defaultSound || sample->objectInfo.wFormatTag != WAVE_FORMAT_TAG_OGG ) {
+			continue;
+		}
+		int lengthMs = int( sample->LengthIn44kHzSamples() / ( sample->objectInfo.nChannels * 44.1 ) );
+		if ( lengthMs > idSoundSystemLocal::s_decodeAheadMinLength.GetInteger() ) {
+			samples.Append( sample );
+		}
+	}
+	fileSystem->FreeFileList( files );
+}
+
+// decodes range of sample in mixer-sized pieces, returns total time spent in Decode calls (in seconds)
+// if waitStream is set, waits after every piece until stream thread decodes everything it wants
+static double DecodeLikeMixer( idSampleDecoderLocal *decoder, idSoundSample *sample, int start, int end, float *dest, bool waitStream ) {
+	static const int WAIT_LIMIT_MS = 200;
+	int piece = MIXBUFFER_SAMPLES * sample->objectInfo.nChannels;
+	double totalTicks = 0.0;
+	for ( int pos = start; pos < end; pos += piece ) {
+		int count = Min( piece, end - pos );
+		double startClock = Sys_GetClockTicks();
+		decoder->Decode( sample, pos, count, dest + ( pos - start ) );
+		totalTicks += Sys_GetClockTicks() - startClock;
+
+		if ( waitStream ) {
+			int wanted = Min( int( idSoundSystemLocal::s_decodeAheadMs.GetInteger() * 44.1 ) * sample->objectInfo.nChannels, end - pos - count );
+			for ( int t = 0; t < WAIT_LIMIT_MS && decoder->StreamAheadSamples() < wanted; t++ ) {
+				Sys_Sleep( 1 );
+			}
+		}
+	}
+	return totalTicks / Sys_ClockTicksPerSecond();
+}
+
+static int CountPcmMismatches( const idList<float> &a, const idList<float> &b ) {
+	int errors = 0;
+	for ( int i = 0; i < a.Num(); i++ ) {
+		if ( idMath::Fabs( a[i] - b[i] ) > 1e-3f ) {
+			errors++;
+		}
+	}
+	return errors;
+}
+
+TEST_CASE("SampleDecoder:StreamAhead") {
+	if ( !soundSystemLocal.soundCache || !sampleStreamThread ) {
+		MESSAGE( "Sound system is disabled, test skipped" );
+		return;
+	}
+	idList<idSoundSample*> samples;
+	FindLongOggSamples( samples, 3 );
+	if ( samples.Num() == 0 ) {
+		MESSAGE( "No long OGG sounds found in sound/ directory, test skipped" );
+		return;
+	}
+	idTestCVar decodeAheadMs( idSoundSystemLocal::s_decodeAheadMs );
+
+	for ( int s = 0; s < samples.Num(); s++ ) {
+		idSoundSample *sample = samples[s];
+		MESSAGE( "Testing on sound " << sample->name.c_str() );
+		int length = sample->LengthIn44kHzSamples();
+		// jump forward by one second in the middle, like when sound is restarted with time offset
+		int jumpFrom = ( length / 2 ) / MIXBUFFER_SAMPLES * MIXBUFFER_SAMPLES;
+		int jumpTo = Min( jumpFrom + 44100 * sample->objectInfo.nChannels, length );
+
+		idList<float> direct, streamed;
+		direct.SetNum( length );
+		streamed.SetNum( length );
+		memset( direct.Ptr(), 0, length * sizeof( float ) );
+		memset( streamed.Ptr(), 0, length * sizeof( float ) );
+
+		idSoundSystemLocal::s_decodeAheadMs.SetInteger( 0 );
+		{
+			idSampleDecoderLocal *decoder = static_cast<idSampleDecoderLocal *>( idSampleDecoder::Alloc() );
+			DecodeLikeMixer( decoder, sample, 0, jumpFrom, direct.Ptr(), false );
+			DecodeLikeMixer( decoder, sample, jumpTo, length, direct.Ptr() + jumpTo, false );
+			CHECK( decoder->streamHits == 0 );
+			idSampleDecoder::Free( decoder );
+		}
+
+		idSoundSystemLocal::s_decodeAheadMs.SetInteger( 250 );
+		{
+			idSampleDecoderLocal *decoder = static_cast<idSampleDecoderLocal *>( idSampleDecoder::Alloc() );
+			DecodeLikeMixer( decoder, sample, 0, jumpFrom, streamed.Ptr(), true );
+			DecodeLikeMixer( decoder, sample, jumpTo, length, streamed.Ptr() + jumpTo, true );
+			// only the first piece and the piece after jump must be decoded synchronously
+			CHECK( decoder->streamHits > 0 );
+			CHECK( decoder->streamMisses <= 2 );
+			idSampleDecoder::Free( decoder );
+		}
+
+		CHECK( CountPcmMismatches( direct, streamed ) == 0 );
+	}
+}
+
+TEST_CASE("SampleDecoder:StreamAheadPerformance"
+	* doctest::skip()
+) {
+	if ( !soundSystemLocal.soundCache || !sampleStreamThread ) {
+		MESSAGE( "Sound system is disabled, test skipped" );
+		return;
+	}
+	idList<idSoundSample*> samples;
+	FindLongOggSamples( samples, 8 );
+	if ( samples.Num() == 0 ) {
+		MESSAGE( "No long OGG sounds found in sound/ directory, test skipped" );
+		return;
+	}
+	idTestCVar decodeAheadMs( idSoundSystemLocal::s_decodeAheadMs );
+
+	// time spent in mixer thread for decoding: on demand vs decoded ahead
+	for ( int mode = 0; mode < 2; mode++ ) {
+		idSoundSystemLocal::s_decodeAheadMs.SetInteger( mode ? 250 : 0 );
+		double totalSec = 0.0, totalLengthSec = 0.0;
+		for ( int s = 0; s < samples.Num(); s++ ) {
+			idSoundSample *sample = samples[s];
+			int length = sample->LengthIn44kHzSamples();
+			idList<float> pcm;
+			pcm.SetNum( length );
+			idSampleDecoderLocal *decoder = static_cast<idSampleDecoderLocal *>( idSampleDecoder::Alloc() );
+			totalSec += DecodeLikeMixer( decoder, sample, 0, length, pcm.Ptr(), mode != 0 );
+			idSampleDecoder::Free( decoder );
+			totalLengthSec += length / ( sample->objectInfo.nChannels * 44100.0 );
+		}
+		MESSAGE( va( "%s: %0.3lf ms in mixer for %0.1lf sec of sound",
+			mode ? "Decode ahead" : "Decode on demand", 1e+3 * totalSec, totalLengthSec
+		) );
+	}
+}
@@ -20,6 +20,7 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 #include <AL/al.h>
 #include <AL/alc.h>
 #include <AL/alext.h>
+#include <memory>
 
 #include "../framework/UsercmdGen.h"
 #include "sound.h"
@@ -528,6 +529,42 @@ typedef struct soundPortalTrace_s {
 	const struct soundPortalTrace_s	*prevStack;
 } soundPortalTrace_t;
 
+/*
+===================================================================================
+
+  Lower bounds of sound loss on the way through portals to the listener area.
+  ResolveOrigin uses them to skip portal chains which can't reach the listener.
+  Rebuilt only when listener changes area or portal loss/state changes.
+
+===================================================================================
+*/
+
+class idSoundPortalCache {
+public:
+	typedef struct {
+		int					areas[2];
+		float				loss;			// lossPlayer in dB
+	} portal_t;
+
+							idSoundPortalCache( void );
+
+	void					Clear( void );
+	void					Build( int numAreas, const idList<portal_t> &portals, int listenerArea, int maxPortals );
+
+	// returns lower bound of loss from the area to the listener area through no more than maxPortals portals
+	// returns idMath::INFINITY if listener area can't be reached that way
+	float					GetMinLoss( int area, int maxPortals ) const;
+
+	int						listenerArea;
+	const idRenderWorld *	world;
+	int						portalStateCount;
+
+private:
+	int						numAreas;
+	int						maxPortals;
+	idList<float>			minLoss;		// [maxPortals + 1][numAreas]
+};
+
 class idSoundWorldLocal : public idSoundWorld {
 public:
 	virtual					~idSoundWorldLocal( void ) override;
@@ -604,7 +641,9 @@ public:
 	void					MixLoopInternal( int current44kHz, int numSpeakers, float *finalMixBuffer );
 	void					AVIUpdate( void );
 	float					GetDiffractionLoss(const idVec3 p1, const idVec3 p2, const idVec3 p3); // grayman #4219
+	std::shared_ptr<const idSoundPortalCache> GetPortalCache( bool primary, const idVec3 &listenerPosition );
 	bool					ResolveOrigin( bool primary, const int stackDepth, const soundPortalTrace_t *prevStack, const int soundArea, const float dist, const float loss, const idVec3& soundOrigin, const idVec3& prevSoundOrigin, idSoundEmitterLocal *def , SoundChainResults *results); // grayman #3042 // grayman #4219 // grayman #4882
+	bool					ResolveOrigin_r( const idSoundPortalCache &cache, const idVec3 &listenerPosition, const int stackDepth, const soundPortalTrace_t *prevStack, const int soundArea, const float dist, const float loss, const idVec3& soundOrigin, const idVec3& prevSoundOrigin, idSoundEmitterLocal *def, SoundChainResults *results );
 	float					FindAmplitude( idSoundEmitterLocal *sound, const int localTime, const idVec3 *listenerPosition, const s_channelType channel, bool shakesOnly );
 	void					GetSubtitles( idList<SubtitleMatch> &dest ) override;	//stgatilov #2454
 
@@ -633,6 +672,12 @@ public:
 
 	idList<idSoundEmitterLocal *>emitters;
 
+	// for primary and secondary listener, ResolveOrigin uses them from the main and the sound thread:
+	// a built cache is never changed, rebuilding replaces it while older users keep theirs
+	std::shared_ptr<const idSoundPortalCache> portalCache[2];
+	idVec3					portalCacheListenerPos[2];	// doom units
+	idSysMutex				portalCacheMutex;
+
 	idSoundFade				soundClassFade[SOUND_MAX_CLASSES];	// for global sound fading
 
 	// avi stuff
@@ -821,6 +866,8 @@ public:
 	static idCVar			s_useEAXReverb;
 	static idCVar			s_useHRTF;
 	static idCVar			s_decompressionLimit;
+	static idCVar			s_decodeAheadMs;
+	static idCVar			s_decodeAheadMinLength;
 	// nbohr1more: #5587 Reverb volume control
 	static idCVar			s_alReverbGain;
 
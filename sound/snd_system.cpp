@@ -54,6 +54,8 @@ idCVar idSoundSystemLocal::s_realTimeDecoding(
 	"  2 --- don't preload, stream everything"
 );
 
+idCVar idSoundSystemLocal::s_decodeAheadMs( "s_decodeAheadMs", "250", CVAR_SOUND | CVAR_INTEGER | CVAR_ARCHIVE, "long streamed OGG sounds are decoded by background thread this many milliseconds ahead of mixer (0 = decode on demand)", 0, 2000 );
+idCVar idSoundSystemLocal::s_decodeAheadMinLength( "s_decodeAheadMinLength", "3000", CVAR_SOUND | CVAR_INTEGER | CVAR_ARCHIVE, "only sounds longer than this many milliseconds are decoded ahead", 0, 100000 );
 idCVar idSoundSystemLocal::s_slowAttenuate( "s_slowAttenuate", "1", CVAR_SOUND | CVAR_BOOL, "slowmo sounds attenuate over shorted distance" );
 idCVar idSoundSystemLocal::s_enviroSuitCutoffFreq( "s_enviroSuitCutoffFreq", "2000", CVAR_SOUND | CVAR_FLOAT, "" );
 idCVar idSoundSystemLocal::s_enviroSuitCutoffQ( "s_enviroSuitCutoffQ", "2", CVAR_SOUND | CVAR_FLOAT, "" );
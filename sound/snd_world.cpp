@@ -36,6 +36,8 @@ void idSoundWorldLocal::Init( idRenderWorld *renderWorld ) {
 	listenerQU.Zero();
 	listenerArea = 0;
 	listenerAreaName = "Undefined";
+	portalCache[0].reset();
+	portalCache[1].reset();
 	listenerEffect = AL_EFFECTSLOT_NULL;
 	// nbohr1more: #5587 Reverb volume control
 	listenerSlotReverbGain = 1.0f;
@@ -184,6 +186,11 @@ void idSoundWorldLocal::ClearAllSoundEmitters() {
 	localSound = NULL;
 	secondarySound = NULL; // grayman #4882
 
+	portalCacheMutex.Lock();
+	portalCache[0].reset();
+	portalCache[1].reset();
+	portalCacheMutex.Unlock();
+
 	Sys_LeaveCriticalSection();
 }
 
@@ -812,6 +819,133 @@ float idSoundWorldLocal::GetDiffractionLoss(const idVec3 p1, const idVec3 p2, co
 	return (idSoundSystemLocal::s_diffractionMax.GetFloat()*(angle / 180.0f));
 }
 
+/*
+===================
+idSoundPortalCache::idSoundPortalCache
+===================
+*/
+idSoundPortalCache::idSoundPortalCache( void ) {
+	Clear();
+}
+
+/*
+===================
+idSoundPortalCache::Clear
+===================
+*/
+void idSoundPortalCache::Clear( void ) {
+	listenerArea = -1;
+	world = NULL;
+	portalStateCount = -1;
+	numAreas = 0;
+	maxPortals = 0;
+	minLoss.Clear();
+}
+
+/*
+===================
+idSoundPortalCache::Build
+
+Bellman-Ford limited by number of portals (ResolveOrigin never goes deeper anyway).
+Minimum is taken over all walks, not only over chains without repeated areas,
+so it is a lower bound for what ResolveOrigin can find, even with negative losses.
+===================
+*/
+void idSoundPortalCache::Build( int numAreas_, const idList<portal_t> &portals, int listenerArea_, int maxPortals_ ) {
+	TRACE_CPU_SCOPE( "Sound:BuildPortalCache" )
+
+	listenerArea = listenerArea_;
+	numAreas = numAreas_;
+	maxPortals = maxPortals_;
+	minLoss.SetNum( ( maxPortals + 1 ) * numAreas );
+
+	float *curr = minLoss.Ptr();
+	for ( int a = 0; a < numAreas; a++ ) {
+		curr[a] = idMath::INFINITY;
+	}
+	if ( listenerArea >= 0 && listenerArea < numAreas ) {
+		curr[listenerArea] = 0.0f;
+	}
+
+	for ( int k = 1; k <= maxPortals; k++ ) {
+		const float *prev = curr;
+		curr += numAreas;
+		memcpy( curr, prev, numAreas * sizeof( curr[0] ) );
+		for ( int p = 0; p < portals.Num(); p++ ) {
+			const portal_t &portal = portals[p];
+			int a0 = portal.areas[0], a1 = portal.areas[1];
+			if ( prev[a1] + portal.loss < curr[a0] ) {
+				curr[a0] = prev[a1] + portal.loss;
+			}
+			if ( prev[a0] + portal.loss < curr[a1] ) {
+				curr[a1] = prev[a0] + portal.loss;
+			}
+		}
+	}
+}
+
+/*
+===================
+idSoundPortalCache::GetMinLoss
+===================
+*/
+float idSoundPortalCache::GetMinLoss( int area, int maxPortals_ ) const {
+	if ( area < 0 || area >= numAreas || maxPortals_ < 0 ) {
+		return idMath::INFINITY;
+	}
+	return minLoss[ Min( maxPortals_, maxPortals ) * numAreas + area ];
+}
+
+static const int MAX_PORTAL_TRACE_DEPTH = 10;
+static const float PORTAL_LOSS_BOUND_EPSILON = 0.01f;	// dB, protects pruning from roundoff errors
+
+/*
+===================
+idSoundWorldLocal::GetPortalCache
+
+Returns portal cache for listener at the given position, rebuilding it if necessary.
+  called by the main thread and the sound thread
+===================
+*/
+std::shared_ptr<const idSoundPortalCache> idSoundWorldLocal::GetPortalCache( bool primary, const idVec3 &listenerPosition ) {
+	idScopedCriticalSection lock( portalCacheMutex );
+	std::shared_ptr<const idSoundPortalCache> &cache = portalCache[primary ? 0 : 1];
+	idVec3 &cachePos = portalCacheListenerPos[primary ? 0 : 1];
+	int stateCount = rw->GetPortalStateCount();
+
+	if ( cache && cache->world == rw && cache->portalStateCount == stateCount && cachePos == listenerPosition ) {
+		return cache;
+	}
+	int area = rw->GetAreaAtPoint( listenerPosition );
+	cachePos = listenerPosition;
+	if ( cache && cache->world == rw && cache->portalStateCount == stateCount && cache->listenerArea == area ) {
+		return cache;
+	}
+
+	idList<idSoundPortalCache::portal_t> portals;
+	int numAreas = rw->NumAreas();
+	for ( int a = 0; a < numAreas; a++ ) {
+		int numPortals = rw->NumPortalsInArea( a );
+		for ( int p = 0; p < numPortals; p++ ) {
+			exitPortal_t re = rw->GetPortal( a, p );
+			// every portal is seen from both areas
+			if ( re.areas[0] < re.areas[1] ) {
+				idSoundPortalCache::portal_t &portal = portals.Alloc();
+				portal.areas[0] = re.areas[0];
+				portal.areas[1] = re.areas[1];
+				portal.loss = re.lossPlayer;
+			}
+		}
+	}
+
+	std::shared_ptr<idSoundPortalCache> newCache = std::make_shared<idSoundPortalCache>();
+	newCache->world = rw;
+	newCache->portalStateCount = stateCount;
+	newCache->Build( numAreas, portals, area, MAX_PORTAL_TRACE_DEPTH );
+	cache = newCache;
+	return cache;
+}
+
 /*
 ===================
 idSoundWorldLocal::ResolveOrigin
@@ -827,9 +961,20 @@ If there is no path through open portals from the sound to the listener, def->di
 set at maxDistance
 ===================
 */
-static const int MAX_PORTAL_TRACE_DEPTH = 10;
-
 bool idSoundWorldLocal::ResolveOrigin( bool primary, const int stackDepth, const soundPortalTrace_t *prevStack, const int soundArea, const float dist, const float loss, const idVec3& soundOrigin, const idVec3& prevSoundOrigin, idSoundEmitterLocal *def , SoundChainResults *results) // grayman #3042 // grayman #4219
+{
+	// the portal cache is fetched once for the whole flood, not at every portal
+	idVec3 listenerPosition = (primary ? listenerQU : gameLocal.GetLocalPlayer()->GetSecondaryListenerLoc()); // doom units
+	std::shared_ptr<const idSoundPortalCache> cache = GetPortalCache( primary, listenerPosition );
+	return ResolveOrigin_r( *cache, listenerPosition, stackDepth, prevStack, soundArea, dist, loss, soundOrigin, prevSoundOrigin, def, results );
+}
+
+/*
+===================
+idSoundWorldLocal::ResolveOrigin_r
+===================
+*/
+bool idSoundWorldLocal::ResolveOrigin_r( const idSoundPortalCache &cache, const idVec3 &listenerPosition, const int stackDepth, const soundPortalTrace_t *prevStack, const int soundArea, const float dist, const float loss, const idVec3& soundOrigin, const idVec3& prevSoundOrigin, idSoundEmitterLocal *def , SoundChainResults *results)
 {
 	if ( dist >= def->distance ) // compare meters to meters
 	{
@@ -841,7 +986,6 @@ bool idSoundWorldLocal::ResolveOrigin( bool primary, const int stackDepth, const
 	// from here is greater than the sound's max distance, then there's no need to continue, because
 	// the listener won't hear the sound using this chain of portals along this path.
 
-	idVec3 listenerPosition = (primary ? listenerQU : gameLocal.GetLocalPlayer()->GetSecondaryListenerLoc()); // doom units
 	float distToListener;
 	distToListener = (soundOrigin - listenerPosition).LengthFast(); // min distance remaining to reach listener (doom units)
 	if ( ( dist + (distToListener * DOOM_TO_METERS) ) >= def->distance )
@@ -869,7 +1013,23 @@ bool idSoundWorldLocal::ResolveOrigin( bool primary, const int stackDepth, const
 
 	float angularLoss = 0.0f;
 
-	int listenArea = rw->GetAreaAtPoint(listenerPosition);
+	int listenArea = cache.listenerArea;
+
+	// diffraction loss is nonnegative, so the loss accumulated over portals is a lower bound of the total loss
+	// skip this area if listener can't be reached within trace depth, or if the sound would be too quiet then
+	bool useLossBound = idSoundSystemLocal::s_diffractionMax.GetFloat() >= 0.0f;
+	if ( soundArea != listenArea )
+	{
+		float minLoss = cache.GetMinLoss( soundArea, MAX_PORTAL_TRACE_DEPTH - stackDepth );
+		if ( minLoss == idMath::INFINITY )
+		{
+			return false;
+		}
+		if ( useLossBound && soundSystemLocal.dB2Scale(def->parms.volume - loss - minLoss + PORTAL_LOSS_BOUND_EPSILON) < SND_EPSILON )
+		{
+			return false;
+		}
+	}
 
 	if ( soundArea == listenArea ) // grayman #4882
 	{
@@ -938,6 +1098,17 @@ bool idSoundWorldLocal::ResolveOrigin( bool primary, const int stackDepth, const
 			continue;
 		}
 
+		// don't go into areas from which listener can't be heard
+		float minLoss = cache.GetMinLoss( otherArea, MAX_PORTAL_TRACE_DEPTH - stackDepth - 1 );
+		if ( minLoss == idMath::INFINITY )
+		{
+			continue;
+		}
+		if ( useLossBound && soundSystemLocal.dB2Scale(def->parms.volume - loss - re.lossPlayer - minLoss + PORTAL_LOSS_BOUND_EPSILON) < SND_EPSILON )
+		{
+			continue;
+		}
+
 		// pick a point on the portal to serve as our virtual sound origin
 #if 1
 		idVec3 source;
@@ -1044,7 +1215,7 @@ bool idSoundWorldLocal::ResolveOrigin( bool primary, const int stackDepth, const
 
 		idVec3 trailingSoundOrigin = soundOrigin; // doom units
 
-		if ( ResolveOrigin( primary, stackDepth+1, &newStack, otherArea, dist+(tlenLength*DOOM_TO_METERS), loss + re.lossPlayer + angularLoss/* + waterLoss*/, source, trailingSoundOrigin, def, res ) ) // grayman #3042
+		if ( ResolveOrigin_r( cache, listenerPosition, stackDepth+1, &newStack, otherArea, dist+(tlenLength*DOOM_TO_METERS), loss + re.lossPlayer + angularLoss/* + waterLoss*/, source, trailingSoundOrigin, def, res ) ) // grayman #3042
 		{
 			chainResults.Append(res);
 		} 
@@ -2615,3 +2786,94 @@ idSoundWorldLocal::SetEnviroSuit
 void idSoundWorldLocal::SetEnviroSuit( bool active ) {
 	enviroSuitActive = active;
 }
+
+
+#include "../tests/testing.h"
+
+// same flood as ResolveOrigin: chains of areas without repetitions, limited depth
+static float PortalChainMinLoss_r( const idList<idSoundPortalCache::portal_t> &portals, int area, int listenerArea, int depth, int maxDepth, idList<int> &chain, float loss ) {
+	if ( area == listenerArea ) {
+		return loss;
+	}
+	if ( depth == maxDepth ) {
+		return idMath::INFINITY;
+	}
+	chain.Append( area );
+	float best = idMath::INFINITY;
+	for ( int p = 0; p < portals.Num(); p++ ) {
+		const idSoundPortalCache::portal_t &portal = portals[p];
+		if ( portal.areas[0] != area && portal.areas[1] != area ) {
+			continue;
+		}
+		int otherArea = ( portal.areas[0] == area ? portal.areas[1] : portal.areas[0] );
+		if ( chain.FindIndex( otherArea ) >= 0 ) {
+			continue;
+		}
+		best = Min( best, PortalChainMinLoss_r( portals, otherArea, listenerArea, depth + 1, maxDepth, chain, loss + portal.loss ) );
+	}
+	chain.RemoveIndex( chain.Num() - 1 );
+	return best;
+}
+
+TEST_CASE("SoundPortalCache:MatchesRecursion") {
+	static const int MAX_DEPTH = 10;
+	idRandom rnd( 1234 );
+
+	for ( int test = 0; test < 200; test++ ) {
+		int numAreas = 1 + rnd.RandomInt( 16 );
+		int numPortals = rnd.RandomInt( numAreas * 3 / 2 + 1 );
+		bool negativeLoss = ( test % 4 == 3 );
+
+		idList<idSoundPortalCache::portal_t> portals;
+		for ( int p = 0; p < numPortals; p++ ) {
+			idSoundPortalCache::portal_t portal;
+			portal.areas[0] = rnd.RandomInt( numAreas );
+			portal.areas[1] = rnd.RandomInt( numAreas );
+			if ( portal.areas[0] == portal.areas[1] ) {
+				continue;
+			}
+			// some doors are closed, some portals are open
+			portal.loss = ( rnd.RandomInt( 3 ) == 0 ? 0.0f : rnd.RandomFloat() * 20.0f );
+			if ( negativeLoss && rnd.RandomInt( 4 ) == 0 ) {
+				portal.loss = -rnd.RandomFloat() * 5.0f;
+			}
+			portals.Append( portal );
+		}
+		int listenerArea = rnd.RandomInt( numAreas );
+
+		idSoundPortalCache cache;
+		cache.Build( numAreas, portals, listenerArea, MAX_DEPTH );
+
+		int errors = 0;
+		for ( int area = 0; area < numAreas; area++ ) {
+			for ( int depth = 0; depth <= MAX_DEPTH; depth++ ) {
+				idList<int> chain;
+				float exact = PortalChainMinLoss_r( portals, area, listenerArea, depth, MAX_DEPTH, chain, 0.0f );
+				float bound = cache.GetMinLoss( area, MAX_DEPTH - depth );
+
+				// cache must say "unreachable" exactly when recursion finds nothing
+				if ( ( exact == idMath::INFINITY ) != ( bound == idMath::INFINITY ) ) {
+					errors++;
+				} else if ( exact != idMath::INFINITY ) {
+					// lower bound always, exact for nonnegative losses
+					if ( bound > exact + 1e-3f ) {
+						errors++;
+					}
+					if ( !negativeLoss && bound < exact - 1e-3f ) {
+						errors++;
+					}
+				}
+			}
+		}
+		CHECK( errors == 0 );
+	}
+
+	// listener outside the world: nothing is reachable
+	idList<idSoundPortalCache::portal_t> portals;
+	idSoundPortalCache::portal_t portal = { { 0, 1 }, 0.0f };
+	portals.Append( portal );
+	idSoundPortalCache cache;
+	cache.Build( 2, portals, -1, MAX_DEPTH );
+	CHECK( cache.GetMinLoss( 0, MAX_DEPTH ) == idMath::INFINITY );
+	CHECK( cache.GetMinLoss( 1, MAX_DEPTH ) == idMath::INFINITY );
+}
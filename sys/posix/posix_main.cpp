@@ -426,6 +426,33 @@ ID_TIME_T Sys_FileTimeStamp(FILE * fp) {
 	return st.st_mtime;
 }
 
+const void *Sys_MapFileRead( const char *path, size_t &length ) {
+	length = 0;
+	int fd = open( path, O_RDONLY );
+	if ( fd < 0 ) {
+		return NULL;
+	}
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || st.st_size <= 0 ) {
+		close( fd );
+		return NULL;
+	}
+	void *data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	// mapping remains valid after descriptor is closed
+	close( fd );
+	if ( data == MAP_FAILED ) {
+		return NULL;
+	}
+	length = st.st_size;
+	return data;
+}
+
+void Sys_UnmapFile( const void *data, size_t length ) {
+	if ( data ) {
+		munmap( const_cast<void *>( data ), length );
+	}
+}
+
 void Sys_Sleep(int msec) {
 	if ( msec < 20 ) {
 		static int last = 0;
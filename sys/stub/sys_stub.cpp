@@ -123,6 +123,14 @@ sysEvent_t	Sys_GetEvent( void ) {
 void	Sys_Mkdir( const char *path ) {
 }
 
+const void *Sys_MapFileRead( const char *path, size_t &length ) {
+	length = 0;
+	return NULL;
+}
+
+void Sys_UnmapFile( const void *data, size_t length ) {
+}
+
 const char *Sys_DefaultCDPath(void) {
 	return "";
 }
@@ -409,6 +409,9 @@ bool			Sys_GetCurrentMonitorResolution( int &width, int &height );
 
 void			Sys_Mkdir( const char *path );
 ID_TIME_T		Sys_FileTimeStamp( FILE *fp );
+// read-only memory mapping of the whole file, returns NULL on failure
+const void *	Sys_MapFileRead( const char *path, size_t &length );
+void			Sys_UnmapFile( const void *data, size_t length );
 // NOTE: do we need to guarantee the same output on all platforms?
 const char *	Sys_TimeStampToStr( ID_TIME_T timeStamp );
 const char *	Sys_DefaultBasePath( void );
@@ -447,6 +447,49 @@ ID_TIME_T Sys_FileTimeStamp( FILE *fp ) {
 	return ( long ) st.st_mtime;
 }
 
+/*
+=================
+Sys_MapFileRead
+=================
+*/
+const void *Sys_MapFileRead( const char *path, size_t &length ) {
+	length = 0;
+	// note: same sharing mode as fopen, so that mapped file can be opened by other code
+	HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx( file, &size ) || size.QuadPart <= 0 || (unsigned long long)size.QuadPart > SIZE_MAX ) {
+		CloseHandle( file );
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if ( !mapping ) {
+		return NULL;
+	}
+	const void *data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	// view keeps the mapping object alive
+	CloseHandle( mapping );
+	if ( !data ) {
+		return NULL;
+	}
+	length = (size_t)size.QuadPart;
+	return data;
+}
+
+/*
+=================
+Sys_UnmapFile
+=================
+*/
+void Sys_UnmapFile( const void *data, size_t length ) {
+	if ( data ) {
+		UnmapViewOfFile( data );
+	}
+}
+
 /*
 ==============
 Sys_Cwd
@@ -649,7 +649,7 @@ void Actions::PerformInstallRepack(ZipSync::ProgressIndicator *progress) {
 	ZipSync::UpdateProcess *updater = g_state->_updater.get();
 	ZipSyncAssert(updater);
 
-	updater->RepackZips(progress->GetDownloaderCallback());
+	updater->RepackZips(progress->GetDownloaderCallback(), 0);
 	g_logger->infof("Repacking finished");
 
 	g_logger->infof("");
@@ -132,54 +132,6 @@ std::string DownloadSimple(const std::string &url, const std::string &rootDir, c
     return filepath;
 }
 
-void ParallelFor(int from, int to, const std::function<void(int)> &body, int thrNum, int blockSize) {
-    if (thrNum == 1) {
-        for (int i = from; i < to; i++)
-            body(i);
-    }
-    else {
-        if (thrNum <= 0)
-            thrNum = std::thread::hardware_concurrency();
-        //int blockNum = (to - from + blockSize-1) / blockSize;
-
-        std::vector<std::thread> threads(thrNum);
-        int lastAssigned = from;
-        std::exception_ptr workerException;
-        std::mutex mutex;
-
-        for (int t = 0; t < thrNum; t++) {
-            auto ThreadFunc = [&,t]() {
-                while (1) {
-                    int left, right;
-                    {
-                        std::lock_guard<std::mutex> lock(mutex);
-                        if (workerException || lastAssigned == to)
-                            break;
-                        left = lastAssigned;
-                        right = std::min(lastAssigned + blockSize, to);
-                        lastAssigned = right;
-                    }
-                    try {
-                        for (int i = left; i < right; i++) {
-                            body(i);
-                        }
-                    } catch(...) {
-                        std::lock_guard<std::mutex> lock(mutex);
-                        workerException = std::current_exception();
-                        break;
-                    }
-                }
-            };
-            threads[t] = std::thread(ThreadFunc);
-        }
-        for (int t = 0; t < thrNum; t++)
-            threads[t].join();
-
-        if (workerException)
-            std::rethrow_exception(workerException);
-    }
-}
-
 double TotalCompressedSize(const ZipSync::Manifest &mani, bool providedOnly) {
     double size = 0.0;
     for (int i = 0; i < mani.size(); i++) {
@@ -29,7 +29,6 @@ std::vector<std::string> CollectFilePaths(const std::vector<std::string> &elemen
 
 std::string DownloadSimple(const std::string &url, const std::string &rootDir, const char *printIndent = "");
 
-void ParallelFor(int from, int to, const std::function<void(int)> &body, int thrNum = -1, int blockSize = 1);
 double TotalCompressedSize(const ZipSync::Manifest &mani, bool providedOnly = true);
 int TotalCount(const ZipSync::Manifest &mani, bool providedOnly = true);
 
@@ -405,6 +405,7 @@ void CommandUpdate(args::Subparser &parser) {
     args::ValueFlag<std::string> argTargetMani(parser, "trgMani", "Path to the target manifest to update to", {'t', "target"}, "manifest.iniz", args::Options::Required);
     args::ValueFlagList<std::string> argProvidedMani(parser, "provMani", "Path to additional provided manifests describing where to take files from", {'p', "provided"}, {});
     args::Flag argClean(parser, "clean", "Run \"clean\" command before and after update", {'c', "clean"});
+    args::ValueFlag<int> argThreads(parser, "threads", "Use this number of parallel threads to accelerate repacking (0 = max)", {'j', "threads"}, 1);
     args::PositionalList<std::string> argManagedZips(parser, "managed", "List of files or globs specifying which zips must be updated");
     args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"}, args::Options::HiddenFromDescription);
     parser.Parse();
@@ -515,7 +516,7 @@ void CommandUpdate(args::Subparser &parser) {
         progress.Update(1.0, "All downloads complete");
     }
     printf("Repacking zips...\n");
-    update.RepackZips();
+    update.RepackZips(GlobalProgressCallback(), argThreads.Get());
     Manifest provMani = update.GetProvidedManifest();
 
     provMani = provMani.Filter([](const FileMetainfo &f) {
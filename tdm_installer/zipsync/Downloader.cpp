@@ -1,6 +1,7 @@
 #include "Downloader.h"
 #include <curl/curl.h>
 #include <algorithm>
+#include <cmath>
 #include "Logging.h"
 #include "StdString.h"
 #include <string.h>
@@ -50,8 +51,10 @@ DownloadSource::DownloadSource(const std::string &url) : url(url) { byterange[0]
 DownloadSource::DownloadSource(const std::string &url, uint32_t from, uint32_t to) : url(url) { byterange[0] = from; byterange[1] = to; }
 
 
-Downloader::~Downloader() {}
-Downloader::Downloader() : _curlHandle(nullptr, curl_easy_cleanup) {}
+Downloader::~Downloader() {
+    CleanupCurl();
+}
+Downloader::Downloader() {}
 
 void Downloader::EnqueueDownload(const DownloadSource &source, const DownloadFinishedCallback &finishedCallback) {
     Download down;
@@ -85,145 +88,225 @@ void Downloader::SetMultipartBlocked(bool blocked) {
     _blockMultipart = blocked;
 }
 
+void Downloader::SetMaxConnections(int total, int perHost) {
+    _maxConnections = std::max(total, 1);
+    _maxConnectionsPerHost = std::max(std::min(perHost, _maxConnections), 1);
+}
+
+//returns "host:port" part of URL
+static std::string GetUrlHost(const std::string &url) {
+    size_t start = url.find("://");
+    start = (start == std::string::npos ? 0 : start + 3);
+    size_t end = url.find('/', start);
+    if (end == std::string::npos)
+        end = url.size();
+    return url.substr(start, end - start);
+}
+
 void Downloader::DownloadAll() {
     if (_progressCallback)
         _progressCallback(0.0, "Downloading started");
-
-    _curlHandle.reset(curl_easy_init());
+    _interruptCode = 0;
 
     //distribute downloads across remote files / urls
+    std::map<std::string, std::vector<int>> urlDownloads;
     for (int i = 0; i <  _downloads.size(); i++)
-        _urlStates[_downloads[i].src.url].downloadsIds.push_back(i);
-    for (auto &pKV : _urlStates) {
-        std::string url = pKV.first;
-        std::vector<int> &ids = pKV.second.downloadsIds;
+        urlDownloads[_downloads[i].src.url].push_back(i);
+    _urlStates.clear();
+    for (auto &pKV : urlDownloads) {
+        std::vector<int> &ids = pKV.second;
         std::sort(ids.begin(), ids.end(), [this](int a, int b) {
            return _downloads[a].src.byterange[0] < _downloads[b].src.byterange[0];
         });
+        CreateUrlStates(pKV.first, ids);
     }
 
-    //go over remote files and process them one by one
-    for (const auto &pKV : _urlStates) {
-        std::string url = pKV.first;
-        try {
-            DownloadAllForUrl(url);
-        }
-        catch(const ErrorException &e) {
-            if (!_silentErrors)
-                throw e;    //rethrow further to caller
-            else
-                {}          //supress exception, continue with other urls
+    _curlMulti = curl_multi_init();
+    curl_multi_setopt(_curlMulti, CURLMOPT_MAX_TOTAL_CONNECTIONS, long(_maxConnections));
+    curl_multi_setopt(_curlMulti, CURLMOPT_MAX_HOST_CONNECTIONS, long(_maxConnectionsPerHost));
+
+    try {
+        while (1) {
+            //occupy free connections with new requests
+            StartRequests();
+            if (_activeResponses.empty())
+                break;  //everything is done
+
+            //let CURL transfer some data
+            int running = 0;
+            CURLMcode mret = curl_multi_perform(_curlMulti, &running);
+            ZipSyncAssertF(mret == CURLM_OK, "Unexpected CURL multi error %d", int(mret));
+
+            //collect finished requests
+            //note: messages are invalidated when handle is removed, so don't process them right away
+            std::vector<std::pair<CURL*, CURLcode>> finished;
+            int msgsLeft = 0;
+            while (CURLMsg *msg = curl_multi_info_read(_curlMulti, &msgsLeft)) {
+                if (msg->msg == CURLMSG_DONE)
+                    finished.emplace_back(msg->easy_handle, msg->data.result);
+            }
+            for (const auto &pCR : finished)
+                FinishRequest(pCR.first, pCR.second);
+
+            //wait for network activity (unless we can start new requests right now)
+            if (finished.empty())
+                curl_multi_wait(_curlMulti, NULL, 0, 100, NULL);
         }
     }
-
-    ZipSyncAssert(_curlHandle.get_deleter() == curl_easy_cleanup);
-    _curlHandle.reset();
+    catch(...) {
+        CleanupCurl();
+        throw;
+    }
+    CleanupCurl();
 
     if (_progressCallback)
         _progressCallback(1.0, "Downloading finished");
 }
 
-void Downloader::DownloadAllForUrl(const std::string &url) {
-    UrlState &state = _urlStates.find(url)->second;
-    int n = state.downloadsIds.size();
+void Downloader::CreateUrlStates(const std::string &url, const std::vector<int> &downloadsIds) {
+    UrlState state;
+    state.url = url;
+    state.host = GetUrlHost(url);
+    state.speedLastFailedAt.assign(SPEED_PROFILES_NUM, -1);
+
+    //estimate how many requests are necessary with the fastest speed profile
+    const SpeedProfile &profile = SPEED_PROFILES[0];
+    int maxParts = (_blockMultipart ? 1 : profile.maxPartsPerRequest);
+    int n = downloadsIds.size();
+    std::vector<double> costs(n);
+    double totalCost = 0.0;
+    uint32_t last = UINT32_MAX;
+    for (int i = 0; i < n; i++) {
+        const Download &down = _downloads[downloadsIds[i]];
+        costs[i] = double(down.progressSize) / profile.maxRequestSize;
+        if (down.src.byterange[0] != last)
+            costs[i] += 1.0 / maxParts;
+        last = down.src.byterange[1];
+        totalCost += costs[i];
+    }
 
-    //used to occasionally restore faster speed profiles
-    int64_t speedLastFailedAt[SPEED_PROFILES_NUM];
-    memset(speedLastFailedAt, -1, sizeof(speedLastFailedAt));
-
-    while (state.doneCnt < n) {
-        //select speed profile
-        ZipSyncAssertF(state.speedProfile < SPEED_PROFILES_NUM, "Repeated timeout on URL %s", url.c_str());
-        SpeedProfile profile = SPEED_PROFILES[state.speedProfile];
-        if (_blockMultipart)
-            profile.maxPartsPerRequest = 1;
-
-        std::vector<SubTask> subtasks;  //set of chunks scheduled as one request
-        uint64_t totalSize = 0;         //total number of bytes scheduled into request
-        int rangesCnt = 0;              //number of separate byteranges scheduled
-        uint32_t last = UINT32_MAX;     //end of the last byterange
-
-        int end = state.doneCnt;
-        //grab a few next downloads for the next HTTP request
-        while (end < n) {
-            //what if we add the whole next download? (or what remains of it)
-            int idx = state.downloadsIds[end];
-            const Download &down = _downloads[idx];
-            uint32_t downStart = down.src.byterange[0] + (subtasks.empty() ? state.doneBytesNext : 0);
-            uint32_t downEnd = down.src.byterange[1];
-
-            //estimate quantities if we add this download
-            uint64_t newTotalSize = totalSize + (downEnd - downStart);
-            int newRangesCnt = rangesCnt + (last != downStart);
-
-            //stop before this download if it exceeds ranges limit
-            if (newRangesCnt > profile.maxPartsPerRequest)
-                break;
-            //does it exceed size limit?
-            if (newTotalSize > profile.maxRequestSize) {
-                if (subtasks.size() > 0) {
-                    //we have added at least one download already,
-                    //don't take a new one with size limit overflow
-                    break;
-                }
-                if (downEnd != UINT32_MAX) {
-                    //this download is larger than limit: split it and download only a part of it
-                    SubTask st = {idx, {downStart, downStart + profile.maxRequestSize}};
-                    subtasks.push_back(st);
-                    break;
-                }
-                //single request with unknown size: never split...
-                //note that we will soon discover its size from HTTP headers
-                //so if timeout happens, then we will be able to split it on retry
-            }
+    //if there would be several requests, split the file into contiguous parts
+    //which are downloaded over separate connections in parallel
+    int partsCnt = std::min(int(std::ceil(totalCost - 1e-9)), _maxConnectionsPerHost);
+    partsCnt = std::max(std::min(partsCnt, n), 1);
+
+    double doneCost = 0.0;
+    int part = 1;
+    for (int i = 0; i < n; i++) {
+        if (!state.downloadsIds.empty() && doneCost >= totalCost * part / partsCnt) {
+            _urlStates.push_back(state);
+            state.downloadsIds.clear();
+            part++;
+        }
+        state.downloadsIds.push_back(downloadsIds[i]);
+        doneCost += costs[i];
+    }
+    _urlStates.push_back(std::move(state));
+}
 
-            //no limit exceeded -> add this full download to scheduled request
-            end++;
-            SubTask st = {idx, {downStart, downEnd}};
-            subtasks.push_back(st);
+void Downloader::StartRequests() {
+    int totalConnections = _activeResponses.size();
+    std::map<std::string, int> hostConnections;
+    for (const auto &resp : _activeResponses)
+        hostConnections[_urlStates[resp->stateIdx].host]++;
 
-            //update stats for limit checks on next iterations
-            last = downEnd;
-            totalSize = newTotalSize;
-            rangesCnt = newRangesCnt;
+    for (int i = 0; i < _urlStates.size() && totalConnections < _maxConnections; i++) {
+        UrlState &state = _urlStates[i];
+        if (state.active || state.failed || state.doneCnt == state.downloadsIds.size())
+            continue;
+        int &hostCnt = hostConnections[state.host];
+        if (hostCnt >= _maxConnectionsPerHost)
+            continue;
+
+        try {
+            StartNextRequest(i);
+        }
+        catch(const ErrorException &e) {
+            if (!_silentErrors)
+                throw;      //rethrow further to caller
+            FailUrl(state.url);     //supress exception, continue with other urls
         }
 
-        //perform the HTTP request
-        bool ok = DownloadOneRequest(url, subtasks, profile.lowSpeedTime, profile.connectTimeout);
-
-        if (ok) {
-            //update number of fully finished downloads
-            state.doneCnt = end;
-            //update progress in the next download
-            if (end < state.downloadsIds.size() && subtasks.back().downloadIdx == state.downloadsIds[end]) {
-                //partly finished
-                int idx = subtasks.back().downloadIdx;
-                state.doneBytesNext = subtasks.back().byterange[1] - _downloads[idx].src.byterange[0];
+        if (state.active) {
+            hostCnt++;
+            totalConnections++;
+        }
+    }
+}
+
+void Downloader::StartNextRequest(int stateIdx) {
+    UrlState &state = _urlStates[stateIdx];
+    int n = state.downloadsIds.size();
+
+    //select speed profile
+    ZipSyncAssertF(state.speedProfile < SPEED_PROFILES_NUM, "Repeated timeout on URL %s", state.url.c_str());
+    SpeedProfile profile = SPEED_PROFILES[state.speedProfile];
+    if (_blockMultipart)
+        profile.maxPartsPerRequest = 1;
+
+    std::vector<SubTask> subtasks;  //set of chunks scheduled as one request
+    uint64_t totalSize = 0;         //total number of bytes scheduled into request
+    int rangesCnt = 0;              //number of separate byteranges scheduled
+    uint32_t last = UINT32_MAX;     //end of the last byterange
+
+    int end = state.doneCnt;
+    //grab a few next downloads for the next HTTP request
+    while (end < n) {
+        //what if we add the whole next download? (or what remains of it)
+        int idx = state.downloadsIds[end];
+        const Download &down = _downloads[idx];
+        uint32_t downStart = down.src.byterange[0] + (subtasks.empty() ? state.doneBytesNext : 0);
+        uint32_t downEnd = down.src.byterange[1];
+
+        //estimate quantities if we add this download
+        uint64_t newTotalSize = totalSize + (downEnd - downStart);
+        int newRangesCnt = rangesCnt + (last != downStart);
+
+        //stop before this download if it exceeds ranges limit
+        if (newRangesCnt > profile.maxPartsPerRequest)
+            break;
+        //does it exceed size limit?
+        if (newTotalSize > profile.maxRequestSize) {
+            if (subtasks.size() > 0) {
+                //we have added at least one download already,
+                //don't take a new one with size limit overflow
+                break;
             }
-            else {
-                //fully finished
-                state.doneBytesNext = 0;
+            if (downEnd != UINT32_MAX) {
+                //this download is larger than limit: split it and download only a part of it
+                SubTask st = {idx, {downStart, downStart + profile.maxRequestSize}};
+                subtasks.push_back(st);
+                break;
             }
-            //reset speed profile
-            for (int i = 0; i < state.speedProfile; i++)
-                if (speedLastFailedAt[i] < 0 || _totalBytesDownloaded - speedLastFailedAt[i] > SPEED_PROFILES[i].maxRequestSize) {
-                    //last time when we failed with this profile was long time ago
-                    //so let's try this speed again, maybe it will work now
-                    state.speedProfile = i;
-                    break;
-                }
-        }
-        else {
-            //soft fail: retry with less strict limits
-            speedLastFailedAt[state.speedProfile] = _totalBytesDownloaded;
-            state.speedProfile++;
+            //single request with unknown size: never split...
+            //note that we will soon discover its size from HTTP headers
+            //so if timeout happens, then we will be able to split it on retry
         }
+
+        //no limit exceeded -> add this full download to scheduled request
+        end++;
+        SubTask st = {idx, {downStart, downEnd}};
+        subtasks.push_back(st);
+
+        //update stats for limit checks on next iterations
+        last = downEnd;
+        totalSize = newTotalSize;
+        rangesCnt = newRangesCnt;
+    }
+
+    if (subtasks.empty()) {
+        //scheduling algorithm should never even create such requests...
+        state.doneCnt = end;
+        return;
     }
+
+    //start the HTTP request
+    StartOneRequest(stateIdx, std::move(subtasks), end, profile.lowSpeedTime, profile.connectTimeout);
 }
 
-bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<SubTask> &subtasks, int lowSpeedTime, int connectTimeout) {
-    if (subtasks.empty())
-        return true;    //scheduling algorithm should never even create such requests...
+void Downloader::StartOneRequest(int stateIdx, std::vector<SubTask> &&subtasks, int end, int lowSpeedTime, int connectTimeout) {
+    UrlState &state = _urlStates[stateIdx];
+    const std::string &url = state.url;
 
     //generate byterange string with all adjacent chunks merged
     std::vector<std::pair<uint32_t, uint32_t>> coaslescedRanges;
@@ -262,7 +345,7 @@ bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<Su
 //------------------- CURL callbacks: begin -------------------
     auto header_callback = [](char *buffer, size_t size, size_t nitems, void *userdata) {
         size *= nitems;
-        auto &resp = *((Downloader*)userdata)->_currResponse;
+        auto &resp = *(CurlResponse*)userdata;
         std::string str(buffer, buffer + size);
         size_t from, to, all;
         if (const char *tail = CheckHttpPrefix(str, "Content-Range: bytes ")) {
@@ -288,18 +371,18 @@ bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<Su
     };
     auto write_callback = [](char *buffer, size_t size, size_t nitems, void *userdata) -> size_t {
         size *= nitems;
-        auto &resp = *((Downloader*)userdata)->_currResponse;
+        auto &resp = *(CurlResponse*)userdata;
         if (resp.onerange[0] == resp.onerange[1] && resp.boundary.empty())
             return 0;  //neither range nor multipart response -> stop
         resp.data.insert(resp.data.end(), buffer, buffer + size);
         return size;
     };
     auto xferinfo_callback = [](void *userdata, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
-        auto &resp = *((Downloader*)userdata)->_currResponse;
+        auto &resp = *(CurlResponse*)userdata;
         if (dltotal > 0 && dlnow > 0) {
             resp.progressRatio = double(dlnow) / std::max(dltotal, dlnow);
             resp.bytesDownloaded = dlnow;
-            if (int code = ((Downloader*)userdata)->UpdateProgress())
+            if (int code = resp.owner->UpdateProgress(&resp))
                 return code;   //interrupt!
         }
         return 0;
@@ -307,23 +390,40 @@ bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<Su
 //-------------------- CURL callbacks: end --------------------
 
     //prepare temporary structure for response
-    _currResponse.reset(new CurlResponse());
-    _currResponse->url = url;
-    _currResponse->progressWeight = progressWeight;
+    std::unique_ptr<CurlResponse> response(new CurlResponse());
+    response->owner = this;
+    response->url = url;
+    response->stateIdx = stateIdx;
+    response->subtasks = std::move(subtasks);
+    response->end = end;
+    response->thisEstimate = thisEstimate;
+    response->progressWeight = progressWeight;
+
+    //take CURL handle: reusing old ones helps to exploit connection pool
+    CURL *curl = nullptr;
+    if (!_curlIdleHandles.empty()) {
+        curl = _curlIdleHandles.back();
+        _curlIdleHandles.pop_back();
+    }
+    else {
+        curl = curl_easy_init();
+        ZipSyncAssertF(curl, "Failed to create CURL handle");
+    }
+    response->curl = curl;
 
     //set up CURL request
-    CURL *curl = _curlHandle.get();
     std::string reprocmd = "curl";
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     reprocmd += formatMessage(" %s", url.c_str());
     curl_easy_setopt(curl, CURLOPT_RANGE, byterangeStr.c_str());
     reprocmd += formatMessage(" -r %s", byterangeStr.c_str());
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response.get());
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, (curl_write_callback)header_callback);
-    curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, response.get());
     curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, (curl_xferinfo_callback)xferinfo_callback);
-    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, response.get());
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, response.get());
     curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
     curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, LOW_SPEED_LIMIT);
     reprocmd += formatMessage(" -Y %d", LOW_SPEED_LIMIT);
@@ -340,18 +440,89 @@ bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<Su
     int reqIdx = _curlRequestIdx++;
     reprocmd += formatMessage(" -o out%d.bin", reqIdx);
     g_logger->debugf("[curl-cmd] %s", reprocmd.c_str());
+
+    //start the request: it is performed in DownloadAll loop
+    CURLMcode mret = curl_multi_add_handle(_curlMulti, curl);
+    if (mret != CURLM_OK) {
+        _curlIdleHandles.push_back(curl);
+        g_logger->errorf(lcAssertFailed, "Unexpected CURL multi error %d on URL %s", int(mret), url.c_str());
+    }
+    state.active = true;
+    _activeResponses.push_back(std::move(response));
+
     //notify user that we start downloading from this URL
-    UpdateProgress();
+    UpdateProgress(_activeResponses.back().get());
+}
+
+void Downloader::FinishRequest(CURL *curl, int ret) {
+    auto it = std::find_if(_activeResponses.begin(), _activeResponses.end(), [curl](const std::unique_ptr<CurlResponse> &resp) {
+        return resp->curl == curl;
+    });
+    if (it == _activeResponses.end())
+        return;     //request was aborted already
 
-    //perform the request
-    CURLcode ret = curl_easy_perform(curl);
+    //detach the request from CURL
+    std::unique_ptr<CurlResponse> response = std::move(*it);
+    _activeResponses.erase(it);
     long httpRes = 0;
     curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &httpRes);
+    curl_multi_remove_handle(_curlMulti, curl);
+    _curlIdleHandles.push_back(curl);
+    response->curl = nullptr;
+
+    UrlState &state = _urlStates[response->stateIdx];
+    state.active = false;
+
+    bool ok = false;
+    try {
+        ok = ProcessResponse(*response, ret, httpRes);
+    }
+    catch(const ErrorException &e) {
+        if (!_silentErrors)
+            throw;      //rethrow further to caller
+        FailUrl(state.url);     //supress exception, continue with other urls
+        return;
+    }
+
+    if (ok) {
+        const std::vector<SubTask> &subtasks = response->subtasks;
+        int end = response->end;
+        //update number of fully finished downloads
+        state.doneCnt = end;
+        //update progress in the next download
+        if (end < state.downloadsIds.size() && subtasks.back().downloadIdx == state.downloadsIds[end]) {
+            //partly finished
+            int idx = subtasks.back().downloadIdx;
+            state.doneBytesNext = subtasks.back().byterange[1] - _downloads[idx].src.byterange[0];
+        }
+        else {
+            //fully finished
+            state.doneBytesNext = 0;
+        }
+        //reset speed profile
+        for (int i = 0; i < state.speedProfile; i++)
+            if (state.speedLastFailedAt[i] < 0 || _totalBytesDownloaded - state.speedLastFailedAt[i] > SPEED_PROFILES[i].maxRequestSize) {
+                //last time when we failed with this profile was long time ago
+                //so let's try this speed again, maybe it will work now
+                state.speedProfile = i;
+                break;
+            }
+    }
+    else {
+        //soft fail: retry with less strict limits
+        state.speedLastFailedAt[state.speedProfile] = _totalBytesDownloaded;
+        state.speedProfile++;
+    }
+}
+
+bool Downloader::ProcessResponse(CurlResponse &response, int ret, long httpRes) {
+    const std::string &url = response.url;
+    const std::vector<SubTask> &subtasks = response.subtasks;
 
     //handle return/error codes
-    if (_currResponse->totalSize != UINT_MAX && _downloads[subtasks.front().downloadIdx].src.byterange[1] == UINT_MAX) {
+    if (response.totalSize != UINT_MAX && _downloads[subtasks.front().downloadIdx].src.byterange[1] == UINT_MAX) {
         //even if we have failed, now we know the size of this file (thanks to HTTP header)
-        _downloads[subtasks.front().downloadIdx].src.byterange[1] = _currResponse->totalSize;
+        _downloads[subtasks.front().downloadIdx].src.byterange[1] = response.totalSize;
     }
     if (ret != 0 || (httpRes != 200 && httpRes != 206)) {
         //log down atypical error codes
@@ -367,7 +538,7 @@ bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<Su
         //so we should retry this request again (or maybe a smaller piece of it)
         g_logger->warningf(lcDownloadTooSlow,
             "Timeout for request with %d segments of total size %lld on URL %s",
-            int(subtasks.size()), thisEstimate, url.c_str()
+            int(subtasks.size()), response.thisEstimate, url.c_str()
         );
         return false;   //soft fail: retry is welcome
     }
@@ -379,20 +550,21 @@ bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<Su
     ZipSyncAssertF(httpRes == 200 || httpRes == 206, "Unexpected HTTP return code %d for URL %s", httpRes, url.c_str());
 
     //update progress indicator given that whole request is done
-    _currResponse->progressRatio = 1.0;
-    UpdateProgress();
-    _totalBytesDownloaded += _currResponse->bytesDownloaded;
-    _totalProgress += _currResponse->progressWeight;
+    _totalBytesDownloaded += response.bytesDownloaded;
+    _totalProgress += response.progressWeight;
+    UpdateProgress(&response);
 
     //parse multipart response, producing many single-range responses instead
     std::vector<CurlResponse> results;
-    if (_currResponse->boundary.empty())
-        results.push_back(std::move(*_currResponse));
+    if (response.boundary.empty()) {
+        CurlResponse whole;
+        whole.onerange[0] = response.onerange[0];
+        whole.onerange[1] = response.onerange[1];
+        whole.data = std::move(response.data);
+        results.push_back(std::move(whole));
+    }
     else
-        BreakMultipartResponse(*_currResponse, results);
-
-    //we have already pulled out all we need from this structure, break it down
-    _currResponse.reset();
+        BreakMultipartResponse(response, results);
 
     std::sort(results.begin(), results.end(), [](const CurlResponse &a, const CurlResponse &b) {
         return a.onerange[0] < b.onerange[0];
@@ -439,6 +611,38 @@ bool Downloader::DownloadOneRequest(const std::string &url, const std::vector<Su
     return true;
 }
 
+void Downloader::FailUrl(const std::string &url) {
+    //don't download anything more from this URL
+    for (UrlState &state : _urlStates)
+        if (state.url == url)
+            state.failed = true;
+
+    //abort requests to this URL which are still in progress
+    for (int i = 0; i < _activeResponses.size(); i++) {
+        CurlResponse &resp = *_activeResponses[i];
+        if (resp.url != url)
+            continue;
+        _urlStates[resp.stateIdx].active = false;
+        curl_multi_remove_handle(_curlMulti, resp.curl);
+        _curlIdleHandles.push_back(resp.curl);
+        _activeResponses.erase(_activeResponses.begin() + i--);
+    }
+}
+
+void Downloader::CleanupCurl() {
+    for (const auto &resp : _activeResponses) {
+        curl_multi_remove_handle(_curlMulti, resp->curl);
+        curl_easy_cleanup(resp->curl);
+    }
+    _activeResponses.clear();
+    for (CURL *curl : _curlIdleHandles)
+        curl_easy_cleanup(curl);
+    _curlIdleHandles.clear();
+    if (_curlMulti)
+        curl_multi_cleanup(_curlMulti);
+    _curlMulti = nullptr;
+}
+
 void Downloader::BreakMultipartResponse(const CurlResponse &response, std::vector<CurlResponse> &parts) {
     const auto &data = response.data;
     const std::string &bound = response.boundary;
@@ -484,15 +688,19 @@ void Downloader::BreakMultipartResponse(const CurlResponse &response, std::vecto
     }
 }
 
-int Downloader::UpdateProgress() {
+int Downloader::UpdateProgress(const CurlResponse *response) {
+    if (_interruptCode)
+        return _interruptCode;  //user has already asked to stop, don't bother him again
     char buffer[256] = "Downloading...";
     double progress = _totalProgress;
-    if (_currResponse) {
-        sprintf(buffer, "Downloading \"%s\"...", _currResponse->url.c_str());
-        progress += _currResponse->progressWeight * _currResponse->progressRatio;
-    }
+    for (const auto &resp : _activeResponses)
+        progress += resp->progressWeight * resp->progressRatio;
+    progress = std::min(progress, 1.0);     //rounding errors
+    if (response)
+        sprintf(buffer, "Downloading \"%s\"...", response->url.c_str());
     if (_progressCallback) {
         int code = _progressCallback(progress, buffer);
+        _interruptCode = code;
         return code;
     }
     return 0;
@@ -9,6 +9,7 @@
 
 
 typedef void CURL;
+typedef void CURLM;
 
 namespace ZipSync {
 
@@ -36,13 +37,17 @@ typedef std::function<int(double, const char*)> GlobalProgressCallback;
 /**
  * Smart downloader over HTTP protocol.
  * Utilizes byteranges and multipart byteranges requests to download many chunks quickly.
+ * Runs several HTTP requests simultaneously (to different files, or different parts of one file) to hide network latency.
  * On a problematic network, can split download into many small pieces to cope with occasional timeouts.
  */
 class Downloader {
     bool _silentErrors = false;
     std::unique_ptr<std::string> _useragent;
     bool _blockMultipart = false;
+    int _maxConnections = 8;
+    int _maxConnectionsPerHost = 4;
     GlobalProgressCallback _progressCallback;
+    int _interruptCode = 0;                 //nonzero if progress callback has asked to stop
 
     //user-specified chunk of data to be downloaded
     struct Download {
@@ -53,15 +58,21 @@ class Downloader {
     };
     std::vector<Download> _downloads;
 
-    //state of one remote file processed
+    //state of one remote file processed (or a part of it, if file is downloaded over several connections)
     //usually contains several user-specified "Download"-s
+    //at most one HTTP request is active for every state
     struct UrlState {
+        std::string url;
+        std::string host;                   //"host:port" part of url (for limiting connections)
         std::vector<int> downloadsIds;      //indices in _downloads (sorted by starting offset)
         int doneCnt = 0;                    //how many FULL downloads done
         uint32_t doneBytesNext = 0;         //how many bytes done in the current download
         int speedProfile = 0;               //index in SPEED_PROFILES
+        std::vector<int64_t> speedLastFailedAt; //used to occasionally restore faster speed profiles
+        bool active = false;                //is HTTP request in progress now?
+        bool failed = false;                //error happened on this URL (only in silent mode)
     };
-    std::map<std::string, UrlState> _urlStates;
+    std::vector<UrlState> _urlStates;
 
     //designates user-specified "Download" or a piece of it
     //every HTTP request contains one or several SubTasks
@@ -69,9 +80,15 @@ class Downloader {
         int downloadIdx;                    //index in _downloads
         uint32_t byterange[2];              //can be part of download's byterange
     };
-    //state of the HTTP request currently active
+    //state of an HTTP request currently active
     struct CurlResponse {
+        Downloader *owner = nullptr;
+        CURL *curl = nullptr;
         std::string url;
+        int stateIdx = -1;                  //index in _urlStates
+        std::vector<SubTask> subtasks;      //chunks requested
+        int end = 0;                        //value of UrlState::doneCnt if request succeeds
+        int64_t thisEstimate = 0;           //estimated size of request (for logging)
 
         std::vector<uint8_t> data;          //downloaded file data is appended to here
         uint32_t totalSize = UINT_MAX;      //size of file as reported by HTTP header (used for whole-file downloads)
@@ -82,12 +99,13 @@ class Downloader {
         int64_t bytesDownloaded = 0;        //how many bytes actually downloaded (as reported by CURL)
         double progressWeight = 0.0;        //this request size / total size of all downloads
     };
-    std::unique_ptr<CurlResponse> _currResponse;
+    std::vector<std::unique_ptr<CurlResponse>> _activeResponses;
 
-    double _totalProgress = 0.0;            //which portion of DownloadAll is complete (without current request)
-    int64_t _totalBytesDownloaded = 0;      //how many bytes downloaded in total (without current request)
+    double _totalProgress = 0.0;            //which portion of DownloadAll is complete (without active requests)
+    int64_t _totalBytesDownloaded = 0;      //how many bytes downloaded in total (without active requests)
 
-    std::unique_ptr<CURL, void (*)(CURL*)> _curlHandle; //CURL handle reused between request in order to exploit connection pool
+    CURLM *_curlMulti = nullptr;            //CURL multi handle runs all requests, its connection pool is reused between requests
+    std::vector<CURL*> _curlIdleHandles;    //CURL easy handles not used by any active request now
     int _curlRequestIdx = 0;                //sequental number of HTTP request (used for logging curl commands)
 
 public:
@@ -109,6 +127,9 @@ public:
     void SetUserAgent(const char *useragent);
     //blocked = true: only use ordinary byterange requests, never use multipart ones
     void SetMultipartBlocked(bool blocked);
+    //limit number of simultaneous HTTP connections: in total and to one host
+    //note: set total = 1 to perform requests strictly one by one
+    void SetMaxConnections(int total, int perHost);
 
     //when everything is set up, call this method to actually perform all downloads
     //it blocks until the job is done (progress callback is the only way to interrupt it)
@@ -119,10 +140,16 @@ public:
     int64_t TotalBytesDownloaded() const { return _totalBytesDownloaded; }
 
 private:
-    void DownloadAllForUrl(const std::string &url);
-    bool DownloadOneRequest(const std::string &url, const std::vector<SubTask> &subtasks, int lowSpeedTime, int connectTimeout);
+    void CreateUrlStates(const std::string &url, const std::vector<int> &downloadsIds);
+    void StartRequests();
+    void StartNextRequest(int stateIdx);
+    void StartOneRequest(int stateIdx, std::vector<SubTask> &&subtasks, int end, int lowSpeedTime, int connectTimeout);
+    void FinishRequest(CURL *curl, int ret);
+    bool ProcessResponse(CurlResponse &response, int ret, long httpRes);
+    void FailUrl(const std::string &url);
+    void CleanupCurl();
     void BreakMultipartResponse(const CurlResponse &response, std::vector<CurlResponse> &parts);
-    int UpdateProgress();
+    int UpdateProgress(const CurlResponse *response);
 };
 
 }
@@ -4,6 +4,7 @@
 #include "HttpServer.h"
 #include "StdString.h"
 #include "StdFilesystem.h"
+#include "Utils.h"
 
 
 namespace ZipSync {
@@ -30,6 +31,9 @@ class Fuzzer : private TestCreator {
     Manifest _initialTargetMani;
     Manifest _initialProvidedMani;
 
+    //number of threads used for repacking
+    int _threadsNum = 1;
+
     //http servers (serving content for remote directories)
     bool _remoteEnabled = false;
     std::vector<std::unique_ptr<HttpServer>> _httpServers;
@@ -88,6 +92,10 @@ public:
             _httpServers.pop_back();
     }
 
+    void SetThreadsNum(int threadsNum) {
+        _threadsNum = threadsNum;
+    }
+
     void GenerateInput(std::string baseDir, int seed) {
         _baseDir = baseDir;
         SetSeed(seed);
@@ -179,7 +187,7 @@ public:
         if (_remoteEnabled)
             _updater->DownloadRemoteFiles();
 
-        _updater->RepackZips();
+        _updater->RepackZips(GlobalProgressCallback(), _threadsNum);
 
         return true;
     }
@@ -231,11 +239,26 @@ public:
             ZipSyncAssertF(available, "File %s with hash %s is no longer available", GetFullPath(oldFile.zipPath.abs, oldFile.filename).c_str(), oldFile.compressedHash.Hex().c_str());
         }
     }
+
+    //returns contents of all files in "inplace" dir after update (except for downloaded zips)
+    std::map<std::string, std::vector<uint8_t>> ReadOutputFiles() const {
+        std::map<std::string, std::vector<uint8_t>> res;
+        auto resultPaths = stdext::recursive_directory_enumerate(_rootInplaceDir);
+        for (stdext::path filePath : resultPaths) {
+            if (!stdext::is_regular_file(filePath))
+                continue;
+            if (stdext::starts_with(filePath.filename().string(), "__download"))
+                continue;   //order of downloaded data is not deterministic
+            PathAR path = PathAR::FromAbs(filePath.string(), _rootInplaceDir);
+            res[path.rel] = ReadWholeFile(path.abs);
+        }
+        return res;
+    }
 };
 
 //==========================================================================================
 
-void Fuzz(std::string where, int casesNum, bool enableRemote) {
+void Fuzz(std::string where, int casesNum, bool enableRemote, const std::vector<int> &threadsNums) {
     static const int SPECIAL_SEEDS[] = {0};
     int SK = sizeof(SPECIAL_SEEDS) / sizeof(SPECIAL_SEEDS[0]);
     if (casesNum < 0)
@@ -251,12 +274,34 @@ void Fuzz(std::string where, int casesNum, bool enableRemote) {
         if (attempt >= 0 && duplicate)
             continue;
 
-        fuzz.GenerateInput(where + "/" + std::to_string(seed), seed);
-        if (!fuzz.ValidateInput())
-            continue;
-        fuzz.WriteInput();
-        if (fuzz.DoUpdate())
+        //run same case with every number of threads, results must be byte-identical
+        std::map<std::string, std::vector<uint8_t>> firstOutput;
+        for (int k = 0; k < threadsNums.size(); k++) {
+            std::string baseDir = where + "/" + std::to_string(seed);
+            if (k > 0)
+                baseDir += "_j" + std::to_string(threadsNums[k]);
+            fuzz.SetThreadsNum(threadsNums[k]);
+            fuzz.GenerateInput(baseDir, seed);
+            if (!fuzz.ValidateInput())
+                break;
+            fuzz.WriteInput();
+            if (!fuzz.DoUpdate())
+                break;
             fuzz.CheckOutput();
+
+            auto output = fuzz.ReadOutputFiles();
+            if (k == 0)
+                firstOutput = std::move(output);
+            else {
+                for (const auto &pFile : firstOutput)
+                    ZipSyncAssertF(output.count(pFile.first), "File %s is missing after repacking in %d threads", pFile.first.c_str(), threadsNums[k]);
+                for (const auto &pFile : output) {
+                    auto iter = firstOutput.find(pFile.first);
+                    ZipSyncAssertF(iter != firstOutput.end(), "File %s is extra after repacking in %d threads", pFile.first.c_str(), threadsNums[k]);
+                    ZipSyncAssertF(iter->second == pFile.second, "File %s differs after repacking in %d threads", pFile.first.c_str(), threadsNums[k]);
+                }
+            }
+        }
     }
 }
 
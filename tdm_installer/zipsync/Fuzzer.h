@@ -1,10 +1,11 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 
 namespace ZipSync {
 
-void Fuzz(std::string where, int casesNum, bool enableRemote);
+void Fuzz(std::string where, int casesNum, bool enableRemote, const std::vector<int> &threadsNums = {1});
 
 }
@@ -29,6 +29,7 @@ HttpServer::HttpServer() {
     SetPortNumber();
     SetPauseModel();
     SetDropMultipart();
+    SetRequestLatency();
 }
 
 void HttpServer::SetRootDir(const std::string &root) {
@@ -54,6 +55,10 @@ void HttpServer::SetDropMultipart(bool drop) {
     _dropMultipart = drop;
 }
 
+void HttpServer::SetRequestLatency(int milliseconds) {
+    _requestLatency = milliseconds;
+}
+
 void HttpServer::CloseSuspendedSocket() {
     if (_suspendedSocket) {
         MHD_socket socket = *(MHD_socket*)_suspendedSocket;
@@ -299,6 +304,10 @@ MHD_Result HttpServer::AcceptCallback(
     const char *method,
     const char *version
 ) const {
+    if (_requestLatency > 0) {
+        //emulate remote server: each connection is served in its own thread, so delays overlap
+        std::this_thread::sleep_for(_requestLatency * std::chrono::milliseconds(1));
+    }
 
     std::string filepath = _rootDir + url;
 
@@ -38,6 +38,7 @@ private:
     int _port = -1;
     int _blockSize = -1;
     bool _dropMultipart = false;
+    int _requestLatency = 0;
     PauseModel _pauseModel;
 
 public:
@@ -54,6 +55,7 @@ public:
     void SetBlockSize(int blockSize = 128*1024);
     void SetDropMultipart(bool drop = false);
     void SetPauseModel(const PauseModel &model = PauseModel());
+    void SetRequestLatency(int milliseconds = 0);   //delay before responding to every request
     std::string GetRootUrl() const;
 
     void Start();
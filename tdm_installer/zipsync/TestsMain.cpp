@@ -939,6 +939,116 @@ TEST_CASE("Downloader") {
     }
 }
 
+TEST_CASE("DownloaderConcurrent") {
+    PrepareFilesForHttpServer();
+    std::map<std::string, std::string> fileData;
+    fileData["test.txt"] = ReadWholeFileAsStr((GetTempDir() / "test.txt").string());
+    fileData["identity.bin"] = ReadWholeFileAsStr((GetTempDir() / "identity.bin").string());
+    fileData["subdir/squares.txt"] = ReadWholeFileAsStr((GetTempDir() / "subdir" / "squares.txt").string());
+    auto CreateDownloadCallback = [](std::string &buffer) -> DownloadFinishedCallback {
+        return [&buffer](const void *ptr, uint32_t bytes) -> void {
+            buffer.assign((char*)ptr, (char*)ptr + bytes);
+        };
+    };
+
+    //server in another part of the world: every request takes a while
+    HttpServer server;
+    server.SetRootDir(GetTempDir().string());
+    server.SetRequestLatency(50);
+    server.Start();
+
+    //many chunks from several files: adjacent, separated, overlapping
+    struct Chunk {
+        std::string file;
+        uint32_t from, to;
+    };
+    std::vector<Chunk> chunks;
+    std::mt19937 rnd;
+    for (const char *fn : {"identity.bin", "subdir/squares.txt"}) {
+        uint32_t size = fileData[fn].size();
+        for (uint32_t pos = 0; pos < size; ) {
+            uint32_t to = std::min(pos + 1000 + rnd() % 20000, size);
+            chunks.push_back(Chunk{fn, pos, to});
+            if (rnd() % 8 == 0)
+                chunks.push_back(Chunk{fn, pos + (to - pos) / 2, std::min(to + 3000, size)});
+            pos = to + (rnd() % 3 == 0 ? rnd() % 5000 : 0);
+        }
+    }
+    chunks.push_back(Chunk{"test.txt", 0, UINT32_MAX});
+
+    for (int nomultipart = 0; nomultipart < 2; nomultipart++) {
+        double elapsed[2];
+        std::vector<std::string> results[2];
+        for (int concurrent = 0; concurrent < 2; concurrent++) {
+            Downloader down;
+            down.SetMultipartBlocked(nomultipart);
+            if (concurrent)
+                down.SetMaxConnections(8, 4);
+            else
+                down.SetMaxConnections(1, 1);
+
+            std::vector<std::string> &res = results[concurrent];
+            res.resize(chunks.size());
+            for (int i = 0; i < chunks.size(); i++) {
+                const Chunk &c = chunks[i];
+                std::string url = server.GetRootUrl() + c.file;
+                if (c.to == UINT32_MAX)
+                    down.EnqueueDownload(DownloadSource(url), CreateDownloadCallback(res[i]));
+                else
+                    down.EnqueueDownload(DownloadSource(url, c.from, c.to), CreateDownloadCallback(res[i]));
+            }
+            double progressRatio = -1.0;
+            down.SetProgressCallback([&](double ratio, const char *message) -> int {
+                CHECK(ratio >= progressRatio);
+                progressRatio = ratio;
+                return 0;
+            });
+
+            auto startTime = std::chrono::steady_clock::now();
+            down.DownloadAll();
+            elapsed[concurrent] = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+            CHECK(progressRatio == 1.0);
+            for (int i = 0; i < chunks.size(); i++) {
+                const Chunk &c = chunks[i];
+                const std::string &data = fileData[c.file];
+                if (c.to == UINT32_MAX)
+                    CHECK(res[i] == data);
+                else
+                    CHECK(res[i] == data.substr(c.from, c.to - c.from));
+            }
+        }
+        CHECK(results[0] == results[1]);
+
+        //latency of requests should overlap, but timing is too noisy to check here
+        MESSAGE(formatMessage("Downloaded %d chunks (multipart %s): one connection %0.3lf sec, many connections %0.3lf sec (%0.2lfx)",
+            int(chunks.size()), nomultipart ? "blocked" : "allowed", elapsed[0], elapsed[1], elapsed[0] / elapsed[1]
+        ));
+    }
+
+    {   //silent errors: failure on one file does not break others
+        Downloader down;
+        down.SetErrorMode(true);
+        down.SetMultipartBlocked(true);
+        std::vector<std::string> res(chunks.size()), resMissing(10);
+        for (int i = 0; i < chunks.size(); i++) {
+            const Chunk &c = chunks[i];
+            if (c.to != UINT32_MAX)
+                down.EnqueueDownload(DownloadSource(server.GetRootUrl() + c.file, c.from, c.to), CreateDownloadCallback(res[i]));
+        }
+        for (int i = 0; i < resMissing.size(); i++)
+            down.EnqueueDownload(DownloadSource(server.GetRootUrl() + "missing.bin", i * 1000, i * 1000 + 500), CreateDownloadCallback(resMissing[i]));
+        down.DownloadAll();
+        for (int i = 0; i < chunks.size(); i++) {
+            const Chunk &c = chunks[i];
+            if (c.to != UINT32_MAX)
+                CHECK(res[i] == fileData[c.file].substr(c.from, c.to - c.from));
+        }
+        for (int i = 0; i < resMissing.size(); i++)
+            CHECK(resMissing[i].empty());
+    }
+}
+
 //this bug was noticed after adding subtasks in Downloader
 //i.e. when I made it possible to split single download into smaller chunks
 TEST_CASE("DownloaderSubtasks") {
@@ -1337,6 +1447,14 @@ TEST_CASE("FuzzRemote50") {
     Fuzz((GetTempDir() / "FR50").string(), 50, true);
 }
 
+TEST_CASE("FuzzLocalThreads20") {
+    Fuzz((GetTempDir() / "FLT20").string(), 20, false, {1, 2, 4});
+}
+
+TEST_CASE("FuzzRemoteThreads20") {
+    Fuzz((GetTempDir() / "FRT20").string(), 20, true, {1, 2, 4});
+}
+
 TEST_CASE("FuzzLocalInfinite"
     * doctest::skip()
 ) {
@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <map>
 #include <set>
+#include <thread>
+#include <mutex>
 #include "Logging.h"
 #include "Utils.h"
 #include "ZipUtils.h"
@@ -127,14 +129,6 @@ public:
         //for progress indicator
         uint64_t _totalTargetSize = 0;
 
-        //cached during repacking to avoid reopening
-        mutable UnzFileIndexed zfCache;
-
-        UnzFileIndexed &UnzFileCached() const {
-            if (!zfCache)
-                zfCache.Open(_zipPath.c_str());
-            return zfCache;
-        }
         bool operator< (const ZipInfo &b) const {
             return _zipPath < b._zipPath;
         }
@@ -147,8 +141,15 @@ public:
         ZipSyncAssert(false);
     }
 
-    //indexed as matches: false if provided file was copied in "raw" mode, true if in recompressing mode
-    std::vector<bool> _recompressed;
+    //results of repacking one target zip, produced by worker thread
+    struct RepackResult {
+        //indexed as zip._matchIds: false if provided file was copied in "raw" mode, true if in recompressing mode
+        std::vector<bool> _recompressed;
+        //analyzed files of repacked zip (indexed as zip._matchIds)
+        std::vector<FileMetainfo> _filesNew;
+        bool _ready = false;
+    };
+
     //how many (local) provided files have specified compressed hash
     //note: includes files from repacked and reduced zips
     std::map<HashDigest, int> _hashProvidedCnt;
@@ -160,6 +161,10 @@ public:
 
     //calling back to report current progress
     GlobalProgressCallback _progress;
+    //number of threads used to repack target zips (<= 0 means hardware concurrency)
+    int _threadsNum = 1;
+    //protects logging, progress callback and all the shared bookkeeping while repacking in parallel
+    std::mutex _mutex;
 
     Repacker(UpdateProcess &owner) : _owner(owner) {}
 
@@ -313,8 +318,6 @@ public:
                 filesMap[pf->byterange[0]] = ManifestIter(_repackedMani, _repackedMani.size() - 1);
             }
             for (int midx : dstZip._matchIds) {
-                _recompressed.resize(midx + 1, false);
-                _recompressed[midx] = false;
                 ManifestIter &pf = _owner._matches[midx].provided;
                 ManifestIter newIter = filesMap.at(pf->byterange[0]);
                 pf->Nullify();
@@ -326,22 +329,32 @@ public:
         }
     }
 
-    void RepackZip(ZipInfo &zip) {
-        g_logger->infof(lcRepackZip, "Repacking %s...", zip._zipPathRepacked.c_str());
-        if (_progress)
-            _progress(ComputeProgressRatio(), formatMessage("Repacking %s...", zip._zipPathRepacked.c_str()).c_str());
+    //note: can be called from worker thread, must not modify shared state
+    void RepackZip(const ZipInfo &zip, RepackResult &result) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            g_logger->infof(lcRepackZip, "Repacking %s...", zip._zipPathRepacked.c_str());
+            if (_progress)
+                _progress(ComputeProgressRatio(), formatMessage("Repacking %s...", zip._zipPathRepacked.c_str()).c_str());
+            //ensure all directories are created if missing
+            CreateDirectoriesForFile(zip._zipPath, _owner._rootDir);
+        }
 
-        //ensure all directories are created if missing
-        CreateDirectoriesForFile(zip._zipPath, _owner._rootDir);
         //create new zip archive (it will contain results of repacking)
         ZipFileHolder zfOut(zip._zipPathRepacked.c_str());
 
+        //source zips opened while repacking this zip (closed when it is done)
+        std::map<std::string, UnzFileIndexed> sourceZips;
+
         //copy all target files one-by-one
-        for (int midx : zip._matchIds) {
-            const Match &m = _owner._matches[midx];
+        result._recompressed.assign(zip._matchIds.size(), false);
+        for (int i = 0; i < zip._matchIds.size(); i++) {
+            const Match &m = _owner._matches[zip._matchIds[i]];
 
             //find provided file
-            UnzFileIndexed &zf = FindZip(m.provided->zipPath.abs).UnzFileCached();
+            UnzFileIndexed &zf = sourceZips[m.provided->zipPath.abs];
+            if (!zf)
+                zf.Open(m.provided->zipPath.abs.c_str());
             zf.LocateByByterange(m.provided->byterange[0], m.provided->byterange[1]);
 
             //can we avoid recompressing the file?
@@ -361,16 +374,11 @@ public:
                 copyRaw, m.target->props.crc32, m.target->props.contentsSize
             );
             //remember whether we repacked or not --- to be used in AnalyzeRepackedZip
-            _recompressed.resize(midx+1, false);
-            _recompressed[midx] = !copyRaw;
+            result._recompressed[i] = !copyRaw;
         }
 
         //flush and close new zip
         zfOut.reset();
-        zip._repacked = true;
-
-        if (_progress)
-            _progress(ComputeProgressRatio(), formatMessage("Repacking %s...", zip._zipPathRepacked.c_str()).c_str());
     }
 
     void ValidateFile(const FileMetainfo &want, const FileMetainfo &have) const {
@@ -392,18 +400,19 @@ public:
         ZipSyncAssertF(want.props.externalAttribs == have.props.externalAttribs, "Wrong external attribs of %s after repack", fullPath.c_str());
     }
 
-    void AnalyzeRepackedZip(const ZipInfo &zip) {
+    //note: can be called from worker thread, must not modify shared state
+    void AnalyzeRepackedZip(const ZipInfo &zip, RepackResult &result) const {
         //analyze the repacked new zip
         UnzFileHolder zf(zip._zipPathRepacked.c_str());
         SAFE_CALL(unzGoToFirstFile(zf));
+        result._filesNew.resize(zip._matchIds.size());
         for (int i = 0; i < zip._matchIds.size(); i++) {
-            int midx = zip._matchIds[i];
-            Match &m = _owner._matches[midx];
+            const Match &m = _owner._matches[zip._matchIds[i]];
             if (i > 0) SAFE_CALL(unzGoToNextFile(zf));
 
             //analyze current file
-            bool needsRehashCompressed = _recompressed[midx];
-            FileMetainfo metaNew;
+            bool needsRehashCompressed = result._recompressed[i];
+            FileMetainfo &metaNew = result._filesNew[i];
             metaNew.zipPath = PathAR::FromAbs(zip._zipPathRepacked, _owner._rootDir);
             metaNew.location = FileLocation::Repacked;
             metaNew.package = m.target->package;
@@ -412,6 +421,14 @@ public:
             AnalyzeCurrentFile(zf, metaNew, false, needsRehashCompressed);
             //check that it indeed matches the target
             ValidateFile(*m.target, metaNew);
+        }
+        zf.reset();
+    }
+
+    void CommitRepackedZip(ZipInfo &zip, RepackResult &result) {
+        for (int i = 0; i < zip._matchIds.size(); i++) {
+            Match &m = _owner._matches[zip._matchIds[i]];
+            FileMetainfo &metaNew = result._filesNew[i];
 
             //decrement ref count on zip (which might allow to "reduce" it in ReduceOldZips)
             int &usedCnt = FindZip(m.provided->zipPath.abs)._usedCnt;
@@ -421,11 +438,55 @@ public:
             _hashProvidedCnt[metaNew.compressedHash]++;
 
             //add info about file to special manifest
-            _repackedMani.AppendFile(metaNew);
+            _repackedMani.AppendFile(std::move(metaNew));
             //switch the match for the target file to this new file
             m.provided = ManifestIter(_repackedMani, _repackedMani.size() - 1);
         }
-        zf.reset();
+        zip._repacked = true;
+
+        if (_progress)
+            _progress(ComputeProgressRatio(), formatMessage("Repacking %s...", zip._zipPathRepacked.c_str()).c_str());
+    }
+
+    void RepackAllZips() {
+        std::vector<ZipInfo*> zips;
+        for (ZipInfo &zip : _zips) {
+            if (!zip._managed)
+                continue;   //no targets, no need to remove
+            if (zip._matchIds.empty())
+                continue;   //minizip doesn't support empty zip
+            if (zip._repacked)
+                continue;   //renamed in ProcessZipsWithoutRepacking
+            zips.push_back(&zip);
+        }
+
+        //every zip is repacked and analyzed independently by some worker,
+        //but the results are committed strictly in the original order of zips,
+        //so the results are exactly the same as in single-threaded run.
+        //note: source zip cannot be reduced while some uncommitted zip still uses it
+        std::vector<RepackResult> results(zips.size());
+        int committedCnt = 0;
+        int threadsNum = _threadsNum;
+        if (threadsNum <= 0)
+            threadsNum = std::thread::hardware_concurrency();
+        threadsNum = std::max(std::min(threadsNum, int(zips.size())), 1);
+
+        ParallelFor(0, zips.size(), [&](int index) {
+            RepackResult result;
+            RepackZip(*zips[index], result);
+            AnalyzeRepackedZip(*zips[index], result);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            results[index] = std::move(result);
+            results[index]._ready = true;
+            while (committedCnt < zips.size() && results[committedCnt]._ready) {
+                CommitRepackedZip(*zips[committedCnt], results[committedCnt]);
+                results[committedCnt] = RepackResult();
+                ReduceOldZips();
+                committedCnt++;
+            }
+        }, threadsNum);
+        ZipSyncAssert(committedCnt == zips.size());
     }
 
     void ReduceOldZips() {
@@ -437,7 +498,6 @@ public:
                 continue;       //already reduced
             if (zip._usedCnt > 0)
                 continue;       //original zip still needed as source
-            zip.zfCache.Clear();
 
             if (IfFileExists(zip._zipPath)) {
                 UnzFileHolder zf(zip._zipPath.c_str());
@@ -591,19 +651,7 @@ public:
 
         //iterate over all zips and repack them
         ReduceOldZips();
-        for (ZipInfo &zip : _zips) {
-            if (!zip._managed)
-                continue;   //no targets, no need to remove
-            if (zip._matchIds.empty())
-                continue;   //minizip doesn't support empty zip
-            if (zip._repacked)
-                continue;   //renamed in ProcessZipsWithoutRepacking
-            RepackZip(zip);
-            AnalyzeRepackedZip(zip);
-            ReduceOldZips();
-        }
-        for (ZipInfo &zip : _zips)
-            zip.zfCache.Clear();
+        RepackAllZips();
 
         RenameRepackedZips();
         RewriteProvidedManifest();
@@ -613,9 +661,10 @@ public:
     }
 };
 
-void UpdateProcess::RepackZips(const GlobalProgressCallback &progressCallback) {
+void UpdateProcess::RepackZips(const GlobalProgressCallback &progressCallback, int threadsNum) {
     Repacker impl(*this);
     impl._progress = progressCallback;
+    impl._threadsNum = threadsNum;
     impl.DoAll();
 }
 
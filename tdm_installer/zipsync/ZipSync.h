@@ -71,7 +71,8 @@ public:
     );
 
     //having all matches available locally, perform the update
-    void RepackZips(const GlobalProgressCallback &progressCallback = GlobalProgressCallback());
+    //target zips are repacked in threadsNum parallel threads (0 = max), result does not depend on it
+    void RepackZips(const GlobalProgressCallback &progressCallback = GlobalProgressCallback(), int threadsNum = 1);
 
     //TODO: local cache for reduced zips?
     void RemoveOldZips(const LocalCache *cache);
@@ -21,4 +21,21 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 #undef None
 #include "doctest/doctest.h"
 
+// sets a cvar for the rest of the scope and restores its old value afterwards,
+// so that a failing check does not leave the test setting behind
+class idTestCVar {
+public:
+	explicit	idTestCVar( idCVar &cvar ) : cvar( cvar ), oldValue( cvar.GetString() ) {}
+				idTestCVar( idCVar &cvar, bool value ) : idTestCVar( cvar ) { cvar.SetBool( value ); }
+				idTestCVar( idCVar &cvar, int value ) : idTestCVar( cvar ) { cvar.SetInteger( value ); }
+				~idTestCVar() { cvar.SetString( oldValue ); }
+
+private:
+	idCVar &	cvar;
+	idStr		oldValue;
+
+				idTestCVar( const idTestCVar & ) = delete;
+	void		operator=( const idTestCVar & ) = delete;
+};
+
 #endif
@@ -26,6 +26,8 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 
 extern idCVar r_skipGuiShaders;		// 1 = don't render any gui elements on surfaces
 
+idCVar gui_tokenCache( "gui_tokenCache", "1", CVAR_GUI | CVAR_BOOL, "cache preprocessed tokens of every gui in fscache/ under fs_savepath to avoid preprocessing unchanged guis on load" );
+
 idUserInterfaceManagerLocal	uiManagerLocal;
 idUserInterfaceManager *	uiManager = &uiManagerLocal;
 
@@ -229,6 +231,196 @@ bool idUserInterfaceManagerLocal::IsBindHandlerActive() const {
 	return false;
 }
 
+/*
+===============================================================================
+
+	gui token cache
+
+	Loading a gui starts with reading its source and preprocessing it: all the #include-s,
+	macros and conditionals are expanded, which is the most expensive part for large guis.
+	The resulting tokens are saved into fscache/ under fs_savepath, and are parsed directly
+	on next load if none of the source files changed and the same preset defines are used.
+	Source files are compared by timestamp and size, so they are not read when cache is used.
+
+===============================================================================
+*/
+
+#define GUI_TOKEN_CACHE_MAGIC	"TDMGUITK"
+#define GUI_TOKEN_CACHE_VERSION	3
+
+class idGuiTokenCache {
+public:
+	idParserTokenStream			tokens;
+	idDict						defines;		// all defines of gui source, after preprocessing
+
+	static idStr				GetPath( const char *qpath );
+	bool						Load( const char *OSPath, const idDict &presetDefines, int parserFlags );
+	bool						Save( const char *OSPath, const idDict &presetDefines, int parserFlags ) const;
+
+private:
+	typedef struct {
+		ID_TIME_T				timestamp;
+		int						length;
+	} sourceStamp_t;
+
+	static idStr				GetPresetsString( const idDict &presetDefines );
+	static bool					GetSourceStamps( const idList<idStr> &files, idList<sourceStamp_t> &stamps );
+};
+
+/*
+================
+idGuiTokenCache::GetPath
+================
+*/
+idStr idGuiTokenCache::GetPath( const char *qpath ) {
+	const char *savePath = cvarSystem->GetCVarString( "fs_savepath" );
+	if ( !savePath[0] ) {
+		return "";
+	}
+	idStr name = qpath;
+	name.SetFileExtension( "guitk" );
+	return fileSystem->BuildOSPath( savePath, "fscache", name );
+}
+
+/*
+================
+idGuiTokenCache::GetPresetsString
+================
+*/
+idStr idGuiTokenCache::GetPresetsString( const idDict &presetDefines ) {
+	idStr res;
+	for ( int i = 0; i < presetDefines.GetNumKeyVals(); i++ ) {
+		const idKeyValue *kv = presetDefines.GetKeyVal( i );
+		res += kv->GetKey() + " " + kv->GetValue() + "\n";
+	}
+	return res;
+}
+
+/*
+================
+idGuiTokenCache::GetSourceStamps
+================
+*/
+bool idGuiTokenCache::GetSourceStamps( const idList<idStr> &files, idList<sourceStamp_t> &stamps ) {
+	stamps.SetNum( files.Num() );
+	for ( int i = 0; i < files.Num(); i++ ) {
+		// only opens the file to get its timestamp and length
+		stamps[i].length = fileSystem->ReadFile( files[i], NULL, &stamps[i].timestamp );
+		if ( stamps[i].length < 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+================
+idGuiTokenCache::Load
+
+Whole contents is protected by checksum, so truncated or damaged file is rejected.
+================
+*/
+bool idGuiTokenCache::Load( const char *OSPath, const idDict &presetDefines, int parserFlags ) {
+	tokens.Clear();
+	defines.Clear();
+
+	idFile *f = fileSystem->OpenExplicitFileRead( OSPath );
+	if ( !f ) {
+		return false;
+	}
+	idStr magic;
+	int version = -1, size = -1, dataChecksum = 0;
+	f->ReadString( magic );
+	f->ReadInt( version );
+	f->ReadInt( size );
+	f->ReadInt( dataChecksum );
+	bool ok = ( magic == GUI_TOKEN_CACHE_MAGIC && version == GUI_TOKEN_CACHE_VERSION && size >= 0 && size == f->Length() - f->Tell() );
+	idList<char> data;
+	if ( ok ) {
+		data.SetNum( size );
+		ok = ( f->Read( data.Ptr(), size ) == size && MD5_BlockChecksum( data.Ptr(), size ) == dataChecksum );
+	}
+	fileSystem->CloseFile( f );
+	if ( !ok ) {
+		return false;
+	}
+
+	idFile_Memory mem( "guitokens", data.Ptr(), data.Num() );
+	idStr presets;
+	int flags = 0, numFiles = 0;
+	mem.ReadString( presets );
+	mem.ReadInt( flags );
+	if ( presets != GetPresetsString( presetDefines ) || flags != parserFlags ) {
+		return false;
+	}
+
+	mem.ReadInt( numFiles );
+	idList<idStr> files;
+	idList<sourceStamp_t> stamps;
+	files.SetNum( numFiles );
+	stamps.SetNum( numFiles );
+	for ( int i = 0; i < numFiles; i++ ) {
+		mem.ReadString( files[i] );
+		mem.Read( &stamps[i].timestamp, sizeof( stamps[i].timestamp ) );
+		mem.ReadInt( stamps[i].length );
+	}
+	// some of the source files (e.g. included ones) have changed
+	idList<sourceStamp_t> actualStamps;
+	if ( !GetSourceStamps( files, actualStamps ) ) {
+		return false;
+	}
+	for ( int i = 0; i < numFiles; i++ ) {
+		if ( actualStamps[i].timestamp != stamps[i].timestamp || actualStamps[i].length != stamps[i].length ) {
+			return false;
+		}
+	}
+
+	defines.ReadFromFileHandle( &mem );
+	if ( !tokens.ReadFromFile( &mem ) ) {
+		defines.Clear();
+		return false;
+	}
+	return true;
+}
+
+/*
+================
+idGuiTokenCache::Save
+================
+*/
+bool idGuiTokenCache::Save( const char *OSPath, const idDict &presetDefines, int parserFlags ) const {
+	const idList<idStr> &files = tokens.GetSourceFiles();
+	idList<sourceStamp_t> stamps;
+	if ( !GetSourceStamps( files, stamps ) ) {
+		return false;	// e.g. included by OS path
+	}
+
+	idFile_Memory mem( "guitokens" );
+	mem.WriteString( GetPresetsString( presetDefines ) );
+	mem.WriteInt( parserFlags );
+	mem.WriteInt( files.Num() );
+	for ( int i = 0; i < files.Num(); i++ ) {
+		mem.WriteString( files[i] );
+		mem.Write( &stamps[i].timestamp, sizeof( stamps[i].timestamp ) );
+		mem.WriteInt( stamps[i].length );
+	}
+	defines.WriteToFileHandle( &mem );
+	tokens.WriteToFile( &mem );
+
+	fileSystem->CreateOSPath( OSPath );
+	idFile *f = fileSystem->OpenExplicitFileWrite( OSPath );
+	if ( !f ) {
+		return false;
+	}
+	f->WriteString( GUI_TOKEN_CACHE_MAGIC );
+	f->WriteInt( GUI_TOKEN_CACHE_VERSION );
+	f->WriteInt( mem.Length() );
+	f->WriteInt( MD5_BlockChecksum( mem.GetDataPtr(), mem.Length() ) );
+	bool ok = ( f->Write( mem.GetDataPtr(), mem.Length() ) == mem.Length() );
+	fileSystem->CloseFile( f );
+	return ok;
+}
+
 /*
 ===============================================================================
 
@@ -297,13 +489,43 @@ bool idUserInterfaceLocal::InitFromFile( const char *qpath, bool rebuild ) {
 	//Load the timestamp so reload guis will work correctly
 	fileSystem->ReadFile(qpath, NULL, &timeStamp);
 
-	src.LoadFile( qpath );
+	// note: gui editor needs original source text of every window
+	idStr cachePath;
+	if ( gui_tokenCache.GetBool() && !( com_editors & EDITOR_GUI ) ) {
+		cachePath = idGuiTokenCache::GetPath( qpath );
+	}
+	idGuiTokenCache cache;	// parser reads tokens from it, must outlive parser
+	bool cached = false;
+	if ( cachePath.Length() && cache.Load( cachePath, presetDefines, src.GetFlags() ) ) {
+		src.LoadTokenStream( &cache.tokens, qpath );
+		cached = true;
+	} else {
+		src.LoadFile( qpath );
+	}
 
 	if ( src.IsLoaded() ) {
-		for (int i = 0; i < presetDefines.GetNumKeyVals(); i++) {
-			const idKeyValue *kv = presetDefines.GetKeyVal(i);
-			idStr line = kv->GetKey() + " " + kv->GetValue();
-			src.AddDefine(line.c_str());
+		if ( !cached ) {
+			for (int i = 0; i < presetDefines.GetNumKeyVals(); i++) {
+				const idKeyValue *kv = presetDefines.GetKeyVal(i);
+				idStr line = kv->GetKey() + " " + kv->GetValue();
+				src.AddDefine(line.c_str());
+			}
+		}
+
+		if ( !cached && cachePath.Length() ) {
+			// preprocess the whole source, then parse windows from the recorded tokens
+			cache.tokens.Record( src );
+			idStrList defNames = src.GetAllDefineNames();
+			for (int i = 0; i < defNames.Num(); i++) {
+				cache.defines.Set( defNames[i], src.GetDefineValueString( defNames[i] ) );
+			}
+			src.FreeSource();
+			src.LoadTokenStream( &cache.tokens, qpath );
+			cached = true;
+
+			if ( !cache.Save( cachePath, presetDefines, src.GetFlags() ) ) {
+				common->DPrintf( "Failed to save gui token cache %s\n", cachePath.c_str() );
+			}
 		}
 
 		// stgatilov #5869: read one desktop window, from start to end
@@ -326,11 +548,15 @@ bool idUserInterfaceLocal::InitFromFile( const char *qpath, bool rebuild ) {
 		state.Set( "name", qpath );
 
 		//stgatilov: make custom defines by mapper visible in C++
-		idStrList defNames = src.GetAllDefineNames();
-		for (int i = 0; i < defNames.Num(); i++) {
-			const char *name = defNames[i];
-			idStr value = src.GetDefineValueString(name);
-			defines.Set(name, value);
+		if ( cached ) {
+			defines.Copy( cache.defines );
+		} else {
+			idStrList defNames = src.GetAllDefineNames();
+			for (int i = 0; i < defNames.Num(); i++) {
+				const char *name = defNames[i];
+				idStr value = src.GetDefineValueString(name);
+				defines.Set(name, value);
+			}
 		}
 	} else {
 		desktop->SetDC( &uiManagerLocal.dc );
@@ -906,3 +1132,385 @@ void idUserInterfaceLocal::UpdateSubtitles() {
 		SetStateString( debugVar, debugMessage.c_str() );
 	}
 }
+
+
+#include "../tests/testing.h"
+
+static idUserInterfaceLocal *GuiTest_Load( const char *qpath, bool useCache ) {
+	idTestCVar tokenCache( gui_tokenCache, useCache );
+	idUserInterfaceLocal *gui = (idUserInterfaceLocal *)uiManager->Alloc();
+	gui->InitFromFile( qpath );
+	return gui;
+}
+
+// some of the game guis, always including the main menu
+static void GuiTest_ListGuis( idStrList &files ) {
+	idFileList *fileList = fileSystem->ListFilesTree( "guis", ".gui", true );
+	for ( int i = 0; i < fileList->GetNumFiles() && files.Num() < 30; i++ ) {
+		files.Append( fileList->GetFile( i ) );
+	}
+	fileSystem->FreeFileList( fileList );
+	if ( fileSystem->FindFile( "guis/mainmenu.gui" ) != FIND_NO ) {
+		files.AddUnique( "guis/mainmenu.gui" );
+	}
+}
+
+static bool GuiTest_IsVarOp( const wexpOp_t &op ) {
+	return op.opType == WOP_TYPE_VAR || op.opType == WOP_TYPE_VARS || op.opType == WOP_TYPE_VARF || op.opType == WOP_TYPE_VARI || op.opType == WOP_TYPE_VARB;
+}
+
+// compares the private state of windows loaded with and without the token cache
+class idGuiTokenCacheTest {
+public:
+	static idStr VarValues( idWindow *win ) {
+		return idStr( win->visible.c_str() ) + "|" + win->rect.c_str() + "|" + win->backColor.c_str() + "|" + win->foreColor.c_str() + "|" +
+			win->matColor.c_str() + "|" + win->textScale.c_str() + "|" + win->rotate.c_str() + "|" + win->text.c_str();
+	}
+
+	static void CompareTrees( idWindow *a, idWindow *b ) {
+		CHECK( idStr::Cmp( a->GetName(), b->GetName() ) == 0 );
+		CHECK( a->flags == b->flags );
+		CHECK( a->srcLocation.ToString() == b->srcLocation.ToString() );
+		CHECK( a->timeLineEvents.Num() == b->timeLineEvents.Num() );
+		CHECK( a->namedEvents.Num() == b->namedEvents.Num() );
+		CHECK( a->definedVars.Num() == b->definedVars.Num() );
+		for ( int i = 0; i < idWindow::SCRIPT_COUNT; i++ ) {
+			CHECK( ( a->scripts[i] == NULL ) == ( b->scripts[i] == NULL ) );
+		}
+
+		REQUIRE( a->ops.Num() == b->ops.Num() );
+		for ( int i = 0; i < a->ops.Num(); i++ ) {
+			const wexpOp_t &x = a->ops[i];
+			const wexpOp_t &y = b->ops[i];
+			CHECK( x.opType == y.opType );
+			CHECK( x.b == y.b );
+			CHECK( x.c == y.c );
+			CHECK( x.d == y.d );
+			if ( GuiTest_IsVarOp( x ) ) {
+				// pointers to window variables
+				if ( x.b == -2 ) {
+					CHECK( idStr::Cmp( (const char *)x.a, (const char *)y.a ) == 0 );
+				} else if ( x.a && y.a ) {
+					CHECK( idStr::Cmp( ( (idWinVar *)x.a )->GetName(), ( (idWinVar *)y.a )->GetName() ) == 0 );
+				}
+			} else {
+				CHECK( x.a == y.a );
+			}
+		}
+		REQUIRE( a->expressionRegisters.Num() == b->expressionRegisters.Num() );
+		for ( int i = 0; i < a->expressionRegisters.Num(); i++ ) {
+			CHECK( a->expressionRegisters[i] == b->expressionRegisters[i] );
+		}
+
+		REQUIRE( a->drawWindows.Num() == b->drawWindows.Num() );
+		for ( int i = 0; i < a->drawWindows.Num(); i++ ) {
+			REQUIRE( ( a->drawWindows[i].simp == NULL ) == ( b->drawWindows[i].simp == NULL ) );
+		}
+		REQUIRE( a->children.Num() == b->children.Num() );
+		for ( int i = 0; i < a->children.Num(); i++ ) {
+			CompareTrees( a->children[i], b->children[i] );
+		}
+	}
+
+	// does what gui does every frame before drawing, then compares evaluated registers and variables
+	static void CompareFrame( idWindow *a, idWindow *b ) {
+		a->Time();
+		b->Time();
+		float regsA[MAX_EXPRESSION_REGISTERS], regsB[MAX_EXPRESSION_REGISTERS];
+		if ( a->expressionRegisters.Num() ) {
+			a->regList.SetToRegs( regsA );
+			a->EvaluateRegisters( regsA );
+			a->regList.GetFromRegs( regsA );
+			b->regList.SetToRegs( regsB );
+			b->EvaluateRegisters( regsB );
+			b->regList.GetFromRegs( regsB );
+			for ( int i = 0; i < a->expressionRegisters.Num(); i++ ) {
+				CHECK( ( regsA[i] == regsB[i] || ( regsA[i] != regsA[i] && regsB[i] != regsB[i] ) ) );
+			}
+		}
+		CHECK( VarValues( a ) == VarValues( b ) );
+		for ( int i = 0; i < a->children.Num(); i++ ) {
+			CompareFrame( a->children[i], b->children[i] );
+		}
+	}
+};
+
+static void GuiTest_SimulateAndCompare( idUserInterfaceLocal *a, idUserInterfaceLocal *b, int frames ) {
+	a->Activate( true, 0 );
+	b->Activate( true, 0 );
+	for ( int f = 0; f < frames; f++ ) {
+		int time = f * 100;
+		a->SetStateInt( "gui_test_frame", f );
+		b->SetStateInt( "gui_test_frame", f );
+		a->StateChanged( time, false );
+		b->StateChanged( time, false );
+		a->SetTime( time );
+		b->SetTime( time );
+		idGuiTokenCacheTest::CompareFrame( a->GetDesktop(), b->GetDesktop() );
+		CHECK( idStr::Cmp( a->GetPendingCmd(), b->GetPendingCmd() ) == 0 );
+	}
+}
+
+TEST_CASE("Gui:TokenCache") {
+	idStrList files;
+	GuiTest_ListGuis( files );
+	REQUIRE( files.Num() > 0 );
+
+	for ( int i = 0; i < files.Num(); i++ ) {
+		const char *qpath = files[i];
+		idStr cachePath = idGuiTokenCache::GetPath( qpath );
+		REQUIRE( cachePath.Length() > 0 );
+		remove( cachePath );
+
+		idUserInterfaceLocal *source = GuiTest_Load( qpath, false );
+		// first load records tokens and saves cache, second one uses it
+		idUserInterfaceLocal *recorded = GuiTest_Load( qpath, true );
+		idGuiTokenCache cache;
+		CHECK( cache.Load( cachePath, idDict(), LEXFL_NOFATALERRORS | LEXFL_NOSTRINGCONCAT | LEXFL_ALLOWMULTICHARLITERALS ) );
+		idUserInterfaceLocal *cached = GuiTest_Load( qpath, true );
+
+		REQUIRE( source->GetDesktop() );
+		REQUIRE( recorded->GetDesktop() );
+		REQUIRE( cached->GetDesktop() );
+		idGuiTokenCacheTest::CompareTrees( source->GetDesktop(), recorded->GetDesktop() );
+		idGuiTokenCacheTest::CompareTrees( source->GetDesktop(), cached->GetDesktop() );
+		GuiTest_SimulateAndCompare( source, cached, 10 );
+
+		uiManager->DeAlloc( source );
+		uiManager->DeAlloc( recorded );
+		uiManager->DeAlloc( cached );
+		remove( cachePath );
+	}
+}
+
+TEST_CASE("Gui:TokenCacheInvalidation") {
+	idStr qpath = "guis/tests/tokencache_test.gui";
+	idStr includePath = "guis/tests/tokencache_test.guicode";
+	idStr cachePath = idGuiTokenCache::GetPath( qpath );
+	const int flags = LEXFL_NOFATALERRORS | LEXFL_NOSTRINGCONCAT | LEXFL_ALLOWMULTICHARLITERALS;
+
+	const char *mainText =
+		"#include \"guis/tests/tokencache_test.guicode\"\n"
+		"windowDef Desktop {\n"
+		"	rect 0, 0, 640, 480\n"
+		"	windowDef Child {\n"
+		"		rect CHILD_X, 10, 100 * 2, 50\n"
+		"		visible (\"gui::gui_test_frame\" > 3)\n"
+		"	}\n"
+		"}\n";
+	fileSystem->WriteFile( qpath, mainText, (int)strlen( mainText ), "fs_savepath", "" );
+	fileSystem->WriteFile( includePath, "#define CHILD_X 20\n", 19, "fs_savepath", "" );
+	if ( fileSystem->FindFile( qpath ) == FIND_NO ) {
+		// save path is not searched for game files in this configuration
+		fileSystem->RemoveFile( qpath );
+		fileSystem->RemoveFile( includePath );
+		return;
+	}
+	remove( cachePath );
+
+	idUserInterfaceLocal *gui = GuiTest_Load( qpath, true );
+	uiManager->DeAlloc( gui );
+	idGuiTokenCache cache;
+	REQUIRE( cache.Load( cachePath, idDict(), flags ) );
+	CHECK( cache.tokens.GetSourceFiles().Num() == 2 );
+	CHECK( idStr::Cmp( cache.defines.GetString( "CHILD_X" ), "20" ) == 0 );
+
+	SUBCASE( "Preset defines must match" ) {
+		idDict presets;
+		presets.Set( "CHILD_X", "30" );
+		CHECK( !cache.Load( cachePath, presets, flags ) );
+	}
+
+	SUBCASE( "Changed include file invalidates cache" ) {
+		// note: timestamp may stay the same within a second, so length changes too
+		fileSystem->WriteFile( includePath, "#define CHILD_X 400\n", 20, "fs_savepath", "" );
+		CHECK( !cache.Load( cachePath, idDict(), flags ) );
+		idUserInterfaceLocal *source = GuiTest_Load( qpath, false );
+		idUserInterfaceLocal *reloaded = GuiTest_Load( qpath, true );
+		idGuiTokenCacheTest::CompareTrees( source->GetDesktop(), reloaded->GetDesktop() );
+		GuiTest_SimulateAndCompare( source, reloaded, 6 );
+		uiManager->DeAlloc( source );
+		uiManager->DeAlloc( reloaded );
+	}
+
+	SUBCASE( "Preprocessor warnings are replayed from cache" ) {
+		const char *includeText = "#define CHILD_X 20\n#warning \"tokencache_test\"\n";
+		fileSystem->WriteFile( includePath, includeText, (int)strlen( includeText ), "fs_savepath", "" );
+		for ( int pass = 0; pass < 2; pass++ ) {
+			// first pass records the tokens, second one loads them from cache
+			idLexerMessages capture;
+			uiManager->DeAlloc( GuiTest_Load( qpath, true ) );
+			int found = 0;
+			for ( int i = 0; i < capture.GetMessages().Num(); i++ ) {
+				if ( capture.GetMessages()[i].Find( "#warning: tokencache_test" ) >= 0 ) {
+					found++;
+				}
+			}
+			CHECK( found == 1 );
+		}
+		REQUIRE( cache.Load( cachePath, idDict(), flags ) );
+	}
+
+	remove( cachePath );
+	fileSystem->RemoveFile( qpath );
+	fileSystem->RemoveFile( includePath );
+}
+
+// runs the private register evaluation of windows with dirty tracking
+class idGuiRegistersTest {
+public:
+	static idCVar &DirtyRegs() {
+		return idWindow::gui_dirtyRegs;
+	}
+
+	static void CollectStateKeys( idWindow *win, idStrList &keys ) {
+		for ( int i = 0; i < win->updateVars.Num(); i++ ) {
+			const char *key = win->updateVars[i]->GetName();
+			if ( key[0] ) {
+				keys.AddUnique( key );
+			}
+		}
+		for ( int i = 0; i < win->children.Num(); i++ ) {
+			CollectStateKeys( win->children[i], keys );
+		}
+	}
+
+	// evaluates registers with dirty tracking and compares them to full evaluation of the same inputs
+	static void CheckRegisters( idWindow *win ) {
+		if ( win->expressionRegisters.Num() && win->ops.Num() ) {
+			win->UpdateWinVars();
+			float full[MAX_EXPRESSION_REGISTERS];
+			win->EvaluateRegisters( full );
+			win->EvalRegs( -1, true );
+			REQUIRE( win->evalRegisters.Num() == win->expressionRegisters.Num() );
+			for ( int i = 0; i < win->expressionRegisters.Num(); i++ ) {
+				CHECK( memcmp( &full[i], &win->evalRegisters[i], sizeof( float ) ) == 0 );
+			}
+		}
+		for ( int i = 0; i < win->children.Num(); i++ ) {
+			CheckRegisters( win->children[i] );
+		}
+	}
+
+	// ops over unchanged variables keep their result, setting a variable makes them evaluate again
+	static void CheckVarChangeTracking( idWindow *win ) {
+		if ( win->expressionRegisters.Num() && win->ops.Num() ) {
+			win->EvalRegs( -1, true );
+			if ( win->regDepsOrdered ) {
+				const float poison = -12345.0f;
+				for ( int i = 0; i < win->varOps.Num(); i++ ) {
+					win->evalRegisters[win->ops[win->varOps[i]].c] = poison;
+				}
+				win->EvaluateDirtyRegisters();
+				for ( int i = 0; i < win->varOps.Num(); i++ ) {
+					CHECK( win->evalRegisters[win->ops[win->varOps[i]].c] == poison );
+				}
+				for ( int i = 0; i < win->varOps.Num(); i++ ) {
+					idWinVar *var = (idWinVar *)win->ops[win->varOps[i]].a;
+					if ( var ) {
+						idStr value = var->c_str();
+						var->Set( value );
+					}
+				}
+				win->EvaluateDirtyRegisters();
+				for ( int i = 0; i < win->varOps.Num(); i++ ) {
+					if ( win->ops[win->varOps[i]].a ) {
+						CHECK( win->evalRegisters[win->ops[win->varOps[i]].c] != poison );
+					}
+				}
+				CheckRegisters( win );
+			}
+		}
+		for ( int i = 0; i < win->children.Num(); i++ ) {
+			CheckVarChangeTracking( win->children[i] );
+		}
+	}
+
+	static void Simulate( idUserInterfaceLocal *gui, const idStrList &keys, int frames, bool runScripts ) {
+		static const float values[] = { 0.0f, 1.0f, 2.0f, 3.0f, 0.5f, 0.25f, 7.0f, -1.5f };
+		idRandom rnd( frames );
+		gui->Activate( true, 0 );
+		for ( int f = 0; f < frames; f++ ) {
+			// every other frame keeps time, so that only state changes are seen
+			int time = ( f / 2 ) * 33;
+			for ( int k = 0; k < keys.Num(); k++ ) {
+				if ( f == 0 || rnd.RandomInt( 4 ) == 0 ) {
+					gui->SetStateString( keys[k], va( "%g", values[rnd.RandomInt( sizeof( values ) / sizeof( values[0] ) )] ) );
+				}
+			}
+			gui->SetTime( time );
+			CheckRegisters( gui->GetDesktop() );
+			gui->StateChanged( time, false );
+			if ( runScripts ) {
+				// scripts change window variables too
+				gui->GetDesktop()->RunTimeEvents( time );
+				CheckRegisters( gui->GetDesktop() );
+			}
+		}
+	}
+};
+
+TEST_CASE("Gui:DirtyRegisters") {
+	idTestCVar dirtyRegs( idGuiRegistersTest::DirtyRegs(), true );
+
+	SUBCASE( "Expressions over state keys, time and window variables" ) {
+		idStr qpath = "guis/tests/dirtyregs_test.gui";
+		const char *text =
+			"windowDef Desktop {\n"
+			"	rect 0, 0, 640, 480\n"
+			"	definefloat counter 0\n"
+			"	definevec4 tint 1, 0.5, 0.25, 1\n"
+			"	backcolor \"gui::r\", \"gui::g\" * 0.5, 1 - \"gui::b\", (\"gui::a\" > 0.5) ? 1 : 0.25\n"
+			"	onEvent {\n"
+			"		if (\"gui::mode\" == 2) {\n"
+			"			set \"tint\" \"0 1 0 1\";\n"
+			"			set \"counter\" \"3\";\n"
+			"		} else {\n"
+			"			set \"tint\" \"1 0 0 1\";\n"
+			"			set \"counter\" \"1\";\n"
+			"		}\n"
+			"	}\n"
+			"	windowDef Child {\n"
+			"		rect \"gui::x\" + 10, \"gui::y\" % 7, 100 * 2, time / 1000\n"
+			"		visible (\"gui::mode\" == 1 || \"gui::mode\" == 2) && \"gui::flag\"\n"
+			"		forecolor tint[0], tint[1] * \"gui::g\", tint[\"gui::idx\"], 1\n"
+			"		matcolor counter, counter * 2, (time % 500) > 250, 1\n"
+			"		textscale \"gui::x\" / (\"gui::y\" + 2)\n"
+			"	}\n"
+			"	windowDef Label {\n"
+			"		rect 0, 0, \"gui::name\" * 2, 10\n"
+			"		text \"gui::name\"\n"
+			"	}\n"
+			"}\n";
+		fileSystem->WriteFile( qpath, text, (int)strlen( text ), "fs_savepath", "" );
+		if ( fileSystem->FindFile( qpath ) != FIND_NO ) {
+			idUserInterfaceLocal *gui = (idUserInterfaceLocal *)uiManager->Alloc();
+			gui->InitFromFile( qpath );
+			REQUIRE( gui->GetDesktop() );
+			idStrList keys;
+			idGuiRegistersTest::CollectStateKeys( gui->GetDesktop(), keys );
+			CHECK( keys.Num() >= 9 );
+			idGuiRegistersTest::Simulate( gui, keys, 60, true );
+			idGuiRegistersTest::CheckVarChangeTracking( gui->GetDesktop() );
+			uiManager->DeAlloc( gui );
+		}
+		// otherwise save path is not searched for game files in this configuration
+		fileSystem->RemoveFile( qpath );
+	}
+
+	SUBCASE( "Game guis" ) {
+		idStrList files;
+		GuiTest_ListGuis( files );
+		REQUIRE( files.Num() > 0 );
+
+		for ( int i = 0; i < files.Num(); i++ ) {
+			idUserInterfaceLocal *gui = (idUserInterfaceLocal *)uiManager->Alloc();
+			gui->InitFromFile( files[i] );
+			REQUIRE( gui->GetDesktop() );
+			idStrList keys;
+			idGuiRegistersTest::CollectStateKeys( gui->GetDesktop(), keys );
+			idGuiRegistersTest::Simulate( gui, keys, 20, false );
+			uiManager->DeAlloc( gui );
+		}
+	}
+}
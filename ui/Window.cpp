@@ -43,6 +43,7 @@ bool idWindow::registerIsTemporary[MAX_EXPRESSION_REGISTERS];		// statics to ass
 
 idCVar idWindow::gui_debug( "gui_debug", "0", CVAR_GUI | CVAR_BOOL, "" );
 idCVar idWindow::gui_edit( "gui_edit", "0", CVAR_GUI | CVAR_BOOL, "" );
+idCVar idWindow::gui_dirtyRegs( "gui_dirtyRegs", "1", CVAR_GUI | CVAR_BOOL, "only re-evaluate gui expressions whose inputs have changed since the previous evaluation" );
 
 extern idCVar r_skipGuiShaders;		// 1 = don't render any gui elements on surfaces
 
@@ -160,6 +161,9 @@ void idWindow::CommonInit() {
 	parent = NULL;
 	saveOps = NULL;
 	saveRegs = NULL;
+	regDepsValid = false;
+	regDepsOrdered = false;
+	varsGlobalChangeCount = 0;
 	timeLine = -1;
 	textShadow = 0;
 	hover = false;
@@ -1133,8 +1137,15 @@ float idWindow::EvalRegs(int test, bool force) {
 	lastEval = this;
 
 	if (expressionRegisters.Num()) {
-		regList.SetToRegs(regs);
-		EvaluateRegisters(regs);
+		if (gui_dirtyRegs.GetBool()) {
+			EvaluateDirtyRegisters();
+			// note: SetToRegs is skipped, since constants are copied over its output anyway
+			memcpy(regs, evalRegisters.Ptr(), expressionRegisters.Num() * sizeof(float));
+		} else {
+			regDepsValid = false;
+			regList.SetToRegs(regs);
+			EvaluateRegisters(regs);
+		}
 		regList.GetFromRegs(regs);
 	}
 
@@ -2898,6 +2909,7 @@ idWindow::ExpressionOp
 ================
 */
 wexpOp_t *idWindow::ExpressionOp() {
+	regDepsValid = false;
 	if ( ops.Num() == MAX_EXPRESSION_OPS ) {
 		common->Warning( "expressionOp: gui %s hit MAX_EXPRESSION_OPS", gui->GetSourceFile());
 		return &ops[0];
@@ -3181,6 +3193,120 @@ void idWindow::ParseBracedExpression(idParser *src) {
 	src->ExpectTokenString("}");
 }
 
+/*
+===============
+idWindow::EvaluateOp
+===============
+*/
+ID_INLINE void idWindow::EvaluateOp(const wexpOp_t &op, float *registers) {
+	switch( op.opType ) {
+	case WOP_TYPE_ADD:
+		registers[op.c] = registers[op.a] + registers[op.b];
+		break;
+	case WOP_TYPE_SUBTRACT:
+		registers[op.c] = registers[op.a] - registers[op.b];
+		break;
+	case WOP_TYPE_MULTIPLY:
+		registers[op.c] = registers[op.a] * registers[op.b];
+		break;
+	case WOP_TYPE_DIVIDE:
+		if ( registers[op.b] == 0.0f ) {
+			common->Warning( "Divide by zero in window '%s' in %s", GetName(), gui->GetSourceFile() );
+			registers[op.c] = registers[op.a];
+		} else {
+			registers[op.c] = registers[op.a] / registers[op.b];
+		}
+		break;
+	case WOP_TYPE_MOD: {
+		int b = (int)registers[op.b];
+		b = b != 0 ? b : 1;
+		registers[op.c] = (int)registers[op.a] % b;
+		break;
+	}
+	case WOP_TYPE_TABLE: {
+		const idDeclTable *table = static_cast<const idDeclTable *>( declManager->DeclByIndex( DECL_TABLE, op.a ) );
+		registers[op.c] = table->TableLookup( registers[op.b] );
+		break;
+	}
+	case WOP_TYPE_GT:
+		registers[op.c] = registers[ op.a ] > registers[op.b];
+		break;
+	case WOP_TYPE_GE:
+		registers[op.c] = registers[ op.a ] >= registers[op.b];
+		break;
+	case WOP_TYPE_LT:
+		registers[op.c] = registers[ op.a ] < registers[op.b];
+		break;
+	case WOP_TYPE_LE:
+		registers[op.c] = registers[ op.a ] <= registers[op.b];
+		break;
+	case WOP_TYPE_EQ:
+		registers[op.c] = registers[ op.a ] == registers[op.b];
+		break;
+	case WOP_TYPE_NE:
+		registers[op.c] = registers[ op.a ] != registers[op.b];
+		break;
+	case WOP_TYPE_COND:
+		registers[op.c] = (registers[ op.a ]) ? registers[op.b] : registers[op.d];
+		break;
+	case WOP_TYPE_AND:
+		registers[op.c] = registers[ op.a ] && registers[op.b];
+		break;
+	case WOP_TYPE_OR:
+		registers[op.c] = registers[ op.a ] || registers[op.b];
+		break;
+	case WOP_TYPE_VAR:
+		if ( !op.a ) {
+			registers[op.c] = 0.0f;
+			break;
+		}
+		if ( op.b >= 0 && registers[op.b] >= 0 && registers[op.b] < 4 ) {
+			// grabs vector components
+			idWinVec4 *var = (idWinVec4 *)( op.a );
+			const idVec4 &value = static_cast<const idVec4&>(*var);
+			int index = int(registers[op.b]);
+			registers[op.c] = value[index];
+		} else {
+			registers[op.c] = ((idWinVar*)(op.a))->x();
+		}
+		break;
+	case WOP_TYPE_VARS:
+		if (op.a) {
+			idWinStr *var = (idWinStr*)(op.a);
+			registers[op.c] = atof(var->c_str());
+		} else {
+			registers[op.c] = 0;
+		}
+		break;
+	case WOP_TYPE_VARF:
+		if (op.a) {
+			idWinFloat *var = (idWinFloat*)(op.a);
+			registers[op.c] = *var;
+		} else {
+			registers[op.c] = 0;
+		}
+		break;
+	case WOP_TYPE_VARI:
+		if (op.a) {
+			idWinInt *var = (idWinInt*)(op.a);
+			registers[op.c] = *var;
+		} else {
+			registers[op.c] = 0;
+		}
+		break;
+	case WOP_TYPE_VARB:
+		if (op.a) {
+			idWinBool *var = (idWinBool*)(op.a);
+			registers[op.c] = *var;
+		} else {
+			registers[op.c] = 0;
+		}
+		break;
+	default:
+		common->FatalError( "R_EvaluateExpression: bad opcode" );
+	}
+}
+
 /*
 ===============
 idWindow::EvaluateRegisters
@@ -3202,115 +3328,201 @@ void idWindow::EvaluateRegisters(float *registers) {
 	registers[WEXP_REG_TIME] = gui->GetTime();
 
 	for ( int i = 0 ; i < oc ; i++ ) {
-		wexpOp_t *op = &ops[i];
-		if (op->b == -2) {
+		const wexpOp_t &op = ops[i];
+		if (op.b == -2) {
 			continue;
 		}
-		switch( op->opType ) {
-		case WOP_TYPE_ADD:
-			registers[op->c] = registers[op->a] + registers[op->b];
-			break;
-		case WOP_TYPE_SUBTRACT:
-			registers[op->c] = registers[op->a] - registers[op->b];
-			break;
-		case WOP_TYPE_MULTIPLY:
-			registers[op->c] = registers[op->a] * registers[op->b];
-			break;
-		case WOP_TYPE_DIVIDE:
-			if ( registers[op->b] == 0.0f ) {
-				common->Warning( "Divide by zero in window '%s' in %s", GetName(), gui->GetSourceFile() );
-				registers[op->c] = registers[op->a];
-			} else {
-				registers[op->c] = registers[op->a] / registers[op->b];
-			}
-			break;
-		case WOP_TYPE_MOD: {
-			int b = (int)registers[op->b];
-			b = b != 0 ? b : 1;
-			registers[op->c] = (int)registers[op->a] % b;
-			break;
-		}
-		case WOP_TYPE_TABLE: {
-			const idDeclTable *table = static_cast<const idDeclTable *>( declManager->DeclByIndex( DECL_TABLE, op->a ) );
-			registers[op->c] = table->TableLookup( registers[op->b] );
-			break;
+		EvaluateOp(op, registers);
+	}
+}
+
+/*
+===============
+idWindow::BuildRegisterDependencies
+
+Finds which ops read each register.
+Ops are emitted in dependency order while parsing expressions,
+so a single pass over ops marked dirty updates everything affected.
+If ops are not ordered this way (e.g. after register overflow),
+all of them are evaluated every time.
+===============
+*/
+void idWindow::BuildRegisterDependencies() {
+	int erc = expressionRegisters.Num();
+	int oc = ops.Num();
+
+	idList<int> producer;
+	producer.SetNum(erc);
+	for ( int r = 0 ; r < erc ; r++ ) {
+		producer[r] = -1;
+	}
+
+	regConsumerStart.SetNum(erc + 1);
+	for ( int r = 0 ; r <= erc ; r++ ) {
+		regConsumerStart[r] = 0;
+	}
+	regConsumers.Clear();
+	varOps.Clear();
+	opDirty.SetNum(oc);
+	regDepsOrdered = true;
+
+	// inputs of op: registers it reads, and whether it reads a window variable
+	auto GetInputs = [](const wexpOp_t &op, intptr_t inputs[3], bool &readsVar) -> int {
+		readsVar = false;
+		if (op.b == -2) {
+			// unresolved variable name, never evaluated
+			return 0;
 		}
-		case WOP_TYPE_GT:
-			registers[op->c] = registers[ op->a ] > registers[op->b];
-			break;
-		case WOP_TYPE_GE:
-			registers[op->c] = registers[ op->a ] >= registers[op->b];
-			break;
-		case WOP_TYPE_LT:
-			registers[op->c] = registers[ op->a ] < registers[op->b];
-			break;
-		case WOP_TYPE_LE:
-			registers[op->c] = registers[ op->a ] <= registers[op->b];
-			break;
-		case WOP_TYPE_EQ:
-			registers[op->c] = registers[ op->a ] == registers[op->b];
-			break;
-		case WOP_TYPE_NE:
-			registers[op->c] = registers[ op->a ] != registers[op->b];
-			break;
+		switch( op.opType ) {
+		case WOP_TYPE_TABLE:
+			inputs[0] = op.b;
+			return 1;
 		case WOP_TYPE_COND:
-			registers[op->c] = (registers[ op->a ]) ? registers[op->b] : registers[op->d];
-			break;
-		case WOP_TYPE_AND:
-			registers[op->c] = registers[ op->a ] && registers[op->b];
-			break;
-		case WOP_TYPE_OR:
-			registers[op->c] = registers[ op->a ] || registers[op->b];
-			break;
+			inputs[0] = op.a;
+			inputs[1] = op.b;
+			inputs[2] = op.d;
+			return 3;
 		case WOP_TYPE_VAR:
-			if ( !op->a ) {
-				registers[op->c] = 0.0f;
-				break;
+			readsVar = true;
+			if (op.b >= 0) {
+				// index of vector component
+				inputs[0] = op.b;
+				return 1;
 			}
-			if ( op->b >= 0 && registers[op->b] >= 0 && registers[op->b] < 4 ) {
-				// grabs vector components
-				idWinVec4 *var = (idWinVec4 *)( op->a );
-				const idVec4 &value = static_cast<const idVec4&>(*var);
-				int index = int(registers[op->b]);
-				registers[op->c] = value[index];
-			} else {
-				registers[op->c] = ((idWinVar*)(op->a))->x();
-			}
-			break;
+			return 0;
 		case WOP_TYPE_VARS:
-			if (op->a) {
-				idWinStr *var = (idWinStr*)(op->a);
-				registers[op->c] = atof(var->c_str());
-			} else {
-				registers[op->c] = 0;
-			}
-			break;
 		case WOP_TYPE_VARF:
-			if (op->a) {
-				idWinFloat *var = (idWinFloat*)(op->a);
-				registers[op->c] = *var;
-			} else {
-				registers[op->c] = 0;
-			}
-			break;
 		case WOP_TYPE_VARI:
-			if (op->a) {
-				idWinInt *var = (idWinInt*)(op->a);
-				registers[op->c] = *var;
-			} else {
-				registers[op->c] = 0;
-			}
-			break;
 		case WOP_TYPE_VARB:
-			if (op->a) {
-				idWinBool *var = (idWinBool*)(op->a);
-				registers[op->c] = *var;
+			readsVar = true;
+			return 0;
+		default:
+			inputs[0] = op.a;
+			inputs[1] = op.b;
+			return 2;
+		}
+	};
+
+	// every register is written by at most one op
+	for ( int i = 0 ; i < oc ; i++ ) {
+		const wexpOp_t &op = ops[i];
+		opDirty[i] = false;
+		if (op.b == -2) {
+			continue;
+		}
+		if (op.c < WEXP_REG_NUM_PREDEFINED || op.c >= erc || producer[op.c] >= 0) {
+			regDepsOrdered = false;
+		} else {
+			producer[op.c] = i;
+		}
+	}
+
+	// count consumers of every register
+	for ( int i = 0 ; i < oc ; i++ ) {
+		intptr_t inputs[3];
+		bool readsVar;
+		int n = GetInputs(ops[i], inputs, readsVar);
+		for ( int k = 0 ; k < n ; k++ ) {
+			if (inputs[k] < 0 || inputs[k] >= erc || producer[inputs[k]] >= i) {
+				regDepsOrdered = false;
 			} else {
-				registers[op->c] = 0;
+				regConsumerStart[inputs[k] + 1]++;
 			}
-			break;
-		default:
-			common->FatalError( "R_EvaluateExpression: bad opcode" );
+		}
+		if (readsVar) {
+			varOps.Append(i);
+		}
+	}
+	for ( int r = 0 ; r < erc ; r++ ) {
+		regConsumerStart[r + 1] += regConsumerStart[r];
+	}
+
+	// fill consumers lists
+	regConsumers.SetNum(regConsumerStart[erc]);
+	idList<int> fill = regConsumerStart;
+	for ( int i = 0 ; i < oc ; i++ ) {
+		intptr_t inputs[3];
+		bool readsVar;
+		int n = GetInputs(ops[i], inputs, readsVar);
+		for ( int k = 0 ; k < n ; k++ ) {
+			if (inputs[k] >= 0 && inputs[k] < erc && producer[inputs[k]] < i) {
+				regConsumers[fill[inputs[k]]++] = i;
+			}
+		}
+	}
+
+	// start from scratch: all ops are evaluated on first call
+	evalRegisters.SetNum(erc);
+	EvaluateRegisters(evalRegisters.Ptr());
+	varOpChangeCounts.SetNum(varOps.Num());
+	for ( int i = 0 ; i < varOps.Num() ; i++ ) {
+		const idWinVar *var = (const idWinVar *)ops[varOps[i]].a;
+		varOpChangeCounts[i] = var ? var->GetChangeCount() : 0;
+	}
+	varsGlobalChangeCount = idWinVar::GetGlobalChangeCount();
+	regDepsValid = true;
+}
+
+/*
+===============
+idWindow::EvaluateDirtyRegisters
+
+Updates evalRegisters, only evaluating ops whose inputs have changed:
+ops reading window variables are evaluated when their variable was changed
+(state keys get there through idWinVar::Update), and ops depending on time
+are evaluated whenever gui time changes.
+===============
+*/
+void idWindow::EvaluateDirtyRegisters() {
+	if (!regDepsValid || evalRegisters.Num() != expressionRegisters.Num()) {
+		BuildRegisterDependencies();
+		return;
+	}
+	float *registers = evalRegisters.Ptr();
+	if (!regDepsOrdered) {
+		EvaluateRegisters(registers);
+		return;
+	}
+
+	// compare bit patterns, so that NaNs and signed zeros are propagated exactly
+	auto Changed = [](float x, float y) -> bool {
+		return *reinterpret_cast<const int *>(&x) != *reinterpret_cast<const int *>(&y);
+	};
+	auto MarkConsumers = [this](int reg) {
+		for ( int k = regConsumerStart[reg] ; k < regConsumerStart[reg + 1] ; k++ ) {
+			opDirty[regConsumers[k]] = true;
+		}
+	};
+
+	float time = gui->GetTime();
+	if (Changed(registers[WEXP_REG_TIME], time)) {
+		registers[WEXP_REG_TIME] = time;
+		MarkConsumers(WEXP_REG_TIME);
+	}
+	// nothing to look for if no variable of any window has changed
+	int globalChangeCount = idWinVar::GetGlobalChangeCount();
+	if (globalChangeCount != varsGlobalChangeCount) {
+		varsGlobalChangeCount = globalChangeCount;
+		for ( int i = 0 ; i < varOps.Num() ; i++ ) {
+			const idWinVar *var = (const idWinVar *)ops[varOps[i]].a;
+			if (var && var->GetChangeCount() != varOpChangeCounts[i]) {
+				varOpChangeCounts[i] = var->GetChangeCount();
+				opDirty[varOps[i]] = true;
+			}
+		}
+	}
+
+	int oc = ops.Num();
+	for ( int i = 0 ; i < oc ; i++ ) {
+		if (!opDirty[i]) {
+			continue;
+		}
+		opDirty[i] = false;
+		const wexpOp_t &op = ops[i];
+		float oldValue = registers[op.c];
+		EvaluateOp(op, registers);
+		if (Changed(oldValue, registers[op.c])) {
+			MarkConsumers(op.c);
 		}
 	}
 }
@@ -3442,6 +3654,7 @@ void idWindow::ReadFromDemoFile( class idDemoFile *f, bool rebuild ) {
 			f->ReadInt( w.d );
 			ops.Append(w);
 		}
+		regDepsValid = false;
 
 		f->ReadInt( c );
 		for (i = 0; i < c; i++) {
@@ -4037,6 +4250,7 @@ void idWindow::FixupParms() {
 			ops[i].b = -1;
 		}
 	}
+	regDepsValid = false;
 	
 	if (flags & WIN_DESKTOP) {
 		CalcRects(0,0);
@@ -4369,6 +4583,7 @@ bool idWindow::UpdateFromDictionary ( idDict& dict ) {
 	regList.Reset ( );
 	expressionRegisters.Clear ( );
 	ops.Clear ( );
+	regDepsValid = false;
 	
 	for ( i = 0; i < dict.GetNumKeyVals(); i ++ ) {
 		kv = dict.GetKeyVal ( i );
@@ -334,6 +334,8 @@ protected:
 
 	friend class idSimpleWindow;
 	friend class idUserInterfaceLocal;
+	friend class idGuiTokenCacheTest;
+	friend class idGuiRegistersTest;
 	bool IsSimple();
 	void UpdateWinVars();
 	void DisableRegister(const char *_name);
@@ -348,6 +350,9 @@ protected:
 	intptr_t ParseTerm( idParser *src, idWinVar *var = NULL, intptr_t component = 0 );
 	intptr_t ParseExpressionPriority( idParser *src, int priority, idWinVar *var = NULL, intptr_t component = 0 );
 	void EvaluateRegisters(float *registers);
+	void EvaluateOp(const wexpOp_t &op, float *registers);
+	void BuildRegisterDependencies();
+	void EvaluateDirtyRegisters();
 	void SaveExpressionParseState();
 	void RestoreExpressionParseState();
 	void ParseBracedExpression(idParser *src);
@@ -423,6 +428,7 @@ protected:
 
 	static idCVar gui_debug;
 	static idCVar gui_edit;
+	static idCVar gui_dirtyRegs;
 
 	idGuiScriptList *scripts[SCRIPT_COUNT];
 	bool *saveTemps;
@@ -438,6 +444,18 @@ protected:
 	idList<rvNamedEvent*>		namedEvents;		//  added named events
 	idList<float> *saveRegs;
 
+	// registers of the last evaluation and dependencies between ops,
+	// used to re-evaluate only ops whose inputs have changed since then
+	idList<float> evalRegisters;
+	idList<int> regConsumerStart;		// ops reading register r are regConsumers[regConsumerStart[r] .. regConsumerStart[r+1])
+	idList<int> regConsumers;
+	idList<int> varOps;					// ops reading window variables
+	idList<int> varOpChangeCounts;		// change count of the variable read by varOps[i] when it was last evaluated
+	int varsGlobalChangeCount;			// idWinVar::GetGlobalChangeCount when variables were last checked
+	idList<bool> opDirty;
+	bool regDepsValid;					// false when ops have changed since BuildRegisterDependencies
+	bool regDepsOrdered;				// every op reads only constants or results of preceding ops
+
 	idRegisterList regList;
 
 	idWinBool	hideCursor;
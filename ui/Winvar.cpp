@@ -22,6 +22,8 @@ Project: The Dark Mod (http://www.thedarkmod.com/)
 #include "Winvar.h"
 #include "UserInterfaceLocal.h"
 
+int idWinVar::globalChangeCount = 0;
+
 idWinVar::idWinVar() { 
 	guiDict = NULL; 
 	name = NULL; 
@@ -40,6 +42,7 @@ void idWinVar::SetGuiInfo(idDict *gd, const char *_name) {
 
 
 void idWinVar::Init(const char *_name, idWindow *win) {
+	Changed();
 	idStr key = _name;
 	guiDict = NULL;
 	int len = key.Length();
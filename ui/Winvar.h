@@ -77,12 +77,30 @@ public:
 		return eval;
 	}
 
+	// bumped whenever the value may have changed: idWindow re-evaluates only expressions over changed vars
+	int GetChangeCount() const { return changeCount; }
+	static int GetGlobalChangeCount() { return globalChangeCount; }
+
 protected:
 	virtual bool _Set(const char *val, bool dryRun) = 0;
 
+	void Changed() {
+		changeCount++;
+		globalChangeCount++;
+	}
+	// state dict values are read on every update, only count them when they differ
+	template<class type> void UpdateData( type &data, const type &value ) {
+		if ( !( data == value ) ) {
+			data = value;
+			Changed();
+		}
+	}
+
 	idDict *guiDict;
 	char *name;
 	bool eval;
+	int changeCount = 0;
+	static int globalChangeCount;
 };
 
 class idWinBool : public idWinVar {
@@ -98,6 +116,7 @@ public:
 	int	operator==(	const bool &other ) { return (other == data); }
 	bool &operator=(	const bool &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->SetBool(GetName(), data);
 		}
@@ -106,6 +125,7 @@ public:
 	idWinBool &operator=( const idWinBool &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 
@@ -118,6 +138,7 @@ public:
 		// stgatilov #5869: other integers will work fine, but better warn
 		good = good && (parsedVal == 0 || parsedVal == 1);
 		if (!dryRun) {
+			Changed();
 			data = ( parsedVal != 0 );
 			if (guiDict) {
 				guiDict->SetBool(GetName(), data);
@@ -129,7 +150,7 @@ public:
 	virtual void Update() override {	
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetBool( s );
+			UpdateData( data, guiDict->GetBool( s ) );
 		}
 	}
 
@@ -142,6 +163,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 		savefile->Read( &data, sizeof( data ) );
 	}
 
@@ -170,6 +192,7 @@ public:
 	}
 	idStr &operator=(	const idStr &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->Set(GetName(), data);
 		}
@@ -178,6 +201,7 @@ public:
 	idWinStr &operator=( const idWinStr &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	operator const char *() const {
@@ -194,15 +218,16 @@ public:
 	}
 	int Length() {
 		if (guiDict && name && *name) {
-			data = guiDict->GetString(GetName());
+			UpdateData( data, idStr( guiDict->GetString( GetName() ) ) );
 		}
 		return data.Length();
 	}
 	void RemoveColors() {
 		if (guiDict && name && *name) {
-			data = guiDict->GetString(GetName());
+			UpdateData( data, idStr( guiDict->GetString( GetName() ) ) );
 		}
 		data.RemoveColors();
+		Changed();
 	}
 	virtual const char *c_str() const override {
 		return data.c_str();
@@ -210,6 +235,7 @@ public:
 
 	virtual bool _Set(const char *val, bool dryRun) override {
 		if (!dryRun) {
+			Changed();
 			data = val;
 			if ( guiDict ) {
 				guiDict->Set(GetName(), data);
@@ -221,7 +247,7 @@ public:
 	virtual void Update() override {
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetString( s );
+			UpdateData( data, idStr( guiDict->GetString( s ) ) );
 		}
 	}
 
@@ -242,6 +268,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 
 		int len;
 		savefile->Read( &len, sizeof( len ) );
@@ -271,6 +298,7 @@ public:
 	}
 	int &operator=(	const int &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->SetInt(GetName(), data);
 		}
@@ -279,6 +307,7 @@ public:
 	idWinInt &operator=( const idWinInt &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	operator int () const {
@@ -289,6 +318,7 @@ public:
 		int numChars = 0;
 		bool good = (idStr::IsNumeric(val) && sscanf(val, "%d%n", &parsedVal, &numChars) == 1 && !val[numChars]);
 		if (!dryRun) {
+			Changed();
 			data = parsedVal;
 			if (guiDict) {
 				guiDict->SetInt(GetName(), data);
@@ -300,7 +330,7 @@ public:
 	virtual void Update() override {
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetInt( s );
+			UpdateData( data, guiDict->GetInt( s ) );
 		}
 	}
 	virtual const char *c_str() const override {
@@ -314,6 +344,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 		savefile->Read( &data, sizeof( data ) );
 	}
 
@@ -338,10 +369,12 @@ public:
 	idWinFloat &operator=( const idWinFloat &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	float &operator=(	const float &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->SetFloat(GetName(), data);
 		}
@@ -355,6 +388,7 @@ public:
 		int numChars = 0;
 		bool good = (idStr::IsNumeric(val) && sscanf(val, "%f%n", &parsedVal, &numChars) == 1 && !val[numChars]);
 		if (!dryRun) {
+			Changed();
 			data = parsedVal;
 			if (guiDict) {
 				guiDict->SetFloat(GetName(), data);
@@ -365,7 +399,7 @@ public:
 	virtual void Update() override {
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetFloat( s );
+			UpdateData( data, guiDict->GetFloat( s ) );
 		}
 	}
 	virtual const char *c_str() const override {
@@ -378,6 +412,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 		savefile->Read( &data, sizeof( data ) );
 	}
 
@@ -409,10 +444,12 @@ public:
 	idWinRectangle &operator=( const idWinRectangle &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	idRectangle &operator=(	const idVec4 &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->SetVec4(GetName(), other);
 		}
@@ -421,6 +458,7 @@ public:
 
 	idRectangle &operator=(	const idRectangle &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			idVec4 v = data.ToVec4();
 			guiDict->SetVec4(GetName(), v);
@@ -464,6 +502,7 @@ public:
 			ret = sscanf( val, "%f %f %f %f", &v.x, &v.y, &v.w, &v.h );
 		}
 		if (!dryRun) {
+			Changed();
 			data = v;
 			if (guiDict) {
 				idVec4 v = data.ToVec4();
@@ -476,10 +515,7 @@ public:
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
 			idVec4 v = guiDict->GetVec4( s );
-			data.x = v.x;
-			data.y = v.y;
-			data.w = v.z;
-			data.h = v.w;
+			UpdateData( data, idRectangle( v.x, v.y, v.z, v.w ) );
 		}
 	}
 
@@ -493,6 +529,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 		savefile->Read( &data, sizeof( data ) );
 	}
 
@@ -517,11 +554,13 @@ public:
 	idWinVec2 &operator=( const idWinVec2 &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	
 	idVec2 &operator=(	const idVec2 &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->SetVec2(GetName(), data);
 		}
@@ -542,6 +581,7 @@ public:
 			ret = sscanf( val, "%f %f", &v.x, &v.y);
 		}
 		if (!dryRun) {
+			Changed();
 			data = v;
 			if (guiDict) {
 				guiDict->SetVec2(GetName(), data);
@@ -555,7 +595,7 @@ public:
 	virtual void Update() override {
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetVec2( s );
+			UpdateData( data, guiDict->GetVec2( s ) );
 		}
 	}
 	virtual const char *c_str() const override {
@@ -563,6 +603,7 @@ public:
 	}
 	void Zero() {
 		data.Zero();
+		Changed();
 	}
 
 	virtual void WriteToSaveGame( idFile *savefile ) override {
@@ -571,6 +612,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 		savefile->Read( &data, sizeof( data ) );
 	}
 
@@ -595,10 +637,12 @@ public:
 	idWinVec4 &operator=( const idWinVec4 &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	idVec4 &operator=(	const idVec4 &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->SetVec4(GetName(), data);
 		}
@@ -634,6 +678,7 @@ public:
 		//stgatilov: "transition" expects vec4, but it often receives scalar for e.g. "rotation" property
 		bool good = (ret == 4 || ret == 1);
 		if (!dryRun) {
+			Changed();
 			data = v;
 			if ( guiDict ) {
 				guiDict->SetVec4( GetName(), data );
@@ -644,7 +689,7 @@ public:
 	virtual void Update() override {
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetVec4( s );
+			UpdateData( data, guiDict->GetVec4( s ) );
 		}
 	}
 	virtual const char *c_str() const override {
@@ -653,6 +698,7 @@ public:
 
 	void Zero() {
 		data.Zero();
+		Changed();
 		if ( guiDict ) {
 			guiDict->SetVec4(GetName(), data);
 		}
@@ -668,6 +714,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 		savefile->Read( &data, sizeof( data ) );
 	}
 
@@ -692,10 +739,12 @@ public:
 	idWinVec3 &operator=( const idWinVec3 &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	idVec3 &operator=(	const idVec3 &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->SetVector(GetName(), data);
 		}
@@ -726,6 +775,7 @@ public:
 			ret = sscanf( val, "%f %f %f", &v.x, &v.y, &v.z );
 		}
 		if (!dryRun) {
+			Changed();
 			data = v;
 			if (guiDict) {
 				guiDict->SetVector(GetName(), data);
@@ -736,7 +786,7 @@ public:
 	virtual void Update() override {
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetVector( s );
+			UpdateData( data, guiDict->GetVector( s ) );
 		}
 	}
 	virtual const char *c_str() const override {
@@ -745,6 +795,7 @@ public:
 
 	void Zero() {
 		data.Zero();
+		Changed();
 		if (guiDict) {
 			guiDict->SetVector(GetName(), data);
 		}
@@ -756,6 +807,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 		savefile->Read( &data, sizeof( data ) );
 	}
 
@@ -784,6 +836,7 @@ public:
 	}
 	idStr &operator=(	const idStr &other ) {
 		data = other;
+		Changed();
 		if (guiDict) {
 			guiDict->Set(GetName(), data);
 		}
@@ -799,6 +852,7 @@ public:
 	idWinBackground &operator=( const idWinBackground &other ) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		mat = other.mat;
 		if (mat) {
 			if ( data == "" ) {
@@ -817,7 +871,7 @@ public:
 	}
 	int Length() {
 		if (guiDict) {
-			data = guiDict->GetString(GetName());
+			UpdateData( data, idStr( guiDict->GetString( GetName() ) ) );
 		}
 		return data.Length();
 	}
@@ -833,6 +887,7 @@ public:
 			matVal = declManager->FindMaterial(val);
 		}
 		if (!dryRun) {
+			Changed();
 			data = val;
 			if (guiDict) {
 				guiDict->Set(GetName(), data);
@@ -847,7 +902,7 @@ public:
 	virtual void Update() override {
 		const char *s = GetName();
 		if ( guiDict && s[0] != '\0' ) {
-			data = guiDict->GetString( s );
+			UpdateData( data, idStr( guiDict->GetString( s ) ) );
 			if (mat) {
 				if ( data == "" ) {
 					(*mat) = NULL;
@@ -878,6 +933,7 @@ public:
 	}
 	virtual void ReadFromSaveGame( idFile *savefile ) override {
 		savefile->Read( &eval, sizeof( eval ) );
+		Changed();
 
 		int len;
 		savefile->Read( &len, sizeof( len ) );
@@ -926,12 +982,14 @@ public:
 	}
 	size_t &operator=(const size_t &other) {
 		data = other;
+		Changed();
 		assert(!guiDict);
 		return data;
 	}
 	idWinUIntPtr &operator=(const idWinUIntPtr &other) {
 		idWinVar::operator=(other);
 		data = other.data;
+		Changed();
 		return *this;
 	}
 	operator size_t() const {
@@ -942,6 +1000,7 @@ public:
 		int numChars = 0;
 		bool good = (idStr::IsNumeric(val) && sscanf(val, "%zu%n", &parsedVal, &numChars) == 1 && !val[numChars]);
 		if (!dryRun) {
+			Changed();
 			data = parsedVal;
 			assert(!guiDict);
 		}